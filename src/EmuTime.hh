@@ -6,6 +6,7 @@
 #include <iosfwd>
 #include <cassert>
 #include <limits>
+#include <optional>
 
 namespace openmsx {
 
@@ -61,6 +62,23 @@ public:
 		{ assert(time >= e.time);
 		  return EmuDuration(time - e.time); }
 
+	/** This time plus the given number of seconds. Returns std::nullopt
+	  * when 'seconds' is negative or NaN, or when the result would not be
+	  * before infinity() (so it can't overflow).
+	  */
+	[[nodiscard]] constexpr std::optional<EmuTime> tryAddSeconds(double seconds) const
+	{
+		if (!(seconds >= 0.0)) return {}; // also rejects NaN
+		double ticks = seconds * MAIN_FREQ;
+		auto remaining = std::numeric_limits<uint64_t>::max() - time;
+		// 'remaining' can round up when converted to double, so also
+		// check the (then well-defined) integer conversion.
+		if (!(ticks < double(remaining))) return {};
+		auto d = uint64_t(ticks);
+		if (d >= remaining) return {};
+		return EmuTime(time + d);
+	}
+
 	static constexpr EmuTime zero()
 	{
 		return EmuTime(uint64_t(0));
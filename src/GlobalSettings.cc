@@ -42,6 +42,10 @@ GlobalSettings::GlobalSettings(GlobalCommandController& commandController_)
 			{"hq",   ResampledSoundDevice::RESAMPLE_HQ},
 			{"fast", ResampledSoundDevice::RESAMPLE_LQ},
 			{"blip", ResampledSoundDevice::RESAMPLE_BLIP}})
+	, reverseMemoryLimitSetting(commandController, "reverse_memory_limit",
+		"maximum amount of memory (in MB) used by the reverse history of "
+		"a machine, older history is moved to disk when this limit is "
+		"exceeded, 0 means no limit", 0, 0, 1024 * 1024)
 	, throttleManager(commandController)
 {
 	deadzoneSettings = to_vector(
@@ -47,6 +47,9 @@ public:
 	EnumSetting<ResampledSoundDevice::ResampleType>& getResampleSetting() {
 		return resampleSetting;
 	}
+	IntegerSetting& getReverseMemoryLimitSetting() {
+		return reverseMemoryLimitSetting;
+	}
 	IntegerSetting& getJoyDeadzoneSetting(int i) {
 		return *deadzoneSettings[i];
 	}
@@ -67,6 +70,7 @@ private:
 	StringSetting  umrCallBackSetting;
 	StringSetting  invalidPsgDirectionsSetting;
 	EnumSetting<ResampledSoundDevice::ResampleType> resampleSetting;
+	IntegerSetting reverseMemoryLimitSetting;
 	std::vector<std::unique_ptr<IntegerSetting>> deadzoneSettings;
 	ThrottleManager throttleManager;
 };
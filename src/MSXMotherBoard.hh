@@ -89,6 +89,7 @@ public:
 	void unpause();
 
 	void powerUp();
+	bool isPowered() const { return powered; }
 
 	void doReset();
 	void activate(bool active);
@@ -24,6 +24,7 @@
 #include "Display.hh"
 #include "Mixer.hh"
 #include "AviRecorder.hh"
+#include "PerfCommand.hh"
 #include "GlobalSettings.hh"
 #include "BooleanSetting.hh"
 #include "EnumSetting.hh"
@@ -134,6 +135,18 @@ private:
 	Reactor& reactor;
 };
 
+class AdvanceMachineCommand final : public Command
+{
+public:
+	AdvanceMachineCommand(CommandController& commandController, Reactor& reactor);
+	void execute(span<const TclObject> tokens, TclObject& result) override;
+	string help(const vector<string>& tokens) const override;
+	void tabCompletion(vector<string>& tokens) const override;
+private:
+	Reactor& reactor;
+	vector<MSXMotherBoard*> advancing; // (nested) calls in progress
+};
+
 class StoreMachineCommand final : public Command
 {
 public:
@@ -249,6 +262,8 @@ void Reactor::init()
 		*globalCommandController, *this);
 	activateMachineCommand = make_unique<ActivateMachineCommand>(
 		*globalCommandController, *this);
+	advanceMachineCommand = make_unique<AdvanceMachineCommand>(
+		*globalCommandController, *this);
 	storeMachineCommand = make_unique<StoreMachineCommand>(
 		*globalCommandController, *this);
 	restoreMachineCommand = make_unique<RestoreMachineCommand>(
@@ -258,6 +273,8 @@ void Reactor::init()
 	setClipboardCommand = make_unique<SetClipboardCommand>(
 		*globalCommandController);
 	aviRecordCommand = make_unique<AviRecorder>(*this);
+	perfCommand = make_unique<PerfCommand>(
+		*globalCommandController, getOpenMSXInfoCommand());
 	extensionInfo = make_unique<ConfigInfo>(
 		getOpenMSXInfoCommand(), "extensions");
 	machineInfo   = make_unique<ConfigInfo>(
@@ -887,6 +904,81 @@ void ActivateMachineCommand::tabCompletion(vector<string>& tokens) const
 }
 
 
+// class AdvanceMachineCommand
+
+AdvanceMachineCommand::AdvanceMachineCommand(
+	CommandController& commandController_, Reactor& reactor_)
+	: Command(commandController_, "advance_machine")
+	, reactor(reactor_)
+{
+}
+
+void AdvanceMachineCommand::execute(span<const TclObject> tokens,
+                                    TclObject& result)
+{
+	checkNumArgs(tokens, Between{2, 3}, Prefix{1}, "id ?seconds?");
+	auto& board = reactor.getMachine(tokens[1].getString());
+	if (&board == reactor.activeBoard) {
+		throw CommandException(
+			"Can't advance the active machine, it's already "
+			"being emulated by the main loop.");
+	}
+	if (!board.isPowered()) {
+		throw CommandException("Machine ", board.getMachineID(),
+		                       " is not powered on.");
+	}
+	if (tokens.size() == 3) {
+		double seconds = tokens[2].getDouble(getInterpreter());
+		auto until = board.getCurrentTime().tryAddSeconds(seconds);
+		if (!until) {
+			throw CommandException(
+				"Duration must be a non-negative number, and "
+				"not beyond the range of emulated time.");
+		}
+		if (contains(advancing, &board)) {
+			// E.g. from a breakpoint or 'after' callback that's
+			// triggered while emulating this same machine.
+			throw CommandException(
+				"Machine ", board.getMachineID(),
+				" is already being advanced.");
+		}
+		// Run as fast as possible (not synced to real time, sound
+		// muted). Unlike reverse, we don't pass 'fast=true' because
+		// then e.g. video frames aren't rendered and screenshots of
+		// this machine would be stale.
+		advancing.push_back(&board);
+		try {
+			board.fastForward(*until, false);
+		} catch (...) {
+			advancing.pop_back();
+			throw;
+		}
+		advancing.pop_back();
+	}
+	result = (board.getCurrentTime() - EmuTime::zero()).toDouble();
+}
+
+string AdvanceMachineCommand::help(const vector<string>& /*tokens*/) const
+{
+	return "advance_machine <id> <seconds>  Emulate the given (inactive) "
+	       "machine for the given amount of emulated time\n"
+	       "advance_machine <id>            Only query the current "
+	       "emulated time of the given machine\n"
+	       "\n"
+	       "The machine is emulated as fast as possible, not synchronized "
+	       "to real time and with its sound muted. Returns the emulated "
+	       "time (in seconds) of that machine after the command finished.\n"
+	       "This allows to step multiple machines inside a single openMSX "
+	       "process, e.g. for batch testing in combination with "
+	       "'set renderer none' and 'set sound_driver null'.";
+}
+
+void AdvanceMachineCommand::tabCompletion(vector<string>& tokens) const
+{
+	completeString(tokens, reactor.getMachineIDs());
+}
+
+
 // class StoreMachineCommand
 
 StoreMachineCommand::StoreMachineCommand(
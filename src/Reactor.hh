@@ -43,11 +43,13 @@ class CreateMachineCommand;
 class DeleteMachineCommand;
 class ListMachinesCommand;
 class ActivateMachineCommand;
+class AdvanceMachineCommand;
 class StoreMachineCommand;
 class RestoreMachineCommand;
 class GetClipboardCommand;
 class SetClipboardCommand;
 class AviRecorder;
+class PerfCommand;
 class ConfigInfo;
 class RealTimeInfo;
 class SoftwareInfoTopic;
@@ -163,11 +165,13 @@ private:
 	std::unique_ptr<DeleteMachineCommand> deleteMachineCommand;
 	std::unique_ptr<ListMachinesCommand> listMachinesCommand;
 	std::unique_ptr<ActivateMachineCommand> activateMachineCommand;
+	std::unique_ptr<AdvanceMachineCommand> advanceMachineCommand;
 	std::unique_ptr<StoreMachineCommand> storeMachineCommand;
 	std::unique_ptr<RestoreMachineCommand> restoreMachineCommand;
 	std::unique_ptr<GetClipboardCommand> getClipboardCommand;
 	std::unique_ptr<SetClipboardCommand> setClipboardCommand;
 	std::unique_ptr<AviRecorder> aviRecordCommand;
+	std::unique_ptr<PerfCommand> perfCommand;
 	std::unique_ptr<ConfigInfo> extensionInfo;
 	std::unique_ptr<ConfigInfo> machineInfo;
 	std::unique_ptr<RealTimeInfo> realTimeInfo;
@@ -203,6 +207,7 @@ private:
 	friend class DeleteMachineCommand;
 	friend class ListMachinesCommand;
 	friend class ActivateMachineCommand;
+	friend class AdvanceMachineCommand;
 	friend class StoreMachineCommand;
 	friend class RestoreMachineCommand;
 };
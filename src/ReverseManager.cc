@@ -18,6 +18,8 @@
 #include "Display.hh"
 #include "Reactor.hh"
 #include "CommandException.hh"
+#include "GlobalSettings.hh"
+#include "IntegerSetting.hh"
 #include "MemBuffer.hh"
 #include "ranges.hh"
 #include "serialize.hh"
@@ -106,6 +108,8 @@ void ReverseManager::ReverseHistory::swap(ReverseHistory& other)
 {
 	std::swap(chunks, other.chunks);
 	std::swap(events, other.events);
+	// the memory bookkeeping belongs to the blocks in 'chunks'
+	lastDeltaBlocks.swapMemory(other.lastDeltaBlocks);
 }
 
 void ReverseManager::ReverseHistory::clear()
@@ -253,6 +257,13 @@ void ReverseManager::debugInfo(TclObject& result) const
 		totalSize += chunk.size;
 	}
 	strAppend(res, "total size: ", totalSize, '\n');
+	const auto& memory = history.lastDeltaBlocks.getMemory();
+	strAppend(res, "memory usage: ",
+	          getSavestatesSize() + memory.getUsedSize(),
+	          " bytes, moved to disk: ", memory.getStoredSize(), " bytes\n");
+	strAppend(res, "pending compression: ",
+	          history.lastDeltaBlocks.getPendingCompressCount(), " blocks (",
+	          history.lastDeltaBlocks.getPendingCompressBytes(), " bytes)\n");
 	result = res;
 }
 
@@ -869,6 +880,45 @@ void ReverseManager::takeSnapshot(EmuTime::param time)
 	newChunk.time = time;
 	newChunk.savestate = out.releaseBuffer(newChunk.size);
 	newChunk.eventCount = replayIndex;
+
+	enforceMemoryLimit();
+}
+
+size_t ReverseManager::getSavestatesSize() const
+{
+	// There are at most a few hundred snapshots (see dropOldSnapshots()),
+	// so this is cheap.
+	size_t result = 0;
+	for (const auto& [idx, chunk] : history.chunks) {
+		result += chunk.size;
+	}
+	return result;
+}
+
+void ReverseManager::enforceMemoryLimit()
+{
+	// The memory used by the DeltaBlocks is tracked when they are created
+	// and destroyed (on this thread) and when they are compressed or
+	// moved to disk (on the compressor thread). Moving blocks to disk
+	// also happens on that thread, so that the (slow) disk writes don't
+	// stall the emulation. Only the DeltaBlocks can be moved, so the
+	// savestates themselves are subtracted from the limit.
+	auto& memory = history.lastDeltaBlocks.getMemory();
+	size_t limit = size_t(motherBoard.getReactor().getGlobalSettings()
+	                      .getReverseMemoryLimitSetting().getInt()) * 1024 * 1024;
+	if (limit == 0) {
+		memory.setLimit(DeltaBlockMemory::NO_LIMIT);
+	} else {
+		memory.setLimit(limit - std::min(limit, getSavestatesSize()));
+		history.lastDeltaBlocks.enforceMemoryLimit();
+	}
+
+	// After a disk error, memory.evict() won't try again (for this
+	// history), so this warning is only printed once.
+	if (auto error = memory.takeError(); !error.empty()) {
+		motherBoard.getMSXCliComm().printWarning(
+			"Couldn't move reverse history to disk: ", error);
+	}
 }
 
 void ReverseManager::replayNextEvent()
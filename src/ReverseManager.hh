@@ -99,6 +99,8 @@ private:
 	                     unsigned oldEventCount);
 	void transferState(MSXMotherBoard& newBoard);
 	void takeSnapshot(EmuTime::param time);
+	size_t getSavestatesSize() const;
+	void enforceMemoryLimit();
 	void schedule(EmuTime::param time);
 	void replayNextEvent();
 	template<unsigned N> void dropOldSnapshots(unsigned count);
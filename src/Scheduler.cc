@@ -2,6 +2,7 @@
 #include "Schedulable.hh"
 #include "Thread.hh"
 #include "MSXCPU.hh"
+#include "PerfCounters.hh"
 #include "ranges.hh"
 #include "serialize.hh"
 #include "stl.hh"
@@ -38,9 +39,7 @@ void Scheduler::setSyncPoint(EmuTime::param time, Schedulable& device)
 
 	// Push sync point into queue.
 	queue.insert(SynchronizationPoint(time, &device),
-	             [](SynchronizationPoint& sp) { sp.setTime(EmuTime::infinity()); },
-	             [](const SynchronizationPoint& x, const SynchronizationPoint& y) {
-	                     return x.getTime() < y.getTime(); });
+	             SetSentinelSyncPoint(), LessSyncPoint());
 
 	if (!scheduleInProgress && cpu) {
 		// only when scheduleHelper() is not being executed
@@ -52,9 +51,15 @@ void Scheduler::setSyncPoint(EmuTime::param time, Schedulable& device)
 
 Scheduler::SyncPoints Scheduler::getSyncPoints(const Schedulable& device) const
 {
+#ifdef USE_SCHEDULER_HEAP
+	// The heap is not sorted. Sort on time and (for equal times) insertion
+	// order, that keeps savestates identical to the sorted queue.
+	return queue.sorted_if(EqualSchedulable(device));
+#else
 	SyncPoints result;
 	ranges::copy_if(queue, back_inserter(result), EqualSchedulable(device));
 	return result;
+#endif
 }
 
 bool Scheduler::removeSyncPoint(Schedulable& device)
@@ -73,6 +78,15 @@ bool Scheduler::pendingSyncPoint(const Schedulable& device,
                                  EmuTime& result) const
 {
 	assert(Thread::isMainThread());
+#ifdef USE_SCHEDULER_HEAP
+	// (the first one found in the heap is not necessarily the earliest)
+	if (auto* sp = queue.find_first(EqualSchedulable(device))) {
+		result = sp->getTime();
+		return true;
+	} else {
+		return false;
+	}
+#else
 	auto it = ranges::find_if(queue, EqualSchedulable(device));
 	if (it != std::end(queue)) {
 		result = it->getTime();
@@ -80,6 +94,7 @@ bool Scheduler::pendingSyncPoint(const Schedulable& device,
 	} else {
 		return false;
 	}
+#endif
 }
 
 EmuTime::param Scheduler::getCurrentTime() const
@@ -90,6 +105,7 @@ EmuTime::param Scheduler::getCurrentTime() const
 
 void Scheduler::scheduleHelper(EmuTime::param limit, EmuTime next)
 {
+	ScopedPerfTimer perfTimer(PerfCounter::SCHEDULER);
 	assert(!scheduleInProgress);
 	scheduleInProgress = true;
 	while (true) {
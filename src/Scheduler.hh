@@ -3,9 +3,20 @@
 
 #include "EmuTime.hh"
 #include "SchedulerQueue.hh"
+#include "SchedulerHeap.hh"
 #include "likely.hh"
 #include <vector>
 
+//
+// #define USE_SCHEDULER_HEAP
+//
+// By default the sync points are stored in a SchedulerQueue (a sorted array).
+// When this is defined a SchedulerHeap (a 4-ary heap) is used instead. Both
+// give exactly the same emulation results, but the heap has O(log(N))
+// worst-case insertion. See src/unittest/SchedulerQueue_test.cc for a
+// benchmark, so far SchedulerQueue is faster for all realistic machine
+// configurations.
+
 namespace openmsx {
 
 class Schedulable;
@@ -29,6 +40,18 @@ private:
 	Schedulable* device = nullptr;
 };
 
+struct LessSyncPoint {
+	bool operator()(const SynchronizationPoint& x,
+	                const SynchronizationPoint& y) const {
+		return x.getTime() < y.getTime();
+	}
+};
+struct SetSentinelSyncPoint {
+	void operator()(SynchronizationPoint& sp) const {
+		sp.setTime(EmuTime::infinity());
+	}
+};
+
 
 class Scheduler
 {
@@ -111,7 +134,11 @@ private:
 	/** Vector used as heap, not a priority queue because that
 	  * doesn't allow removal of non-top element.
 	  */
+#ifdef USE_SCHEDULER_HEAP
+	SchedulerHeap<SynchronizationPoint, LessSyncPoint> queue;
+#else
 	SchedulerQueue<SynchronizationPoint> queue;
+#endif
 	EmuTime scheduleTime = EmuTime::zero();
 	MSXCPU* cpu = nullptr;
 	bool scheduleInProgress = false;
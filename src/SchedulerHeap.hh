@@ -0,0 +1,222 @@
+#ifndef SCHEDULERHEAP_HH
+#define SCHEDULERHEAP_HH
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+namespace openmsx {
+
+// Alternative for SchedulerQueue: a 4-ary min-heap. It has the same interface
+// (so the Scheduler can use either), but has O(log(N)) instead of O(N)
+// worst-case insert. Though the benchmark in SchedulerQueue_test.cc shows
+// that for realistic numbers of Schedulables (even for a few hundred) the
+// sorted array in SchedulerQueue is still faster: its linear insert only
+// moves a few cache lines, while the heap needs more comparisons per
+// remove_front() and removing (all) sync points of a device is a linear
+// search for both. So SchedulerQueue remains the default.
+//
+// Like SchedulerQueue, elements that are equivalent according to 'LESS' are
+// removed in the order in which they were inserted. This is required to keep
+// emulation deterministic. It's implemented by storing a sequence number
+// next to each element.
+//
+// Unlike SchedulerQueue, iterating over the elements (begin()/end()) does
+// _not_ visit them in sorted order.
+template<typename T, typename LESS> class SchedulerHeap
+{
+	struct Entry {
+		T value;
+		uint64_t seq;
+	};
+
+public:
+	static constexpr size_t ARITY = 4;
+
+	class const_iterator {
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = T;
+		using difference_type = ptrdiff_t;
+		using pointer = const T*;
+		using reference = const T&;
+
+		explicit const_iterator(const Entry* e_) : e(e_) {}
+		const T& operator*()  const { return  e->value; }
+		const T* operator->() const { return &e->value; }
+		const_iterator& operator++() { ++e; return *this; }
+		const_iterator operator++(int) { auto r = *this; ++e; return r; }
+		bool operator==(const const_iterator& o) const { return e == o.e; }
+		bool operator!=(const const_iterator& o) const { return e != o.e; }
+	private:
+		const Entry* e;
+	};
+
+	SchedulerHeap()
+	{
+		heap.reserve(32);
+	}
+
+	size_t size()  const { return heap.size(); }
+	bool   empty() const { return heap.empty(); }
+
+	// Returns the smallest element. When the heap is empty this returns
+	// the sentinel (see insert()), just like SchedulerQueue.
+	const T& front() const { return empty() ? sentinel : heap.front().value; }
+
+	const_iterator begin() const { return const_iterator(heap.data()); }
+	const_iterator end()   const { return const_iterator(heap.data() + heap.size()); }
+
+	// Insert new element. The arguments are the same as for
+	// SchedulerQueue::insert(). Note that 'less' must be the same
+	// comparison as the 'LESS' template parameter.
+	template<typename SET_SENTINEL>
+	void insert(const T& t, SET_SENTINEL setSentinel, LESS /*less*/)
+	{
+		setSentinel(sentinel);
+		heap.push_back({t, counter++});
+		siftUp(heap.size() - 1);
+	}
+
+	// Remove the smallest element.
+	void remove_front()
+	{
+		assert(!empty());
+		removeAt(0);
+	}
+
+	// Returns the smallest element for which the given predicate returns
+	// true, or nullptr if there is none. This is the first such element
+	// when iterating over a SchedulerQueue.
+	template<typename PRED> const T* find_first(PRED p) const
+	{
+		const Entry* best = findFirst(p);
+		return best ? &best->value : nullptr;
+	}
+
+	// Returns all elements for which the given predicate returns true, in
+	// the same order as iterating over a SchedulerQueue would visit them
+	// (so also elements that are equivalent according to 'LESS' are in
+	// insertion order).
+	template<typename PRED> std::vector<T> sorted_if(PRED p) const
+	{
+		std::vector<const Entry*> matches;
+		for (auto& e : heap) {
+			if (p(e.value)) matches.push_back(&e);
+		}
+		std::sort(matches.begin(), matches.end(),
+		          [](const Entry* x, const Entry* y) { return less(*x, *y); });
+		std::vector<T> result;
+		result.reserve(matches.size());
+		for (auto* e : matches) result.push_back(e->value);
+		return result;
+	}
+
+	// Remove the smallest element for which the given predicate returns
+	// true. This is the same element SchedulerQueue::remove() would remove.
+	template<typename PRED> bool remove(PRED p)
+	{
+		const Entry* best = findFirst(p);
+		if (!best) return false;
+		removeAt(best - heap.data());
+		return true;
+	}
+
+	// Remove all elements for which the given predicate returns true.
+	template<typename PRED> void remove_all(PRED p)
+	{
+		// Typically only one or a few elements match, removing those one
+		// by one is cheaper than rebuilding the whole heap.
+		size_t i = 0;
+		while (i < heap.size()) {
+			if (!p(heap[i].value)) {
+				++i;
+				continue;
+			}
+			// Make sure the (last) element that replaces the removed
+			// one doesn't match: it may move up to an already
+			// visited position.
+			while ((heap.size() - 1 > i) && p(heap.back().value)) {
+				heap.pop_back();
+			}
+			removeAt(i); // re-check position 'i'
+		}
+	}
+
+private:
+	template<typename PRED> const Entry* findFirst(PRED p) const
+	{
+		const Entry* best = nullptr;
+		for (auto& e : heap) {
+			if (p(e.value) && (!best || less(e, *best))) best = &e;
+		}
+		return best;
+	}
+
+	static bool less(const Entry& x, const Entry& y)
+	{
+		LESS l;
+		if (l(x.value, y.value)) return true;
+		if (l(y.value, x.value)) return false;
+		return x.seq < y.seq;
+	}
+
+	void siftUp(size_t i)
+	{
+		Entry e = heap[i];
+		while (i > 0) {
+			size_t parent = (i - 1) / ARITY;
+			if (!less(e, heap[parent])) break;
+			heap[i] = heap[parent];
+			i = parent;
+		}
+		heap[i] = e;
+	}
+
+	void siftDown(size_t i)
+	{
+		size_t n = heap.size();
+		Entry e = heap[i];
+		while (true) {
+			size_t first = i * ARITY + 1;
+			if (first >= n) break;
+			size_t last = std::min(first + ARITY, n);
+			size_t best = first;
+			for (size_t c = first + 1; c < last; ++c) {
+				if (less(heap[c], heap[best])) best = c;
+			}
+			if (!less(heap[best], e)) break;
+			heap[i] = heap[best];
+			i = best;
+		}
+		heap[i] = e;
+	}
+
+	void removeAt(size_t i)
+	{
+		assert(i < heap.size());
+		if (i + 1 != heap.size()) {
+			heap[i] = heap.back();
+			heap.pop_back();
+			if ((i > 0) && less(heap[i], heap[(i - 1) / ARITY])) {
+				siftUp(i);
+			} else {
+				siftDown(i);
+			}
+		} else {
+			heap.pop_back();
+		}
+	}
+
+private:
+	std::vector<Entry> heap;
+	T sentinel = T();
+	uint64_t counter = 0;
+};
+
+} // namespace openmsx
+
+#endif // SCHEDULERHEAP_HH
@@ -2,6 +2,7 @@
 #include "CommandController.hh"
 #include "CliComm.hh"
 #include "CommandException.hh"
+#include "PerfCounters.hh"
 #include "StringSetting.hh"
 #include <iostream>
 #include <memory>
@@ -84,6 +85,8 @@ TclObject TclCallback::execute(std::string_view arg1, std::string_view arg2)
 
 TclObject TclCallback::executeCommon(TclObject& command)
 {
+	ScopedPerfTimer perfTimer(PerfCounter::TCL_CALLBACK);
+
 	try {
 		return command.executeCommand(callbackSetting.getInterpreter());
 	} catch (CommandException& e) {
@@ -38,6 +38,7 @@ protected:
 		return clock.getFastAdd(limit - remaining + cc);
 	}
 	void setTime(EmuTime::param time) { sync(); clock.reset(time); }
+	uint64_t getTotalTicks() const { sync(); return clock.getTotalTicks(); }
 	void setFreq(unsigned freq) { clock.setFreq(freq); }
 	void advanceTime(EmuTime::param time);
 	EmuTime calcTime(EmuTime::param time, unsigned ticks) const {
@@ -159,6 +159,7 @@
 // instructions too late.
 
 #include "CPUCore.hh"
+#include "CPUProfiler.hh"
 #include "MSXCPUInterface.hh"
 #include "Scheduler.hh"
 #include "MSXMotherBoard.hh"
@@ -885,6 +886,7 @@ void CPUCore<T>::executeInstructions()
 	T::add(ii.cycles); \
 	T::R800Refresh(*this); \
 	if (likely(!T::limitReached())) { \
+		if (unlikely(profiler != nullptr)) profileInstruction(); \
 		incR(1); \
 		unsigned address = getPC(); \
 		const byte* line = readCacheLine[address >> CacheLine::BITS]; \
@@ -949,6 +951,7 @@ void CPUCore<T>::executeInstructions()
 #ifndef USE_COMPUTED_GOTO
 start:
 #endif
+	if (unlikely(profiler != nullptr)) profileInstruction();
 	unsigned ixy; // for dd_cb/fd_cb
 	byte opcodeMain = RDMEM_OPCODE<0>(T::CC_MAIN);
 	incR(1);
@@ -2439,10 +2442,32 @@ template<class T> inline void CPUCore<T>::cpuTracePre()
 }
 template<class T> inline void CPUCore<T>::cpuTracePost()
 {
+	if (unlikely(profiler != nullptr)) {
+		profileFlush();
+	}
 	if (unlikely(tracingEnabled)) {
 		cpuTracePost_slow();
 	}
 }
+// Called (while profiling) at the start of every instruction, also in the
+// fast loop. Accounts the previous instruction, if any, and starts measuring
+// the current one. The last one is accounted by profileFlush().
+template<class T> void CPUCore<T>::profileInstruction()
+{
+	profileFlush();
+	profileIndex = profiler->getIndex(getPC());
+	profileStartTicks = T::getTotalTicks();
+	profileActive = true;
+}
+template<class T> void CPUCore<T>::profileFlush()
+{
+	if (profileActive) {
+		profiler->addInstruction(
+			profileIndex, unsigned(T::getTotalTicks() - profileStartTicks));
+		profileActive = false;
+	}
+}
+
 template<class T> void CPUCore<T>::cpuTracePost_slow()
 {
 	byte opbuf[4];
@@ -2509,7 +2534,12 @@ template<class T> void CPUCore<T>::executeSlow(ExecIRQ execIRQ)
 		}
 	} else if (unlikely(getHALT())) {
 		// in halt mode
-		incR(T::advanceHalt(T::haltStates(), scheduler.getNext()));
+		unsigned halts = T::advanceHalt(T::haltStates(), scheduler.getNext());
+		incR(halts);
+		if (unlikely(profiler != nullptr)) {
+			profiler->addIdle(profiler->getIndex(getPC()),
+			                  halts * T::haltStates());
+		}
 		setSlowInstructions();
 	} else {
 		cpuTracePre();
@@ -2562,7 +2592,8 @@ template<class T> void CPUCore<T>::execute2(bool fastForward)
 	// SyncPoint could set an IRQ and then we must choose executeSlow())
 	if (fastForward ||
 	    (!interface->anyBreakPoints() && !tracingEnabled)) {
-		// fast path, no breakpoints, no tracing
+		// fast path, no breakpoints, no tracing (profiling is done
+		// per instruction inside executeInstructions())
 		do {
 			if (slowInstructions) {
 				--slowInstructions;
@@ -2574,6 +2605,9 @@ template<class T> void CPUCore<T>::execute2(bool fastForward)
 					if (likely(!T::limitReached())) {
 						// multiple instructions
 						executeInstructions();
+						if (unlikely(profiler != nullptr)) {
+							profileFlush();
+						}
 						// note: pipeline only shifted one
 						// step for multiple instructions
 						endInstruction();
@@ -16,6 +16,7 @@
 namespace openmsx {
 
 class MSXCPUInterface;
+class CPUProfiler;
 class Scheduler;
 class MSXMotherBoard;
 class TclCallback;
@@ -117,6 +118,15 @@ public:
 	 */
 	void setFreq(unsigned freq);
 
+	/**
+	 * Start (non-null) or stop (nullptr) profiling. While profiling every
+	 * instruction is recorded in the profiler.
+	 */
+	void setProfiler(CPUProfiler* profiler_) {
+		profiler = profiler_;
+		profileActive = false;
+	}
+
 	template<typename Archive>
 	void serialize(Archive& ar, unsigned version);
 
@@ -164,10 +174,18 @@ private:
 	/** In sync with traceSetting.getBoolean(). */
 	bool tracingEnabled;
 
+	/** Non-null while profiling, see MSXCPU::startProfile(). */
+	CPUProfiler* profiler = nullptr;
+	uint64_t profileStartTicks = 0;
+	unsigned profileIndex = 0;
+	bool profileActive = false; // profileIndex/StartTicks are valid
+
 	/** 'normal' Z80 and Z80 in a turboR behave slightly different */
 	const bool isTurboR;
 
 
+	void profileInstruction();
+	void profileFlush();
 	inline void cpuTracePre();
 	inline void cpuTracePost();
 	void cpuTracePost_slow();
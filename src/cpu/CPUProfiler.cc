@@ -0,0 +1,96 @@
+#include "CPUProfiler.hh"
+#include "FileException.hh"
+#include "FileOperations.hh"
+#include "TclObject.hh"
+#include "ranges.hh"
+#include "strCat.hh"
+#include "xrange.hh"
+#include <algorithm>
+#include <fstream>
+#include <numeric>
+
+namespace openmsx {
+
+CPUProfiler::CPUProfiler(const byte* slots_)
+	: slots(slots_)
+	, cycles(NUM_SLOTS * 0x10000)
+	, instructions(NUM_SLOTS * 0x10000)
+{
+}
+
+void CPUProfiler::clear()
+{
+	ranges::fill(cycles, 0);
+	ranges::fill(instructions, 0);
+}
+
+uint64_t CPUProfiler::getTotalCycles() const
+{
+	return std::accumulate(begin(cycles), end(cycles), uint64_t(0));
+}
+
+TclObject CPUProfiler::getResult() const
+{
+	std::vector<unsigned> indices;
+	for (auto i : xrange(cycles.size())) {
+		if (cycles[i]) indices.push_back(unsigned(i));
+	}
+	std::stable_sort(begin(indices), end(indices), [&](unsigned x, unsigned y) {
+		return cycles[x] > cycles[y];
+	});
+
+	TclObject result;
+	for (auto i : indices) {
+		unsigned slot = i >> 16;
+		result.addListElement(makeTclList(
+			int(slot / 4), int(slot % 4), int(i & 0xFFFF),
+			// counts may not fit in a (32-bit) Tcl int
+			strCat(instructions[i]), strCat(cycles[i])));
+	}
+	return result;
+}
+
+void CPUProfiler::writeCallgrind(const std::string& filename,
+                                 const std::string& command) const
+{
+	std::ofstream file;
+	FileOperations::openofstream(file, filename);
+	if (!file.is_open()) {
+		throw FileException("Couldn't open file for writing: ", filename);
+	}
+
+	file << "# callgrind format\n"
+	        "version: 1\n"
+	        "creator: openMSX\n"
+	        "cmd: " << command << "\n"
+	        "positions: instr\n"
+	        "events: Cycles Instructions\n"
+	        "summary: " << getTotalCycles() << ' '
+	     << std::accumulate(begin(instructions), end(instructions), uint64_t(0))
+	     << '\n';
+
+	// Each (slot, page) combination is reported as a separate function,
+	// the addresses within that page are the instruction positions.
+	for (auto slot : xrange(NUM_SLOTS)) {
+		for (auto page : xrange(4)) {
+			unsigned first = slot * 0x10000 + page * 0x4000;
+			auto b = begin(cycles) + first;
+			auto e = b + 0x4000;
+			if (std::all_of(b, e, [](uint64_t c) { return c == 0; })) continue;
+
+			file << "\nob=slot " << slot / 4 << '-' << slot % 4
+			     << "\nfn=slot " << slot / 4 << '-' << slot % 4
+			     << " page " << page << '\n';
+			for (auto i : xrange(first, first + 0x4000)) {
+				if (cycles[i] == 0) continue;
+				file << strCat("0x", hex_string<4>(i & 0xFFFF), ' ',
+				               cycles[i], ' ', instructions[i], '\n');
+			}
+		}
+	}
+	if (!file) {
+		throw FileException("Error while writing file: ", filename);
+	}
+}
+
+} // namespace openmsx
@@ -0,0 +1,74 @@
+#ifndef CPUPROFILER_HH
+#define CPUPROFILER_HH
+
+#include "openmsx.hh"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace openmsx {
+
+class TclObject;
+
+/** Accumulates the number of executed instructions and T-states per
+  * (slot, address) pair of the emulated CPU.
+  *
+  * The counters are stored in flat arrays (one entry for every address in
+  * every one of the 16 primary/secondary slot combinations), so recording
+  * an instruction is only an index calculation and two additions.
+  */
+class CPUProfiler
+{
+public:
+	static constexpr unsigned NUM_SLOTS = 16;
+
+	/** @param slots Pointer to the (4 element) array that holds, for each
+	  *              16kB page, the currently visible slot encoded as
+	  *              4 * primarySlot + secondarySlot (see MSXCPU).
+	  */
+	explicit CPUProfiler(const byte* slots);
+
+	void clear();
+
+	/** Index of the counters for the given address in the current slot
+	  * configuration. The index should be taken at the start of an
+	  * instruction, because that instruction itself may switch slots.
+	  */
+	unsigned getIndex(unsigned address) const {
+		address &= 0xFFFF;
+		return slots[address >> 14] * 0x10000 + address;
+	}
+
+	void addInstruction(unsigned index, unsigned ticks) {
+		++instructions[index];
+		cycles[index] += ticks;
+	}
+	/** Cycles spent without executing instructions (e.g. in HALT state). */
+	void addIdle(unsigned index, unsigned ticks) {
+		cycles[index] += ticks;
+	}
+
+	uint64_t getTotalCycles() const;
+
+	/** Returns a Tcl list with for each executed address (sorted on
+	  * descending number of cycles) a sublist
+	  *   {primary-slot secondary-slot address instructions cycles}
+	  */
+	TclObject getResult() const;
+
+	/** Write the profile in callgrind format (can be viewed with tools
+	  * like KCachegrind).
+	  * @throws FileException
+	  */
+	void writeCallgrind(const std::string& filename,
+	                    const std::string& command) const;
+
+private:
+	const byte* slots;
+	std::vector<uint64_t> cycles;
+	std::vector<uint64_t> instructions;
+};
+
+} // namespace openmsx
+
+#endif
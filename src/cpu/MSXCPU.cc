@@ -2,9 +2,11 @@
 #include "MSXCPUInterface.hh"
 #include "MSXMotherBoard.hh"
 #include "Debugger.hh"
+#include "PerfCounters.hh"
 #include "Scheduler.hh"
 #include "IntegerSetting.hh"
 #include "CPUCore.hh"
+#include "CPUProfiler.hh"
 #include "Z80.hh"
 #include "R800.hh"
 #include "TclObject.hh"
@@ -110,6 +112,8 @@ void MSXCPU::setDRAMmode(bool dram)
 
 void MSXCPU::execute(bool fastForward)
 {
+	ScopedPerfTimer perfTimer(PerfCounter::CPU);
+
 	if (z80Active != newZ80Active) {
 		EmuTime time = getCurrentTime();
 		z80Active = newZ80Active;
@@ -331,6 +335,25 @@ CPURegs& MSXCPU::getRegisters()
 	}
 }
 
+void MSXCPU::startProfile()
+{
+	if (profiler) {
+		profiler->clear();
+	} else {
+		profiler = std::make_unique<CPUProfiler>(slots);
+	}
+	          z80 ->setProfiler(profiler.get());
+	if (r800) r800->setProfiler(profiler.get());
+	exitCPULoopSync();
+}
+
+void MSXCPU::stopProfile()
+{
+	          z80 ->setProfiler(nullptr);
+	if (r800) r800->setProfiler(nullptr);
+	exitCPULoopSync();
+}
+
 void MSXCPU::update(const Setting& setting)
 {
 	          z80 ->update(setting);
@@ -19,6 +19,7 @@ class MSXMotherBoard;
 class MSXCPUInterface;
 class CPUClock;
 class CPURegs;
+class CPUProfiler;
 class Z80TYPE;
 class R800TYPE;
 template <typename T> class CPUCore;
@@ -144,6 +145,14 @@ public:
 
 	CPURegs& getRegisters();
 
+	/** Start collecting a new profile (discards the previous one). While
+	  * profiling, emulation runs (a lot) slower, but not as slow as with
+	  * breakpoints that execute Tcl scripts. */
+	void startProfile();
+	void stopProfile();
+	/** Returns the last collected profile, nullptr if never started. */
+	const CPUProfiler* getProfiler() const { return profiler.get(); }
+
 	template<typename Archive>
 	void serialize(Archive& ar, unsigned version);
 
@@ -210,6 +219,8 @@ private:
 	bool newZ80Active;
 
 	MSXCPUInterface* interface = nullptr; // only used for debug
+
+	std::unique_ptr<CPUProfiler> profiler;
 };
 SERIALIZE_CLASS_VERSION(MSXCPU, 2);
 
@@ -4,12 +4,15 @@
 #include "MSXMotherBoard.hh"
 #include "MSXCPU.hh"
 #include "MSXCPUInterface.hh"
+#include "CPUProfiler.hh"
 #include "BreakPoint.hh"
 #include "DebugCondition.hh"
 #include "MSXWatchIODevice.hh"
 #include "TclArgParser.hh"
 #include "TclObject.hh"
 #include "CommandException.hh"
+#include "FileContext.hh"
+#include "FileException.hh"
 #include "MemBuffer.hh"
 #include "ranges.hh"
 #include "stl.hh"
@@ -247,7 +250,8 @@ void Debugger::Cmd::execute(
 		"set_condition",     [&]{ setCondition(tokens, result); },
 		"remove_condition",  [&]{ removeCondition(tokens, result); },
 		"list_conditions",   [&]{ listConditions(tokens, result); },
-		"probe",             [&]{ probe(tokens, result); });
+		"probe",             [&]{ probe(tokens, result); },
+		"profile",           [&]{ profile(tokens, result); });
 }
 
 void Debugger::Cmd::list(TclObject& result)
@@ -698,6 +702,39 @@ void Debugger::Cmd::probeListBreakPoints(
 	result = res;
 }
 
+void Debugger::Cmd::profile(span<const TclObject> tokens, TclObject& result)
+{
+	checkNumArgs(tokens, AtLeast{3}, "subcommand ?arg ...?");
+	auto& cpu = *debugger().cpu;
+	executeSubCommand(tokens[2].getString(),
+		"start", [&]{
+			checkNumArgs(tokens, 3, Prefix{3}, nullptr);
+			cpu.startProfile();
+		},
+		"stop", [&]{
+			checkNumArgs(tokens, 3, Prefix{3}, nullptr);
+			cpu.stopProfile();
+		},
+		"dump", [&]{
+			checkNumArgs(tokens, Between{3, 4}, Prefix{3}, "?filename?");
+			const auto* profiler = cpu.getProfiler();
+			if (!profiler) {
+				throw CommandException("No profile collected yet");
+			}
+			if (tokens.size() == 3) {
+				result = profiler->getResult();
+				return;
+			}
+			try {
+				profiler->writeCallgrind(
+					string(tokens[3].getString()),
+					strCat("openMSX ", debugger().motherBoard.getMachineName()));
+			} catch (FileException& e) {
+				throw CommandException(e.getMessage());
+			}
+		});
+}
+
 string Debugger::Cmd::help(const vector<string>& tokens) const
 {
 	static const string generalHelp =
@@ -725,6 +762,7 @@ string Debugger::Cmd::help(const vector<string>& tokens) const
 		"    break             break CPU at current position\n"
 		"    breaked           query CPU breaked status\n"
 		"    disasm            disassemble instructions\n"
+		"    profile           collect an execution profile of the CPU\n"
 		"  The arguments are specific for each subcommand.\n"
 		"  Type 'help debug <subcommand>' for help about a specific subcommand.\n";
 
@@ -860,6 +898,18 @@ string Debugger::Cmd::help(const vector<string>& tokens) const
 		"    set_bp <probe> [-once] [<cond>] [<cmd>]  set a breakpoint on the given probe\n"
 		"    remove_bp <id>                           remove the given breakpoint\n"
 		"    list_bp                                  returns a list of breakpoints that are set on probes\n";
+	static const string profileHelp =
+		"debug profile <subcommand> [<arguments>]\n"
+		"  Count the executed instructions and T-states per address (and "
+		"per slot) of the emulated CPU. Emulation runs slower while "
+		"profiling. Possible subcommands are:\n"
+		"    start             clear the previous results and start profiling\n"
+		"    stop              stop profiling, the results are kept\n"
+		"    dump              returns a list with an element "
+		"{<primary-slot> <secondary-slot> <address> <instructions> <T-states>} "
+		"for each executed address, sorted on descending T-states\n"
+		"    dump <filename>   write the results in callgrind format to a "
+		"file, this can be viewed with e.g. KCachegrind\n";
 	static const string contHelp =
 		"debug cont\n"
 		"  Continue execution after CPU was breaked.\n";
@@ -925,6 +975,8 @@ string Debugger::Cmd::help(const vector<string>& tokens) const
 		return listCondHelp;
 	} else if (tokens[1] == "probe") {
 		return probeHelp;
+	} else if (tokens[1] == "profile") {
+		return profileHelp;
 	} else if (tokens[1] == "cont") {
 		return contHelp;
 	} else if (tokens[1] == "step") {
@@ -972,7 +1024,7 @@ void Debugger::Cmd::tabCompletion(vector<string>& tokens) const
 	static constexpr const char* const otherCmds[] = {
 		"disasm", "set_bp", "remove_bp", "set_watchpoint",
 		"remove_watchpoint", "set_condition", "remove_condition",
-		"probe",
+		"probe", "profile",
 	};
 	switch (tokens.size()) {
 	case 2: {
@@ -1006,10 +1058,18 @@ void Debugger::Cmd::tabCompletion(vector<string>& tokens) const
 					"remove_bp", "list_bp",
 				};
 				completeString(tokens, subCmds);
+			} else if (tokens[1] == "profile") {
+				static constexpr const char* const subCmds[] = {
+					"start", "stop", "dump",
+				};
+				completeString(tokens, subCmds);
 			}
 		}
 		break;
 	case 4:
+		if ((tokens[1] == "profile") && (tokens[2] == "dump")) {
+			completeFileName(tokens, userFileContext());
+		}
 		if ((tokens[1] == "probe") &&
 		    ((tokens[2] == "desc") || (tokens[2] == "read") ||
 		     (tokens[2] == "set_bp"))) {
@@ -99,6 +99,7 @@ private:
 		void probeSetBreakPoint(span<const TclObject> tokens, TclObject& result);
 		void probeRemoveBreakPoint(span<const TclObject> tokens, TclObject& result);
 		void probeListBreakPoints(span<const TclObject> tokens, TclObject& result);
+		void profile(span<const TclObject> tokens, TclObject& result);
 	} cmd;
 
 	struct NameFromProbe {
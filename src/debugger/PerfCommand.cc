@@ -0,0 +1,155 @@
+#include "PerfCommand.hh"
+#include "PerfCounters.hh"
+#include "CommandException.hh"
+#include "FileContext.hh"
+#include "FileException.hh"
+#include "TclObject.hh"
+#include "view.hh"
+#include "xrange.hh"
+
+namespace openmsx {
+
+static auto getCounterNames()
+{
+	return view::transform(xrange(size_t(PerfCounter::NUM)), [](auto i) {
+		return PerfCounters::getName(PerfCounter(i));
+	});
+}
+
+static TclObject getStats(PerfCounter counter)
+{
+	auto stats = PerfCounters::instance().getStats(counter);
+	// Use doubles, 64-bit counters don't fit in a Tcl int.
+	return makeTclDict(
+		"calls",    double(stats.calls),
+		"total_ms", stats.totalNs * 1e-6,
+		"max_us",   stats.maxNs * 1e-3);
+}
+
+
+PerfCommand::PerfCommand(CommandController& commandController_,
+                         InfoCommand& openMSXInfoCommand)
+	: Command(commandController_, "perf")
+	, info(openMSXInfoCommand)
+{
+}
+
+void PerfCommand::execute(span<const TclObject> tokens, TclObject& result)
+{
+	checkNumArgs(tokens, AtLeast{2}, "subcommand ?arg ...?");
+	auto& perf = PerfCounters::instance();
+	executeSubCommand(tokens[1].getString(),
+		"start", [&]{
+			checkNumArgs(tokens, Between{2, 3}, Prefix{2}, "?-trace?");
+			bool trace = false;
+			if (tokens.size() == 3) {
+				if (tokens[2] != "-trace") throw SyntaxError();
+				trace = true;
+			}
+			perf.start(trace);
+		},
+		"stop", [&]{
+			checkNumArgs(tokens, 2, Prefix{2}, nullptr);
+			perf.stop();
+		},
+		"reset", [&]{
+			checkNumArgs(tokens, 2, Prefix{2}, nullptr);
+			perf.reset();
+		},
+		"status", [&]{
+			checkNumArgs(tokens, 2, Prefix{2}, nullptr);
+			result.addDictKeyValues(
+				"enabled", perf.isEnabled(),
+				"tracing", perf.isTracing(),
+				"trace_events", unsigned(perf.getNumTraceEvents()),
+				"dropped_events", double(perf.getNumDroppedTraceEvents()));
+		},
+		"write_trace", [&]{
+			checkNumArgs(tokens, 3, Prefix{2}, "filename");
+			try {
+				perf.writeChromeTrace(std::string(tokens[2].getString()));
+			} catch (FileException& e) {
+				throw CommandException(e.getMessage());
+			}
+		});
+}
+
+std::string PerfCommand::help(const std::vector<std::string>& /*tokens*/) const
+{
+	return "Measure how much host time is spent in the main parts of the "
+	       "emulator. See also 'info perf'.\n"
+	       "perf start            start measuring\n"
+	       "perf start -trace     start measuring and also record a trace of "
+	       "every measured interval\n"
+	       "perf stop             stop measuring (and tracing)\n"
+	       "perf reset            clear all measurements and the trace\n"
+	       "perf status           show whether measuring/tracing is active\n"
+	       "perf write_trace <filename>\n"
+	       "                      write the trace as a Chrome trace JSON file "
+	       "(view it in chrome://tracing or Perfetto)\n";
+}
+
+void PerfCommand::tabCompletion(std::vector<std::string>& tokens) const
+{
+	if (tokens.size() == 2) {
+		static constexpr const char* const cmds[] = {
+			"start", "stop", "reset", "status", "write_trace",
+		};
+		completeString(tokens, cmds);
+	} else if ((tokens.size() == 3) && (tokens[1] == "start")) {
+		static constexpr const char* const options[] = { "-trace" };
+		completeString(tokens, options);
+	} else if ((tokens.size() == 3) && (tokens[1] == "write_trace")) {
+		completeFileName(tokens, userFileContext());
+	}
+}
+
+
+PerfCommand::Info::Info(InfoCommand& openMSXInfoCommand)
+	: InfoTopic(openMSXInfoCommand, "perf")
+{
+}
+
+void PerfCommand::Info::execute(span<const TclObject> tokens,
+                                TclObject& result) const
+{
+	switch (tokens.size()) {
+	case 2:
+		for (auto i : xrange(size_t(PerfCounter::NUM))) {
+			auto counter = PerfCounter(i);
+			result.addDictKeyValue(PerfCounters::getName(counter),
+			                       getStats(counter));
+		}
+		break;
+	case 3: {
+		auto name = tokens[2].getString();
+		for (auto i : xrange(size_t(PerfCounter::NUM))) {
+			auto counter = PerfCounter(i);
+			if (PerfCounters::getName(counter) == name) {
+				result = getStats(counter);
+				return;
+			}
+		}
+		throw CommandException("No such perf counter: ", name);
+	}
+	default:
+		throw CommandException("Too many parameters");
+	}
+}
+
+std::string PerfCommand::Info::help(const std::vector<std::string>& /*tokens*/) const
+{
+	return "Returns the measurements collected with the 'perf' command, "
+	       "optionally for one specific counter. For each counter the "
+	       "number of calls, the total time (in ms) and the maximum time "
+	       "of one call (in us) are given. Counters can be nested (e.g. the "
+	       "renderer runs from within the scheduler), so times are "
+	       "inclusive.";
+}
+
+void PerfCommand::Info::tabCompletion(std::vector<std::string>& tokens) const
+{
+	completeString(tokens, getCounterNames());
+}
+
+} // namespace openmsx
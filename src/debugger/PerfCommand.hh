@@ -0,0 +1,37 @@
+#ifndef PERFCOMMAND_HH
+#define PERFCOMMAND_HH
+
+#include "Command.hh"
+#include "InfoTopic.hh"
+
+namespace openmsx {
+
+class CommandController;
+class InfoCommand;
+
+/** Tcl interface to PerfCounters: the 'perf' command to control the
+  * instrumentation and the 'info perf' topic to query the results.
+  */
+class PerfCommand final : public Command
+{
+public:
+	PerfCommand(CommandController& commandController,
+	            InfoCommand& openMSXInfoCommand);
+
+	void execute(span<const TclObject> tokens, TclObject& result) override;
+	std::string help(const std::vector<std::string>& tokens) const override;
+	void tabCompletion(std::vector<std::string>& tokens) const override;
+
+private:
+	struct Info final : InfoTopic {
+		explicit Info(InfoCommand& openMSXInfoCommand);
+		void execute(span<const TclObject> tokens,
+		             TclObject& result) const override;
+		std::string help(const std::vector<std::string>& tokens) const override;
+		void tabCompletion(std::vector<std::string>& tokens) const override;
+	} info;
+};
+
+} // namespace openmsx
+
+#endif
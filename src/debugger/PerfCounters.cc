@@ -0,0 +1,137 @@
+#include "PerfCounters.hh"
+#include "FileException.hh"
+#include "FileOperations.hh"
+#include "strCat.hh"
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+
+namespace openmsx {
+
+PerfCounters& PerfCounters::instance()
+{
+	static PerfCounters oneInstance;
+	return oneInstance;
+}
+
+std::string_view PerfCounters::getName(PerfCounter counter)
+{
+	static constexpr std::string_view names[size_t(PerfCounter::NUM)] = {
+		"cpu", "scheduler", "renderer", "mixer", "postprocessor",
+		"zmbv_encoder", "tcl_callback",
+	};
+	assert(size_t(counter) < size_t(PerfCounter::NUM));
+	return names[size_t(counter)];
+}
+
+// Small, stable thread ids make the trace easier to read than the
+// (huge) numbers from std::thread::id.
+static unsigned getThreadNum()
+{
+	static std::atomic<unsigned> counter{0};
+	thread_local unsigned num = ++counter;
+	return num;
+}
+
+void PerfCounters::start(bool trace)
+{
+	tracing = trace;
+	enabled = true;
+}
+
+void PerfCounters::stop()
+{
+	enabled = false;
+	tracing = false;
+}
+
+void PerfCounters::reset()
+{
+	for (auto& c : counters) {
+		c.calls = 0;
+		c.totalNs = 0;
+		c.maxNs = 0;
+	}
+	std::lock_guard<std::mutex> lock(traceMutex);
+	traceEvents.clear();
+	traceEvents.shrink_to_fit();
+	dropped = 0;
+}
+
+PerfCounters::Stats PerfCounters::getStats(PerfCounter counter) const
+{
+	auto& c = counters[size_t(counter)];
+	return {c.calls, c.totalNs, c.maxNs};
+}
+
+size_t PerfCounters::getNumTraceEvents() const
+{
+	std::lock_guard<std::mutex> lock(traceMutex);
+	return traceEvents.size();
+}
+
+uint64_t PerfCounters::getNumDroppedTraceEvents() const
+{
+	std::lock_guard<std::mutex> lock(traceMutex);
+	return dropped;
+}
+
+void PerfCounters::record(PerfCounter counter, uint64_t startNs, uint64_t endNs)
+{
+	uint64_t duration = endNs - startNs;
+	auto& c = counters[size_t(counter)];
+	c.calls.fetch_add(1, std::memory_order_relaxed);
+	c.totalNs.fetch_add(duration, std::memory_order_relaxed);
+	uint64_t prevMax = c.maxNs.load(std::memory_order_relaxed);
+	while ((duration > prevMax) &&
+	       !c.maxNs.compare_exchange_weak(prevMax, duration,
+	                                      std::memory_order_relaxed)) {
+		// retry
+	}
+
+	if (tracing.load(std::memory_order_relaxed)) {
+		unsigned thread = getThreadNum();
+		std::lock_guard<std::mutex> lock(traceMutex);
+		if (traceEvents.size() < MAX_TRACE_EVENTS) {
+			traceEvents.push_back({startNs, duration, counter, thread});
+		} else {
+			++dropped;
+		}
+	}
+}
+
+void PerfCounters::writeChromeTrace(const std::string& filename) const
+{
+	std::lock_guard<std::mutex> lock(traceMutex);
+
+	std::ofstream file;
+	FileOperations::openofstream(file, filename);
+	if (!file.is_open()) {
+		throw FileException("Couldn't open file for writing: ", filename);
+	}
+
+	uint64_t base = traceEvents.empty() ? 0 : std::min_element(
+		begin(traceEvents), end(traceEvents),
+		[](auto& x, auto& y) { return x.startNs < y.startNs; })->startNs;
+
+	// Timestamps and durations are in microseconds, keep ns precision.
+	auto us = [](uint64_t ns) {
+		return strCat(ns / 1000, '.', ns % 1000 / 100, ns % 100 / 10, ns % 10);
+	};
+	file << "{\"traceEvents\":[";
+	bool first = true;
+	for (auto& e : traceEvents) {
+		file << (first ? "\n" : ",\n")
+		     << strCat("{\"name\":\"", getName(e.counter),
+		               "\",\"cat\":\"openMSX\",\"ph\":\"X\",\"ts\":",
+		               us(e.startNs - base), ",\"dur\":", us(e.durationNs),
+		               ",\"pid\":1,\"tid\":", e.thread, '}');
+		first = false;
+	}
+	file << "\n],\"displayTimeUnit\":\"ns\"}\n";
+	if (!file) {
+		throw FileException("Error while writing file: ", filename);
+	}
+}
+
+} // namespace openmsx
@@ -0,0 +1,131 @@
+#ifndef PERFCOUNTERS_HH
+#define PERFCOUNTERS_HH
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace openmsx {
+
+/** The (host) code paths that are instrumented. */
+enum class PerfCounter {
+	CPU,            // MSXCPU::execute()
+	SCHEDULER,      // Scheduler::scheduleHelper()
+	RENDERER,       // PixelRenderer::renderUntil()
+	MIXER,          // MSXMixer::generate()
+	POST_PROCESSOR, // PostProcessor::paint()
+	ZMBV_ENCODER,   // ZMBVEncoder::compressFrame()
+	TCL_CALLBACK,   // TclCallback::execute()
+	NUM // must be last
+};
+
+/** Runtime enabled host-time instrumentation of the main emulation hot
+  * paths. When disabled the only cost of a ScopedPerfTimer is one (relaxed)
+  * atomic load. When enabled, the number of calls and the total and maximum
+  * host time per PerfCounter are accumulated. Optionally every timed
+  * interval is also recorded so that it can be written as a Chrome trace
+  * (viewable in chrome://tracing or Perfetto).
+  *
+  * Timers can be nested (e.g. the renderer is called from within the
+  * scheduler), so reported times are inclusive.
+  *
+  * This class is thread-safe: timers may run in any thread.
+  */
+class PerfCounters
+{
+public:
+	struct Stats {
+		uint64_t calls;
+		uint64_t totalNs;
+		uint64_t maxNs;
+	};
+
+	static PerfCounters& instance();
+
+	static std::string_view getName(PerfCounter counter);
+	static uint64_t getTimeNs() {
+		using namespace std::chrono;
+		return duration_cast<nanoseconds>(
+			steady_clock::now().time_since_epoch()).count();
+	}
+
+	bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+	bool isTracing() const { return tracing; }
+
+	/** Start collecting, optionally also record a trace. This does not
+	  * reset the previously collected data. */
+	void start(bool trace);
+	void stop();
+	void reset();
+
+	Stats getStats(PerfCounter counter) const;
+	size_t getNumTraceEvents() const;
+	uint64_t getNumDroppedTraceEvents() const;
+
+	void record(PerfCounter counter, uint64_t startNs, uint64_t endNs);
+
+	/** Write the recorded trace events in Chrome trace event format.
+	  * @throws FileException */
+	void writeChromeTrace(const std::string& filename) const;
+
+private:
+	PerfCounters() = default;
+
+	struct Counter {
+		std::atomic<uint64_t> calls{0};
+		std::atomic<uint64_t> totalNs{0};
+		std::atomic<uint64_t> maxNs{0};
+	};
+	struct TraceEvent {
+		uint64_t startNs;
+		uint64_t durationNs;
+		PerfCounter counter;
+		unsigned thread;
+	};
+	// limit memory usage when a trace is accidentally left running
+	static constexpr size_t MAX_TRACE_EVENTS = 1000000;
+
+	Counter counters[size_t(PerfCounter::NUM)];
+	std::atomic<bool> enabled{false};
+	std::atomic<bool> tracing{false};
+
+	mutable std::mutex traceMutex; // protects the members below
+	std::vector<TraceEvent> traceEvents;
+	uint64_t dropped = 0;
+};
+
+/** Measures the host time between construction and destruction of this
+  * object, but only when PerfCounters are enabled. */
+class ScopedPerfTimer
+{
+public:
+	explicit ScopedPerfTimer(PerfCounter counter_)
+		: counter(counter_)
+		, start(PerfCounters::instance().isEnabled()
+		        ? PerfCounters::getTimeNs() : 0)
+	{
+	}
+
+	~ScopedPerfTimer()
+	{
+		if (start) {
+			PerfCounters::instance().record(
+				counter, start, PerfCounters::getTimeNs());
+		}
+	}
+
+	ScopedPerfTimer(const ScopedPerfTimer&) = delete;
+	ScopedPerfTimer& operator=(const ScopedPerfTimer&) = delete;
+
+private:
+	const PerfCounter counter;
+	const uint64_t start;
+};
+
+} // namespace openmsx
+
+#endif
@@ -75,6 +75,9 @@ enum EventType
 	OPENMSX_MIDI_IN_COREMIDI_VIRTUAL_EVENT,
 	OPENMSX_RS232_TESTER_EVENT,
 
+	/** Sent when the FilePool indexer (background thread) has new results */
+	OPENMSX_FILEPOOL_INDEX_EVENT,
+
 	NUM_EVENT_TYPES // must be last
 };
 
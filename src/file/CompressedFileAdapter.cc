@@ -1,8 +1,10 @@
 #include "CompressedFileAdapter.hh"
+#include "DecompressedCache.hh"
 #include "FileException.hh"
 #include "hash_set.hh"
 #include "xxhash.hh"
 #include <cstring>
+#include <mutex>
 
 using std::string;
 
@@ -15,15 +17,18 @@ struct GetURLFromDecompressed {
 };
 static hash_set<std::shared_ptr<CompressedFileAdapter::Decompressed>,
                 GetURLFromDecompressed, XXHasher> decompressCache;
+// Files are also opened from the FilePool indexer threads.
+static std::mutex decompressCacheMutex;
 
-
-CompressedFileAdapter::CompressedFileAdapter(std::unique_ptr<FileBase> file_)
-	: file(std::move(file_)), pos(0)
+CompressedFileAdapter::CompressedFileAdapter(std::unique_ptr<FileBase> file_,
+                                             bool useDiskCache_)
+	: file(std::move(file_)), pos(0), useDiskCache(useDiskCache_)
 {
 }
 
 CompressedFileAdapter::~CompressedFileAdapter()
 {
+	std::lock_guard<std::mutex> lock(decompressCacheMutex);
 	auto it = decompressCache.find(getURL());
 	decompressed.reset();
 	if (it != end(decompressCache) && it->unique()) {
@@ -37,15 +42,39 @@ void CompressedFileAdapter::decompress()
 	if (decompressed) return;
 
 	string url = getURL();
-	auto it = decompressCache.find(url);
-	if (it != end(decompressCache)) {
-		decompressed = *it;
-	} else {
-		decompressed = std::make_shared<Decompressed>();
-		decompress(*file, *decompressed);
-		decompressed->cachedModificationDate = getModificationDate();
-		decompressed->cachedURL = std::move(url);
-		decompressCache.insert_noDuplicateCheck(decompressed);
+	{
+		std::lock_guard<std::mutex> lock(decompressCacheMutex);
+		auto it = decompressCache.find(url);
+		if (it != end(decompressCache)) decompressed = *it;
+	}
+	if (!decompressed) {
+		// Don't hold the lock while decompressing, so that different
+		// files can be decompressed in parallel.
+		auto result = std::make_shared<Decompressed>();
+		if (useDiskCache) {
+			auto& diskCache = DecompressedCache::instance();
+			string path = diskCache.getPath(file->mmap());
+			if (!diskCache.load(path, *result)) {
+				decompress(*file, *result);
+				result->data = result->buf.data();
+				diskCache.store(path, *result);
+			}
+		} else {
+			decompress(*file, *result);
+			result->data = result->buf.data();
+		}
+		result->cachedModificationDate = getModificationDate();
+		result->cachedURL = std::move(url);
+
+		std::lock_guard<std::mutex> lock(decompressCacheMutex);
+		auto it = decompressCache.find(result->cachedURL);
+		if (it != end(decompressCache)) {
+			// another thread was faster
+			decompressed = *it;
+		} else {
+			decompressed = std::move(result);
+			decompressCache.insert_noDuplicateCheck(decompressed);
+		}
 	}
 
 	// close original file after succesful decompress
@@ -58,8 +87,7 @@ void CompressedFileAdapter::read(void* buffer, size_t num)
 	if (decompressed->size < (pos + num)) {
 		throw FileException("Read beyond end of file");
 	}
-	const auto& buf = decompressed->buf;
-	memcpy(buffer, buf.data() + pos, num);
+	memcpy(buffer, decompressed->data + pos, num);
 	pos += num;
 }
 
@@ -71,7 +99,7 @@ void CompressedFileAdapter::write(const void* /*buffer*/, size_t /*num*/)
 span<uint8_t> CompressedFileAdapter::mmap()
 {
 	decompress();
-	return { decompressed->buf.data(), decompressed->size };
+	return { decompressed->data, decompressed->size };
 }
 
 void CompressedFileAdapter::munmap()
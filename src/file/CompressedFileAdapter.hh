@@ -12,6 +12,8 @@ class CompressedFileAdapter : public FileBase
 public:
 	struct Decompressed {
 		MemBuffer<uint8_t> buf;
+		std::unique_ptr<FileBase> mapped; // entry in the on-disk cache
+		uint8_t* data; // points into 'buf' or into 'mapped'
 		size_t size;
 		std::string originalName;
 		std::string cachedURL;
@@ -33,7 +35,10 @@ public:
 	time_t getModificationDate() final override;
 
 protected:
-	explicit CompressedFileAdapter(std::unique_ptr<FileBase> file);
+	/** @param useDiskCache Look up (and store) the decompressed content
+	  *                     in the DecompressedCache?
+	  */
+	CompressedFileAdapter(std::unique_ptr<FileBase> file, bool useDiskCache);
 	~CompressedFileAdapter() override;
 	virtual void decompress(FileBase& file, Decompressed& decompressed) = 0;
 
@@ -43,6 +48,7 @@ private:
 	std::unique_ptr<FileBase> file;
 	std::shared_ptr<Decompressed> decompressed;
 	size_t pos;
+	const bool useDiskCache;
 };
 
 } // namespace openmsx
@@ -0,0 +1,180 @@
+#include "DecompressedCache.hh"
+#include "FileException.hh"
+#include "FileOperations.hh"
+#include "LocalFile.hh"
+#include "ReadDir.hh"
+#include "endian.hh"
+#include "ranges.hh"
+#include "sha1.hh"
+#include "strCat.hh"
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+using std::string;
+
+namespace openmsx {
+
+// Layout of an entry (all integers are little endian):
+// - CacheHeader
+// - the original filename (not zero-terminated)
+// - padding up to a multiple of 64 bytes
+// - the decompressed data
+static constexpr char CACHE_MAGIC[8] = {'o', 'M', 'S', 'X', 'u', 'n', 'z', '1'};
+static constexpr size_t CACHE_ALIGN = 64;
+static constexpr size_t MAX_CACHE_SIZE = size_t(512) * 1024 * 1024;
+
+struct CacheHeader {
+	char magic[8];
+	Endian::UA_L64 size;
+	Endian::UA_L32 nameSize;
+	Endian::UA_L32 reserved;
+};
+static_assert(sizeof(CacheHeader) == 24);
+
+static size_t dataOffset(size_t nameSize)
+{
+	return (sizeof(CacheHeader) + nameSize + CACHE_ALIGN - 1) & ~(CACHE_ALIGN - 1);
+}
+
+DecompressedCache::DecompressedCache(string dir_, size_t maxSize_)
+	: dir(std::move(dir_)), maxSize(maxSize_)
+{
+}
+
+DecompressedCache& DecompressedCache::instance()
+{
+	static DecompressedCache oneInstance(
+		FileOperations::getUserDataDir() + "/decompressed", MAX_CACHE_SIZE);
+	return oneInstance;
+}
+
+string DecompressedCache::getPath(span<const uint8_t> compressed) const
+{
+	return strCat(dir, '/',
+	              SHA1::calc(compressed.data(), compressed.size()).toString(),
+	              ".bin");
+}
+
+bool DecompressedCache::load(const string& path, CompressedFileAdapter::Decompressed& d)
+{
+	try {
+		auto file = std::make_unique<LocalFile>(path, "rb");
+		auto mem = file->mmap();
+		if (mem.size() < sizeof(CacheHeader)) return false;
+		const auto& header = *reinterpret_cast<const CacheHeader*>(mem.data());
+		if (memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0) {
+			return false;
+		}
+		size_t nameSize = header.nameSize;
+		size_t offset = dataOffset(nameSize);
+		uint64_t size = header.size;
+		if ((mem.size() < offset) || ((mem.size() - offset) != size)) {
+			return false;
+		}
+		d.originalName.assign(
+			reinterpret_cast<const char*>(mem.data() + sizeof(CacheHeader)),
+			nameSize);
+		d.data = mem.data() + offset;
+		d.size = size;
+		d.mapped = std::move(file);
+	} catch (FileException&) {
+		return false; // typically: not in the cache
+	}
+	FileOperations::touch(path); // for LRU eviction
+	return true;
+}
+
+void DecompressedCache::store(const string& path, const CompressedFileAdapter::Decompressed& d)
+{
+	// Don't let a single file flush the whole cache.
+	if (d.size > (maxSize / 4)) return;
+
+	size_t entrySize = dataOffset(d.originalName.size()) + d.size;
+	try {
+		FileOperations::mkdirp(dir);
+		string tmpFile;
+		bool ok;
+		{
+			auto file = FileOperations::openUniqueFile(dir, tmpFile);
+			if (!file) return;
+
+			CacheHeader header;
+			memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+			header.size = uint64_t(d.size);
+			header.nameSize = uint32_t(d.originalName.size());
+			header.reserved = 0;
+			char padding[CACHE_ALIGN] = {};
+			size_t nameSize = d.originalName.size();
+			size_t padSize = dataOffset(nameSize) - sizeof(header) - nameSize;
+			FILE* f = file.get();
+			ok = (fwrite(&header, sizeof(header), 1, f) == 1) &&
+			     (fwrite(d.originalName.data(), 1, nameSize, f) == nameSize) &&
+			     (fwrite(padding, 1, padSize, f) == padSize) &&
+			     (fwrite(d.data, 1, d.size, f) == d.size) &&
+			     (fflush(f) == 0);
+		}
+		// When another thread or process stored the same entry in the
+		// mean time, this replaces it with an identical copy. On
+		// Windows that fails when the entry is in use, that's fine too.
+		if (!ok || (FileOperations::rename(tmpFile, path) != 0)) {
+			FileOperations::unlink(tmpFile);
+			return;
+		}
+	} catch (FileException&) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!totalSizeKnown) {
+		evict(); // also calculates the size
+	} else {
+		totalSize += entrySize;
+		if (totalSize > maxSize) evict();
+	}
+}
+
+// Determine the size of all entries, and when that's too large remove the
+// least recently used ones. Should be called with 'mutex' locked.
+void DecompressedCache::evict()
+{
+	struct Entry {
+		string path;
+		time_t time;
+		size_t size;
+	};
+	std::vector<Entry> entries;
+	size_t total = 0;
+	ReadDir rd(dir);
+	while (dirent* de = rd.getEntry()) {
+		// also (stale) temporary files
+		string path = strCat(dir, '/', de->d_name);
+		FileOperations::Stat st;
+		if (!FileOperations::getStat(path, st) ||
+		    !FileOperations::isRegularFile(st)) {
+			continue;
+		}
+		entries.push_back({path, FileOperations::getModificationDate(st),
+		                   size_t(st.st_size)});
+		total += st.st_size;
+	}
+
+	if (total > maxSize) {
+		// Remove a bit more than strictly needed, so that this doesn't
+		// have to be done again for the next new entry.
+		ranges::sort(entries, [](const Entry& x, const Entry& y) {
+			return x.time < y.time;
+		});
+		for (auto& e : entries) {
+			if (total <= (maxSize / 4 * 3)) break;
+			// Fails on Windows when the file is still mapped (possibly
+			// by another process), then just try the next one.
+			if (FileOperations::unlink(e.path) == 0) total -= e.size;
+		}
+	}
+	totalSize = total;
+	totalSizeKnown = true;
+}
+
+} // namespace openmsx
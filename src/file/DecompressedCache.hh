@@ -0,0 +1,71 @@
+#ifndef DECOMPRESSEDCACHE_HH
+#define DECOMPRESSEDCACHE_HH
+
+#include "CompressedFileAdapter.hh"
+#include "span.hh"
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace openmsx {
+
+/** Stores the decompressed content of (g)zipped files on disk, so that it
+ * can be reused by later runs of openMSX (or by other openMSX processes
+ * running at the same time).
+ *
+ * The entries are content-addressed: the name is the sha1sum of the
+ * compressed file, so a modified file automatically gets a new entry. Each
+ * entry is written to a temporary file first and then renamed, so an entry
+ * is always complete. Entries are mmap'ed, so the decompressed data is only
+ * loaded in memory once and only when it's actually needed.
+ *
+ * The total size of the cache is bounded: when it gets too large, the least
+ * recently used entries (on a hit the modification time is updated) are
+ * removed. Errors (e.g. read-only or full disk) are ignored, the cache is
+ * only an optimization.
+ */
+class DecompressedCache
+{
+public:
+	/** @param dir Directory that contains the entries (created when
+	  *            needed).
+	  * @param maxSize Maximum total size of all entries (in bytes).
+	  */
+	DecompressedCache(std::string dir, size_t maxSize);
+
+	/** The cache in the openMSX user directory, used for all
+	  * CompressedFileAdapters.
+	  */
+	[[nodiscard]] static DecompressedCache& instance();
+
+	/** The path of the entry for the given compressed data. */
+	[[nodiscard]] std::string getPath(span<const uint8_t> compressed) const;
+
+	/** When the entry exists, map it and fill in 'data', 'size',
+	  * 'originalName' and 'mapped' of 'd'. Returns false otherwise.
+	  */
+	bool load(const std::string& path, CompressedFileAdapter::Decompressed& d);
+
+	/** Store 'data', 'size' and 'originalName' of 'd' as a new entry.
+	  * Afterwards, when the cache is too large, the least recently used
+	  * entries are removed.
+	  */
+	void store(const std::string& path, const CompressedFileAdapter::Decompressed& d);
+
+private:
+	void evict();
+
+	const std::string dir;
+	const size_t maxSize;
+
+	std::mutex mutex; // protects 'totalSize' and 'totalSizeKnown'
+	// Size of all entries. Only rescanned when it gets too large, other
+	// processes using the same cache aren't included before that.
+	size_t totalSize = 0;
+	bool totalSizeKnown = false;
+};
+
+} // namespace openmsx
+
+#endif
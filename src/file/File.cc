@@ -24,9 +24,11 @@ static std::unique_ptr<FileBase> init(std::string_view filename, File::OpenMode
 		file->read(buf, 4);
 		file->seek(0);
 		if (memcmp(buf, GZ_HEADER, 3) == 0) {
-			file = std::make_unique<GZFileAdapter>(std::move(file));
+			file = std::make_unique<GZFileAdapter>(
+				std::move(file), mode != File::READ_ONCE);
 		} else if (memcmp(buf, ZIP_HEADER, 4) == 0) {
-			file = std::make_unique<ZipFileAdapter>(std::move(file));
+			file = std::make_unique<ZipFileAdapter>(
+				std::move(file), mode != File::READ_ONCE);
 		} else {
 			// only pre-cache non-compressed files
 			if (mode == File::PRE_CACHE) {
@@ -22,6 +22,8 @@ public:
 		LOAD_PERSISTENT,
 		SAVE_PERSISTENT,
 		PRE_CACHE,
+		READ_ONCE, // e.g. to calculate the sha1sum, don't store
+		           // decompressed content in the DecompressedCache
 	};
 
 	/** Create a closed file handle.
@@ -9,6 +9,7 @@
 #include <shellapi.h>
 #include <io.h>
 #include <direct.h>
+#include <sys/utime.h>
 #include <ctype.h>
 #include <cstdlib>
 #include <cstring>
@@ -18,6 +19,8 @@
 #include <pwd.h>
 #include <climits>
 #include <unistd.h>
+#include <ctime> // for Mac OS X 10.3 this must be included before <utime.h>
+#include <utime.h>
 #endif // ifdef _WIN32_ ... else ...
 
 #include "openmsx.hh" // for ad_printf
@@ -53,6 +56,7 @@
 #include <algorithm>
 #include <sstream>
 #include <cerrno>
+#include <cstdio>
 #include <cstdlib>
 #include <stdexcept>
 #include <cassert>
@@ -296,6 +300,29 @@ int rmdir(const std::string& path)
 #endif
 }
 
+int rename(const std::string& oldPath, const std::string& newPath)
+{
+#ifdef _WIN32
+	return MoveFileExW(utf8to16(oldPath).c_str(), utf8to16(newPath).c_str(),
+	                   MOVEFILE_REPLACE_EXISTING)
+	     ? 0 : -1;
+#else
+	return ::rename(oldPath.c_str(), newPath.c_str());
+#endif
+}
+
+int touch(const std::string& path, time_t time)
+{
+#ifdef _WIN32
+	struct _utimbuf times = {time, time};
+	return _wutime(utf8to16(path).c_str(),
+	               (time == time_t(-1)) ? nullptr : &times);
+#else
+	struct utimbuf times = {time, time};
+	return ::utime(path.c_str(), (time == time_t(-1)) ? nullptr : &times);
+#endif
+}
+
 #ifdef _WIN32
 int deleteRecursive(const std::string& path)
 {
@@ -60,6 +60,19 @@ namespace openmsx::FileOperations {
 	 */
 	int rmdir(const std::string& path);
 
+	/**
+	 * Call rename() in a platform-independent manner. An existing file
+	 * 'newPath' is (atomically) replaced, also on Windows.
+	 */
+	int rename(const std::string& oldPath, const std::string& newPath);
+
+	/**
+	 * Set the access and modification time of an existing file to 'time'
+	 * (by default the current time). Unlike the unix command "touch", this
+	 * doesn't create the file.
+	 */
+	int touch(const std::string& path, time_t time = time_t(-1));
+
 	/** Recurively delete a file or directory and (in case of a directory)
 	  * all its sub-components.
 	  */
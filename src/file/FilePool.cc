@@ -1,4 +1,6 @@
 #include "FilePool.hh"
+#include "FilePoolCache.hh"
+#include "FilePoolIndexer.hh"
 #include "File.hh"
 #include "FileException.hh"
 #include "FileContext.hh"
@@ -13,12 +15,15 @@
 #include "Reactor.hh"
 #include "Timer.hh"
 #include "ranges.hh"
+#include "xrange.hh"
 #include "sha1.hh"
-#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <memory>
+#include <string_view>
+#include <unordered_map>
 
-using std::ifstream;
-using std::ofstream;
 using std::string;
 using std::vector;
 
@@ -36,7 +41,10 @@ private:
 };
 
 
-const char* const FILE_CACHE = "/.filecache";
+const char* const FILE_CACHE = "/.filecache"; // old text format, only read
+const char* const FILE_CACHE_BIN = "/.filecache.bin";
+// While the indexer is busy, write the results to disk at this interval (us).
+constexpr uint64_t WRITE_INTERVAL = 60 * 1000000;
 
 static string initialFilePoolSettingValue()
 {
@@ -59,26 +67,31 @@ FilePool::FilePool(CommandController& controller, Reactor& reactor_)
 		"instead use the 'filepool' command.",
 		initialFilePoolSettingValue())
 	, reactor(reactor_)
+	, lastWriteTime(Timer::getTime())
 	, quit(false)
 {
 	filePoolSetting.attach(*this);
-	reactor.getEventDistributor().registerEventListener(OPENMSX_QUIT_EVENT, *this);
-	try {
-		readSha1sums();
-	} catch (MSXException&) {
-		// ignore, probably .filecache doesn't exist yet
-	}
-	needWrite = false;
+	auto& distributor = reactor.getEventDistributor();
+	distributor.registerEventListener(OPENMSX_QUIT_EVENT, *this);
+	distributor.registerEventListener(OPENMSX_FILEPOOL_INDEX_EVENT, *this);
+	readSha1sums();
 
 	sha1SumCommand = std::make_unique<Sha1SumCommand>(controller, *this);
+
+	indexer = std::make_unique<FilePoolIndexer>(distributor);
+	startIndexer();
 }
 
 FilePool::~FilePool()
 {
-	if (needWrite) {
+	indexer->stop();
+	processIndexResults();
+	if (!unsaved.empty()) {
 		writeSha1sums();
 	}
-	reactor.getEventDistributor().unregisterEventListener(OPENMSX_QUIT_EVENT, *this);
+	auto& distributor = reactor.getEventDistributor();
+	distributor.unregisterEventListener(OPENMSX_FILEPOOL_INDEX_EVENT, *this);
+	distributor.unregisterEventListener(OPENMSX_QUIT_EVENT, *this);
 	filePoolSetting.detach(*this);
 }
 
@@ -87,13 +100,13 @@ void FilePool::insert(const Sha1Sum& sum, time_t time, const string& filename)
 	auto it = ranges::upper_bound(pool, sum, ComparePool());
 	stringBuffer.push_back(filename);
 	pool.emplace(it, sum, time, stringBuffer.back().c_str());
-	needWrite = true;
+	unsaved.push_back({filename, time, sum});
 }
 
 void FilePool::remove(Pool::iterator it)
 {
+	unsaved.push_back({it->filename, time_t(-1), Sha1Sum()});
 	pool.erase(it);
-	needWrite = true;
 }
 
 // Change the sha1sum of the element pointed to by 'it' into 'newSum'.
@@ -103,9 +116,9 @@ void FilePool::remove(Pool::iterator it)
 // Returns true  if the new position is after          the old position.
 bool FilePool::adjust(Pool::iterator it, const Sha1Sum& newSum)
 {
-	needWrite = true;
 	auto newIt = ranges::upper_bound(pool, newSum, ComparePool());
 	it->sum = newSum; // update sum
+	logChange(*it);
 	if (newIt > it) {
 		// move to back
 		rotate(it, it + 1, newIt);
@@ -123,6 +136,11 @@ bool FilePool::adjust(Pool::iterator it, const Sha1Sum& newSum)
 	}
 }
 
+void FilePool::logChange(PoolEntry& entry)
+{
+	unsaved.push_back({entry.filename, entry.getTime(), entry.sum});
+}
+
 time_t FilePool::PoolEntry::getTime()
 {
 	if (time == time_t(-1)) {
@@ -169,6 +187,53 @@ static bool parse(char* line, char* line_end,
 }
 
 void FilePool::readSha1sums()
+{
+	try {
+		if (readBinary()) return;
+	} catch (MSXException&) {
+		// ignore, probably .filecache.bin doesn't exist yet
+	}
+	pool.clear();
+	fileMem.clear();
+	unsaved.clear();
+	diskSize = numDiskEntries = numDiskChanges = 0;
+
+	// Migrate from the old text format (if it exists).
+	try {
+		readText();
+	} catch (MSXException&) {
+		return; // ignore, probably .filecache doesn't exist either
+	}
+	writeSha1sums();
+}
+
+// Returns false when the file is not a valid .filecache.bin.
+bool FilePool::readBinary()
+{
+	assert(pool.empty());
+	assert(fileMem.empty());
+
+	File file(FileOperations::getUserDataDir() + FILE_CACHE_BIN);
+	auto size = file.getSize();
+	fileMem.resize(size);
+	file.read(fileMem.data(), size);
+
+	FilePoolCache::Contents contents;
+	if (!FilePoolCache::parse(fileMem.data(), size, contents)) return false;
+	pool.reserve(contents.entries.size());
+	for (auto& e : contents.entries) {
+		pool.emplace_back(e.sum, e.time, e.filename);
+	}
+	mergeChanges(contents.changes);
+
+	diskHeader = contents.header;
+	diskSize = contents.validSize;
+	numDiskEntries = contents.entries.size();
+	numDiskChanges = contents.changes.size();
+	return true;
+}
+
+void FilePool::readText()
 {
 	assert(pool.empty());
 	assert(fileMem.empty());
@@ -212,24 +277,82 @@ void FilePool::readSha1sums()
 
 void FilePool::writeSha1sums()
 {
-	string cacheFile = FileOperations::getUserDataDir() + FILE_CACHE;
-	ofstream file;
-	FileOperations::openofstream(file, cacheFile);
-	if (!file.is_open()) {
-		return;
-	}
-	for (auto& p : pool) {
-		file << p.sum.toString() << "  ";
-		if (p.timeStr) {
-			file << p.timeStr;
+	// Rewrite the file when the appended changes would become a
+	// significant part of it (they make loading slower).
+	auto maxChanges = std::max<size_t>(1000, numDiskEntries / 4);
+	try {
+		if (diskSize && ((numDiskChanges + unsaved.size()) <= maxChanges)) {
+			appendChanges();
 		} else {
-			assert(p.time != time_t(-1));
-			file << Date::toString(p.time);
+			writeBinary();
 		}
-		file << "  " << p.filename << '\n';
+	} catch (FileException&) {
+		// ignore, but rewrite the whole file on the next attempt
+		diskSize = 0;
 	}
 }
 
+void FilePool::writeBinary()
+{
+	std::vector<FilePoolCache::Entry> entries;
+	entries.reserve(pool.size());
+	for (auto& p : pool) {
+		auto time = p.getTime();
+		if (time == time_t(-1)) continue; // invalid date in old text format
+		entries.push_back({p.sum, time, p.filename});
+	}
+	auto buf = FilePoolCache::encodeEntries(entries);
+
+	// Write to a temporary file and then rename it, so that there's
+	// always a complete file on disk.
+	string cacheFile = FileOperations::getUserDataDir() + FILE_CACHE_BIN;
+	string tmpFile = cacheFile + ".tmp";
+	{
+		File file(tmpFile, File::TRUNCATE);
+		file.write(buf.data(), buf.size());
+	}
+	if (FileOperations::rename(tmpFile, cacheFile) != 0) {
+		FileOperations::unlink(tmpFile);
+		throw FileException("Couldn't rename ", tmpFile);
+	}
+
+	memcpy(&diskHeader, buf.data(), sizeof(diskHeader));
+	diskSize = buf.size();
+	numDiskEntries = entries.size();
+	numDiskChanges = 0;
+	unsaved.clear();
+}
+
+void FilePool::appendChanges()
+{
+	File file(FileOperations::getUserDataDir() + FILE_CACHE_BIN);
+
+	// Only append when the file is still exactly as we left it. When
+	// another process (e.g. a second openMSX instance) rewrote or
+	// appended to it, or when it ends with a partially written change,
+	// rewrite it completely instead.
+	if (file.getSize() != diskSize) {
+		writeBinary();
+		return;
+	}
+	FilePoolCache::Header header;
+	file.read(&header, sizeof(header));
+	if (memcmp(&header, &diskHeader, sizeof(header)) != 0) {
+		writeBinary();
+		return;
+	}
+
+	// Written with a single write() call, right after the valid part of
+	// the file.
+	auto buf = FilePoolCache::encodeChanges(unsaved);
+	file.seek(diskSize);
+	file.write(buf.data(), buf.size());
+
+	diskSize += buf.size();
+	numDiskChanges += unsaved.size();
+	unsaved.clear();
+}
+
 static int parseTypes(Interpreter& interp, const TclObject& list)
 {
 	int result = 0;
@@ -255,6 +378,146 @@ void FilePool::update(const Setting& setting)
 {
 	assert(&setting == &filePoolSetting); (void)setting;
 	getDirectories(); // check for syntax errors
+	startIndexer();
+}
+
+void FilePool::startIndexer()
+{
+	processIndexResults(); // so that 'known' below is up to date
+
+	vector<string> directories;
+	try {
+		for (auto& d : getDirectories()) {
+			directories.push_back(FileOperations::expandTilde(d.path));
+		}
+	} catch (CommandException&) {
+		// ignore, reported when a file is searched
+	}
+	// the same directory can be listed for different types
+	ranges::sort(directories);
+	directories.erase(ranges::unique(directories), end(directories));
+
+	FilePoolIndexer::Known known;
+	known.reserve(pool.size());
+	for (auto& p : pool) {
+		auto time = p.getTime();
+		if (time != time_t(-1)) known.emplace(p.filename, time);
+	}
+	indexer->start(std::move(directories), std::move(known));
+}
+
+// Merge the results of the indexer in the database.
+void FilePool::processIndexResults()
+{
+	auto results = indexer->takeResults();
+	if (results.empty()) return;
+
+	mergeChanges(results);
+	unsaved.insert(end(unsaved), std::make_move_iterator(begin(results)),
+	                             std::make_move_iterator(end(results)));
+}
+
+// For each removed path: 1 + the index of the last change that removed it.
+using Removals = std::unordered_map<std::string_view, size_t>;
+
+// Returns 1 + the index of the last change that removed 'path' or a directory
+// that (indirectly) contains it, or 0 if there's no such change. So this looks
+// up all 'dir' for which FilePoolIndexer::isInside(path, dir) holds.
+static size_t lastRemoval(const Removals& removals, std::string_view path)
+{
+	if (removals.empty()) return 0;
+	size_t result = 0;
+	auto check = [&](std::string_view dir) {
+		if (auto it = removals.find(dir); it != end(removals)) {
+			result = std::max(result, it->second);
+		}
+	};
+	check(path);
+	for (auto pos = path.find('/'); pos != std::string_view::npos;
+	     pos = path.find('/', pos + 1)) {
+		check(path.substr(0, pos));
+	}
+	return result;
+}
+
+// Apply a batch of changes (from the indexer, or from .filecache.bin) to the
+// database. This does a single pass over the pool (instead of a linear search
+// per change), so this is efficient for large batches.
+void FilePool::mergeChanges(const Changes& changes)
+{
+	if (changes.empty()) return;
+
+	// Later changes for the same file override earlier ones. Removing a
+	// file (or a directory) cancels earlier changes for that file (or
+	// the files in that directory).
+	std::unordered_map<std::string_view, size_t> updateIdx;
+	Removals removals;
+	for (auto i : xrange(changes.size())) {
+		auto& r = changes[i];
+		if (r.time == time_t(-1)) {
+			removals[r.filename] = i + 1;
+		} else {
+			updateIdx[r.filename] = i + 1;
+		}
+	}
+	std::unordered_map<std::string_view, const FilePoolIndexer::Result*> updates;
+	updates.reserve(updateIdx.size());
+	for (auto& [filename, idx] : updateIdx) {
+		if (lastRemoval(removals, filename) < idx) {
+			updates.emplace(filename, &changes[idx - 1]);
+		}
+	}
+
+	for (auto& p : pool) {
+		if (auto it = updates.find(p.filename); it != end(updates)) {
+			if (p.sum == it->second->sum) {
+				p.setTime(it->second->time);
+				updates.erase(it);
+			} else {
+				// re-insert (below) at the position for the
+				// new sum
+				p.filename = nullptr;
+			}
+		} else if (lastRemoval(removals, p.filename)) {
+			p.filename = nullptr; // mark for removal
+		}
+	}
+	pool.erase(ranges::remove_if(pool, [](auto& p) { return p.filename == nullptr; }),
+	           end(pool));
+
+	// The remaining entries are still sorted, only sort the new ones
+	// (typically much fewer) and merge them in.
+	auto oldSize = pool.size();
+	for (auto& [filename, r] : updates) {
+		stringBuffer.push_back(r->filename);
+		pool.emplace_back(r->sum, r->time, stringBuffer.back().c_str());
+	}
+	auto middle = begin(pool) + oldSize;
+	std::sort(middle, end(pool), ComparePool());
+	std::inplace_merge(begin(pool), middle, end(pool), ComparePool());
+}
+
+// Wait till the indexer is done (or till it finds the requested file).
+File FilePool::waitForIndexer(const Sha1Sum& sha1sum)
+{
+	auto lastTime = Timer::getTime();
+	while (indexer->isBusy() && !quit) {
+		indexer->waitForResults(std::chrono::milliseconds(250));
+		processIndexResults();
+		File result = getFromPool(sha1sum);
+		if (result.is_open()) return result;
+
+		auto now = Timer::getTime();
+		if (now > (lastTime + 250000)) { // 4Hz
+			lastTime = now;
+			reactor.getCliComm().printProgress(
+				"Searching for file with sha1sum ",
+				sha1sum.toString(), "...\nIndexing filepool: [",
+				indexer->getNumScanned(), ']');
+			reactor.getDisplay().repaintDelayed(0);
+		}
+	}
+	return File(); // not found
 }
 
 FilePool::Directories FilePool::getDirectories() const
@@ -301,9 +564,18 @@ FilePool::Directories FilePool::getDirectories() const
 
 File FilePool::getFile(FileType fileType, const Sha1Sum& sha1sum)
 {
+	processIndexResults();
 	File result = getFromPool(sha1sum);
 	if (result.is_open()) return result;
 
+	result = waitForIndexer(sha1sum);
+	if (result.is_open()) return result;
+	if (indexer->isComplete()) {
+		// The database contains all files in the filepool (and it's
+		// kept up to date), no need to scan the directories.
+		return result;
+	}
+
 	// not found in cache, need to scan directories
 	ScanProgress progress;
 	progress.lastTime = Timer::getTime();
@@ -397,7 +669,7 @@ File FilePool::getFromPool(const Sha1Sum& sha1sum)
 				return file;
 			}
 			it->setTime(newTime); // update timestamp
-			needWrite = true;
+			logChange(*it);
 			auto newSum = calcSha1sum(file, reactor);
 			if (newSum == sha1sum) {
 				// Modification time was changed, but
@@ -533,7 +805,7 @@ FilePool::Pool::iterator FilePool::findInDatabase(const string& filename)
 			if (it->getTime() == time_t(-1)) {
 				// invalid time/date format, remove from db
 				// and continue searching
-				pool.erase(it);
+				remove(it);
 				continue;
 			}
 			return it;
@@ -570,9 +842,20 @@ Sha1Sum FilePool::getSha1Sum(File& file)
 
 int FilePool::signalEvent(const std::shared_ptr<const Event>& event)
 {
-	(void)event; // avoid warning for non-assert compiles
-	assert(event->getType() == OPENMSX_QUIT_EVENT);
-	quit = true;
+	if (event->getType() == OPENMSX_QUIT_EVENT) {
+		quit = true;
+	} else {
+		assert(event->getType() == OPENMSX_FILEPOOL_INDEX_EVENT);
+		processIndexResults();
+		// Save intermediate results, so that they're not lost when
+		// openMSX exits (or crashes) before indexing is finished.
+		auto now = Timer::getTime();
+		if (!unsaved.empty() &&
+		    (!indexer->isBusy() || (now > (lastWriteTime + WRITE_INTERVAL)))) {
+			writeSha1sums();
+			lastWriteTime = now;
+		}
+	}
 	return 0;
 }
 
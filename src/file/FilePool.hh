@@ -2,6 +2,8 @@
 #define FILEPOOL_HH
 
 #include "FileOperations.hh"
+#include "FilePoolCache.hh"
+#include "FilePoolIndexer.hh"
 #include "StringSetting.hh"
 #include "Observer.hh"
 #include "EventListener.hh"
@@ -10,6 +12,7 @@
 #include <cassert>
 #include <cstdint>
 #include <ctime>
+#include <deque>
 #include <memory>
 #include <string>
 #include <vector>
@@ -88,13 +91,24 @@ private:
 		}
 	};
 	using Pool = std::vector<PoolEntry>; // sorted with 'ComparePool'
+	using Changes = std::vector<FilePoolIndexer::Result>;
 
 	void insert(const Sha1Sum& sum, time_t time, const std::string& filename);
 	void remove(Pool::iterator it);
 	bool adjust(Pool::iterator it, const Sha1Sum& newSum);
+	void logChange(PoolEntry& entry);
 
 	void readSha1sums();
+	bool readBinary();
+	void readText();
 	void writeSha1sums();
+	void writeBinary();
+	void appendChanges();
+
+	void startIndexer();
+	void processIndexResults();
+	void mergeChanges(const Changes& changes);
+	File waitForIndexer(const Sha1Sum& sha1sum);
 
 	File getFromPool(const Sha1Sum& sha1sum);
 	File scanDirectory(const Sha1Sum& sha1sum,
@@ -120,12 +134,24 @@ private:
 	StringSetting filePoolSetting;
 	Reactor& reactor;
 	std::unique_ptr<Sha1SumCommand> sha1SumCommand;
-	MemBuffer<char> fileMem; // content of initial .filecache
-	std::vector<std::string> stringBuffer; // owns strings that are not in 'fileMem'
+	MemBuffer<char> fileMem; // content of initial .filecache(.bin)
+	std::deque<std::string> stringBuffer; // owns strings that are not in 'fileMem'
 
 	Pool pool;
+	std::unique_ptr<FilePoolIndexer> indexer;
+
+	// Changes to 'pool' that are not yet stored on disk (oldest first).
+	Changes unsaved;
+	// Header and size of the valid part of .filecache.bin as last read or
+	// written (size 0 if it must be rewritten), number of (sorted) entries
+	// and number of appended changes in it.
+	FilePoolCache::Header diskHeader;
+	size_t diskSize = 0;
+	size_t numDiskEntries = 0;
+	size_t numDiskChanges = 0;
+
+	uint64_t lastWriteTime;
 	bool quit;
-	bool needWrite;
 };
 
 } // namespace openmsx
@@ -0,0 +1,150 @@
+#include "FilePoolCache.hh"
+#include "ranges.hh"
+#include "xrange.hh"
+#include "xxhash.hh"
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace openmsx::FilePoolCache {
+
+static constexpr char MAGIC[8] = {'o', 'M', 'S', 'X', 's', 'h', 'a', '1'};
+static constexpr uint32_t CHANGE_MAGIC = 0x45474843; // "CHGE"
+
+struct BinEntry {
+	uint8_t sum[20];
+	Endian::UA_L32 filename; // offset in string table
+	Endian::UA_L64 time;
+};
+struct BinChange {
+	Endian::UA_L32 magic;
+	Endian::UA_L32 filenameSize; // including zero and padding
+	Endian::UA_L32 check; // xxhash of 'sum', 'time' and the filename
+	uint8_t sum[20];
+	Endian::UA_L64 time;
+};
+static_assert(sizeof(BinEntry)  == 32);
+static_assert(sizeof(BinChange) == 40);
+
+static uint32_t calcCheck(const BinChange& change, size_t filenameSize)
+{
+	auto* p = reinterpret_cast<const char*>(&change) + offsetof(BinChange, sum);
+	return xxhash(std::string_view(p, sizeof(BinChange) - offsetof(BinChange, sum) + filenameSize));
+}
+
+static size_t paddedSize(size_t size)
+{
+	return (size + 7) & ~7;
+}
+
+bool parse(const char* data, size_t size, Contents& result)
+{
+	result.entries.clear();
+	result.changes.clear();
+
+	if (size < sizeof(Header)) return false;
+	memcpy(&result.header, data, sizeof(Header));
+	const auto& header = result.header;
+	if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) return false;
+	size_t numEntries = header.numEntries;
+	size_t stringsSize = header.stringsSize;
+	// (check before multiplying, that could overflow on 32-bit systems)
+	if (numEntries > ((size - sizeof(Header)) / sizeof(BinEntry))) return false;
+	size_t stringsStart = sizeof(Header) + numEntries * sizeof(BinEntry);
+	if ((stringsSize > (size - stringsStart)) || (stringsSize % 8) ||
+	    (stringsSize && data[stringsStart + stringsSize - 1])) {
+		return false;
+	}
+	size_t stringsEnd = stringsStart + stringsSize;
+
+	// sorted part
+	const auto* entries = reinterpret_cast<const BinEntry*>(data + sizeof(Header));
+	const char* strings = data + stringsStart;
+	result.entries.reserve(numEntries);
+	for (auto i : xrange(numEntries)) {
+		const auto& e = entries[i];
+		size_t offset = e.filename;
+		auto time = time_t(int64_t(uint64_t(e.time)));
+		if ((offset >= stringsSize) || (time == time_t(-1))) return false;
+		auto& r = result.entries.emplace_back();
+		r.sum.fromRaw(e.sum);
+		r.time = time;
+		r.filename = strings + offset;
+	}
+	if (!ranges::is_sorted(result.entries, [](auto& x, auto& y) {
+			return x.sum < y.sum; })) {
+		return false;
+	}
+
+	// appended changes
+	size_t pos = stringsEnd;
+	while ((size - pos) >= sizeof(BinChange)) {
+		const auto& c = *reinterpret_cast<const BinChange*>(data + pos);
+		size_t filenameSize = c.filenameSize;
+		if ((c.magic != CHANGE_MAGIC) || (filenameSize == 0) ||
+		    (filenameSize % 8) ||
+		    (filenameSize > (size - pos - sizeof(BinChange)))) {
+			break; // partially written, ignore the rest
+		}
+		size_t next = pos + sizeof(BinChange) + filenameSize;
+		if (data[next - 1] || (c.check != calcCheck(c, filenameSize))) {
+			break;
+		}
+		Sha1Sum sum(Sha1Sum::UninitializedTag{});
+		sum.fromRaw(c.sum);
+		result.changes.push_back({data + pos + sizeof(BinChange),
+		                          time_t(int64_t(uint64_t(c.time))), sum});
+		pos = next;
+	}
+	result.validSize = pos;
+	return true;
+}
+
+std::vector<char> encodeEntries(span<const Entry> entries)
+{
+	std::vector<char> strings;
+	std::vector<BinEntry> binEntries;
+	binEntries.reserve(entries.size());
+	for (auto& e : entries) {
+		auto& b = binEntries.emplace_back();
+		e.sum.toRaw(b.sum);
+		b.filename = uint32_t(strings.size());
+		b.time = uint64_t(int64_t(e.time));
+		std::string_view filename = e.filename;
+		strings.insert(end(strings), begin(filename), end(filename));
+		strings.push_back('\0');
+	}
+	strings.resize(paddedSize(strings.size()), '\0');
+
+	Header header;
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.numEntries = uint32_t(binEntries.size());
+	header.stringsSize = uint32_t(strings.size());
+
+	std::vector<char> result(sizeof(Header));
+	memcpy(result.data(), &header, sizeof(Header));
+	auto* e = reinterpret_cast<const char*>(binEntries.data());
+	result.insert(end(result), e, e + binEntries.size() * sizeof(BinEntry));
+	result.insert(end(result), begin(strings), end(strings));
+	return result;
+}
+
+std::vector<char> encodeChanges(span<const Change> changes)
+{
+	std::vector<char> result;
+	for (auto& u : changes) {
+		auto filenameSize = paddedSize(u.filename.size() + 1);
+		auto pos = result.size();
+		result.resize(pos + sizeof(BinChange) + filenameSize); // zero-filled
+		auto& c = *reinterpret_cast<BinChange*>(&result[pos]);
+		c.magic = CHANGE_MAGIC;
+		c.filenameSize = uint32_t(filenameSize);
+		u.sum.toRaw(c.sum);
+		c.time = uint64_t(int64_t(u.time));
+		memcpy(&result[pos + sizeof(BinChange)], u.filename.data(), u.filename.size());
+		c.check = calcCheck(c, filenameSize);
+	}
+	return result;
+}
+
+} // namespace openmsx::FilePoolCache
@@ -0,0 +1,68 @@
+#ifndef FILEPOOLCACHE_HH
+#define FILEPOOLCACHE_HH
+
+#include "FilePoolIndexer.hh"
+#include "endian.hh"
+#include "sha1.hh"
+#include "span.hh"
+#include <cstddef>
+#include <ctime>
+#include <vector>
+
+/** The on-disk format of the FilePool database (.filecache.bin).
+ *
+ * Layout (all integers are little endian):
+ * - Header
+ * - 'numEntries' entries, sorted on sha1sum
+ * - string table: zero-terminated filenames, padded to a multiple of 8 bytes
+ * - zero or more changes, each followed by a zero-terminated filename
+ *   (padded to a multiple of 8 bytes). These are changes appended after the
+ *   sorted part was written, they must be applied in order. A change with
+ *   time -1 means the file (or directory) was removed.
+ *
+ * The sorted part can be used (e.g. mmap'ed and binary searched) as-is,
+ * without parsing. Saving usually only appends a few changes, the file is
+ * only completely rewritten when there are too many changes. Each change has
+ * a checksum, so a partially written change (e.g. after a crash) is detected.
+ * Then it's ignored, together with everything after it.
+ */
+namespace openmsx::FilePoolCache {
+
+struct Header {
+	char magic[8];
+	Endian::UA_L32 numEntries;
+	Endian::UA_L32 stringsSize;
+};
+static_assert(sizeof(Header) == 16);
+
+struct Entry {
+	Sha1Sum sum;
+	time_t time;
+	const char* filename; // non-owning
+};
+
+using Change = FilePoolIndexer::Result;
+
+struct Contents {
+	Header header;
+	std::vector<Entry> entries; // filenames point inside the parsed data
+	std::vector<Change> changes; // oldest first
+	size_t validSize; // the rest is a partially written change
+};
+
+/** Parse the content of .filecache.bin.
+  * @return false when 'data' isn't a valid .filecache.bin.
+  */
+[[nodiscard]] bool parse(const char* data, size_t size, Contents& result);
+
+/** Create the sorted part of the file.
+  * @param entries Must be sorted on sha1sum, none of them has time -1.
+  */
+[[nodiscard]] std::vector<char> encodeEntries(span<const Entry> entries);
+
+/** Create the data to append to the file for the given changes. */
+[[nodiscard]] std::vector<char> encodeChanges(span<const Change> changes);
+
+} // namespace openmsx::FilePoolCache
+
+#endif
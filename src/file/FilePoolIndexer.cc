@@ -0,0 +1,315 @@
+#include "FilePoolIndexer.hh"
+#include "File.hh"
+#include "FileException.hh"
+#include "Event.hh"
+#include "EventDistributor.hh"
+#include "MemBuffer.hh"
+#include "Poller.hh"
+#include "ReadDir.hh"
+#include "StringOp.hh"
+#include "ThreadPool.hh"
+#include "ranges.hh"
+#include "strCat.hh"
+#include "systemfuncs.hh"
+#include <algorithm>
+#include <cassert>
+
+#if HAVE_INOTIFY_INIT1
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using std::string;
+
+namespace openmsx {
+
+FilePoolIndexer::FilePoolIndexer(EventDistributor& eventDistributor_)
+	: eventDistributor(eventDistributor_)
+{
+}
+
+FilePoolIndexer::~FilePoolIndexer()
+{
+	stop();
+}
+
+bool FilePoolIndexer::isInside(std::string_view path, std::string_view dir)
+{
+	return StringOp::startsWith(path, dir) &&
+	       ((path.size() == dir.size()) || (path[dir.size()] == '/'));
+}
+
+void FilePoolIndexer::start(std::vector<string> directories_, Known known_)
+{
+	stop();
+
+	directories = std::move(directories_);
+	known = std::move(known_);
+	stopping = false;
+	scanning = true;
+	complete = false;
+	watchFailed = false;
+	numScanned = 0;
+
+	// Reading the files in parallel helps, even on a single disk: a lot
+	// of them are small and hashing the larger ones takes about as much
+	// time as reading them.
+	if (!hashers) hashers = std::make_unique<ThreadPool>();
+	poller = std::make_unique<Poller>();
+#if HAVE_INOTIFY_INIT1
+	inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+	thread = std::thread([this] { run(); });
+}
+
+void FilePoolIndexer::stop()
+{
+	if (!thread.joinable()) return;
+
+	stopping = true;
+	poller->abort();
+	thread.join();
+	hashers->wait(); // remaining jobs return immediately
+
+#if HAVE_INOTIFY_INIT1
+	if (inotifyFd != -1) {
+		close(inotifyFd);
+		inotifyFd = -1;
+	}
+#endif
+	watches.clear();
+	modified.clear();
+	known.clear();
+	scanning = false;
+}
+
+std::vector<FilePoolIndexer::Result> FilePoolIndexer::takeResults()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	eventPending = false;
+	std::vector<Result> result;
+	swap(result, results);
+	return result;
+}
+
+void FilePoolIndexer::waitForResults(std::chrono::milliseconds timeout)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	resultsChanged.wait_for(lock, timeout, [&] {
+		return !results.empty() || !isBusy();
+	});
+}
+
+void FilePoolIndexer::addResult(Result&& result)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		results.push_back(std::move(result));
+	}
+	notifyMainThread();
+}
+
+void FilePoolIndexer::notifyMainThread()
+{
+	// Only send a new event after the main thread has picked up the
+	// previous results, so when the main thread is busy, results are
+	// handled in (larger) batches.
+	bool sendEvent;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		sendEvent = !eventPending;
+		eventPending = true;
+	}
+	resultsChanged.notify_all();
+	if (sendEvent) {
+		eventDistributor.distributeEvent(
+			std::make_shared<SimpleEvent>(OPENMSX_FILEPOOL_INDEX_EVENT));
+	}
+}
+
+void FilePoolIndexer::run()
+{
+	for (auto& dir : directories) {
+		if (stopping) break;
+		scanDirectory(dir);
+	}
+	if (!stopping) {
+		// Known files in the scanned directories that were not seen
+		// during the scan no longer exist.
+		for (auto& [filename, time] : known) {
+			if (ranges::any_of(directories, [&](auto& dir) {
+					return isInside(filename, dir); })) {
+				addResult({filename, time_t(-1), Sha1Sum()});
+			}
+		}
+		complete = (inotifyFd != -1) && !watchFailed;
+	}
+	known.clear();
+	scanning = false;
+	notifyMainThread();
+
+	watchLoop();
+}
+
+void FilePoolIndexer::scanDirectory(const string& directory)
+{
+	// Start watching before reading the directory, so that no changes
+	// can get lost.
+	watchDirectory(directory);
+
+	ReadDir dir(directory);
+	while (dirent* d = dir.getEntry()) {
+		if (stopping) return;
+		string file = d->d_name;
+		string path = strCat(directory, '/', file);
+		FileOperations::Stat st;
+		if (FileOperations::getStat(path, st)) {
+			if (FileOperations::isRegularFile(st)) {
+				scanFile(path, st);
+			} else if (FileOperations::isDirectory(st)) {
+				if ((file != ".") && (file != "..")) {
+					scanDirectory(path);
+				}
+			}
+		}
+	}
+}
+
+void FilePoolIndexer::scanFile(const string& filename, const FileOperations::Stat& st)
+{
+	++numScanned;
+	auto time = FileOperations::getModificationDate(st);
+	if (auto it = known.find(filename); it != end(known)) {
+		bool upToDate = it->second == time;
+		known.erase(it); // seen
+		if (upToDate) return;
+	}
+	++pendingHashes;
+	(void)hashers->submit([this, filename, time] { hashFile(filename, time); });
+}
+
+void FilePoolIndexer::hashFile(const string& filename, time_t time)
+{
+	if (!stopping) {
+		try {
+			// Read in large sequential blocks (instead of mmap()),
+			// that keeps the memory usage per thread bounded.
+			constexpr size_t BLOCK_SIZE = 1024 * 1024;
+			File file(filename, File::READ_ONCE);
+			size_t remaining = file.getSize();
+			MemBuffer<uint8_t> buf(std::min(remaining, BLOCK_SIZE));
+			SHA1 sha1;
+			while (remaining && !stopping) {
+				size_t num = std::min(remaining, BLOCK_SIZE);
+				file.read(buf.data(), num);
+				sha1.update(buf.data(), num);
+				remaining -= num;
+			}
+			if (!remaining) addResult({filename, time, sha1.digest()});
+		} catch (FileException&) {
+			// ignore (e.g. no permission), FilePool will try again
+			// when this file is actually needed
+		}
+	}
+	if (--pendingHashes == 0) notifyMainThread();
+}
+
+void FilePoolIndexer::watchDirectory(const string& directory)
+{
+#if HAVE_INOTIFY_INIT1
+	if (inotifyFd == -1) return;
+	int wd = inotify_add_watch(
+		inotifyFd, directory.c_str(),
+		IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM |
+		IN_CREATE | IN_DELETE | IN_ONLYDIR);
+	if (wd == -1) {
+		// Typically because the limit on the number of watches is
+		// reached (see /proc/sys/fs/inotify/max_user_watches).
+		// This can also happen for a directory that's created after
+		// the initial scan, so immediately drop 'complete' as well.
+		watchFailed = true;
+		complete = false;
+		return;
+	}
+	watches[wd] = directory;
+#else
+	(void)directory;
+#endif
+}
+
+#if HAVE_INOTIFY_INIT1
+// Creating a (hard or symbolic) link to an existing file only generates an
+// IN_CREATE event, the file won't be closed after writing.
+static bool isNewLink(const string& path, const FileOperations::Stat& st)
+{
+	if ((st.st_nlink > 1) || (st.st_size != 0)) return true;
+	struct stat lst;
+	return (lstat(path.c_str(), &lst) == 0) && S_ISLNK(lst.st_mode);
+}
+#endif
+
+void FilePoolIndexer::watchLoop()
+{
+#if HAVE_INOTIFY_INIT1
+	if (inotifyFd == -1) return;
+
+	alignas(inotify_event) char buf[16 * 1024];
+	while (!poller->poll(inotifyFd)) {
+		auto len = read(inotifyFd, buf, sizeof(buf));
+		if (len <= 0) continue;
+		for (char* p = buf; p < (buf + len); /**/) {
+			auto& event = *reinterpret_cast<inotify_event*>(p);
+			p += sizeof(inotify_event) + event.len;
+
+			if (event.mask & IN_Q_OVERFLOW) {
+				// Lost some changes, results are no longer
+				// complete.
+				complete = false;
+				continue;
+			}
+			if (event.mask & IN_IGNORED) {
+				watches.erase(event.wd);
+				continue;
+			}
+			auto it = watches.find(event.wd);
+			if ((it == end(watches)) || (event.len == 0)) continue;
+			string path = strCat(it->second, '/', event.name);
+
+			if (event.mask & (IN_DELETE | IN_MOVED_FROM)) {
+				// Also for directories, that removes all
+				// files inside that directory.
+				modified.erase(path);
+				addResult({path, time_t(-1), Sha1Sum()});
+				continue;
+			}
+			if (event.mask & IN_MODIFY) {
+				modified.insert(path);
+				continue;
+			}
+			if ((event.mask & IN_CLOSE_WRITE) && !modified.erase(path)) {
+				// Files are often opened read/write (also by
+				// openMSX itself, including this indexer),
+				// only rescan when actually written.
+				continue;
+			}
+			FileOperations::Stat st;
+			if (!FileOperations::getStat(path, st)) continue;
+			if (FileOperations::isDirectory(st)) {
+				scanDirectory(path);
+			} else if (FileOperations::isRegularFile(st)) {
+				if ((event.mask & IN_CREATE) && !isNewLink(path, st)) {
+					// Wait till a new file is written,
+					// closing it triggers the scan (also
+					// when nothing was written).
+					modified.insert(path);
+					continue;
+				}
+				scanFile(path, st);
+			}
+		}
+	}
+#endif
+}
+
+} // namespace openmsx
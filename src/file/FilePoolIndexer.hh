@@ -0,0 +1,120 @@
+#ifndef FILEPOOLINDEXER_HH
+#define FILEPOOLINDEXER_HH
+
+#include "FileOperations.hh"
+#include "sha1.hh"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace openmsx {
+
+class EventDistributor;
+class Poller;
+class ThreadPool;
+
+/** Keeps the FilePool database up to date in the background.
+ *
+ * A scanner thread walks over the filepool directories. New or modified
+ * files (files that are not yet in the database with the same modification
+ * time) are handed to a pool of worker threads that calculate the
+ * sha1sums. After this initial scan the directories are watched (using
+ * inotify, when available) so that later changes are picked up as well.
+ *
+ * This class never accesses the FilePool database itself. Instead results
+ * are queued and an OPENMSX_FILEPOOL_INDEX_EVENT is sent. FilePool then
+ * retrieves them (in the main thread) with takeResults().
+ */
+class FilePoolIndexer
+{
+public:
+	struct Result {
+		std::string filename;
+		time_t time; // time_t(-1) means the file (or directory) is removed
+		Sha1Sum sum;
+	};
+	/** The files that are already in the database, with their time. */
+	using Known = std::unordered_map<std::string, time_t>;
+
+	explicit FilePoolIndexer(EventDistributor& eventDistributor);
+	~FilePoolIndexer();
+
+	/** (Re)start indexing the given directories. Stops a previous scan
+	  * (or watch) first.
+	  */
+	void start(std::vector<std::string> directories, Known known);
+
+	/** Stop scanning and watching. Blocks until the threads are idle. */
+	void stop();
+
+	/** Results collected since the previous call (oldest first). */
+	[[nodiscard]] std::vector<Result> takeResults();
+
+	/** Wait till new results are available, or till this indexer is no
+	  * longer busy, or till the timeout expires.
+	  */
+	void waitForResults(std::chrono::milliseconds timeout);
+
+	/** Still scanning or calculating sha1sums? */
+	[[nodiscard]] bool isBusy() const { return scanning || (pendingHashes != 0); }
+
+	/** When not busy: do the results (together with the known files)
+	  * cover all files in the directories? That's only the case when all
+	  * directories could be watched for changes.
+	  */
+	[[nodiscard]] bool isComplete() const { return complete && !isBusy(); }
+
+	/** Number of files seen so far (for progress reporting). */
+	[[nodiscard]] unsigned getNumScanned() const { return numScanned; }
+
+	/** Is 'path' equal to 'dir', or a file (indirectly) inside 'dir'? */
+	[[nodiscard]] static bool isInside(std::string_view path, std::string_view dir);
+
+private:
+	void run();
+	void scanDirectory(const std::string& directory);
+	void scanFile(const std::string& filename, const FileOperations::Stat& st);
+	void hashFile(const std::string& filename, time_t time);
+	void addResult(Result&& result);
+	void notifyMainThread();
+	void watchDirectory(const std::string& directory);
+	void watchLoop();
+
+	EventDistributor& eventDistributor;
+
+	// Only accessed by the scanner thread (while it runs).
+	std::vector<std::string> directories;
+	Known known;
+	int inotifyFd = -1; // only used when inotify is available
+	std::unordered_map<int, std::string> watches; // watch descriptor -> dir
+	std::unordered_set<std::string> modified; // written, but not yet closed
+	bool watchFailed = false;
+
+	std::unique_ptr<ThreadPool> hashers;
+	std::unique_ptr<Poller> poller; // (an aborted Poller can't be reused)
+	std::thread thread;
+
+	std::mutex mutex; // protects 'results' and 'eventPending'
+	std::condition_variable resultsChanged;
+	std::vector<Result> results;
+	bool eventPending = false;
+
+	std::atomic<bool> stopping{false};
+	std::atomic<bool> scanning{false};
+	std::atomic<bool> complete{false};
+	std::atomic<unsigned> pendingHashes{0};
+	std::atomic<unsigned> numScanned{0};
+};
+
+} // namespace openmsx
+
+#endif
@@ -12,8 +12,8 @@ constexpr uint8_t COMMENT     = 0x10; // bit 4 set: file comment present
 constexpr uint8_t RESERVED    = 0xE0; // bits 5..7: reserved
 
 
-GZFileAdapter::GZFileAdapter(std::unique_ptr<FileBase> file_)
-	: CompressedFileAdapter(std::move(file_))
+GZFileAdapter::GZFileAdapter(std::unique_ptr<FileBase> file_, bool useDiskCache_)
+	: CompressedFileAdapter(std::move(file_), useDiskCache_)
 {
 }
 
@@ -4,8 +4,8 @@
 
 namespace openmsx {
 
-ZipFileAdapter::ZipFileAdapter(std::unique_ptr<FileBase> file_)
-	: CompressedFileAdapter(std::move(file_))
+ZipFileAdapter::ZipFileAdapter(std::unique_ptr<FileBase> file_, bool useDiskCache_)
+	: CompressedFileAdapter(std::move(file_), useDiskCache_)
 {
 }
 
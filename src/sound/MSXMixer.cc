@@ -3,6 +3,7 @@
 #include "SoundDevice.hh"
 #include "MSXMotherBoard.hh"
 #include "MSXCommandController.hh"
+#include "PerfCounters.hh"
 #include "TclObject.hh"
 #include "ThrottleManager.hh"
 #include "GlobalSettings.hh"
@@ -13,16 +14,21 @@
 #include "AviRecorder.hh"
 #include "Filename.hh"
 #include "CliComm.hh"
+#include "ThreadPool.hh"
 #include "stl.hh"
 #include "aligned.hh"
+#include "likely.hh"
 #include "outer.hh"
 #include "ranges.hh"
 #include "unreachable.hh"
 #include "view.hh"
 #include "vla.hh"
+#include "xrange.hh"
 #include <cassert>
 #include <cmath>
 #include <cstring>
+#include <exception>
+#include <future>
 #include <memory>
 #include <tuple>
 
@@ -409,6 +415,8 @@ static bool approxEqual(float x, float y)
 
 void MSXMixer::generate(float* output, EmuTime::param time, unsigned samples)
 {
+	ScopedPerfTimer perfTimer(PerfCounter::MIXER);
+
 	// The code below is specialized for a lot of cases (before this
 	// routine was _much_ shorter). This is done because this routine
 	// ends up relatively high (top 5) in a profile run.
@@ -436,32 +444,53 @@ void MSXMixer::generate(float* output, EmuTime::param time, unsigned samples)
 	constexpr unsigned HAS_STEREO_FLAG = 2;
 	unsigned usedBuffers = 0;
 
+	// Sound devices are independent of each other, so (when enabled) let
+	// worker threads generate their output in parallel. Afterwards that
+	// output is mixed in the same order as when it was generated
+	// serially, so the result is bit-identical.
+	auto* pool = mixer.getSoundThreadPool();
+	bool parallel = pool && (infos.size() > 1);
+	unsigned pitch = (2 * samples + 3) & ~3; // align for SSE access
+	if (parallel) {
+		generateParallel(*pool, time, samples, pitch);
+	}
+	auto fillBuffer = [&](size_t i, float* buf) {
+		if (!parallel) {
+			return infos[i].device->updateBuffer(samples, buf, time);
+		}
+		if (!parallelResults[i]) return false;
+		unsigned n = infos[i].device->isStereo() ? 2 * samples : samples;
+		memcpy(buf, &parallelBuffer[i * pitch], n * sizeof(float));
+		return true;
+	};
+
 	// FIXME: The Infos should be ordered such that all the mono
 	// devices are handled first
-	for (auto& info : infos) {
+	for (auto i : xrange(infos.size())) {
+		auto& info = infos[i];
 		SoundDevice& device = *info.device;
 		auto l1 = info.left1;
 		auto r1 = info.right1;
 		if (!device.isStereo()) {
 			if (l1 == r1) {
 				if (!(usedBuffers & HAS_MONO_FLAG)) {
-					if (device.updateBuffer(samples, monoBuf, time)) {
+					if (fillBuffer(i, monoBuf)) {
 						usedBuffers |= HAS_MONO_FLAG;
 						mul(monoBuf, samples, l1);
 					}
 				} else {
-					if (device.updateBuffer(samples, tmpBuf, time)) {
+					if (fillBuffer(i, tmpBuf)) {
 						mulAcc(monoBuf, tmpBuf, samples, l1);
 					}
 				}
 			} else {
 				if (!(usedBuffers & HAS_STEREO_FLAG)) {
-					if (device.updateBuffer(samples, stereoBuf, time)) {
+					if (fillBuffer(i, stereoBuf)) {
 						usedBuffers |= HAS_STEREO_FLAG;
 						mulExpand(stereoBuf, samples, l1, r1);
 					}
 				} else {
-					if (device.updateBuffer(samples, tmpBuf, time)) {
+					if (fillBuffer(i, tmpBuf)) {
 						mulExpandAcc(stereoBuf, tmpBuf, samples, l1, r1);
 					}
 				}
@@ -473,23 +502,23 @@ void MSXMixer::generate(float* output, EmuTime::param time, unsigned samples)
 				assert(l2 == 0.0f);
 				assert(r1 == 0.0f);
 				if (!(usedBuffers & HAS_STEREO_FLAG)) {
-					if (device.updateBuffer(samples, stereoBuf, time)) {
+					if (fillBuffer(i, stereoBuf)) {
 						usedBuffers |= HAS_STEREO_FLAG;
 						mul(stereoBuf, 2 * samples, l1);
 					}
 				} else {
-					if (device.updateBuffer(samples, tmpBuf, time)) {
+					if (fillBuffer(i, tmpBuf)) {
 						mulAcc(stereoBuf, tmpBuf, 2 * samples, l1);
 					}
 				}
 			} else {
 				if (!(usedBuffers & HAS_STEREO_FLAG)) {
-					if (device.updateBuffer(samples, stereoBuf, time)) {
+					if (fillBuffer(i, stereoBuf)) {
 						usedBuffers |= HAS_STEREO_FLAG;
 						mulMix2(stereoBuf, samples, l1, l2, r1, r2);
 					}
 				} else {
-					if (device.updateBuffer(samples, tmpBuf, time)) {
+					if (fillBuffer(i, tmpBuf)) {
 						mulMix2Acc(stereoBuf, tmpBuf, samples, l1, l2, r1, r2);
 					}
 				}
@@ -536,6 +565,44 @@ void MSXMixer::generate(float* output, EmuTime::param time, unsigned samples)
 	}
 }
 
+void MSXMixer::generateParallel(ThreadPool& pool, EmuTime::param time,
+                                unsigned samples, unsigned pitch)
+{
+	size_t required = infos.size() * pitch;
+	if (unlikely(parallelBufferSize < required)) {
+		parallelBufferSize = required;
+		parallelBuffer.resize(parallelBufferSize);
+	}
+	parallelResults.resize(infos.size());
+
+	auto generateOne = [&, pitch](size_t i) {
+		parallelResults[i] = infos[i].device->updateBuffer(
+			samples, &parallelBuffer[i * pitch], time);
+	};
+	std::vector<std::future<void>> futures;
+	futures.reserve(infos.size() - 1);
+	for (auto i : xrange(size_t(1), infos.size())) {
+		futures.push_back(pool.submit([&, i] { generateOne(i); }));
+	}
+	// Each task refers to this stack frame, so all of them must have
+	// finished before an exception (e.g. a full disk while recording a
+	// wav file) may leave this function. Rethrow the first one.
+	std::exception_ptr error;
+	try {
+		generateOne(0); // main thread does its share as well
+	} catch (...) {
+		error = std::current_exception();
+	}
+	for (auto& f : futures) {
+		try {
+			f.get();
+		} catch (...) {
+			if (!error) error = std::current_exception();
+		}
+	}
+	if (error) std::rethrow_exception(error);
+}
+
 bool MSXMixer::needStereoRecording() const
 {
 	return ranges::any_of(infos, [](auto& info) {
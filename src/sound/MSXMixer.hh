@@ -6,6 +6,9 @@
 #include "InfoTopic.hh"
 #include "EmuTime.hh"
 #include "DynamicClock.hh"
+#include "MemBuffer.hh"
+#include "aligned.hh"
+#include <cstdint>
 #include <vector>
 #include <memory>
 
@@ -22,6 +25,7 @@ class StringSetting;
 class BooleanSetting;
 class Setting;
 class AviRecorder;
+class ThreadPool;
 
 class MSXMixer final : private Schedulable, private Observer<Setting>
                      , private Observer<ThrottleManager>
@@ -132,6 +136,8 @@ private:
 	void reschedule();
 	void reschedule2();
 	void generate(float* output, EmuTime::param time, unsigned samples);
+	void generateParallel(ThreadPool& pool, EmuTime::param time,
+	                      unsigned samples, unsigned pitch);
 
 	// Schedulable
 	void executeUntil(EmuTime::param time) override;
@@ -173,6 +179,11 @@ private:
 
 	unsigned muteCount;
 	float tl0, tr0; // internal DC-filter state
+
+	// output of each device, only used when generating in parallel
+	MemBuffer<float, SSE_ALIGNMENT> parallelBuffer;
+	size_t parallelBufferSize = 0;
+	std::vector<uint8_t> parallelResults; // not vector<bool>: written concurrently
 };
 
 } // namespace openmsx
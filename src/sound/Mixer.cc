@@ -5,6 +5,7 @@
 #include "CommandController.hh"
 #include "CliComm.hh"
 #include "MSXException.hh"
+#include "ThreadPool.hh"
 #include "stl.hh"
 #include "unreachable.hh"
 #include "build-info.hh"
@@ -48,28 +49,37 @@ Mixer::Mixer(Reactor& reactor_, CommandController& commandController_)
 	, samplesSetting(
 		commandController, "samples",
 		"mixer samples", defaultsamples, 64, 8192)
+	, soundThreadsSetting(
+		commandController, "sound_threads",
+		"number of worker threads used to generate the sound of the "
+		"emulated sound chips in parallel, 0 means all sound is "
+		"generated in the main thread", 0, 0, 16)
 	, muteCount(0)
 {
-	muteSetting       .attach(*this);
-	frequencySetting  .attach(*this);
-	samplesSetting    .attach(*this);
-	soundDriverSetting.attach(*this);
+	muteSetting        .attach(*this);
+	frequencySetting   .attach(*this);
+	samplesSetting     .attach(*this);
+	soundDriverSetting .attach(*this);
+	soundThreadsSetting.attach(*this);
 
 	// Set correct initial mute state.
 	if (muteSetting.getBoolean()) ++muteCount;
 
 	reloadDriver();
+	reloadThreadPool();
 }
 
 Mixer::~Mixer()
 {
 	assert(msxMixers.empty());
 	driver.reset();
+	soundThreadPool.reset();
 
-	soundDriverSetting.detach(*this);
-	samplesSetting    .detach(*this);
-	frequencySetting  .detach(*this);
-	muteSetting       .detach(*this);
+	soundThreadsSetting.detach(*this);
+	soundDriverSetting .detach(*this);
+	samplesSetting     .detach(*this);
+	frequencySetting   .detach(*this);
+	muteSetting        .detach(*this);
 }
 
 void Mixer::reloadDriver()
@@ -101,6 +111,17 @@ void Mixer::reloadDriver()
 	muteHelper();
 }
 
+void Mixer::reloadThreadPool()
+{
+	// Destroying the old pool waits for its pending jobs, but there are
+	// none: MSXMixer only submits jobs from within generate() and waits
+	// for them before returning.
+	soundThreadPool.reset();
+	if (int n = soundThreadsSetting.getInt()) {
+		soundThreadPool = std::make_unique<ThreadPool>(n);
+	}
+}
+
 void Mixer::registerMixer(MSXMixer& mixer)
 {
 	assert(!contains(msxMixers, &mixer));
@@ -166,6 +187,8 @@ void Mixer::update(const Setting& setting)
 	           (&setting == &soundDriverSetting) ||
 	           (&setting == &frequencySetting)) {
 		reloadDriver();
+	} else if (&setting == &soundThreadsSetting) {
+		reloadThreadPool();
 	} else {
 		UNREACHABLE;
 	}
@@ -14,6 +14,7 @@ class SoundDriver;
 class Reactor;
 class CommandController;
 class MSXMixer;
+class ThreadPool;
 
 class Mixer final : private Observer<Setting>
 {
@@ -47,9 +48,16 @@ public:
 
 	IntegerSetting& getMasterVolume() { return masterVolume; }
 
+	/** Worker threads to generate the sound of the individual sound
+	  * devices in parallel, or nullptr when this is disabled (see the
+	  * 'sound_threads' setting).
+	  */
+	ThreadPool* getSoundThreadPool() { return soundThreadPool.get(); }
+
 private:
 	void reloadDriver();
 	void muteHelper();
+	void reloadThreadPool();
 
 	// Observer<Setting>
 	void update(const Setting& setting) override;
@@ -57,6 +65,7 @@ private:
 	std::vector<MSXMixer*> msxMixers; // unordered
 
 	std::unique_ptr<SoundDriver> driver;
+	std::unique_ptr<ThreadPool> soundThreadPool;
 	Reactor& reactor;
 	CommandController& commandController;
 
@@ -65,6 +74,7 @@ private:
 	IntegerSetting masterVolume;
 	IntegerSetting frequencySetting;
 	IntegerSetting samplesSetting;
+	IntegerSetting soundThreadsSetting;
 
 	int muteCount;
 };
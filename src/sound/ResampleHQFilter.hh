@@ -0,0 +1,376 @@
+#ifndef RESAMPLEHQFILTER_HH
+#define RESAMPLEHQFILTER_HH
+
+// The inner loop of ResampleHQ: calculate one output sample (or one stereo
+// pair) by applying one row of the (polyphase) filter table to the input.
+//
+// These routines are in a separate header so that they can be tested and
+// benchmarked (see ResampleHQ_test.cc) without needing a ResampleHQ object.
+//
+// The implementation is selected at compile time (like in the rest of
+// openMSX): AVX, SSE2, NEON or a portable c++ version. The vectorized
+// versions sum the products in a different order, so the results are not
+// bit-identical to the c++ version, but the differences are far below the
+// resolution of the (16-bit) output.
+//
+// Parameters:
+//   buf: input samples (interleaved left/right for stereo), no alignment
+//        requirement
+//   tab: start (REVERSE=false) or end (REVERSE=true) of a row in the filter
+//        table. In the latter case the row is walked backwards. For SSE2
+//        this must be 16-byte aligned.
+//   len: the filter length, must be a multiple of 4
+//   out: the result, 1 or 2 (for stereo) values
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+namespace openmsx::ResampleHQFilter {
+
+// Portable version. Also used as the reference in the unittest.
+template<unsigned CHANNELS, bool REVERSE>
+inline void calcScalar(const float* buf, const float* tab, size_t len, float* out)
+{
+	assert((len % 4) == 0);
+	auto coef = [&](size_t i) { return REVERSE ? tab[-ptrdiff_t(i) - 1] : tab[i]; };
+	for (unsigned ch = 0; ch < CHANNELS; ++ch) {
+		float r0 = 0.0f;
+		float r1 = 0.0f;
+		float r2 = 0.0f;
+		float r3 = 0.0f;
+		for (size_t i = 0; i < len; i += 4) {
+			r0 += coef(i + 0) * buf[CHANNELS * (i + 0)];
+			r1 += coef(i + 1) * buf[CHANNELS * (i + 1)];
+			r2 += coef(i + 2) * buf[CHANNELS * (i + 2)];
+			r3 += coef(i + 3) * buf[CHANNELS * (i + 3)];
+		}
+		out[ch] = r0 + r1 + r2 + r3;
+		++buf;
+	}
+}
+
+#ifdef __SSE2__
+template<bool REVERSE>
+inline void calcSseMono(const float* buf_, const float* tab_, size_t len, float* out)
+{
+	assert((len % 4) == 0);
+	assert((uintptr_t(tab_) % 16) == 0);
+
+	ptrdiff_t x = (len & ~7) * sizeof(float);
+	assert((x % 32) == 0);
+	const char* buf = reinterpret_cast<const char*>(buf_) + x;
+	const char* tab = reinterpret_cast<const char*>(tab_) + (REVERSE ? -x : x);
+	x = -x;
+
+	__m128 a0 = _mm_setzero_ps();
+	__m128 a1 = _mm_setzero_ps();
+	do {
+		__m128 b0 = _mm_loadu_ps(reinterpret_cast<const float*>(buf + x +  0));
+		__m128 b1 = _mm_loadu_ps(reinterpret_cast<const float*>(buf + x + 16));
+		__m128 t0, t1;
+		if (REVERSE) {
+			t0 = _mm_loadr_ps(reinterpret_cast<const float*>(tab - x - 16));
+			t1 = _mm_loadr_ps(reinterpret_cast<const float*>(tab - x - 32));
+		} else {
+			t0 = _mm_load_ps (reinterpret_cast<const float*>(tab + x +  0));
+			t1 = _mm_load_ps (reinterpret_cast<const float*>(tab + x + 16));
+		}
+		__m128 m0 = _mm_mul_ps(b0, t0);
+		__m128 m1 = _mm_mul_ps(b1, t1);
+		a0 = _mm_add_ps(a0, m0);
+		a1 = _mm_add_ps(a1, m1);
+		x += 2 * sizeof(__m128);
+	} while (x < 0);
+	if (len & 4) {
+		__m128 b0 = _mm_loadu_ps(reinterpret_cast<const float*>(buf));
+		__m128 t0;
+		if (REVERSE) {
+			t0 = _mm_loadr_ps(reinterpret_cast<const float*>(tab - 16));
+		} else {
+			t0 = _mm_load_ps (reinterpret_cast<const float*>(tab));
+		}
+		__m128 m0 = _mm_mul_ps(b0, t0);
+		a0 = _mm_add_ps(a0, m0);
+	}
+
+	__m128 a = _mm_add_ps(a0, a1);
+	// The following can be _slightly_ faster by using the SSE3 _mm_hadd_ps()
+	// intrinsic, but not worth the trouble.
+	__m128 t = _mm_add_ps(a, _mm_movehl_ps(a, a));
+	__m128 s = _mm_add_ss(t, _mm_shuffle_ps(t, t, 1));
+
+	_mm_store_ss(out, s);
+}
+
+template<int N> inline __m128 shuffle(__m128 x)
+{
+	return _mm_castsi128_ps(_mm_shuffle_epi32(_mm_castps_si128(x), N));
+}
+template<bool REVERSE>
+inline void calcSseStereo(const float* buf_, const float* tab_, size_t len, float* out)
+{
+	assert((len % 4) == 0);
+	assert((uintptr_t(tab_) % 16) == 0);
+
+	ptrdiff_t x = 2 * (len & ~7) * sizeof(float);
+	const char* buf = reinterpret_cast<const char*>(buf_) + x;
+	const char* tab = reinterpret_cast<const char*>(tab_);
+	x = -x;
+
+	__m128 a0 = _mm_setzero_ps();
+	__m128 a1 = _mm_setzero_ps();
+	__m128 a2 = _mm_setzero_ps();
+	__m128 a3 = _mm_setzero_ps();
+	do {
+		__m128 b0 = _mm_loadu_ps(reinterpret_cast<const float*>(buf + x +  0));
+		__m128 b1 = _mm_loadu_ps(reinterpret_cast<const float*>(buf + x + 16));
+		__m128 b2 = _mm_loadu_ps(reinterpret_cast<const float*>(buf + x + 32));
+		__m128 b3 = _mm_loadu_ps(reinterpret_cast<const float*>(buf + x + 48));
+		__m128 ta, tb;
+		if (REVERSE) {
+			ta = _mm_loadr_ps(reinterpret_cast<const float*>(tab - 16));
+			tb = _mm_loadr_ps(reinterpret_cast<const float*>(tab - 32));
+			tab -= 2 * sizeof(__m128);
+		} else {
+			ta = _mm_load_ps (reinterpret_cast<const float*>(tab +  0));
+			tb = _mm_load_ps (reinterpret_cast<const float*>(tab + 16));
+			tab += 2 * sizeof(__m128);
+		}
+		__m128 t0 = shuffle<0x50>(ta);
+		__m128 t1 = shuffle<0xFA>(ta);
+		__m128 t2 = shuffle<0x50>(tb);
+		__m128 t3 = shuffle<0xFA>(tb);
+		__m128 m0 = _mm_mul_ps(b0, t0);
+		__m128 m1 = _mm_mul_ps(b1, t1);
+		__m128 m2 = _mm_mul_ps(b2, t2);
+		__m128 m3 = _mm_mul_ps(b3, t3);
+		a0 = _mm_add_ps(a0, m0);
+		a1 = _mm_add_ps(a1, m1);
+		a2 = _mm_add_ps(a2, m2);
+		a3 = _mm_add_ps(a3, m3);
+		x += 4 * sizeof(__m128);
+	} while (x < 0);
+	if (len & 4) {
+		__m128 b0 = _mm_loadu_ps(reinterpret_cast<const float*>(buf +  0));
+		__m128 b1 = _mm_loadu_ps(reinterpret_cast<const float*>(buf + 16));
+		__m128 ta;
+		if (REVERSE) {
+			ta = _mm_loadr_ps(reinterpret_cast<const float*>(tab - 16));
+		} else {
+			ta = _mm_load_ps (reinterpret_cast<const float*>(tab +  0));
+		}
+		__m128 t0 = shuffle<0x50>(ta);
+		__m128 t1 = shuffle<0xFA>(ta);
+		__m128 m0 = _mm_mul_ps(b0, t0);
+		__m128 m1 = _mm_mul_ps(b1, t1);
+		a0 = _mm_add_ps(a0, m0);
+		a1 = _mm_add_ps(a1, m1);
+	}
+
+	__m128 a01 = _mm_add_ps(a0, a1);
+	__m128 a23 = _mm_add_ps(a2, a3);
+	__m128 a   = _mm_add_ps(a01, a23);
+	// Can faster with SSE3, but (like above) not worth the trouble.
+	__m128 s = _mm_add_ps(a, _mm_movehl_ps(a, a));
+	_mm_store_ss(&out[0], s);
+	_mm_store_ss(&out[1], shuffle<0x55>(s));
+}
+#endif // __SSE2__
+
+#ifdef __AVX__
+// Note: the rows in the filter table are only 16-byte aligned, so (unlike in
+// the SSE2 version) all loads are unaligned loads.
+
+// Load 4 coefficients, in reverse order when walking the row backwards.
+template<bool REVERSE>
+inline __m128 loadTab4(const float* tab, size_t i)
+{
+	if (REVERSE) {
+		__m128 t = _mm_loadu_ps(tab - i - 4);
+		return _mm_shuffle_ps(t, t, 0x1B);
+	} else {
+		return _mm_loadu_ps(tab + i);
+	}
+}
+// Same for 8 coefficients.
+template<bool REVERSE>
+inline __m256 loadTab8(const float* tab, size_t i)
+{
+	if (REVERSE) {
+		__m256 t = _mm256_permute_ps(_mm256_loadu_ps(tab - i - 8), 0x1B);
+		return _mm256_permute2f128_ps(t, t, 0x01); // swap 128-bit halves
+	} else {
+		return _mm256_loadu_ps(tab + i);
+	}
+}
+// Duplicate each of 4 coefficients (for the left and right channel).
+inline __m256 duplicate(__m128 t)
+{
+	return _mm256_insertf128_ps(
+		_mm256_castps128_ps256(_mm_unpacklo_ps(t, t)),
+		_mm_unpackhi_ps(t, t), 1);
+}
+
+template<bool REVERSE>
+inline void calcAvxMono(const float* buf, const float* tab, size_t len, float* out)
+{
+	assert((len % 4) == 0);
+
+	__m256 a0 = _mm256_setzero_ps();
+	__m256 a1 = _mm256_setzero_ps();
+	size_t i = 0;
+	for (/**/; (i + 16) <= len; i += 16) {
+		__m256 m0 = _mm256_mul_ps(_mm256_loadu_ps(buf + i + 0),
+		                          loadTab8<REVERSE>(tab, i + 0));
+		__m256 m1 = _mm256_mul_ps(_mm256_loadu_ps(buf + i + 8),
+		                          loadTab8<REVERSE>(tab, i + 8));
+		a0 = _mm256_add_ps(a0, m0);
+		a1 = _mm256_add_ps(a1, m1);
+	}
+	if (len & 8) {
+		__m256 m0 = _mm256_mul_ps(_mm256_loadu_ps(buf + i),
+		                          loadTab8<REVERSE>(tab, i));
+		a0 = _mm256_add_ps(a0, m0);
+		i += 8;
+	}
+	__m256 a8 = _mm256_add_ps(a0, a1);
+	__m128 a = _mm_add_ps(_mm256_castps256_ps128(a8),
+	                      _mm256_extractf128_ps(a8, 1));
+	if (len & 4) {
+		__m128 m = _mm_mul_ps(_mm_loadu_ps(buf + i),
+		                      loadTab4<REVERSE>(tab, i));
+		a = _mm_add_ps(a, m);
+	}
+
+	__m128 t = _mm_add_ps(a, _mm_movehl_ps(a, a));
+	__m128 s = _mm_add_ss(t, _mm_shuffle_ps(t, t, 1));
+	_mm_store_ss(out, s);
+}
+
+template<bool REVERSE>
+inline void calcAvxStereo(const float* buf, const float* tab, size_t len, float* out)
+{
+	assert((len % 4) == 0);
+
+	__m256 a0 = _mm256_setzero_ps();
+	__m256 a1 = _mm256_setzero_ps();
+	size_t i = 0;
+	for (/**/; (i + 8) <= len; i += 8) {
+		__m256 m0 = _mm256_mul_ps(_mm256_loadu_ps(buf + 2 * i + 0),
+		                          duplicate(loadTab4<REVERSE>(tab, i + 0)));
+		__m256 m1 = _mm256_mul_ps(_mm256_loadu_ps(buf + 2 * i + 8),
+		                          duplicate(loadTab4<REVERSE>(tab, i + 4)));
+		a0 = _mm256_add_ps(a0, m0);
+		a1 = _mm256_add_ps(a1, m1);
+	}
+	if (len & 4) {
+		__m256 m0 = _mm256_mul_ps(_mm256_loadu_ps(buf + 2 * i),
+		                          duplicate(loadTab4<REVERSE>(tab, i)));
+		a0 = _mm256_add_ps(a0, m0);
+	}
+
+	__m256 a8 = _mm256_add_ps(a0, a1);
+	__m128 a = _mm_add_ps(_mm256_castps256_ps128(a8),
+	                      _mm256_extractf128_ps(a8, 1));
+	// a = {l0, r0, l1, r1}
+	__m128 s = _mm_add_ps(a, _mm_movehl_ps(a, a));
+	_mm_store_ss(&out[0], s);
+	_mm_store_ss(&out[1], _mm_shuffle_ps(s, s, 0x55));
+}
+#endif // __AVX__
+
+#ifdef __ARM_NEON
+template<bool REVERSE>
+inline float32x4_t loadTab4(const float* tab, size_t i)
+{
+	if (REVERSE) {
+		float32x4_t t = vrev64q_f32(vld1q_f32(tab - i - 4)); // {1,0,3,2}
+		return vcombine_f32(vget_high_f32(t), vget_low_f32(t)); // {3,2,1,0}
+	} else {
+		return vld1q_f32(tab + i);
+	}
+}
+
+template<bool REVERSE>
+inline void calcNeonMono(const float* buf, const float* tab, size_t len, float* out)
+{
+	assert((len % 4) == 0);
+
+	float32x4_t a0 = vdupq_n_f32(0.0f);
+	float32x4_t a1 = vdupq_n_f32(0.0f);
+	size_t i = 0;
+	for (/**/; (i + 8) <= len; i += 8) {
+		a0 = vmlaq_f32(a0, vld1q_f32(buf + i + 0), loadTab4<REVERSE>(tab, i + 0));
+		a1 = vmlaq_f32(a1, vld1q_f32(buf + i + 4), loadTab4<REVERSE>(tab, i + 4));
+	}
+	if (len & 4) {
+		a0 = vmlaq_f32(a0, vld1q_f32(buf + i), loadTab4<REVERSE>(tab, i));
+	}
+
+	float32x4_t a = vaddq_f32(a0, a1);
+	float32x2_t s = vadd_f32(vget_low_f32(a), vget_high_f32(a));
+	s = vpadd_f32(s, s);
+	out[0] = vget_lane_f32(s, 0);
+}
+
+template<bool REVERSE>
+inline void calcNeonStereo(const float* buf, const float* tab, size_t len, float* out)
+{
+	assert((len % 4) == 0);
+
+	float32x4_t a0 = vdupq_n_f32(0.0f);
+	float32x4_t a1 = vdupq_n_f32(0.0f);
+	for (size_t i = 0; i < len; i += 4) {
+		// {t0, t0, t1, t1} and {t2, t2, t3, t3}
+		float32x4_t t4 = loadTab4<REVERSE>(tab, i);
+		float32x4x2_t t = vzipq_f32(t4, t4);
+		a0 = vmlaq_f32(a0, vld1q_f32(buf + 2 * i + 0), t.val[0]);
+		a1 = vmlaq_f32(a1, vld1q_f32(buf + 2 * i + 4), t.val[1]);
+	}
+
+	// a = {l0, r0, l1, r1}
+	float32x4_t a = vaddq_f32(a0, a1);
+	vst1_f32(out, vadd_f32(vget_low_f32(a), vget_high_f32(a)));
+}
+#endif // __ARM_NEON
+
+template<unsigned CHANNELS, bool REVERSE>
+inline void calc(const float* buf, const float* tab, size_t len, float* out)
+{
+	static_assert((CHANNELS == 1) || (CHANNELS == 2));
+#if defined(__AVX__)
+	if (CHANNELS == 1) {
+		calcAvxMono   <REVERSE>(buf, tab, len, out);
+	} else {
+		calcAvxStereo <REVERSE>(buf, tab, len, out);
+	}
+#elif defined(__SSE2__)
+	if (CHANNELS == 1) {
+		calcSseMono   <REVERSE>(buf, tab, len, out);
+	} else {
+		calcSseStereo <REVERSE>(buf, tab, len, out);
+	}
+#elif defined(__ARM_NEON)
+	if (CHANNELS == 1) {
+		calcNeonMono  <REVERSE>(buf, tab, len, out);
+	} else {
+		calcNeonStereo<REVERSE>(buf, tab, len, out);
+	}
+#else
+	calcScalar<CHANNELS, REVERSE>(buf, tab, len, out);
+#endif
+}
+
+} // namespace openmsx::ResampleHQFilter
+
+#endif
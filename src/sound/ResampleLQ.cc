@@ -9,10 +9,11 @@
 
 namespace openmsx {
 
-// 16-byte aligned buffer of ints (shared among all instances of this resampler)
-static std::vector<float> bufferStorage; // (possibly) unaligned storage
-static unsigned bufferSize = 0; // usable buffer size (aligned portion)
-static float* aBuffer = nullptr; // pointer to aligned sub-buffer
+// 16-byte aligned buffer of ints (shared among all instances of this resampler
+// that run in the same thread, see MSXMixer::generateParallel())
+static thread_local std::vector<float> bufferStorage; // (possibly) unaligned storage
+static thread_local unsigned bufferSize = 0; // usable buffer size (aligned portion)
+static thread_local float* aBuffer = nullptr; // pointer to aligned sub-buffer
 
 ////
 
@@ -19,8 +19,9 @@ using std::string;
 
 namespace openmsx {
 
-static MemBuffer<float, SSE2_ALIGNMENT> mixBuffer;
-static unsigned mixBufferSize = 0;
+// thread_local: sound devices may be updated in parallel (see MSXMixer)
+static thread_local MemBuffer<float, SSE2_ALIGNMENT> mixBuffer;
+static thread_local unsigned mixBufferSize = 0;
 
 static void allocateMixBuffer(unsigned size)
 {
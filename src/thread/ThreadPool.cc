@@ -0,0 +1,66 @@
+#include "ThreadPool.hh"
+#include <algorithm>
+#include <cassert>
+
+namespace openmsx {
+
+ThreadPool::ThreadPool(unsigned numThreads)
+{
+	if (numThreads == 0) {
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	threads.reserve(numThreads);
+	for (unsigned i = 0; i < numThreads; ++i) {
+		threads.emplace_back([this]() { run(); });
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		exitLoop = true;
+	}
+	jobAvailable.notify_all();
+	for (auto& t : threads) t.join();
+	assert(jobs.empty());
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> job)
+{
+	std::packaged_task<void()> task(std::move(job));
+	auto result = task.get_future();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(std::move(task));
+	}
+	jobAvailable.notify_one();
+	return result;
+}
+
+void ThreadPool::wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	allDone.wait(lock, [&] { return jobs.empty() && (busy == 0); });
+}
+
+void ThreadPool::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		jobAvailable.wait(lock, [&] { return exitLoop || !jobs.empty(); });
+		// Even when asked to exit, first drain the queue.
+		if (jobs.empty()) return;
+
+		auto task = std::move(jobs.front());
+		jobs.pop_front();
+		++busy;
+		lock.unlock();
+		task(); // exceptions are stored in the associated future
+		lock.lock();
+		--busy;
+		if (jobs.empty() && (busy == 0)) allDone.notify_all();
+	}
+}
+
+} // namespace openmsx
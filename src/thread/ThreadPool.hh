@@ -0,0 +1,58 @@
+#ifndef THREADPOOL_HH
+#define THREADPOOL_HH
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace openmsx {
+
+/** A fixed set of worker threads that execute submitted jobs in FIFO order.
+  * Use this for work that doesn't need to happen in lock-step with the
+  * emulation (e.g. compression of data that's no longer being modified).
+  * Jobs must not touch emulation state that the main thread can access
+  * concurrently.
+  */
+class ThreadPool
+{
+public:
+	/** @param numThreads The number of worker threads, when zero use one
+	  *                   thread per hardware core.
+	  */
+	explicit ThreadPool(unsigned numThreads = 0);
+
+	/** Finishes all pending jobs before returning. */
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/** Queue a job for execution on one of the worker threads.
+	  * The returned future can be used to wait for (only) this job.
+	  */
+	std::future<void> submit(std::function<void()> job);
+
+	/** Block until all jobs submitted so far have finished. */
+	void wait();
+
+	[[nodiscard]] unsigned size() const { return unsigned(threads.size()); }
+
+private:
+	void run();
+
+	std::vector<std::thread> threads;
+	std::deque<std::packaged_task<void()>> jobs;
+	std::mutex mutex; // protects 'jobs', 'busy' and 'exitLoop'
+	std::condition_variable jobAvailable;
+	std::condition_variable allDone;
+	unsigned busy = 0;
+	bool exitLoop = false;
+};
+
+} // namespace openmsx
+
+#endif
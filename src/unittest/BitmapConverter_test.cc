@@ -0,0 +1,217 @@
+#include "catch.hpp"
+#include "BitmapConverter.hh"
+#include "YJKConverter.hh"
+#include "Math.hh"
+#include "xrange.hh"
+#include "build-info.hh"
+#include "components.hh"
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace openmsx;
+using namespace openmsx::YJKConverter;
+
+// Two VRAM planes, filled with random data, followed by all possible
+// combinations of (pairs of) bytes that determine J and K.
+struct VRAM {
+	explicit VRAM(unsigned seed)
+	{
+		std::mt19937 rng(seed);
+		for (auto& b : plane0) b = rng();
+		for (auto& b : plane1) b = rng();
+		for (auto i : xrange(256)) {
+			plane0[128 + i] = i;
+			plane1[128 + i] = ~i;
+		}
+	}
+	byte plane0[128 + 256 + 1];
+	byte plane1[128 + 256 + 1];
+};
+
+// Straight from the V9958 datasheet, independent from the implementation.
+template<bool YAE>
+static std::vector<uint16_t> reference(const byte* v0, const byte* v1)
+{
+	std::vector<uint16_t> result;
+	for (auto i : xrange(WIDTH / 4)) {
+		byte p[4] = { v0[2 * i], v1[2 * i], v0[2 * i + 1], v1[2 * i + 1] };
+		auto sext6 = [](int x) { return (x & 0x20) ? x - 64 : x; };
+		int k = sext6(((p[1] & 7) << 3) | (p[0] & 7));
+		int j = sext6(((p[3] & 7) << 3) | (p[2] & 7));
+		for (auto n : xrange(4)) {
+			if (YAE && (p[n] & 8)) {
+				result.push_back(0x8000 | (p[n] >> 4));
+				continue;
+			}
+			int y = p[n] >> 3;
+			int r = Math::clip<0, 31>(y + j);
+			int g = Math::clip<0, 31>(y + k);
+			int b = Math::clip<0, 31>((5 * y - 2 * j - k) / 4);
+			result.push_back((r << 10) | (g << 5) | b);
+		}
+	}
+	return result;
+}
+
+template<bool YAE, typename CALC>
+static void checkColors(CALC calc)
+{
+	VRAM vram(1234);
+	// different (unaligned) offsets in the VRAM planes
+	for (unsigned offset : {0, 1, 64, 128, 129}) {
+		const byte* v0 = vram.plane0 + offset;
+		const byte* v1 = vram.plane1 + offset;
+		std::vector<uint16_t> actual(WIDTH);
+		calc(v0, v1, actual.data());
+		CHECK(actual == reference<YAE>(v0, v1));
+	}
+}
+
+TEST_CASE("YJKConverter: calcColors")
+{
+	checkColors<false>(calcColorsScalar<false>);
+	checkColors<true >(calcColorsScalar<true >);
+	checkColors<false>(calcColors<false>);
+	checkColors<true >(calcColors<true >);
+#ifdef __SSE2__
+	checkColors<false>(calcColorsSSE2<false>);
+	checkColors<true >(calcColorsSSE2<true >);
+#endif
+}
+
+// Some arbitrary (but different) host pixels.
+template<typename Pixel> struct Palettes {
+	Palettes()
+	{
+		std::mt19937 rng(42);
+		for (auto& p : pal16)    p = Pixel(rng());
+		for (auto& p : pal256)   p = Pixel(rng());
+		for (auto& p : pal32768) p = Pixel(rng());
+	}
+	Pixel pal16[2 * 16];
+	Pixel pal256[256];
+	Pixel pal32768[32768];
+};
+
+// Bitmap display mode from register values: reg25 = 0x08 for YJK and 0x18
+// for YAE.
+static DisplayMode bitmapMode(byte base, byte reg25 = 0)
+{
+	return DisplayMode(base >> 1, 0, reg25);
+}
+
+template<typename Pixel>
+static void checkConvert(bool yae)
+{
+	Palettes<Pixel> pal;
+	BitmapConverter<Pixel> converter(pal.pal16, pal.pal256, pal.pal32768);
+	converter.setDisplayMode(bitmapMode(DisplayMode::GRAPHIC7, yae ? 0x18 : 0x08));
+
+	VRAM vram(99);
+	for (unsigned offset : {0, 3, 128}) {
+		const byte* v0 = vram.plane0 + offset;
+		const byte* v1 = vram.plane1 + offset;
+		Pixel actual[512];
+		converter.convertLinePlanar(actual, v0, v1);
+
+		auto colors = yae ? reference<true >(v0, v1)
+		                  : reference<false>(v0, v1);
+		for (auto x : xrange(WIDTH)) {
+			unsigned c = colors[x];
+			Pixel expected = (c & 0x8000) ? pal.pal16[c & 15]
+			                              : pal.pal32768[c];
+			CHECK(actual[x] == expected);
+		}
+	}
+}
+
+TEST_CASE("BitmapConverter: YJK and YAE")
+{
+#if HAVE_16BPP
+	SECTION("16bpp") {
+		checkConvert<uint16_t>(false);
+		checkConvert<uint16_t>(true);
+	}
+#endif
+#if HAVE_32BPP || COMPONENT_GL
+	SECTION("32bpp") {
+		checkConvert<uint32_t>(false);
+		checkConvert<uint32_t>(true);
+	}
+#endif
+}
+
+template<typename FUNC>
+static double benchmark(FUNC convertLine)
+{
+	// ns per line, a frame has 212 lines
+	unsigned lines = 0;
+	auto start = std::chrono::steady_clock::now();
+	auto stop = start;
+	do {
+		for (auto y : xrange(212)) convertLine(y);
+		lines += 212;
+		stop = std::chrono::steady_clock::now();
+	} while ((stop - start) < std::chrono::milliseconds(200));
+	return std::chrono::duration<double, std::nano>(stop - start).count() / lines;
+}
+
+template<typename Pixel>
+static void benchmarkModes()
+{
+	Palettes<Pixel> pal;
+	BitmapConverter<Pixel> converter(pal.pal16, pal.pal256, pal.pal32768);
+	// 64kB per plane, like in Graphic6/7
+	std::mt19937 rng(1);
+	std::vector<byte> vram0(0x10000), vram1(0x10000);
+	for (auto& b : vram0) b = rng();
+	for (auto& b : vram1) b = rng();
+	Pixel line[512];
+
+	auto run = [&](const char* name, DisplayMode mode, bool planar) {
+		converter.setDisplayMode(mode);
+		double t = benchmark([&](unsigned y) {
+			if (planar) {
+				converter.convertLinePlanar(line, &vram0[y * 128], &vram1[y * 128]);
+			} else {
+				converter.convertLine(line, &vram0[y * 128]);
+			}
+		});
+		std::cout << "  " << name << ": " << t << " ns/line\n";
+	};
+	run("Graphic4", bitmapMode(DisplayMode::GRAPHIC4), false);
+	run("Graphic5", bitmapMode(DisplayMode::GRAPHIC5), false);
+	run("Graphic6", bitmapMode(DisplayMode::GRAPHIC6), true);
+	run("Graphic7", bitmapMode(DisplayMode::GRAPHIC7), true);
+	run("YJK     ", bitmapMode(DisplayMode::GRAPHIC7, 0x08), true);
+	run("YAE     ", bitmapMode(DisplayMode::GRAPHIC7, 0x18), true);
+
+	// the c++ versions of the YJK/YAE routines
+	alignas(16) uint16_t colors[WIDTH];
+	double yjk = benchmark([&](unsigned y) {
+		calcColorsScalar<false>(&vram0[y * 128], &vram1[y * 128], colors);
+		lookupScalar<false>(colors, line, pal.pal16, pal.pal32768);
+	});
+	double yae = benchmark([&](unsigned y) {
+		calcColorsScalar<true>(&vram0[y * 128], &vram1[y * 128], colors);
+		lookupScalar<true>(colors, line, pal.pal16, pal.pal32768);
+	});
+	std::cout << "  YJK c++ : " << yjk << " ns/line\n"
+	          << "  YAE c++ : " << yae << " ns/line\n";
+}
+
+TEST_CASE("BitmapConverter benchmark", "[.][benchmark]")
+{
+#if HAVE_16BPP
+	std::cout << "BitmapConverter 16bpp\n";
+	benchmarkModes<uint16_t>();
+#endif
+#if HAVE_32BPP || COMPONENT_GL
+	std::cout << "BitmapConverter 32bpp\n";
+	benchmarkModes<uint32_t>();
+#endif
+}
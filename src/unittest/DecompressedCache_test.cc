@@ -0,0 +1,100 @@
+#include "catch.hpp"
+#include "DecompressedCache.hh"
+#include "FileOperations.hh"
+#include "MemBuffer.hh"
+#include "xrange.hh"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+using namespace openmsx;
+
+// A decompressed file of 'size' bytes with content 'value'.
+static CompressedFileAdapter::Decompressed makeDecompressed(
+	const std::string& name, size_t size, uint8_t value)
+{
+	CompressedFileAdapter::Decompressed result;
+	result.buf.resize(size);
+	memset(result.buf.data(), value, size);
+	result.data = result.buf.data();
+	result.size = size;
+	result.originalName = name;
+	return result;
+}
+
+static bool exists(const std::string& path)
+{
+	FileOperations::Stat st;
+	return FileOperations::getStat(path, st);
+}
+
+struct TempDir {
+	TempDir() { FileOperations::deleteRecursive(path); }
+	~TempDir() { FileOperations::deleteRecursive(path); }
+	std::string path = FileOperations::getTempDir() + "/openmsx-DecompressedCache_test";
+};
+
+TEST_CASE("DecompressedCache: store and load")
+{
+	TempDir dir;
+	DecompressedCache cache(dir.path, 1024 * 1024);
+	uint8_t compressed[] = {1, 2, 3};
+	auto path = cache.getPath(compressed);
+
+	CompressedFileAdapter::Decompressed miss;
+	CHECK(!cache.load(path, miss));
+
+	cache.store(path, makeDecompressed("file.dsk", 1000, 0x55));
+	CompressedFileAdapter::Decompressed hit;
+	REQUIRE(cache.load(path, hit));
+	CHECK(hit.originalName == "file.dsk");
+	REQUIRE(hit.size == 1000);
+	CHECK(hit.mapped);
+	CHECK(std::all_of(hit.data, hit.data + hit.size, [](uint8_t b) { return b == 0x55; }));
+
+	// other content, other entry
+	uint8_t compressed2[] = {1, 2, 4};
+	CHECK(cache.getPath(compressed2) != path);
+	CompressedFileAdapter::Decompressed miss2;
+	CHECK(!cache.load(cache.getPath(compressed2), miss2));
+}
+
+TEST_CASE("DecompressedCache: least recently used entries are removed first")
+{
+	TempDir dir;
+	// An entry has a 64 byte header (for short names). The cache can
+	// hold A, B and C (3 x 1064 bytes), adding D (864 bytes) removes
+	// entries till the total is at most 3000 bytes.
+	DecompressedCache cache(dir.path, 4000);
+	std::string paths[4];
+	for (auto i : xrange(4)) {
+		uint8_t compressed[] = {uint8_t(i)};
+		paths[i] = cache.getPath(compressed);
+	}
+	for (auto i : xrange(3)) {
+		cache.store(paths[i], makeDecompressed("x", 1000, uint8_t(i)));
+		REQUIRE(exists(paths[i]));
+		FileOperations::touch(paths[i], time_t(1000000 + 1000 * i));
+	}
+
+	// A hit makes A the most recently used entry, B is now the oldest.
+	CompressedFileAdapter::Decompressed a;
+	REQUIRE(cache.load(paths[0], a));
+	a.mapped.reset();
+
+	cache.store(paths[3], makeDecompressed("x", 800, 3));
+	CHECK( exists(paths[0]));
+	CHECK(!exists(paths[1]));
+	CHECK( exists(paths[2]));
+	CHECK( exists(paths[3]));
+}
+
+TEST_CASE("DecompressedCache: large files are not stored")
+{
+	TempDir dir;
+	DecompressedCache cache(dir.path, 4000);
+	uint8_t compressed[] = {0};
+	auto path = cache.getPath(compressed);
+	cache.store(path, makeDecompressed("x", 1001, 0));
+	CHECK(!exists(path));
+}
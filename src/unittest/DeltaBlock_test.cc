@@ -0,0 +1,230 @@
+#include "catch.hpp"
+#include "DeltaBlock.hh"
+#include "xrange.hh"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace openmsx;
+
+// Apply a 'change pattern' to a buffer:
+//  - 'numRuns' runs of changed bytes,
+//  - each 'runLen' bytes long,
+//  - at pseudo-random positions.
+static void mutate(std::vector<uint8_t>& buf, size_t offset, size_t size,
+                   unsigned numRuns, unsigned runLen, std::mt19937& rng)
+{
+	if (size == 0) return;
+	for (auto r : xrange(numRuns)) {
+		(void)r;
+		size_t start = rng() % size;
+		for (auto i : xrange(runLen)) {
+			if ((start + i) >= size) break;
+			buf[offset + start + i] += uint8_t(1 + (rng() % 255));
+		}
+	}
+}
+
+static void checkHistory(size_t size, size_t offset, unsigned numRuns, unsigned runLen)
+{
+	std::mt19937 rng(size + offset);
+	// 'offset' tests differently aligned buffers
+	std::vector<uint8_t> buf(size + offset);
+	for (auto& b : buf) b = uint8_t(rng());
+
+	LastDeltaBlocks lastDeltaBlocks;
+	std::vector<std::shared_ptr<DeltaBlock>> blocks;
+	std::vector<std::vector<uint8_t>> expected;
+	for (auto i : xrange(20)) {
+		(void)i;
+		blocks.push_back(lastDeltaBlocks.createNew(
+			&buf, buf.data() + offset, size));
+		expected.emplace_back(buf.begin() + offset, buf.end());
+		mutate(buf, offset, size, numRuns, runLen, rng);
+	}
+
+	std::vector<uint8_t> out(size);
+	for (auto i : xrange(blocks.size())) {
+		blocks[i]->apply(out.data(), size);
+		CHECK(out == expected[i]);
+	}
+}
+
+TEST_CASE("DeltaBlock")
+{
+	for (size_t size : {1, 15, 16, 31, 32, 33, 64, 100, 1000, 65536}) {
+		for (size_t offset : {0, 1, 7, 16, 17}) {
+			checkHistory(size, offset,  1,  1);
+			checkHistory(size, offset,  3,  1);
+			checkHistory(size, offset, 10,  3);
+			checkHistory(size, offset,  2, 40);
+		}
+	}
+}
+
+TEST_CASE("DeltaBlockStore")
+{
+	auto store = std::make_shared<DeltaBlockStore>();
+	constexpr size_t SIZE = 10000;
+	std::vector<std::vector<uint8_t>> data;
+	std::vector<std::shared_ptr<DeltaBlockCopy>> blocks;
+	for (auto i : xrange(10)) {
+		auto& d = data.emplace_back(SIZE);
+		for (auto j : xrange(SIZE)) d[j] = uint8_t((j / (i + 1)) & 7); // compressible
+		blocks.push_back(std::make_shared<DeltaBlockCopy>(d.data(), SIZE));
+	}
+
+	// also not compressed blocks can be moved
+	auto& d0 = data.emplace_back(SIZE);
+	for (auto j : xrange(SIZE)) d0[j] = uint8_t(j);
+	blocks.push_back(std::make_shared<DeltaBlockCopy>(d0.data(), SIZE));
+	CHECK(blocks.back()->moveToStore(store) == SIZE);
+	CHECK(blocks.back()->getMemorySize() == 0);
+
+	for (auto i : xrange(10)) {
+		auto& b = blocks[i];
+		b->compress(SIZE);
+		auto memSize = b->getMemorySize();
+		CHECK(memSize < SIZE);
+		CHECK(b->moveToStore(store) == memSize);
+		CHECK(b->getMemorySize() == 0);
+		CHECK(b->moveToStore(store) == 0); // already moved
+	}
+	auto used = store->getUsedSize();
+	CHECK(used != 0);
+
+	// delete some blocks, space gets reused for new blocks
+	blocks[3].reset();
+	blocks[4].reset();
+	CHECK(store->getUsedSize() < used);
+	auto& d = data.emplace_back(SIZE, 0);
+	auto b = std::make_shared<DeltaBlockCopy>(d.data(), SIZE);
+	b->compress(SIZE);
+	b->moveToStore(store);
+	blocks.push_back(b);
+
+	std::vector<uint8_t> out(SIZE);
+	for (auto i : xrange(blocks.size())) {
+		if (!blocks[i]) continue;
+		blocks[i]->apply(out.data(), SIZE);
+		CHECK(out == data[i]);
+	}
+}
+
+TEST_CASE("DeltaBlockMemory")
+{
+	constexpr size_t SIZE = 10000;
+	auto memory = std::make_shared<DeltaBlockMemory>();
+	std::vector<std::vector<uint8_t>> data;
+	std::vector<std::shared_ptr<DeltaBlockCopy>> copies;
+	for (auto i : xrange(4)) {
+		auto& d = data.emplace_back(SIZE);
+		for (auto j : xrange(SIZE)) d[j] = uint8_t((j / (i + 1)) & 7);
+		copies.push_back(std::make_shared<DeltaBlockCopy>(d.data(), SIZE, memory));
+	}
+	CHECK(memory->getUsedSize() == 4 * SIZE);
+
+	std::vector<uint8_t> scratch;
+	auto newData = data[3];
+	newData[100] ^= 1;
+	auto diff = std::make_shared<DeltaBlockDiff>(
+		copies[3], newData.data(), SIZE, scratch, memory);
+	CHECK(memory->getUsedSize() == 4 * SIZE + diff->getDeltaSize());
+
+	size_t expected = 0;
+	for (auto& c : copies) {
+		c->compress(SIZE);
+		expected += c->getMemorySize();
+	}
+	CHECK(expected < 4 * SIZE);
+	expected += diff->getDeltaSize();
+	CHECK(memory->getUsedSize() == expected);
+
+	// Not evictable yet (or no limit) -> nothing happens.
+	memory->setLimit(0);
+	CHECK(!memory->startEvict());
+	memory->setLimit(DeltaBlockMemory::NO_LIMIT);
+	for (auto& c : copies) memory->addEvictable(c);
+	CHECK(!memory->startEvict());
+
+	// Oldest blocks are moved first, only till the limit is reached.
+	size_t limit = expected - copies[0]->getMemorySize()
+	                        - copies[1]->getMemorySize() / 2;
+	memory->setLimit(limit);
+	CHECK(memory->startEvict());
+	CHECK(!memory->startEvict()); // already pending
+	memory->evict();
+	CHECK(copies[0]->getMemorySize() == 0);
+	CHECK(copies[1]->getMemorySize() == 0);
+	CHECK(copies[2]->getMemorySize() != 0);
+	CHECK(copies[3]->getMemorySize() != 0);
+	CHECK(memory->getUsedSize() <= limit);
+	CHECK(memory->getStoredSize() != 0);
+	CHECK(memory->takeError().empty());
+
+	// Moved blocks are still usable.
+	std::vector<uint8_t> out(SIZE);
+	for (auto i : xrange(copies.size())) {
+		copies[i]->apply(out.data(), SIZE);
+		CHECK(out == data[i]);
+	}
+	diff->apply(out.data(), SIZE);
+	CHECK(out == newData);
+
+	// Destroyed blocks are subtracted again.
+	diff.reset();
+	copies.clear();
+	CHECK(memory->getUsedSize() == 0);
+	CHECK(memory->getStoredSize() == 0);
+}
+
+// Not run by default, select it explicitly with: "[benchmark]"
+TEST_CASE("DeltaBlock benchmark", "[.][benchmark]")
+{
+	struct Pattern {
+		const char* name;
+		size_t size;
+		unsigned numRuns;
+		unsigned runLen;
+	};
+	const Pattern patterns[] = {
+		{"VRAM 128kB, name table update",     128 * 1024,   1, 768},
+		{"VRAM 128kB, sprite attributes",     128 * 1024,   1, 128},
+		{"RAM 4MB, few scattered writes",    4096 * 1024,  50,   4},
+		{"RAM 4MB, many scattered writes",   4096 * 1024, 5000,  2},
+		{"RAM 4MB, unchanged",               4096 * 1024,   0,   0},
+	};
+	for (const auto& p : patterns) {
+		std::mt19937 rng(12345);
+		std::vector<uint8_t> buf(p.size);
+		for (auto& b : buf) b = uint8_t(rng());
+		std::vector<uint8_t> out(p.size);
+
+		LastDeltaBlocks lastDeltaBlocks;
+		constexpr unsigned ITERATIONS = 100;
+		std::vector<std::shared_ptr<DeltaBlock>> blocks;
+		blocks.reserve(ITERATIONS);
+
+		auto t0 = std::chrono::steady_clock::now();
+		for (auto i : xrange(ITERATIONS)) {
+			(void)i;
+			mutate(buf, 0, p.size, p.numRuns, p.runLen, rng);
+			blocks.push_back(lastDeltaBlocks.createNew(
+				&buf, buf.data(), p.size));
+		}
+		auto t1 = std::chrono::steady_clock::now();
+		for (auto& b : blocks) {
+			b->apply(out.data(), p.size);
+		}
+		auto t2 = std::chrono::steady_clock::now();
+
+		auto mbPerSec = [&](auto d) {
+			double sec = std::chrono::duration<double>(d).count();
+			return (double(p.size) * ITERATIONS / (1024 * 1024)) / sec;
+		};
+		std::cout << p.name << ": encode " << mbPerSec(t1 - t0)
+		          << " MB/s, apply " << mbPerSec(t2 - t1) << " MB/s\n";
+	}
+}
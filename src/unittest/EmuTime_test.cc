@@ -0,0 +1,48 @@
+#include "catch.hpp"
+#include "EmuTime.hh"
+#include <cmath>
+#include <limits>
+
+using namespace openmsx;
+
+TEST_CASE("EmuTime: tryAddSeconds")
+{
+	auto t0 = EmuTime::zero();
+	auto t1 = EmuTime::makeEmuTime(1000);
+
+	// regular values
+	CHECK(t0.tryAddSeconds(0.0) == t0);
+	CHECK(t1.tryAddSeconds(0.0) == t1);
+	CHECK(t0.tryAddSeconds(1.0) == t0 + EmuDuration::sec(1));
+	CHECK(t1.tryAddSeconds(2.5) == t1 + EmuDuration(2.5));
+	CHECK(t1.tryAddSeconds(1e9) == t1 + EmuDuration(1e9));
+
+	// negative, NaN, infinity
+	CHECK(!t0.tryAddSeconds(-1.0));
+	CHECK(!t0.tryAddSeconds(-0.5 / MAIN_FREQ));
+	CHECK(!t0.tryAddSeconds(std::nan("")));
+	CHECK(!t0.tryAddSeconds(std::numeric_limits<double>::infinity()));
+	CHECK(!t0.tryAddSeconds(-std::numeric_limits<double>::infinity()));
+
+	// beyond the range of EmuTime
+	CHECK(!t0.tryAddSeconds(1e12));
+	CHECK(!t1.tryAddSeconds(1e300));
+	CHECK(!t0.tryAddSeconds(std::numeric_limits<double>::max()));
+
+	// near the end of the range
+	auto maxSeconds = (EmuTime::infinity() - t0).toDouble();
+	CHECK(!t0.tryAddSeconds(maxSeconds));
+	auto r = t0.tryAddSeconds(maxSeconds * 0.999);
+	REQUIRE(r);
+	CHECK(*r > t0);
+	CHECK(*r < EmuTime::infinity());
+
+	auto late = EmuTime::infinity() - EmuDuration::sec(10);
+	CHECK(late.tryAddSeconds(9.0) == late + EmuDuration::sec(9));
+	CHECK(!late.tryAddSeconds(10.0));
+	CHECK(!late.tryAddSeconds(11.0));
+
+	auto last = EmuTime::infinity() - EmuDuration(uint64_t(1));
+	CHECK(last.tryAddSeconds(0.0) == last);
+	CHECK(!last.tryAddSeconds(1.0 / MAIN_FREQ));
+}
@@ -0,0 +1,178 @@
+#include "catch.hpp"
+#include "FilePoolCache.hh"
+#include "ranges.hh"
+#include "strCat.hh"
+#include "xrange.hh"
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace openmsx;
+using namespace openmsx::FilePoolCache;
+
+static Sha1Sum randomSum(std::mt19937& rng)
+{
+	uint8_t raw[20];
+	for (auto& b : raw) b = rng();
+	Sha1Sum result;
+	result.fromRaw(raw);
+	return result;
+}
+
+// 'n' random entries, sorted on sha1sum. The filenames are stored in 'names'.
+static std::vector<Entry> randomEntries(std::mt19937& rng, unsigned n,
+                                        std::vector<std::string>& names)
+{
+	names.clear();
+	for (auto i : xrange(n)) {
+		names.push_back(strCat("/dir/file", i, std::string(rng() % 20, 'x')));
+	}
+	std::vector<Entry> result;
+	for (auto& name : names) {
+		result.push_back({randomSum(rng), time_t(rng()), name.c_str()});
+	}
+	ranges::sort(result, [](auto& x, auto& y) { return x.sum < y.sum; });
+	return result;
+}
+
+static std::vector<Change> randomChanges(std::mt19937& rng, unsigned n)
+{
+	std::vector<Change> result;
+	for (auto i : xrange(n)) {
+		if (rng() % 4) {
+			result.push_back({strCat("/dir/new", i), time_t(rng()), randomSum(rng)});
+		} else {
+			// removed file (or directory)
+			result.push_back({strCat("/dir/file", i), time_t(-1), Sha1Sum()});
+		}
+	}
+	return result;
+}
+
+static void checkEntries(const std::vector<Entry>& actual, const std::vector<Entry>& expected)
+{
+	REQUIRE(actual.size() == expected.size());
+	for (auto i : xrange(actual.size())) {
+		CHECK(actual[i].sum == expected[i].sum);
+		CHECK(actual[i].time == expected[i].time);
+		CHECK(std::string(actual[i].filename) == expected[i].filename);
+	}
+}
+
+static void checkChanges(const std::vector<Change>& actual, const std::vector<Change>& expected)
+{
+	REQUIRE(actual.size() == expected.size());
+	for (auto i : xrange(actual.size())) {
+		CHECK(actual[i].filename == expected[i].filename);
+		CHECK(actual[i].time == expected[i].time);
+		CHECK(actual[i].sum == expected[i].sum);
+	}
+}
+
+TEST_CASE("FilePoolCache: round trip")
+{
+	std::mt19937 rng(1234);
+	std::vector<std::string> names;
+	for (unsigned n : {0, 1, 2, 100}) {
+		auto entries = randomEntries(rng, n, names);
+		auto data = encodeEntries(entries);
+
+		Contents contents;
+		REQUIRE(parse(data.data(), data.size(), contents));
+		checkEntries(contents.entries, entries);
+		CHECK(contents.changes.empty());
+		CHECK(contents.validSize == data.size());
+		CHECK(memcmp(&contents.header, data.data(), sizeof(Header)) == 0);
+	}
+}
+
+TEST_CASE("FilePoolCache: appended changes are replayed in order")
+{
+	std::mt19937 rng(5678);
+	std::vector<std::string> names;
+	auto entries = randomEntries(rng, 50, names);
+	auto data = encodeEntries(entries);
+
+	// appended in several batches
+	std::vector<Change> allChanges;
+	for (auto batch : xrange(3)) {
+		auto changes = randomChanges(rng, 10 + batch);
+		auto buf = encodeChanges(changes);
+		data.insert(end(data), begin(buf), end(buf));
+		allChanges.insert(end(allChanges), begin(changes), end(changes));
+	}
+	REQUIRE(ranges::any_of(allChanges, [](auto& c) { return c.time == time_t(-1); }));
+
+	Contents contents;
+	REQUIRE(parse(data.data(), data.size(), contents));
+	checkEntries(contents.entries, entries);
+	checkChanges(contents.changes, allChanges);
+	CHECK(contents.validSize == data.size());
+}
+
+TEST_CASE("FilePoolCache: a partially written change is ignored")
+{
+	std::mt19937 rng(9012);
+	std::vector<std::string> names;
+	auto entries = randomEntries(rng, 20, names);
+	auto data = encodeEntries(entries);
+	auto changes = randomChanges(rng, 5);
+	auto buf = encodeChanges(changes);
+	data.insert(end(data), begin(buf), end(buf));
+	auto last = encodeChanges(randomChanges(rng, 1));
+	auto validSize = data.size();
+	data.insert(end(data), begin(last), end(last));
+
+	SECTION("truncated") {
+		for (auto cut : xrange(size_t(1), last.size())) {
+			Contents contents;
+			REQUIRE(parse(data.data(), data.size() - cut, contents));
+			checkEntries(contents.entries, entries);
+			checkChanges(contents.changes, changes);
+			CHECK(contents.validSize == validSize);
+		}
+	}
+	SECTION("corrupted") {
+		for (auto i : xrange(last.size())) {
+			auto copy = data;
+			copy[validSize + i] ^= 0x10;
+			Contents contents;
+			REQUIRE(parse(copy.data(), copy.size(), contents));
+			checkChanges(contents.changes, changes);
+			CHECK(contents.validSize == validSize);
+		}
+	}
+}
+
+TEST_CASE("FilePoolCache: invalid files are rejected")
+{
+	std::mt19937 rng(3456);
+	std::vector<std::string> names;
+	auto entries = randomEntries(rng, 10, names);
+	auto data = encodeEntries(entries);
+	Contents contents;
+
+	SECTION("too small") {
+		CHECK(!parse(data.data(), sizeof(Header) - 1, contents));
+		CHECK(!parse(data.data(), data.size() - 1, contents));
+	}
+	SECTION("wrong magic") {
+		data[0] ^= 1;
+		CHECK(!parse(data.data(), data.size(), contents));
+	}
+	SECTION("too many entries") {
+		Header header;
+		memcpy(&header, data.data(), sizeof(header));
+		for (uint32_t n : {11u, 0x08000000u, 0xFFFFFFFFu}) {
+			header.numEntries = n;
+			memcpy(data.data(), &header, sizeof(header));
+			CHECK(!parse(data.data(), data.size(), contents));
+		}
+	}
+	SECTION("not sorted") {
+		std::swap(entries[3], entries[4]);
+		auto unsorted = encodeEntries(entries);
+		CHECK(!parse(unsorted.data(), unsorted.size(), contents));
+	}
+}
@@ -0,0 +1,49 @@
+#include "catch.hpp"
+#include "PerfCounters.hh"
+
+using namespace openmsx;
+
+TEST_CASE("PerfCounters")
+{
+	auto& perf = PerfCounters::instance();
+	perf.stop();
+	perf.reset();
+
+	SECTION("disabled") {
+		{ ScopedPerfTimer t(PerfCounter::MIXER); }
+		CHECK(perf.getStats(PerfCounter::MIXER).calls == 0);
+	}
+	SECTION("enabled") {
+		perf.start(false);
+		perf.record(PerfCounter::MIXER, 1000, 1500);
+		perf.record(PerfCounter::MIXER, 2000, 4000);
+		perf.record(PerfCounter::RENDERER, 3000, 3100);
+		{ ScopedPerfTimer t(PerfCounter::SCHEDULER); }
+		perf.stop();
+
+		auto mixer = perf.getStats(PerfCounter::MIXER);
+		CHECK(mixer.calls == 2);
+		CHECK(mixer.totalNs == 2500);
+		CHECK(mixer.maxNs == 2000);
+		auto renderer = perf.getStats(PerfCounter::RENDERER);
+		CHECK(renderer.calls == 1);
+		CHECK(renderer.totalNs == 100);
+		CHECK(perf.getStats(PerfCounter::SCHEDULER).calls == 1);
+		CHECK(perf.getNumTraceEvents() == 0);
+
+		perf.reset();
+		CHECK(perf.getStats(PerfCounter::MIXER).calls == 0);
+		CHECK(perf.getStats(PerfCounter::MIXER).maxNs == 0);
+	}
+	SECTION("tracing") {
+		perf.start(true);
+		CHECK(perf.isTracing());
+		perf.record(PerfCounter::CPU, 100, 200);
+		perf.record(PerfCounter::CPU, 300, 400);
+		perf.stop();
+		CHECK(perf.getNumTraceEvents() == 2);
+		CHECK(perf.getNumDroppedTraceEvents() == 0);
+		perf.reset();
+		CHECK(perf.getNumTraceEvents() == 0);
+	}
+}
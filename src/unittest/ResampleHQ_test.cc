@@ -0,0 +1,137 @@
+#include "catch.hpp"
+#include "ResampleHQFilter.hh"
+#include "xrange.hh"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace openmsx;
+using namespace openmsx::ResampleHQFilter;
+
+constexpr size_t MAX_LEN = 64;
+
+// Filter rows in ResampleHQ are 16-byte aligned, the input is not.
+struct Data {
+	alignas(32) float tab[MAX_LEN];
+	float buf[2 * MAX_LEN + 1];
+};
+
+static void fill(Data& d, unsigned seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+	for (auto& t : d.tab) t = dist(rng);
+	for (auto& b : d.buf) b = dist(rng);
+}
+
+template<unsigned CHANNELS, bool REVERSE, typename CALC>
+static void check(CALC calc)
+{
+	Data d;
+	for (size_t len = 8; len <= MAX_LEN; len += 4) {
+		fill(d, unsigned(len));
+		const float* buf = &d.buf[1]; // unaligned
+		const float* tab = REVERSE ? &d.tab[len] : &d.tab[0];
+		float expected[CHANNELS];
+		float actual[CHANNELS];
+		calcScalar<CHANNELS, REVERSE>(buf, tab, len, expected);
+		calc(buf, tab, len, actual);
+		for (auto ch : xrange(CHANNELS)) {
+			CHECK(std::abs(actual[ch] - expected[ch]) < 1e-5f);
+		}
+	}
+}
+
+template<unsigned CHANNELS, bool REVERSE>
+static void checkAll()
+{
+	check<CHANNELS, REVERSE>(calc<CHANNELS, REVERSE>);
+#ifdef __SSE2__
+	if (CHANNELS == 1) {
+		check<CHANNELS, REVERSE>(calcSseMono<REVERSE>);
+	} else {
+		check<CHANNELS, REVERSE>(calcSseStereo<REVERSE>);
+	}
+#endif
+#ifdef __AVX__
+	if (CHANNELS == 1) {
+		check<CHANNELS, REVERSE>(calcAvxMono<REVERSE>);
+	} else {
+		check<CHANNELS, REVERSE>(calcAvxStereo<REVERSE>);
+	}
+#endif
+#ifdef __ARM_NEON
+	if (CHANNELS == 1) {
+		check<CHANNELS, REVERSE>(calcNeonMono<REVERSE>);
+	} else {
+		check<CHANNELS, REVERSE>(calcNeonStereo<REVERSE>);
+	}
+#endif
+}
+
+TEST_CASE("ResampleHQFilter: mono")
+{
+	checkAll<1, false>();
+	checkAll<1, true >();
+}
+
+TEST_CASE("ResampleHQFilter: stereo")
+{
+	checkAll<2, false>();
+	checkAll<2, true >();
+}
+
+TEST_CASE("ResampleHQFilter: reverse walks the row backwards")
+{
+	Data d;
+	fill(d, 1);
+	// reversing the row of coefficients gives the same result
+	alignas(32) float rev[MAX_LEN];
+	constexpr size_t len = 36;
+	for (auto i : xrange(len)) rev[i] = d.tab[len - 1 - i];
+	float x[2], y[2];
+	calcScalar<2, true >(d.buf, &d.tab[len], len, x);
+	calcScalar<2, false>(d.buf, rev,         len, y);
+	CHECK(x[0] == y[0]);
+	CHECK(x[1] == y[1]);
+}
+
+template<unsigned CHANNELS, typename CALC>
+static double benchmark(CALC calc, size_t len)
+{
+	// simulate resampling a block of 10000 input samples
+	constexpr size_t NUM = 10000;
+	std::vector<float> buf((NUM + len) * CHANNELS, 0.5f);
+	Data d;
+	fill(d, 42);
+	float out[CHANNELS] = {};
+	float sum = 0.0f;
+	auto start = std::chrono::steady_clock::now();
+	for (auto r : xrange(100)) {
+		(void)r;
+		for (auto i : xrange(NUM)) {
+			calc(&buf[i * CHANNELS], d.tab, len, out);
+			sum += out[0];
+		}
+	}
+	auto stop = std::chrono::steady_clock::now();
+	CHECK(sum != 0.0f);
+	return std::chrono::duration<double, std::nano>(stop - start).count()
+	     / (100.0 * NUM);
+}
+
+TEST_CASE("ResampleHQFilter benchmark", "[.][benchmark]")
+{
+	// the filter length depends on the ratio of the input and output
+	// sample rates
+	for (size_t len : {20, 32, 48, 64}) {
+		std::cout << "len=" << len
+		          << "  mono: c++ " << benchmark<1>(calcScalar<1, false>, len)
+		          << " ns, selected " << benchmark<1>(calc<1, false>, len)
+		          << " ns;  stereo: c++ " << benchmark<2>(calcScalar<2, false>, len)
+		          << " ns, selected " << benchmark<2>(calc<2, false>, len)
+		          << " ns\n";
+	}
+}
@@ -0,0 +1,502 @@
+#include "catch.hpp"
+#include "Scaler1.hh"
+#include "SaI2xScaler.hh"
+#include "SaI3xScaler.hh"
+#include "Scale2xScaler.hh"
+#include "Scale3xScaler.hh"
+#include "HQ2xScaler.hh"
+#include "HQ3xScaler.hh"
+#include "HQ2xLiteScaler.hh"
+#include "HQ3xLiteScaler.hh"
+#include "MLAAScaler.hh"
+#include "HQCommon.hh"
+#include "ScalerOutput.hh"
+#include "RawFrame.hh"
+#include "ScaleBands.hh"
+#include "PixelOperations.hh"
+#include "MemBuffer.hh"
+#include "ThreadPool.hh"
+#include "xrange.hh"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace openmsx;
+using Pixel = uint32_t;
+
+// Scales into a block of memory.
+class MemoryOutput final : public ScalerOutput<Pixel>
+{
+public:
+	MemoryOutput(Pixel* data_, unsigned width_, unsigned height_)
+		: data(data_), width(width_), height(height_) {}
+
+	unsigned getWidth()  const override { return width; }
+	unsigned getHeight() const override { return height; }
+	Pixel* acquireLine(unsigned y) override { return data + y * width; }
+	void   releaseLine(unsigned /*y*/, Pixel* /*buf*/) override {}
+	void   fillLine   (unsigned y, Pixel color) override {
+		std::fill_n(acquireLine(y), width, color);
+	}
+
+private:
+	Pixel* data;
+	unsigned width;
+	unsigned height;
+};
+
+static PixelFormat getPixelFormat()
+{
+	return PixelFormat(32,
+		0x00FF0000, 16, 0,
+		0x0000FF00,  8, 0,
+		0x000000FF,  0, 0,
+		0xFF000000, 24, 0);
+}
+
+// A frame with some border lines at the top and bottom, and in between
+// regions with a different line width. The pixels are taken from a small
+// palette, so that there are plenty of edges for the HQ scalers.
+static std::unique_ptr<RawFrame> createFrame(const PixelFormat& format)
+{
+	constexpr unsigned HEIGHT = 240;
+	auto frame = std::make_unique<RawFrame>(format, 640, HEIGHT);
+	std::mt19937 rng(1234);
+	static constexpr Pixel palette[4] = {
+		0xFF000000, 0xFFFFFFFF, 0xFF2080C0, 0xFFE0C040
+	};
+	for (auto y : xrange(HEIGHT)) {
+		if ((y < 13) || (y >= 227)) {
+			frame->setBlank(y, palette[2]);
+			continue;
+		}
+		unsigned width = (y < 150) ? 320 : 640;
+		auto* line = frame->getLinePtrDirect<Pixel>(y);
+		for (auto x : xrange(width)) {
+			line[x] = palette[rng() % 4];
+		}
+		frame->setLineWidth(y, width);
+	}
+	return frame;
+}
+
+struct Band {
+	unsigned srcStartY, srcEndY, lineWidth;
+	unsigned dstStartY, dstEndY;
+};
+
+// Split the frame in regions with equal line width (like FBPostProcessor
+// does) and optionally split those further in bands of at most 'maxLines'
+// source lines.
+static std::vector<Band> getBands(RawFrame& frame, unsigned factor, unsigned maxLines)
+{
+	std::vector<Band> result;
+	unsigned height = frame.getHeight();
+	unsigned y = 0;
+	while (y < height) {
+		unsigned width = frame.getLineWidthDirect(y);
+		unsigned end = y + 1;
+		while ((end < height) && ((end - y) < maxLines) &&
+		       (frame.getLineWidthDirect(end) == width)) {
+			++end;
+		}
+		result.push_back({y, end, width, y * factor, end * factor});
+		y = end;
+	}
+	return result;
+}
+
+static void checkBands(Scaler<Pixel>& scaler, const PixelFormat& format,
+                       unsigned factor)
+{
+	REQUIRE(scaler.canScaleInBands());
+
+	auto frame = createFrame(format);
+	unsigned width = 320 * factor;
+	unsigned height = frame->getHeight() * factor;
+	MemBuffer<Pixel, 64> expected(width * height);
+	MemBuffer<Pixel, 64> actual  (width * height);
+	memset(expected.data(), 0, width * height * sizeof(Pixel));
+	memset(actual  .data(), 0, width * height * sizeof(Pixel));
+
+	// whole regions at once, in this thread
+	MemoryOutput out1(expected.data(), width, height);
+	for (auto& b : getBands(*frame, factor, height)) {
+		scaler.scaleImage(*frame, nullptr,
+		                  b.srcStartY, b.srcEndY, b.lineWidth,
+		                  out1, b.dstStartY, b.dstEndY);
+	}
+
+	// small bands, each with its own output, in a thread pool
+	ThreadPool pool(3);
+	std::vector<std::unique_ptr<MemoryOutput>> outputs;
+	std::vector<std::future<void>> jobs;
+	for (auto& b : getBands(*frame, factor, 7)) {
+		auto& out = *outputs.emplace_back(std::make_unique<MemoryOutput>(
+			actual.data(), width, height));
+		jobs.push_back(pool.submit([&, b] {
+			scaler.scaleImage(*frame, nullptr,
+			                  b.srcStartY, b.srcEndY, b.lineWidth,
+			                  out, b.dstStartY, b.dstEndY);
+		}));
+	}
+	for (auto& job : jobs) job.get();
+
+	CHECK(memcmp(expected.data(), actual.data(),
+	             width * height * sizeof(Pixel)) == 0);
+}
+
+TEST_CASE("Scaler: scaling in bands gives the same result")
+{
+	// note: PixelOperations keeps a reference to the PixelFormat
+	auto format = getPixelFormat();
+	PixelOperations<Pixel> pixelOps(format);
+	SECTION("Scaler1") {
+		Scaler1<Pixel> scaler(pixelOps);
+		checkBands(scaler, format, 1);
+	}
+	SECTION("Scale2x") {
+		Scale2xScaler<Pixel> scaler(pixelOps);
+		checkBands(scaler, format, 2);
+	}
+	SECTION("Scale3x") {
+		Scale3xScaler<Pixel> scaler(pixelOps);
+		checkBands(scaler, format, 3);
+	}
+	SECTION("HQ2x") {
+		HQ2xScaler<Pixel> scaler(pixelOps);
+		checkBands(scaler, format, 2);
+	}
+	SECTION("HQ3x") {
+		HQ3xScaler<Pixel> scaler(pixelOps);
+		checkBands(scaler, format, 3);
+	}
+	SECTION("HQ2xLite") {
+		HQ2xLiteScaler<Pixel> scaler(pixelOps);
+		checkBands(scaler, format, 2);
+	}
+	SECTION("HQ3xLite") {
+		HQ3xLiteScaler<Pixel> scaler(pixelOps);
+		checkBands(scaler, format, 3);
+	}
+}
+
+// Scales the given groups of lines of 'frame' into 'out' (one source line
+// per group, like FBPostProcessor does for 240 -> 240*factor lines).
+static void scaleLines(Scaler<Pixel>& scaler, RawFrame& frame, unsigned factor,
+                       const std::vector<bool>& changed, ScalerOutput<Pixel>& out)
+{
+	unsigned height = out.getHeight();
+	for (auto& b : getScaleBands(frame, height, 1, factor, changed, height)) {
+		scaler.scaleImage(frame, nullptr,
+		                  b.srcStartY, b.srcEndY, b.lineWidth,
+		                  out, b.dstStartY, b.dstEndY);
+	}
+}
+
+static void checkPartial(Scaler<Pixel>& scaler, const PixelFormat& format,
+                         unsigned factor)
+{
+	auto frame = createFrame(format);
+	unsigned srcHeight = frame->getHeight();
+	unsigned width = 320 * factor;
+	unsigned height = srcHeight * factor;
+	MemBuffer<Pixel, 64> expected(width * height);
+	MemBuffer<Pixel, 64> actual  (width * height);
+	memset(expected.data(), 0, width * height * sizeof(Pixel));
+	memset(actual  .data(), 0, width * height * sizeof(Pixel));
+	MemoryOutput out1(expected.data(), width, height);
+	MemoryOutput out2(actual  .data(), width, height);
+	auto count = [](const std::vector<bool>& v) {
+		return std::count(v.begin(), v.end(), true);
+	};
+
+	// nothing remembered yet: everything is scaled
+	LineChangeTracker<Pixel> tracker;
+	auto changed = tracker.update(*frame, 1, true);
+	CHECK(count(changed) == srcHeight);
+	scaleLines(scaler, *frame, factor, changed, out2);
+
+	// change some lines: a border line, the first and last line of a
+	// region, a line in the middle, and a line that changes its width
+	frame->setBlank(12, 0xFF000000);
+	frame->getLinePtrDirect<Pixel>( 13)[  0] ^= 0x00FFFFFF;
+	frame->getLinePtrDirect<Pixel>( 80)[100] ^= 0x00FFFFFF;
+	frame->getLinePtrDirect<Pixel>(149)[319] ^= 0x00FFFFFF;
+	frame->setLineWidth(150, 320);
+	frame->getLinePtrDirect<Pixel>(226)[639] ^= 0x00FFFFFF;
+	changed = tracker.update(*frame, 1, true);
+	CHECK(count(changed) == 6 + 5 + 6 + 5); // plus 2 lines of context
+	CHECK(tracker.usePartial());
+
+	// only rescaling the changed lines gives the same result as
+	// rescaling everything
+	scaleLines(scaler, *frame, factor, changed, out2);
+	scaleLines(scaler, *frame, factor,
+	           std::vector<bool>(srcHeight, true), out1);
+	CHECK(memcmp(expected.data(), actual.data(),
+	             width * height * sizeof(Pixel)) == 0);
+
+	// nothing changed anymore
+	changed = tracker.update(*frame, 1, true);
+	CHECK(count(changed) == 0);
+
+	// can't reuse the previous result: everything is scaled again
+	changed = tracker.update(*frame, 1, false);
+	CHECK(count(changed) == srcHeight);
+}
+
+TEST_CASE("Scaler: partial rescale gives the same result as a full rescale")
+{
+	auto format = getPixelFormat();
+	PixelOperations<Pixel> pixelOps(format);
+	SECTION("Scaler1") {
+		Scaler1<Pixel> scaler(pixelOps);
+		checkPartial(scaler, format, 1);
+	}
+	SECTION("Scale2x") {
+		Scale2xScaler<Pixel> scaler(pixelOps);
+		checkPartial(scaler, format, 2);
+	}
+	SECTION("Scale3x") {
+		Scale3xScaler<Pixel> scaler(pixelOps);
+		checkPartial(scaler, format, 3);
+	}
+	SECTION("HQ2x") {
+		HQ2xScaler<Pixel> scaler(pixelOps);
+		checkPartial(scaler, format, 2);
+	}
+	SECTION("HQ3x") {
+		HQ3xScaler<Pixel> scaler(pixelOps);
+		checkPartial(scaler, format, 3);
+	}
+	SECTION("HQ2xLite") {
+		HQ2xLiteScaler<Pixel> scaler(pixelOps);
+		checkPartial(scaler, format, 2);
+	}
+	SECTION("HQ3xLite") {
+		HQ3xLiteScaler<Pixel> scaler(pixelOps);
+		checkPartial(scaler, format, 3);
+	}
+}
+
+TEST_CASE("LineChangeTracker: suspend after a frame in which most lines changed")
+{
+	auto format = getPixelFormat();
+	auto frame = createFrame(format);
+	LineChangeTracker<Pixel> tracker;
+	(void)tracker.update(*frame, 1, true); // first frame doesn't count
+	CHECK(tracker.usePartial());
+
+	for (auto y : xrange(13, 227)) {
+		frame->getLinePtrDirect<Pixel>(y)[0] ^= 0x00FFFFFF;
+	}
+	(void)tracker.update(*frame, 1, true);
+	for (auto i : xrange(LineChangeTracker<Pixel>::BACKOFF_FRAMES)) {
+		(void)i;
+		CHECK(!tracker.usePartial());
+	}
+	CHECK(tracker.usePartial());
+
+	// the remembered lines still match the frame that was last compared
+	auto changed = tracker.update(*frame, 1, true);
+	CHECK(std::count(changed.begin(), changed.end(), true) == 0);
+}
+
+template<typename CALC>
+static void checkLineEdges(CALC calc)
+{
+	// Random colors, and colors that differ only a little from their
+	// neighbours (close to the thresholds in EdgeHQ).
+	std::mt19937 rng(42);
+	auto format = getPixelFormat();
+	PixelOperations<Pixel> pixelOps(format);
+	EdgeHQ edgeOp = createEdgeHQ(pixelOps);
+	for (unsigned width : {1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 320, 640}) {
+		std::vector<Pixel> curr(width), next(width);
+		for (auto x : xrange(width)) {
+			curr[x] = rng();
+			next[x] = (x & 1) ? rng() : (curr[x] ^ (rng() & 0x3F3F3F3F));
+		}
+		std::vector<unsigned> expected(width), actual(width);
+		calcLineEdgesScalar(curr.data(), next.data(), width, expected.data(), edgeOp);
+		calc(curr.data(), next.data(), width, actual.data(), edgeOp);
+		CHECK(expected == actual);
+	}
+}
+
+TEST_CASE("HQCommon: calcLineEdges")
+{
+	checkLineEdges(calcLineEdges<Pixel>);
+#ifdef __SSE2__
+	checkLineEdges(calcLineEdgesSSE2);
+#endif
+#ifdef __AVX2__
+	checkLineEdges(calcLineEdgesAVX2);
+#endif
+}
+
+// Something that looks like an MSX screen: 8x8 characters and sprites from a
+// 16 color palette, with some border lines at the top and bottom.
+static std::unique_ptr<RawFrame> createMsxFrame(const PixelFormat& format,
+                                                unsigned width)
+{
+	constexpr unsigned HEIGHT = 240;
+	auto frame = std::make_unique<RawFrame>(format, 640, HEIGHT);
+	std::mt19937 rng(5678);
+	Pixel palette[16];
+	for (auto& p : palette) p = 0xFF000000 | (rng() & 0xFFFFFF);
+	unsigned charWidth = width / 40;
+	unsigned char patterns[256][8];
+	for (auto& pat : patterns) {
+		for (auto& line : pat) line = rng();
+	}
+	unsigned char screen[30][40];
+	for (auto& row : screen) {
+		for (auto& c : row) c = (rng() % 4) ? rng() : 0;
+	}
+	for (auto y : xrange(HEIGHT)) {
+		if ((y < 14) || (y >= 226)) {
+			frame->setBlank(y, palette[4]);
+			continue;
+		}
+		auto* line = frame->getLinePtrDirect<Pixel>(y);
+		for (auto x : xrange(width)) {
+			unsigned c = screen[y / 8][x / charWidth];
+			unsigned bit = (x % charWidth) * 8 / charWidth;
+			bool fg = (patterns[c][y % 8] >> bit) & 1;
+			line[x] = palette[fg ? (c % 15) + 1 : 4];
+		}
+		frame->setLineWidth(y, width);
+	}
+	return frame;
+}
+
+static void benchmark(const std::string& name, Scaler<Pixel>& scaler,
+                      RawFrame& frame, unsigned dstWidth, unsigned factor)
+{
+	unsigned height = frame.getHeight();
+	MemBuffer<Pixel, 64> buf(dstWidth * height * factor);
+	MemoryOutput out(buf.data(), dstWidth, height * factor);
+	auto bands = getBands(frame, factor, height);
+	auto scaleFrame = [&] {
+		for (auto& b : bands) {
+			scaler.scaleImage(frame, nullptr,
+			                  b.srcStartY, b.srcEndY, b.lineWidth,
+			                  out, b.dstStartY, b.dstEndY);
+		}
+	};
+	scaleFrame(); // warm up
+	unsigned frames = 0;
+	auto start = std::chrono::steady_clock::now();
+	auto stop = start;
+	do {
+		scaleFrame();
+		++frames;
+		stop = std::chrono::steady_clock::now();
+	} while ((stop - start) < std::chrono::milliseconds(500));
+	double s = std::chrono::duration<double>(stop - start).count();
+	std::cout << "  " << name << ": " << frames / s << " frames/s\n";
+}
+
+TEST_CASE("Scaler benchmark", "[.][benchmark]")
+{
+	// Only the scalers that can be created without RenderSettings.
+	auto format = getPixelFormat();
+	PixelOperations<Pixel> pixelOps(format);
+	for (unsigned width : {320, 640}) {
+		auto frame = createMsxFrame(format, width);
+		std::cout << "MSX lines of " << width << " pixels, 32bpp\n";
+		{ Scaler1       <Pixel> s(pixelOps); benchmark("1x",       s, *frame, 320, 1); }
+		{ SaI2xScaler   <Pixel> s(pixelOps); benchmark("SaI 2x",   s, *frame, 640, 2); }
+		{ Scale2xScaler <Pixel> s(pixelOps); benchmark("Scale 2x", s, *frame, 640, 2); }
+		{ HQ2xScaler    <Pixel> s(pixelOps); benchmark("HQ 2x",    s, *frame, 640, 2); }
+		{ HQ2xLiteScaler<Pixel> s(pixelOps); benchmark("HQlite 2x",s, *frame, 640, 2); }
+		{ MLAAScaler<Pixel> s(640, pixelOps); benchmark("MLAA 2x", s, *frame, 640, 2); }
+		{ SaI3xScaler   <Pixel> s(pixelOps); benchmark("SaI 3x",   s, *frame, 960, 3); }
+		{ Scale3xScaler <Pixel> s(pixelOps); benchmark("Scale 3x", s, *frame, 960, 3); }
+		{ HQ3xScaler    <Pixel> s(pixelOps); benchmark("HQ 3x",    s, *frame, 960, 3); }
+		{ HQ3xLiteScaler<Pixel> s(pixelOps); benchmark("HQlite 3x",s, *frame, 960, 3); }
+		{ MLAAScaler<Pixel> s(960, pixelOps); benchmark("MLAA 3x", s, *frame, 960, 3); }
+	}
+}
+
+// Compares scaling the whole frame with scaling only the changed lines (which
+// includes comparing all lines and copying the previous result), on a static
+// screen and on a screen that changes completely every frame.
+static void benchmarkPartial(const std::string& name, Scaler<Pixel>& scaler,
+                             RawFrame& frame, unsigned factor, bool changing)
+{
+	unsigned srcHeight = frame.getHeight();
+	unsigned width = 320 * factor;
+	unsigned height = srcHeight * factor;
+	MemBuffer<Pixel, 64> prev(width * height);
+	MemBuffer<Pixel, 64> buf (width * height);
+	MemoryOutput prevOut(prev.data(), width, height);
+	MemoryOutput out    (buf .data(), width, height);
+	std::vector<bool> all(srcHeight, true);
+	auto modify = [&] {
+		if (!changing) return;
+		for (auto y : xrange(14, 226)) {
+			frame.getLinePtrDirect<Pixel>(y)[0] ^= 1;
+		}
+	};
+	auto partialFrame = [&](LineChangeTracker<Pixel>& tracker) {
+		auto changed = tracker.update(frame, 1, true);
+		scaleLines(scaler, frame, factor, changed, prevOut);
+		memcpy(buf.data(), prev.data(), width * height * sizeof(Pixel));
+	};
+	auto run = [&](const char* mode, auto scaleFrame) {
+		scaleFrame(); // warm up
+		unsigned frames = 0;
+		auto start = std::chrono::steady_clock::now();
+		auto stop = start;
+		do {
+			scaleFrame();
+			++frames;
+			stop = std::chrono::steady_clock::now();
+		} while ((stop - start) < std::chrono::milliseconds(500));
+		double s = std::chrono::duration<double>(stop - start).count();
+		std::cout << "  " << name << (changing ? " changing, " : " static, ")
+		          << mode << ": " << frames / s << " frames/s\n";
+	};
+	run("full", [&] {
+		modify();
+		scaleLines(scaler, frame, factor, all, out);
+	});
+	LineChangeTracker<Pixel> tracker1;
+	run("always partial", [&] {
+		modify();
+		partialFrame(tracker1);
+	});
+	LineChangeTracker<Pixel> tracker2;
+	run("adaptive", [&] {
+		modify();
+		if (tracker2.usePartial()) {
+			partialFrame(tracker2);
+		} else {
+			scaleLines(scaler, frame, factor, all, out);
+		}
+	});
+}
+
+TEST_CASE("Scaler partial rescale benchmark", "[.][benchmark]")
+{
+	auto format = getPixelFormat();
+	PixelOperations<Pixel> pixelOps(format);
+	auto frame = createMsxFrame(format, 320);
+	std::cout << "MSX lines of 320 pixels, 32bpp\n";
+	for (bool changing : {false, true}) {
+		{ Scaler1       <Pixel> s(pixelOps); benchmarkPartial("1x",       s, *frame, 1, changing); }
+		{ Scale2xScaler <Pixel> s(pixelOps); benchmarkPartial("Scale 2x", s, *frame, 2, changing); }
+		{ HQ2xScaler    <Pixel> s(pixelOps); benchmarkPartial("HQ 2x",    s, *frame, 2, changing); }
+		{ HQ3xScaler    <Pixel> s(pixelOps); benchmarkPartial("HQ 3x",    s, *frame, 3, changing); }
+	}
+}
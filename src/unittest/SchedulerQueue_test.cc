@@ -0,0 +1,250 @@
+#include "catch.hpp"
+#include "SchedulerQueue.hh"
+#include "SchedulerHeap.hh"
+#include "xrange.hh"
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace openmsx;
+
+struct Item {
+	uint64_t time;
+	int id;
+};
+struct LessItem {
+	bool operator()(const Item& x, const Item& y) const { return x.time < y.time; }
+};
+struct SetSentinelItem {
+	void operator()(Item& i) const { i.time = std::numeric_limits<uint64_t>::max(); }
+};
+
+using Queue = SchedulerQueue<Item>;
+using Heap = SchedulerHeap<Item, LessItem>;
+
+// A recorded sequence of scheduler operations, replayed on both containers.
+struct Op {
+	enum Type { INSERT, POP, REMOVE, REMOVE_ALL } type;
+	uint64_t time;
+	int id;
+};
+
+template<typename Container>
+static std::vector<int> replay(const std::vector<Op>& trace)
+{
+	Container c;
+	std::vector<int> popped;
+	for (auto& op : trace) {
+		switch (op.type) {
+		case Op::INSERT:
+			c.insert(Item{op.time, op.id}, SetSentinelItem(), LessItem());
+			break;
+		case Op::POP:
+			// the model in makeTrace() can pick a different element
+			// on equal times, so this can (rarely) run out of elements
+			if (c.empty()) break;
+			popped.push_back(c.front().id);
+			c.remove_front();
+			break;
+		case Op::REMOVE: {
+			int id = op.id;
+			c.remove([&](const Item& i) { return i.id == id; });
+			break;
+		}
+		case Op::REMOVE_ALL: {
+			int id = op.id;
+			c.remove_all([&](const Item& i) { return i.id == id; });
+			break;
+		}
+		}
+	}
+	return popped;
+}
+
+// Model of a running machine: 'numDevices' Schedulables, each one reschedules
+// itself with its own (typical) period after its sync point was reached.
+// Occasionally a device cancels its sync point(s) and sets a new one, like
+// e.g. the VDP does when registers are changed.
+static std::vector<Op> makeTrace(int numDevices, size_t numOps, unsigned seed)
+{
+	std::mt19937 rng(seed);
+	std::vector<uint64_t> periods;
+	std::vector<uint64_t> next;
+	for (auto i : xrange(numDevices)) {
+		(void)i;
+		// ticks of the 3579545 Hz main clock: from a few cycles (e.g.
+		// a busy FDC or command engine) up to frame rate (e.g. RTC)
+		periods.push_back(4 + (rng() % 60000));
+		next.push_back(rng() % 1000);
+	}
+	std::vector<Op> trace;
+	for (auto i : xrange(numDevices)) {
+		trace.push_back({Op::INSERT, next[i], int(i)});
+	}
+	// simulate with a plain (linear search) model
+	while (trace.size() < numOps) {
+		int dev = 0;
+		for (auto i : xrange(numDevices)) {
+			if (next[i] < next[dev]) dev = i;
+		}
+		uint64_t now = next[dev];
+		trace.push_back({Op::POP, now, dev});
+		next[dev] = now + periods[dev];
+		trace.push_back({Op::INSERT, next[dev], dev});
+
+		if ((rng() % 16) == 0) {
+			int other = rng() % numDevices;
+			trace.push_back({Op::REMOVE_ALL, 0, other});
+			next[other] = now + 1 + (rng() % periods[other]);
+			trace.push_back({Op::INSERT, next[other], other});
+		}
+	}
+	return trace;
+}
+
+TEST_CASE("SchedulerHeap: same order as SchedulerQueue")
+{
+	for (int numDevices : {1, 2, 5, 17, 60}) {
+		auto trace = makeTrace(numDevices, 20000, 1234 + numDevices);
+		CHECK(replay<Queue>(trace) == replay<Heap>(trace));
+	}
+}
+
+TEST_CASE("SchedulerHeap: equal times keep insertion order")
+{
+	Heap heap;
+	for (auto i : xrange(100)) {
+		heap.insert(Item{uint64_t(i % 3), int(i)}, SetSentinelItem(), LessItem());
+	}
+	for (int t : {0, 1, 2}) {
+		for (int i = t; i < 100; i += 3) {
+			REQUIRE(!heap.empty());
+			CHECK(heap.front().time == uint64_t(t));
+			CHECK(heap.front().id == i);
+			heap.remove_front();
+		}
+	}
+	CHECK(heap.empty());
+	CHECK(heap.front().time == std::numeric_limits<uint64_t>::max()); // sentinel
+}
+
+TEST_CASE("SchedulerHeap: remove")
+{
+	Heap heap;
+	heap.insert(Item{30, 1}, SetSentinelItem(), LessItem());
+	heap.insert(Item{10, 1}, SetSentinelItem(), LessItem());
+	heap.insert(Item{20, 2}, SetSentinelItem(), LessItem());
+	// removes the earliest matching element, like SchedulerQueue
+	CHECK(heap.remove([](const Item& i) { return i.id == 1; }));
+	CHECK(heap.front().time == 20);
+	CHECK(!heap.remove([](const Item& i) { return i.id == 3; }));
+	heap.remove_all([](const Item& i) { return i.id == 2; });
+	CHECK(heap.size() == 1);
+	CHECK(heap.front().time == 30);
+}
+
+TEST_CASE("SchedulerHeap: remove_all")
+{
+	std::mt19937 rng(99);
+	for (auto iter : xrange(100)) {
+		(void)iter;
+		Queue queue;
+		Heap heap;
+		auto n = 1 + rng() % 50;
+		for (auto i : xrange(n)) {
+			(void)i;
+			Item item{rng() % 20, int(rng() % 5)};
+			queue.insert(item, SetSentinelItem(), LessItem());
+			heap .insert(item, SetSentinelItem(), LessItem());
+		}
+		int id = rng() % 5;
+		auto pred = [&](const Item& i) { return i.id == id; };
+		queue.remove_all(pred);
+		heap .remove_all(pred);
+		REQUIRE(queue.size() == heap.size());
+		while (!queue.empty()) {
+			CHECK(heap.front().id != id);
+			CHECK(heap.front().time == queue.front().time);
+			CHECK(heap.front().id   == queue.front().id);
+			queue.remove_front();
+			heap .remove_front();
+		}
+	}
+}
+
+TEST_CASE("SchedulerHeap: find_first and sorted_if")
+{
+	// Like Scheduler::getSyncPoints() and pendingSyncPoint(): the result
+	// must be the same as iterating over the (sorted) SchedulerQueue, also
+	// for elements with equal times.
+	std::mt19937 rng(7);
+	for (auto iter : xrange(100)) {
+		(void)iter;
+		Queue queue;
+		Heap heap;
+		auto n = 1 + rng() % 50;
+		for (auto i : xrange(n)) {
+			Item item{rng() % 4, int(i)}; // lots of equal times
+			queue.insert(item, SetSentinelItem(), LessItem());
+			heap .insert(item, SetSentinelItem(), LessItem());
+			if ((rng() % 4) == 0) {
+				queue.remove_front();
+				heap .remove_front();
+			}
+		}
+		for (int k : xrange(3)) {
+			auto pred = [&](const Item& i) { return (i.id % 3) == k; };
+			std::vector<int> expected;
+			for (auto& i : queue) {
+				if (pred(i)) expected.push_back(i.id);
+			}
+			std::vector<int> actual;
+			for (auto& i : heap.sorted_if(pred)) actual.push_back(i.id);
+			CHECK(actual == expected);
+
+			auto* first = heap.find_first(pred);
+			if (expected.empty()) {
+				CHECK(first == nullptr);
+			} else {
+				REQUIRE(first != nullptr);
+				CHECK(first->id == expected.front());
+			}
+		}
+	}
+}
+
+template<typename Container>
+static double benchmark(const std::vector<Op>& trace, int repeat)
+{
+	auto start = std::chrono::steady_clock::now();
+	size_t dummy = 0;
+	for (auto r : xrange(repeat)) {
+		(void)r;
+		dummy += replay<Container>(trace).size();
+	}
+	auto stop = std::chrono::steady_clock::now();
+	CHECK(dummy != 0);
+	return std::chrono::duration<double, std::nano>(stop - start).count()
+	     / (double(trace.size()) * repeat);
+}
+
+TEST_CASE("SchedulerQueue benchmark", "[.][benchmark]")
+{
+	// Number of Schedulables in some typical machine configurations:
+	//   5: MSX1
+	//  12: MSX2 + FM-PAC + SCC cartridge
+	//  25: turboR + MIDI, RS232, V9990, several sound cartridges
+	//  60: stress test
+	// 200, 1000: (unrealistic) stress tests, to see where the heap wins
+	for (int numDevices : {5, 12, 25, 60, 200, 1000}) {
+		auto trace = makeTrace(numDevices, 1000000, 42);
+		double q = benchmark<Queue>(trace, 5);
+		double h = benchmark<Heap >(trace, 5);
+		std::cout << numDevices << " schedulables: "
+		          << "SchedulerQueue " << q << " ns/op, "
+		          << "SchedulerHeap " << h << " ns/op\n";
+	}
+}
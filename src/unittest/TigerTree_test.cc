@@ -1,7 +1,11 @@
 #include "catch.hpp"
 #include "TigerTree.hh"
 #include "tiger.hh"
+#include <algorithm>
+#include <chrono>
 #include <cstring>
+#include <iostream>
+#include <vector>
 
 using namespace openmsx;
 
@@ -79,3 +83,79 @@ TEST_CASE("TigerTree")
 		       "SJUYB3QVIJXNKZMSQZGIMHA7GA2MYU2UECDA26A");
 	}
 }
+
+// Straightforward (non-incremental, single threaded) calculation.
+static TigerHash referenceHash(const uint8_t* data, size_t size)
+{
+	std::vector<TigerHash> hashes;
+	size_t offset = 0;
+	do {
+		size_t len = std::min<size_t>(size - offset, 1024);
+		std::vector<uint8_t> block(len + 1, 0);
+		memcpy(&block[1], data + offset, len);
+		tiger(block.data(), block.size(), hashes.emplace_back());
+		offset += len;
+	} while (offset < size);
+	while (hashes.size() > 1) {
+		std::vector<TigerHash> next;
+		for (size_t i = 0; (i + 1) < hashes.size(); i += 2) {
+			tiger_int(hashes[i], hashes[i + 1], next.emplace_back());
+		}
+		if (hashes.size() & 1) next.push_back(hashes.back());
+		swap(hashes, next);
+	}
+	return hashes.front();
+}
+
+TEST_CASE("TigerTree: many blocks (parallel)")
+{
+	size_t size = 3000 * 1024 + 512; // also a partial block
+	std::vector<uint8_t> buffer(size + 1);
+	for (size_t i = 0; i < buffer.size(); ++i) {
+		buffer[i] = uint8_t((i * 13) ^ (i >> 10));
+	}
+	TTTestData data;
+	data.buffer = &buffer[1];
+	std::string name = "parallel";
+	size_t lastProgress = 0;
+	auto callback = [&](size_t p, size_t t) {
+		CHECK(p > lastProgress);
+		CHECK(p <= t);
+		lastProgress = p;
+	};
+
+	TigerTree tt(data, size, name);
+	CHECK(tt.calcHash(callback).toString() ==
+	      referenceHash(&buffer[1], size).toString());
+
+	// incremental (single threaded) update
+	lastProgress = 0;
+	memset(&buffer[1] + 5000, 1, 3000);
+	tt.notifyChange(5000, 3000, 0);
+	CHECK(tt.calcHash(callback).toString() ==
+	      referenceHash(&buffer[1], size).toString());
+}
+
+TEST_CASE("TigerTree benchmark", "[.][benchmark]")
+{
+	size_t size = 64 * 1024 * 1024;
+	std::vector<uint8_t> buffer(size + 1, 0x55);
+	TTTestData data; // invalidates the cache on each TigerTree construction
+	data.buffer = &buffer[1];
+	std::string name = "benchmark";
+	auto calc = [&] {
+		TigerTree tt(data, size, name);
+		(void)tt.calcHash({});
+	};
+	calc(); // warm up
+	unsigned count = 0;
+	auto start = std::chrono::steady_clock::now();
+	auto stop = start;
+	do {
+		calc();
+		++count;
+		stop = std::chrono::steady_clock::now();
+	} while ((stop - start) < std::chrono::milliseconds(500));
+	double s = std::chrono::duration<double>(stop - start).count();
+	std::cout << "TigerTree: " << (count * double(size)) / s / 1e9 << " GB/s\n";
+}
@@ -0,0 +1,169 @@
+#include "catch.hpp"
+#include "V9990CmdModes.hh"
+#include "V9990DisplayTiming.hh"
+#include "Clock.hh"
+#include "unreachable.hh"
+#include "xrange.hh"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace openmsx;
+
+// Acts like V9990VRAM. Counts how often the bulk paths are taken.
+struct TestVRAM {
+	std::vector<byte> data;
+	unsigned bulkRuns = 0;
+
+	byte readVRAMDirect(unsigned address) { return data[address]; }
+	void writeVRAMDirect(unsigned address, byte value) { data[address] = value; }
+	byte readVRAMBx(unsigned address) {
+		return data[V9990VRAM::transformBx(address)];
+	}
+	void writeVRAMBx(unsigned address, byte value) {
+		data[V9990VRAM::transformBx(address)] = value;
+	}
+	byte* getWriteBackdoor() { ++bulkRuns; return data.data(); }
+};
+
+// Address of the first difference, or -1 when equal (on failure this is more
+// readable than printing all of VRAM).
+static int firstDifference(const TestVRAM& a, const TestVRAM& b)
+{
+	auto [it, dummy] = std::mismatch(a.data.begin(), a.data.end(), b.data.begin());
+	(void)dummy;
+	return (it == a.data.end()) ? -1 : int(it - a.data.begin());
+}
+
+enum Command { LMMV, LMMM, BMXL, BMLX, BMLL };
+
+template<typename Mode>
+static bool run(Command cmd, V9990CmdState& s, TestVRAM& vram, unsigned pitch,
+                EmuDuration::param delta, EmuTime::param limit)
+{
+	switch (cmd) {
+	case LMMV: return s.runLMMV<Mode>(vram, pitch, delta, limit);
+	case LMMM: return s.runLMMM<Mode>(vram, pitch, delta, limit);
+	case BMXL: return s.runBMXL<Mode>(vram, pitch, delta, limit);
+	case BMLX: return s.runBMLX<Mode>(vram, pitch, delta, limit);
+	case BMLL: return s.runBMLL<Mode>(vram, delta, limit);
+	}
+	UNREACHABLE; return true;
+}
+
+// Random command parameters, often with overlapping source and destination.
+// Initialized like in V9990CmdEngine::startXXX().
+template<typename Mode>
+static V9990CmdState randomCommand(std::mt19937& rng, Command cmd, unsigned width)
+{
+	V9990CmdState s(EmuTime::zero());
+	s.SX = rng() % 2048;
+	s.SY = rng() % 4096;
+	s.DX = (rng() & 1) ? ((s.SX + rng() % 64) % 2048) : (rng() % 2048);
+	s.DY = (rng() & 1) ? ((s.SY + rng() % 3) % 4096) : (rng() % 4096);
+	s.NX = (rng() % 8) ? (rng() % (width + 64)) : 0;
+	s.NY = 1 + rng() % 4;
+	s.ARG = rng() & (V9990CmdState::DIX | V9990CmdState::DIY);
+	s.LOG = rng() & 0x1F;
+	s.WM = (rng() & 1) ? 0xFFFF : word(rng());
+	s.fgCol = rng();
+	s.ANX = s.getWrappedNX();
+	s.ANY = s.getWrappedNY();
+	s.srcAddress = s.dstAddress = s.nbBytes = 0;
+	if (cmd == BMXL) {
+		s.srcAddress = (s.SX & 0xFF) + ((s.SY & 0x7FF) << 8);
+	} else if (cmd == BMLX) {
+		s.dstAddress = (s.DX & 0xFF) + ((s.DY & 0x7FF) << 8);
+	} else if (cmd == BMLL) {
+		s.NY &= 0x0F; // keep it short
+		s.srcAddress = (s.SX & 0xFF) + ((s.SY & 0x7FF) << 8);
+		s.dstAddress = (s.DX & 0xFF) + ((s.DY & 0x7FF) << 8);
+		s.nbBytes    = (s.NX & 0xFF) + ((s.NY & 0x7FF) << 8);
+		if (s.nbBytes == 0) s.nbBytes = 0x80000;
+		if (Mode::BITS_PER_PIXEL == 16) {
+			s.srcAddress >>= 1;
+			s.dstAddress >>= 1;
+			s.nbBytes    >>= 1;
+		}
+	}
+	return s;
+}
+
+static void checkSame(const V9990CmdState& a, const V9990CmdState& b)
+{
+	CHECK(a.engineTime == b.engineTime);
+	CHECK(a.srcAddress == b.srcAddress);
+	CHECK(a.dstAddress == b.dstAddress);
+	CHECK(a.nbBytes    == b.nbBytes);
+	CHECK(a.ANX == b.ANX);
+	CHECK(a.ANY == b.ANY);
+	CHECK(a.SX == b.SX);
+	CHECK(a.SY == b.SY);
+	CHECK(a.DX == b.DX);
+	CHECK(a.DY == b.DY);
+}
+
+// The result of a command may not depend on how often the command engine is
+// synced: running it in one go (mostly bulk paths), step by step (each step
+// is too short for the bulk paths) and in random pieces must give the same
+// VRAM content and the same end time.
+template<typename Mode>
+static void checkCommand(Command cmd)
+{
+	std::mt19937 rng(1234 + cmd);
+	unsigned bulkRuns = 0;
+	for (auto i : xrange(40)) {
+		(void)i;
+		unsigned width = 256 << (rng() % 4);
+		unsigned pitch = Mode::getPitch(width);
+		auto delta = Clock<V9990DisplayTiming::UC_TICKS_PER_SECOND>::duration(
+			5 + rng() % 100);
+		auto start = randomCommand<Mode>(rng, cmd, width);
+
+		TestVRAM init;
+		init.data.resize(V9990VRAM::VRAM_SIZE);
+		for (auto& b : init.data) b = (rng() & 3) ? byte(rng()) : 0;
+
+		auto bulkState = start;
+		auto bulkVRAM = init;
+		while (!run<Mode>(cmd, bulkState, bulkVRAM, pitch, delta,
+		                  EmuTime::infinity())) {}
+
+		auto stepState = start;
+		auto stepVRAM = init;
+		while (!run<Mode>(cmd, stepState, stepVRAM, pitch, delta,
+		                  stepState.engineTime + delta)) {}
+		CHECK(stepVRAM.bulkRuns == 0);
+
+		auto mixState = start;
+		auto mixVRAM = init;
+		while (!run<Mode>(cmd, mixState, mixVRAM, pitch, delta,
+		                  mixState.engineTime + delta * (rng() % 300) +
+		                  delta / 2)) {}
+
+		checkSame(bulkState, stepState);
+		checkSame(mixState, stepState);
+		CHECK(firstDifference(bulkVRAM, stepVRAM) == -1);
+		CHECK(firstDifference(mixVRAM, stepVRAM) == -1);
+		bulkRuns += bulkVRAM.bulkRuns;
+	}
+	// make sure the bulk paths are actually tested
+	CHECK(bulkRuns > 0);
+}
+
+template<typename Mode>
+static void checkMode()
+{
+	for (auto cmd : {LMMV, LMMM, BMXL, BMLX, BMLL}) {
+		INFO("command " << int(cmd));
+		checkCommand<Mode>(cmd);
+	}
+}
+
+TEST_CASE("V9990CmdModes: bulk paths give the same result as pixel by pixel")
+{
+	SECTION("2bpp")  { checkMode<V9990Bpp2 >(); }
+	SECTION("4bpp")  { checkMode<V9990Bpp4 >(); }
+	SECTION("8bpp")  { checkMode<V9990Bpp8 >(); }
+	SECTION("16bpp") { checkMode<V9990Bpp16>(); }
+}
@@ -0,0 +1,176 @@
+#include "catch.hpp"
+#include "V9990LogOp.hh"
+#include "xrange.hh"
+#include <random>
+#include <vector>
+
+using namespace openmsx;
+using namespace openmsx::V9990LogOp;
+
+// Pixel by pixel, like the V9990 datasheet describes it (and like the
+// per-pixel code in V9990CmdEngine does it).
+static unsigned refPixel(byte op, unsigned bpp, unsigned s, unsigned d)
+{
+	if ((op & 0x10) && (s == 0)) return d; // transparent
+	unsigned result = 0;
+	for (auto bit : xrange(bpp)) {
+		unsigned sb = (s >> bit) & 1;
+		unsigned db = (d >> bit) & 1;
+		result |= ((op >> (2 * sb + db)) & 1) << bit;
+	}
+	return result;
+}
+
+static byte refByte(byte op, unsigned bpp, byte s, byte d, byte mask)
+{
+	byte result = 0;
+	unsigned pixelMask = (1 << bpp) - 1;
+	for (unsigned i = 0; i < 8; i += bpp) {
+		unsigned sp = (s >> i) & pixelMask;
+		unsigned dp = (d >> i) & pixelMask;
+		result |= refPixel(op, bpp, sp, dp) << i;
+	}
+	return (d & ~mask) | (result & mask);
+}
+
+static std::vector<byte> randomBytes(std::mt19937& rng, unsigned num)
+{
+	// plenty of zeros, so that transparency gets tested
+	std::vector<byte> result(num);
+	for (auto& b : result) {
+		unsigned r = rng();
+		b = (r & 0x300) ? (r & 0xFF) : 0;
+		if ((r & 0xC00) == 0) b &= 0x0F;
+		if ((r & 0x3000) == 0) b &= 0xCC;
+	}
+	return result;
+}
+
+// different lengths (including the tail that isn't a multiple of 16) and
+// different (unaligned) offsets
+static constexpr unsigned LENGTHS[] = { 0, 1, 15, 16, 17, 40, 100 };
+static constexpr byte MASKS[] = { 0xFF, 0x00, 0x0F, 0xA5 };
+
+TEST_CASE("V9990LogOp: copy")
+{
+	std::mt19937 rng(1234);
+	for (unsigned bpp : {2, 4, 8}) {
+		for (auto op : xrange(32)) {
+			for (auto mask : MASKS) {
+				for (auto num : LENGTHS) {
+					auto src = randomBytes(rng, num + 1);
+					auto dst = randomBytes(rng, num + 3);
+					auto expected = dst;
+					for (auto i : xrange(num)) {
+						expected[i + 3] = refByte(op, bpp, src[i + 1], dst[i + 3], mask);
+					}
+					auto actual = dst;
+					copy(src.data() + 1, actual.data() + 3, num, op, mask, bpp);
+					CHECK(actual == expected);
+#ifdef __SSE2__
+					actual = dst;
+					switch ((op & 0x10) ? bpp : 0) {
+						case 0: copyScalar<0>(src.data() + 1, actual.data() + 3, num, op, mask); break;
+						case 2: copyScalar<2>(src.data() + 1, actual.data() + 3, num, op, mask); break;
+						case 4: copyScalar<4>(src.data() + 1, actual.data() + 3, num, op, mask); break;
+						case 8: copyScalar<8>(src.data() + 1, actual.data() + 3, num, op, mask); break;
+					}
+					CHECK(actual == expected);
+#endif
+				}
+			}
+		}
+	}
+}
+
+TEST_CASE("V9990LogOp: copy16")
+{
+	std::mt19937 rng(5678);
+	for (auto op : xrange(32)) {
+		for (word mask : {0xFFFF, 0x0000, 0x00FF, 0x7C1F}) {
+			for (auto num : LENGTHS) {
+				auto srcLo = randomBytes(rng, num);
+				auto srcHi = randomBytes(rng, num);
+				auto dstLo = randomBytes(rng, num);
+				auto dstHi = randomBytes(rng, num);
+				auto expLo = dstLo;
+				auto expHi = dstHi;
+				for (auto i : xrange(num)) {
+					unsigned s = srcLo[i] + 256 * srcHi[i];
+					unsigned d = dstLo[i] + 256 * dstHi[i];
+					unsigned r = refPixel(op, 16, s, d);
+					r = (d & ~mask) | (r & mask);
+					expLo[i] = r & 0xFF;
+					expHi[i] = r >> 8;
+				}
+				auto actLo = dstLo;
+				auto actHi = dstHi;
+				copy16(srcLo.data(), srcHi.data(), actLo.data(), actHi.data(),
+				       num, op, mask);
+				CHECK(actLo == expLo);
+				CHECK(actHi == expHi);
+#ifdef __SSE2__
+				actLo = dstLo;
+				actHi = dstHi;
+				copy16Scalar(srcLo.data(), srcHi.data(), actLo.data(), actHi.data(),
+				             num, op, mask);
+				CHECK(actLo == expLo);
+				CHECK(actHi == expHi);
+#endif
+			}
+		}
+	}
+}
+
+TEST_CASE("V9990LogOp: fill")
+{
+	std::mt19937 rng(42);
+	for (unsigned bpp : {2, 4, 8}) {
+		for (auto op : xrange(32)) {
+			for (auto mask : MASKS) {
+				for (byte color : {0x00, 0x01, 0x30, 0xC0, 0x5A, 0xFF}) {
+					for (auto num : LENGTHS) {
+						auto dst = randomBytes(rng, num + 1);
+						auto expected = dst;
+						for (auto i : xrange(num)) {
+							expected[i + 1] = refByte(op, bpp, color, dst[i + 1], mask);
+						}
+						auto actual = dst;
+						fill(actual.data() + 1, num, op, color, mask, bpp);
+						CHECK(actual == expected);
+#ifdef __SSE2__
+						actual = dst;
+						fillScalar(actual.data() + 1, num, FillOp(op, color, mask, bpp));
+						CHECK(actual == expected);
+#endif
+					}
+				}
+			}
+		}
+	}
+}
+
+TEST_CASE("V9990LogOp: fill16")
+{
+	std::mt19937 rng(99);
+	for (auto op : xrange(32)) {
+		for (word color : {0x0000, 0x0001, 0x0100, 0x1234}) {
+			word mask = 0xF0F7;
+			unsigned num = 37;
+			auto dstLo = randomBytes(rng, num);
+			auto dstHi = randomBytes(rng, num);
+			auto expLo = dstLo;
+			auto expHi = dstHi;
+			for (auto i : xrange(num)) {
+				unsigned d = dstLo[i] + 256 * dstHi[i];
+				unsigned r = refPixel(op, 16, color, d);
+				r = (d & ~mask) | (r & mask);
+				expLo[i] = r & 0xFF;
+				expHi[i] = r >> 8;
+			}
+			fill16(dstLo.data(), dstHi.data(), num, op, color, mask);
+			CHECK(dstLo == expLo);
+			CHECK(dstHi == expHi);
+		}
+	}
+}
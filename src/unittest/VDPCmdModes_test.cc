@@ -0,0 +1,240 @@
+#include "catch.hpp"
+#include "VDPCmdModes.hh"
+#include "xrange.hh"
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace openmsx;
+using namespace openmsx::VDPAccessSlots;
+
+// VRAM as seen by the regular (per access) code of the command engine.
+struct TestVRAM {
+	std::vector<byte> data;
+	void cmdWrite(unsigned addr, byte value, EmuTime::param /*time*/) {
+		data[addr] = value;
+	}
+};
+
+static std::vector<byte> randomVRAM(std::mt19937& rng)
+{
+	std::vector<byte> result(0x20000);
+	for (auto& b : result) b = rng();
+	return result;
+}
+
+// A random line of 'n' pixels or bytes, starting at 'x' in direction 'tx'.
+template<typename Mode>
+static void randomLine(std::mt19937& rng, int step,
+                       unsigned& x, int& tx, unsigned& n)
+{
+	x = rng() % Mode::PIXELS_PER_LINE;
+	tx = (rng() & 1) ? -step : step;
+	unsigned room = (tx > 0) ? (Mode::PIXELS_PER_LINE - 1 - x) / step
+	                         : x / step;
+	n = 1 + rng() % (room + 1);
+}
+
+// The addresses touched by the regular code are inside the BulkRange (in the
+// planar modes: in the lower or upper half).
+template<typename Mode>
+static void checkRange(unsigned x, int tx, unsigned n, unsigned y)
+{
+	BulkRange<Mode> range(x, tx, n, y);
+	REQUIRE(range.valid);
+	for (auto i : xrange(n)) {
+		unsigned a = Mode::addressOf(x + i * tx, y, false);
+		if (Mode::PLANAR) a &= 0xFFFF;
+		CHECK(range.first <= a);
+		CHECK(a <= range.last);
+	}
+}
+
+template<typename Mode, typename LogOp>
+static void checkPset(std::mt19937& rng, LogOp op)
+{
+	for (auto i : xrange(20)) {
+		(void)i;
+		unsigned x, n; int tx;
+		randomLine<Mode>(rng, 1, x, tx, n);
+		unsigned y = rng() % 256;
+		byte color = rng() & Mode::COLOR_MASK;
+		checkRange<Mode>(x, tx, n, y);
+
+		TestVRAM expected{randomVRAM(rng)};
+		auto actual = expected.data;
+		unsigned ex = x;
+		for (auto j : xrange(n)) {
+			(void)j;
+			unsigned a = Mode::addressOf(ex, y, false);
+			Mode::pset(EmuTime::zero(), expected, ex, a,
+			           expected.data[a], color, op);
+			ex += tx;
+		}
+		unsigned ax = bulkPset<Mode>(actual.data(), x, tx, n, y, color,
+		                             EmuTime::zero(), op);
+		CHECK(ax == ex);
+		CHECK(actual == expected.data);
+	}
+}
+
+template<typename Mode>
+static void checkFill(std::mt19937& rng)
+{
+	for (auto i : xrange(100)) {
+		(void)i;
+		unsigned x, n; int tx;
+		randomLine<Mode>(rng, Mode::PIXELS_PER_BYTE, x, tx, n);
+		unsigned y = rng() % 256;
+		byte value = rng();
+		checkRange<Mode>(x, tx, n, y);
+
+		auto expected = randomVRAM(rng);
+		auto actual = expected;
+		for (auto j : xrange(n)) {
+			expected[Mode::addressOf(x + j * tx, y, false)] = value;
+		}
+		bulkFill<Mode>(actual.data(), x, tx, n, y, value);
+		CHECK(actual == expected);
+	}
+}
+
+// HMMM (ymmm == false) or YMMM (ymmm == true). Often on the same or on a
+// neighbouring line, so that source and destination overlap.
+template<typename Mode>
+static void checkCopy(std::mt19937& rng, bool ymmm)
+{
+	for (auto i : xrange(100)) {
+		(void)i;
+		unsigned sx, dx, n; int tx;
+		randomLine<Mode>(rng, Mode::PIXELS_PER_BYTE, sx, tx, n);
+		if (ymmm) {
+			dx = sx;
+		} else {
+			unsigned dummy; int dummyTx;
+			randomLine<Mode>(rng, Mode::PIXELS_PER_BYTE, dx, dummyTx, dummy);
+			unsigned room = (tx > 0)
+				? (Mode::PIXELS_PER_LINE - 1 - std::max(sx, dx)) / Mode::PIXELS_PER_BYTE
+				: std::min(sx, dx) / Mode::PIXELS_PER_BYTE;
+			n = std::min(n, room + 1);
+		}
+		unsigned sy = rng() % 256;
+		unsigned dy = (rng() & 1) ? sy : (sy + (rng() % 3)) % 256;
+		checkRange<Mode>(sx, tx, n, sy);
+		checkRange<Mode>(dx, tx, n, dy);
+
+		auto expected = randomVRAM(rng);
+		auto actual = expected;
+		for (auto j : xrange(n)) {
+			expected[Mode::addressOf(dx + j * tx, dy, false)] =
+				expected[Mode::addressOf(sx + j * tx, sy, false)];
+		}
+		bulkCopy<Mode>(actual.data(), sx, sy, dx, dy, tx, n);
+		CHECK(actual == expected);
+	}
+}
+
+template<typename Mode>
+static void checkMode()
+{
+	std::mt19937 rng(1234);
+	checkPset<Mode>(rng, ImpOp());
+	checkPset<Mode>(rng, AndOp());
+	checkPset<Mode>(rng, OrOp());
+	checkPset<Mode>(rng, XorOp());
+	checkPset<Mode>(rng, NotOp());
+	checkPset<Mode>(rng, TImpOp());
+	checkPset<Mode>(rng, TAndOp());
+	checkPset<Mode>(rng, TOrOp());
+	checkPset<Mode>(rng, TXorOp());
+	checkPset<Mode>(rng, TNotOp());
+	checkFill<Mode>(rng);
+	checkCopy<Mode>(rng, false);
+	checkCopy<Mode>(rng, true);
+}
+
+TEST_CASE("VDPCmdModes: bulk paths give the same VRAM as the regular code")
+{
+	SECTION("Graphic4") { checkMode<Graphic4Mode>(); }
+	SECTION("Graphic5") { checkMode<Graphic5Mode>(); }
+	SECTION("Graphic6") { checkMode<Graphic6Mode>(); }
+	SECTION("Graphic7") { checkMode<Graphic7Mode>(); }
+}
+
+// An access slot table (see VDPAccessSlots.cc) for random slot positions.
+static std::vector<uint8_t> randomAccessTable(std::mt19937& rng)
+{
+	std::vector<int> slots;
+	for (int t = rng() % 16; t < TICKS; t += 4 + rng() % 40) {
+		slots.push_back(t);
+	}
+	auto num = slots.size();
+	for (auto line : {1, 2}) {
+		for (auto i : xrange(num)) slots.push_back(slots[i] + line * TICKS);
+	}
+
+	static constexpr int delta[NUM_DELTAS] = {
+		0, 1, 16, 24, 28, 32, 40, 48, 64, 72, 88, 104, 120, 128, 136
+	};
+	std::vector<uint8_t> result;
+	for (auto step : delta) {
+		for (auto i : xrange(TICKS)) {
+			auto it = std::find_if(slots.begin(), slots.end(),
+				[&](int s) { return (s - i) >= step; });
+			result.push_back(*it - i);
+		}
+	}
+	return result;
+}
+
+TEST_CASE("VDPCmdModes: bulkSlots gives the same timing as the regular code")
+{
+	std::mt19937 rng(5678);
+	auto tab = randomAccessTable(rng);
+	VDP::VDPClock clock(EmuTime::zero());
+	auto at = [&](unsigned ticks) {
+		return clock.getFastAdd(ticks);
+	};
+	static constexpr Delta deltas[] = {
+		DELTA_24, DELTA_40, DELTA_48, DELTA_64, DELTA_72
+	};
+	for (auto i : xrange(1000)) {
+		(void)i;
+		unsigned start = rng() % (4 * TICKS);
+		unsigned limit = start + rng() % (2 * TICKS);
+		unsigned max = rng() % 600;
+		Delta d0 = deltas[rng() % 5];
+		Delta d1 = deltas[rng() % 5];
+		auto calc = [&] {
+			return Calculator(at(0), at(start), at(limit), tab.data());
+		};
+
+		// one access per pixel or byte (HMMV)
+		std::vector<EmuTime> times;
+		auto ref = calc();
+		while ((times.size() < max) && !ref.limitReached()) {
+			ref.next(d0);
+			times.push_back(ref.getTime());
+		}
+		auto bulk = calc();
+		unsigned n = bulkSlots(bulk, max, d0);
+		CHECK(n == times.size());
+		CHECK(bulk.getTime() == (n ? times.back() : at(start)));
+
+		// two accesses per pixel or byte (LMMV, HMMM, YMMM): a pixel only
+		// counts when its second access happens before the limit
+		times.clear();
+		auto ref2 = calc();
+		while ((times.size() < max) && !ref2.limitReached()) {
+			ref2.next(d0);
+			if (ref2.limitReached()) break;
+			ref2.next(d1);
+			times.push_back(ref2.getTime());
+		}
+		auto bulk2 = calc();
+		n = bulkSlots(bulk2, max, d0, d1);
+		CHECK(n == times.size());
+		CHECK(bulk2.getTime() == (n ? times.back() : at(start)));
+	}
+}
@@ -1,7 +1,11 @@
 #include "catch.hpp"
 #include "sha1.hh"
+#include <algorithm>
+#include <chrono>
 #include <cstring>
+#include <iostream>
 #include <sstream>
+#include <vector>
 
 using namespace openmsx;
 
@@ -43,6 +47,21 @@ TEST_CASE("Sha1Sum: parse")
 	}
 }
 
+TEST_CASE("Sha1Sum: raw")
+{
+	Sha1Sum sum("0123456789abcdef00112233445566778899aabb");
+	uint8_t raw[20];
+	sum.toRaw(raw);
+	CHECK(raw[ 0] == 0x01);
+	CHECK(raw[ 1] == 0x23);
+	CHECK(raw[ 7] == 0xef);
+	CHECK(raw[19] == 0xbb);
+
+	Sha1Sum sum2;
+	sum2.fromRaw(raw);
+	CHECK(sum2 == sum);
+}
+
 TEST_CASE("Sha1Sum: clear")
 {
 	Sha1Sum sum("1111111111111111111111111111111111111111");
@@ -132,3 +151,35 @@ TEST_CASE("sha1: update,digest")
 		CHECK(sum.toString() == "34aa973cd4c4daa4f61eeb2bdbad27316534016f");
 	}
 }
+
+TEST_CASE("sha1: large input")
+{
+	std::vector<uint8_t> in(100000);
+	for (size_t i = 0; i < in.size(); ++i) {
+		in[i] = uint8_t((i * 7) ^ (i >> 8));
+	}
+	// different split-ups in update() calls
+	for (size_t chunk : {100000, 4096, 1000, 65, 63}) {
+		SHA1 sha1;
+		for (size_t i = 0; i < in.size(); i += chunk) {
+			sha1.update(&in[i], std::min(chunk, in.size() - i));
+		}
+		CHECK(sha1.digest().toString() == "b9243dd57b72a9f53dbd836d947524143a8409b1");
+	}
+}
+
+TEST_CASE("sha1 benchmark", "[.][benchmark]")
+{
+	std::vector<uint8_t> in(64 * 1024 * 1024, 0x55);
+	(void)SHA1::calc(in.data(), in.size()); // warm up
+	unsigned count = 0;
+	auto start = std::chrono::steady_clock::now();
+	auto stop = start;
+	do {
+		(void)SHA1::calc(in.data(), in.size());
+		++count;
+		stop = std::chrono::steady_clock::now();
+	} while ((stop - start) < std::chrono::milliseconds(500));
+	double s = std::chrono::duration<double>(stop - start).count();
+	std::cout << "sha1: " << (count * double(in.size())) / s / 1e9 << " GB/s\n";
+}
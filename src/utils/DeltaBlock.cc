@@ -1,4 +1,6 @@
 #include "DeltaBlock.hh"
+#include "FileException.hh"
+#include "ThreadPool.hh"
 #include "likely.hh"
 #include "ranges.hh"
 #include "lz4.hh"
@@ -12,6 +14,9 @@
 #ifdef __SSE2__
 #include <emmintrin.h>
 #endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 namespace openmsx {
 
@@ -44,8 +49,11 @@ static size_t loadUleb(const uint8_t*& data)
 }
 
 
-// --- Helper functions to compare {4,8,16} bytes at aligned memory locations ---
+// --- Helper functions to compare {4,8,16,32} bytes ---
 
+// The first pointer must be aligned to the word size, the second one only has
+// to be aligned when no SIMD instructions are used (SIMD has cheap unaligned
+// loads).
 template<int N> bool comp(const uint8_t* p, const uint8_t* q);
 
 template<> bool comp<4>(const uint8_t* p, const uint8_t* q)
@@ -66,13 +74,23 @@ template<> bool comp<16>(const uint8_t* p, const uint8_t* q)
 	// Tests show that (on my machine) using 1 128-bit load is faster than
 	// 2 64-bit loads. Even though the actual comparison is slightly more
 	// complicated with SSE instructions.
-	__m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(p));
-	__m128i b = _mm_load_si128(reinterpret_cast<const __m128i*>(q));
+	__m128i a = _mm_load_si128 (reinterpret_cast<const __m128i*>(p));
+	__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(q));
 	__m128i d = _mm_cmpeq_epi8(a, b);
 	return _mm_movemask_epi8(d) == 0xffff;
 }
 #endif
 
+#ifdef __AVX2__
+template<> bool comp<32>(const uint8_t* p, const uint8_t* q)
+{
+	__m256i a = _mm256_load_si256 (reinterpret_cast<const __m256i*>(p));
+	__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q));
+	__m256i d = _mm256_cmpeq_epi8(a, b);
+	return unsigned(_mm256_movemask_epi8(d)) == 0xffffffff;
+}
+#endif
+
 
 // --- Optimized mismatch function ---
 
@@ -89,22 +107,27 @@ static std::pair<const uint8_t*, const uint8_t*> scan_mismatch(
 {
 	assert((p_end - p) == (q_end - q));
 
-	// When SSE is available, work with 16-byte words, otherwise 4 or 8
-	// bytes. This routine also benefits from AVX2 instructions. Though not
-	// all x86_64 CPUs have AVX2 (all have SSE2), so using them requires
-	// extra run-time checks and that's not worth it at this point.
+	// When AVX2 is available, work with 32-byte words, else when SSE2 is
+	// available with 16-byte words, otherwise 4 or 8 bytes. (Like for the
+	// other SIMD code in openMSX, this is a compile-time choice.)
 	constexpr int WORD_SIZE =
-#ifdef __SSE2__
+#if defined(__AVX2__)
+		sizeof(__m256i);
+#elif defined(__SSE2__)
 		sizeof(__m128i);
 #else
 		sizeof(void*);
 #endif
+	// The SIMD versions of comp<N>() use unaligned loads for 'q'. Without
+	// SIMD both buffers must have the same alignment.
+	constexpr bool NEED_SAME_ALIGNMENT = WORD_SIZE == sizeof(void*);
 
 	// Region too small or
 	// both buffers are differently aligned.
 	if (unlikely((p_end - p) < (2 * WORD_SIZE)) ||
-	    unlikely((reinterpret_cast<uintptr_t>(p) & (WORD_SIZE - 1)) !=
-	             (reinterpret_cast<uintptr_t>(q) & (WORD_SIZE - 1)))) {
+	    (NEED_SAME_ALIGNMENT &&
+	     unlikely((reinterpret_cast<uintptr_t>(p) & (WORD_SIZE - 1)) !=
+	              (reinterpret_cast<uintptr_t>(q) & (WORD_SIZE - 1))))) {
 		goto end;
 	}
 
@@ -182,9 +205,14 @@ static std::pair<const uint8_t*, const uint8_t*> scan_match(
 //   n2 number of bytes are different, and here are the bytes
 //   n3 number of bytes are equal
 //   ...
-static vector<uint8_t> calcDelta(const uint8_t* oldBuf, const uint8_t* newBuf, size_t size)
+// The delta is built in a scratch buffer that is reused for all diffs (so that
+// we don't repeatedly grow a new vector), the final result is copied into an
+// exactly sized buffer.
+static MemBuffer<uint8_t> calcDelta(const uint8_t* oldBuf, const uint8_t* newBuf,
+                                    size_t size, vector<uint8_t>& result,
+                                    size_t& deltaSize)
 {
-	vector<uint8_t> result;
+	result.clear();
 
 	auto* p = oldBuf;
 	auto* q = newBuf;
@@ -216,11 +244,14 @@ static vector<uint8_t> calcDelta(const uint8_t* oldBuf, const uint8_t* newBuf, s
 		if (n3 != 0) storeUleb(result, n3);
 	}
 
-	result.shrink_to_fit();
-	return result;
+	deltaSize = result.size();
+	MemBuffer<uint8_t> delta(deltaSize);
+	memcpy(delta.data(), result.data(), deltaSize);
+	return delta;
 }
 
 // Apply a previously calculated 'delta' to 'oldBuf' to get 'newbuf'.
+// Note: memcpy() already uses the widest available SIMD instructions.
 static void applyDeltaInPlace(uint8_t* buf, size_t size, const uint8_t* delta)
 {
 	auto* end = buf + size;
@@ -250,17 +281,170 @@ DeltaBlock::~DeltaBlock()
 
 #endif
 
+// class DeltaBlockStore
+
+// (plain fseek() only takes a 'long', that's 32-bit on Windows)
+static int seek(FILE* file, size_t offset)
+{
+#ifdef _WIN32
+	return _fseeki64(file, int64_t(offset), SEEK_SET);
+#else
+	return fseeko(file, off_t(offset), SEEK_SET);
+#endif
+}
+
+DeltaBlockStore::DeltaBlockStore()
+	: used(0)
+{
+}
+
+size_t DeltaBlockStore::write(const uint8_t* data, size_t size)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!file) {
+		file.reset(tmpfile());
+		if (!file) {
+			throw FileException("Couldn't create temporary file "
+			                    "for reverse history");
+		}
+	}
+
+	// first-fit in the free list, otherwise append
+	size_t offset = fileSize;
+	auto it = ranges::find_if(freeList, [&](auto& p) { return p.second >= size; });
+	if (it != end(freeList)) {
+		offset = it->first;
+		auto remaining = it->second - size;
+		freeList.erase(it);
+		if (remaining) freeList.emplace(offset + size, remaining);
+	}
+	if ((seek(file.get(), offset) != 0) ||
+	    (fwrite(data, 1, size, file.get()) != size)) {
+		// keep the file in a consistent state (the region is unused)
+		if (offset != fileSize) freeList.emplace(offset, size);
+		throw FileException("Couldn't write reverse history to disk");
+	}
+	fileSize = std::max(fileSize, offset + size);
+	used += size;
+	return offset;
+}
+
+void DeltaBlockStore::read(size_t offset, uint8_t* data, size_t size)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	assert(file);
+	if ((seek(file.get(), offset) != 0) ||
+	    (fread(data, 1, size, file.get()) != size)) {
+		// This can only happen on an I/O error. There's no sane way to
+		// recover: the content of this block is lost.
+		throw FileException("Couldn't read reverse history from disk");
+	}
+}
+
+void DeltaBlockStore::free(size_t offset, size_t size)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	used -= size;
+	// insert in free list, merge with adjacent free regions
+	auto [it, inserted] = freeList.emplace(offset, size);
+	assert(inserted); (void)inserted;
+	if (auto next = std::next(it);
+	    (next != end(freeList)) && (offset + size == next->first)) {
+		it->second += next->second;
+		freeList.erase(next);
+	}
+	if (it != begin(freeList)) {
+		auto prev = std::prev(it);
+		if (prev->first + prev->second == offset) {
+			prev->second += it->second;
+			freeList.erase(it);
+		}
+	}
+}
+
+
+// class DeltaBlockMemory
+
+DeltaBlockMemory::DeltaBlockMemory()
+	: used(0), limit(NO_LIMIT), evictPending(false), failed(false)
+{
+}
+
+size_t DeltaBlockMemory::getStoredSize() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return store ? store->getUsedSize() : 0;
+}
+
+bool DeltaBlockMemory::startEvict()
+{
+	if ((used <= limit) || failed) return false;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (evictable.empty()) return false;
+	}
+	return !evictPending.exchange(true);
+}
+
+void DeltaBlockMemory::addEvictable(const std::shared_ptr<DeltaBlockCopy>& block)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	evictable.push_back(block);
+}
+
+void DeltaBlockMemory::evict()
+{
+	while ((used > limit) && !failed) {
+		std::shared_ptr<DeltaBlockCopy> block;
+		std::shared_ptr<DeltaBlockStore> s;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (evictable.empty()) break;
+			block = evictable.front().lock();
+			evictable.pop_front();
+			if (!block) continue; // already dropped from the history
+			if (!store) store = std::make_shared<DeltaBlockStore>();
+			s = store;
+		}
+		// Don't hold the lock while writing to disk, startEvict() is
+		// called from the emulation thread.
+		try {
+			block->moveToStore(s);
+		} catch (FileException& e) {
+			std::lock_guard<std::mutex> lock(mutex);
+			error = e.getMessage();
+			failed = true;
+			evictable.clear();
+		}
+	}
+	evictPending = false;
+}
+
+std::string DeltaBlockMemory::takeError()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::string result;
+	swap(result, error);
+	return result;
+}
+
+
 // class DeltaBlockCopy
 
-DeltaBlockCopy::DeltaBlockCopy(const uint8_t* data, size_t size)
-	: block(size)
+DeltaBlockCopy::DeltaBlockCopy(const uint8_t* data, size_t size,
+                               std::shared_ptr<DeltaBlockMemory> memory_)
+	: DeltaBlock(std::move(memory_))
+	, block(size)
+	, originalSize(size)
 	, compressedSize(0)
+	, storeOffset(0)
 {
 #ifdef DEBUG
 	sha1 = SHA1::calc(data, size);
 #endif
 	memcpy(block.data(), data, size);
 	assert(!compressed());
+	if (memory) memory->add(size);
 #if STATISTICS
 	allocSize = size;
 	globalAllocSize += allocSize;
@@ -269,9 +453,27 @@ DeltaBlockCopy::DeltaBlockCopy(const uint8_t* data, size_t size)
 #endif
 }
 
+DeltaBlockCopy::~DeltaBlockCopy()
+{
+	if (stored()) {
+		store->free(storeOffset, getSizeNoLock());
+	} else if (memory) {
+		memory->sub(getSizeNoLock());
+	}
+}
+
 void DeltaBlockCopy::apply(uint8_t* dst, size_t size) const
 {
-	if (compressed()) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (stored()) {
+		if (compressed()) {
+			MemBuffer<uint8_t> buf(compressedSize);
+			store->read(storeOffset, buf.data(), compressedSize);
+			LZ4::decompress(buf.data(), dst, int(compressedSize), int(size));
+		} else {
+			store->read(storeOffset, dst, size);
+		}
+	} else if (compressed()) {
 		LZ4::decompress(block.data(), dst, int(compressedSize), int(size));
 	} else {
 		memcpy(dst, block.data(), size);
@@ -283,7 +485,8 @@ void DeltaBlockCopy::apply(uint8_t* dst, size_t size) const
 
 void DeltaBlockCopy::compress(size_t size)
 {
-	if (compressed()) return;
+	std::lock_guard<std::mutex> lock(mutex);
+	if (compressed() || stored()) return;
 
 	size_t dstLen = LZ4::compressBound(size);
 	MemBuffer<uint8_t> buf2(dstLen);
@@ -297,9 +500,10 @@ void DeltaBlockCopy::compress(size_t size)
 	block.swap(buf2);
 	block.resize(compressedSize); // shrink to fit
 	assert(compressed());
+	if (memory) memory->sub(size - compressedSize);
 #ifdef DEBUG
 	MemBuffer<uint8_t> buf3(size);
-	apply(buf3.data(), size);
+	LZ4::decompress(block.data(), buf3.data(), int(compressedSize), int(size));
 	assert(memcmp(buf3.data(), buf2.data(), size) == 0);
 #endif
 #if STATISTICS
@@ -313,19 +517,41 @@ void DeltaBlockCopy::compress(size_t size)
 
 const uint8_t* DeltaBlockCopy::getData()
 {
-	assert(!compressed());
+	assert(!compressed() && !stored());
 	return block.data();
 }
 
+size_t DeltaBlockCopy::getMemorySize() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return stored() ? 0 : getSizeNoLock();
+}
+
+size_t DeltaBlockCopy::moveToStore(const std::shared_ptr<DeltaBlockStore>& store_)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (stored()) return 0;
+
+	auto size = getSizeNoLock();
+	storeOffset = store_->write(block.data(), size);
+	store = store_;
+	block = MemBuffer<uint8_t>();
+	if (memory) memory->sub(size);
+	return size;
+}
+
 
 // class DeltaBlockDiff
 
 DeltaBlockDiff::DeltaBlockDiff(
 		std::shared_ptr<DeltaBlockCopy> prev_,
-		const uint8_t* data, size_t size)
-	: prev(std::move(prev_))
-	, delta(calcDelta(prev->getData(), data, size))
+		const uint8_t* data, size_t size, vector<uint8_t>& scratch,
+		std::shared_ptr<DeltaBlockMemory> memory_)
+	: DeltaBlock(std::move(memory_))
+	, prev(std::move(prev_))
+	, delta(calcDelta(prev->getData(), data, size, scratch, deltaSize))
 {
+	if (memory) memory->add(deltaSize);
 #ifdef DEBUG
 	sha1 = SHA1::calc(data, size);
 
@@ -334,13 +560,18 @@ DeltaBlockDiff::DeltaBlockDiff(
 	assert(memcmp(buf.data(), data, size) == 0);
 #endif
 #if STATISTICS
-	allocSize = delta.size();
+	allocSize = deltaSize;
 	globalAllocSize += allocSize;
 	std::cout << "stat: DeltaBlockDiff " << globalAllocSize
 	          << " (+" << allocSize << ")\n";
 #endif
 }
 
+DeltaBlockDiff::~DeltaBlockDiff()
+{
+	if (memory) memory->sub(deltaSize);
+}
+
 void DeltaBlockDiff::apply(uint8_t* dst, size_t size) const
 {
 	prev->apply(dst, size);
@@ -352,12 +583,56 @@ void DeltaBlockDiff::apply(uint8_t* dst, size_t size) const
 
 size_t DeltaBlockDiff::getDeltaSize() const
 {
-	return delta.size();
+	return deltaSize;
 }
 
 
 // class LastDeltaBlocks
 
+LastDeltaBlocks::LastDeltaBlocks()
+	: memory(std::make_shared<DeltaBlockMemory>())
+	, pendingCount(0), pendingBytes(0)
+{
+}
+
+LastDeltaBlocks::~LastDeltaBlocks()
+{
+	// Waits for all pending compressions. Those only hold weak references,
+	// so blocks that were already dropped from the history are skipped.
+	compressor.reset();
+	assert(pendingCount == 0);
+}
+
+void LastDeltaBlocks::compressAsync(
+	const std::shared_ptr<DeltaBlockCopy>& block, size_t size)
+{
+	// Compressing a (multi-megabyte) block takes long enough to cause a
+	// noticeable hiccup when done on the emulation thread. The block
+	// contents no longer change at this point, so it's safe to do this in
+	// the background.
+	if (!compressor) compressor = std::make_unique<ThreadPool>(1);
+	++pendingCount;
+	pendingBytes += size;
+	compressor->submit([this, weak = std::weak_ptr(block), size] {
+		if (auto b = weak.lock()) {
+			b->compress(size);
+			if (auto& m = b->getMemory()) {
+				m->addEvictable(b);
+				m->evict();
+			}
+		}
+		pendingBytes -= size;
+		--pendingCount;
+	});
+}
+
+void LastDeltaBlocks::enforceMemoryLimit()
+{
+	if (!memory->startEvict()) return;
+	if (!compressor) compressor = std::make_unique<ThreadPool>(1);
+	compressor->submit([m = memory] { m->evict(); });
+}
+
 std::shared_ptr<DeltaBlock> LastDeltaBlocks::createNew(
 		const void* id, const uint8_t* data, size_t size)
 {
@@ -376,11 +651,11 @@ std::shared_ptr<DeltaBlock> LastDeltaBlocks::createNew(
 		if (ref) {
 			// We will switch to a new DeltaBlockCopy object. So
 			// now is a good time to compress the old one.
-			ref->compress(size);
+			compressAsync(ref, size);
 		}
 		// Heuristic: create a new block when too many small
 		// differences have accumulated.
-		auto b = std::make_shared<DeltaBlockCopy>(data, size);
+		auto b = std::make_shared<DeltaBlockCopy>(data, size, memory);
 		it->ref = b;
 		it->last = b;
 		it->accSize = 0;
@@ -388,7 +663,7 @@ std::shared_ptr<DeltaBlock> LastDeltaBlocks::createNew(
 	} else {
 		// Create diff based on earlier reference block.
 		// Reference remains unchanged.
-		auto b = std::make_shared<DeltaBlockDiff>(ref, data, size);
+		auto b = std::make_shared<DeltaBlockDiff>(ref, data, size, scratch, memory);
 		it->last = b;
 		it->accSize += b->getDeltaSize();
 		return b;
@@ -409,7 +684,7 @@ std::shared_ptr<DeltaBlock> LastDeltaBlocks::createNullDiff(
 
 	auto last = it->last.lock();
 	if (!last) {
-		auto b = std::make_shared<DeltaBlockCopy>(data, size);
+		auto b = std::make_shared<DeltaBlockCopy>(data, size, memory);
 		it->ref = b;
 		it->last = b;
 		it->accSize = 0;
@@ -426,7 +701,7 @@ void LastDeltaBlocks::clear()
 {
 	for (const Info& info : infos) {
 		if (auto ref = info.ref.lock()) {
-			ref->compress(info.size);
+			compressAsync(ref, info.size);
 		}
 	}
 	infos.clear();
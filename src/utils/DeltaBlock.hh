@@ -3,9 +3,16 @@
 
 #define STATISTICS 0
 
+#include "FileOperations.hh"
 #include "MemBuffer.hh"
+#include <atomic>
 #include <cstdint>
+#include <deque>
+#include <limits>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 #ifdef DEBUG
 #include "sha1.hh"
@@ -13,6 +20,10 @@
 
 namespace openmsx {
 
+class DeltaBlockCopy;
+class DeltaBlockMemory;
+class ThreadPool;
+
 class DeltaBlock
 {
 public:
@@ -23,8 +34,22 @@ public:
 #endif
 	virtual void apply(uint8_t* dst, size_t size) const = 0;
 
+	/** The amount of (host) memory used by this block. This excludes
+	  * blocks it refers to and data that was moved to disk.
+	  */
+	[[nodiscard]] virtual size_t getMemorySize() const = 0;
+
+	/** The object that keeps track of the memory used by this block,
+	  * possibly nullptr. */
+	[[nodiscard]] const std::shared_ptr<DeltaBlockMemory>& getMemory() const {
+		return memory;
+	}
+
 protected:
-	DeltaBlock() = default;
+	explicit DeltaBlock(std::shared_ptr<DeltaBlockMemory> memory_)
+		: memory(std::move(memory_)) {}
+
+	const std::shared_ptr<DeltaBlockMemory> memory;
 
 #ifdef DEBUG
 public:
@@ -39,46 +64,185 @@ protected:
 };
 
 
+/** Temporary (anonymous) file that holds the content of DeltaBlockCopy
+  * objects that were moved out of memory. Space of destroyed blocks gets
+  * reused for new blocks.
+  */
+class DeltaBlockStore
+{
+public:
+	DeltaBlockStore();
+	DeltaBlockStore(const DeltaBlockStore&) = delete;
+	DeltaBlockStore& operator=(const DeltaBlockStore&) = delete;
+
+	/** Store a block, returns its offset in the file or throws
+	  * FileException. */
+	[[nodiscard]] size_t write(const uint8_t* data, size_t size);
+	void read(size_t offset, uint8_t* data, size_t size);
+	void free(size_t offset, size_t size);
+
+	/** Number of bytes in use (excluding free space) in the file. */
+	[[nodiscard]] size_t getUsedSize() const { return used; }
+
+private:
+	std::mutex mutex;
+	FileOperations::FILE_t file; // deleted when closed
+	std::map<size_t, size_t> freeList; // offset -> size
+	size_t fileSize = 0;
+	std::atomic<size_t> used;
+};
+
+
+/** Keeps track of the (host) memory used by all DeltaBlocks of one reverse
+  * history: the blocks add their size on creation and subtract it again
+  * when they get compressed, moved to disk or destroyed.
+  *
+  * When a limit is set and exceeded, the oldest DeltaBlockCopy objects that
+  * are no longer used as reference for new diffs are moved to a
+  * DeltaBlockStore. That's done on the (background) compressor thread.
+  */
+class DeltaBlockMemory
+{
+public:
+	static constexpr size_t NO_LIMIT = std::numeric_limits<size_t>::max();
+
+	DeltaBlockMemory();
+
+	void add(size_t size) { used += size; }
+	void sub(size_t size) { used -= size; }
+	[[nodiscard]] size_t getUsedSize() const { return used; }
+	[[nodiscard]] size_t getStoredSize() const;
+
+	void setLimit(size_t limit_) { limit = limit_; }
+
+	/** Should evict() be called? Only returns true once, till evict()
+	  * has run. */
+	[[nodiscard]] bool startEvict();
+
+	/** 'block' is no longer used as reference for new diffs, so it may
+	  * be moved to disk. Blocks should be added oldest first.
+	  */
+	void addEvictable(const std::shared_ptr<DeltaBlockCopy>& block);
+
+	/** Move blocks to disk till the memory usage is below the limit (or
+	  * till there are no more blocks that can be moved). After a disk
+	  * error, this does nothing anymore.
+	  */
+	void evict();
+
+	/** Returns the error message of a failed evict() (only once), or an
+	  * empty string. */
+	[[nodiscard]] std::string takeError();
+
+private:
+	mutable std::mutex mutex; // protects the members below
+	std::deque<std::weak_ptr<DeltaBlockCopy>> evictable; // oldest first
+	std::shared_ptr<DeltaBlockStore> store; // created on first use
+	std::string error;
+
+	std::atomic<size_t> used;
+	std::atomic<size_t> limit;
+	std::atomic<bool> evictPending;
+	std::atomic<bool> failed;
+};
+
+
 class DeltaBlockCopy final : public DeltaBlock
 {
 public:
-	DeltaBlockCopy(const uint8_t* data, size_t size);
+	DeltaBlockCopy(const uint8_t* data, size_t size,
+	               std::shared_ptr<DeltaBlockMemory> memory = nullptr);
+	~DeltaBlockCopy() override;
 	void apply(uint8_t* dst, size_t size) const override;
 	void compress(size_t size);
 	[[nodiscard]] const uint8_t* getData();
+	[[nodiscard]] size_t getMemorySize() const override;
+
+	/** Move the (possibly compressed) content of this block to the given
+	  * store. This may only be done for blocks that are no longer used as
+	  * reference for new diffs.
+	  * @return The amount of memory freed by this operation.
+	  * @throw FileException
+	  */
+	size_t moveToStore(const std::shared_ptr<DeltaBlockStore>& store);
 
 private:
 	[[nodiscard]] bool compressed() const { return compressedSize != 0; }
+	[[nodiscard]] bool stored() const { return store != nullptr; }
+	[[nodiscard]] size_t getSizeNoLock() const {
+		return compressed() ? compressedSize : originalSize;
+	}
 
+	// compress() can run on a background thread while the main thread
+	// calls apply() (e.g. during 'reverse goto').
+	mutable std::mutex mutex;
 	MemBuffer<uint8_t> block;
+	size_t originalSize;
 	size_t compressedSize;
+	std::shared_ptr<DeltaBlockStore> store; // only set when moved to disk
+	size_t storeOffset;
 };
 
 
 class DeltaBlockDiff final : public DeltaBlock
 {
 public:
+	/** @param scratch Temporary work buffer, only used during the
+	  *                construction. Reusing the same buffer for many
+	  *                DeltaBlockDiff objects avoids repeated reallocations.
+	  */
 	DeltaBlockDiff(std::shared_ptr<DeltaBlockCopy> prev_,
-	               const uint8_t* data, size_t size);
+	               const uint8_t* data, size_t size,
+	               std::vector<uint8_t>& scratch,
+	               std::shared_ptr<DeltaBlockMemory> memory = nullptr);
+	~DeltaBlockDiff() override;
 	void apply(uint8_t* dst, size_t size) const override;
 	[[nodiscard]] size_t getDeltaSize() const;
+	[[nodiscard]] size_t getMemorySize() const override { return getDeltaSize(); }
+	[[nodiscard]] DeltaBlockCopy* getReference() const { return prev.get(); }
 
 private:
 	const std::shared_ptr<DeltaBlockCopy> prev;
-	const std::vector<uint8_t> delta; // TODO could be tweaked to use OutputBuffer
+	size_t deltaSize;
+	const MemBuffer<uint8_t> delta;
 };
 
 
 class LastDeltaBlocks
 {
 public:
+	LastDeltaBlocks();
+	~LastDeltaBlocks();
+
 	[[nodiscard]] std::shared_ptr<DeltaBlock> createNew(
 		const void* id, const uint8_t* data, size_t size);
 	[[nodiscard]] std::shared_ptr<DeltaBlock> createNullDiff(
 		const void* id, const uint8_t* data, size_t size);
 	void clear();
 
+	/** Keeps track of the memory used by the created blocks. */
+	[[nodiscard]] DeltaBlockMemory& getMemory() { return *memory; }
+	[[nodiscard]] const DeltaBlockMemory& getMemory() const { return *memory; }
+
+	/** Exchange the memory bookkeeping with another object. Used when the
+	  * history (the created blocks) is moved to another ReverseManager.
+	  */
+	void swapMemory(LastDeltaBlocks& other) { memory.swap(other.memory); }
+
+	/** When the memory limit is exceeded, start moving blocks to disk (in
+	  * the background). */
+	void enforceMemoryLimit();
+
+	/** Blocks that are no longer used as reference for new diffs get
+	  * compressed on a background thread. These return the number of
+	  * blocks (and their uncompressed size) still waiting for that.
+	  */
+	[[nodiscard]] size_t getPendingCompressCount() const { return pendingCount; }
+	[[nodiscard]] size_t getPendingCompressBytes() const { return pendingBytes; }
+
 private:
+	void compressAsync(const std::shared_ptr<DeltaBlockCopy>& block, size_t size);
+
 	struct Info {
 		Info(const void* id_, size_t size_)
 			: id(id_), size(size_), accSize(0) {}
@@ -91,6 +255,12 @@ private:
 	};
 
 	std::vector<Info> infos;
+	std::vector<uint8_t> scratch; // see DeltaBlockDiff constructor
+	std::shared_ptr<DeltaBlockMemory> memory;
+
+	std::atomic<size_t> pendingCount;
+	std::atomic<size_t> pendingBytes;
+	std::unique_ptr<ThreadPool> compressor; // created on first use
 };
 
 } // namespace openmsx
@@ -6,6 +6,7 @@
 #include "ranges.hh"
 #include "stl.hh"
 #include "unreachable.hh"
+#include <mutex>
 #include <utility>
 #include <vector>
 #include <cassert>
@@ -212,7 +213,9 @@ template struct MemSet2<uint32_t>;
 /** Aligned memory (de)allocation
  */
 
-// Helper class to keep track of aligned/unaligned pointer pairs
+// Helper class to keep track of aligned/unaligned pointer pairs. Aligned
+// memory is also allocated from worker threads (e.g. by the scalers), so
+// access is protected by a mutex.
 class AllocMap
 {
 public:
@@ -223,12 +226,14 @@ public:
 
 	void insert(void* aligned, void* unaligned) {
 		if (!aligned) return;
+		std::lock_guard<std::mutex> lock(mutex);
 		assert(ranges::none_of(allocMap, EqualTupleValue<0>(aligned)));
 		allocMap.emplace_back(aligned, unaligned);
 	}
 
 	void* remove(void* aligned) {
 		if (!aligned) return nullptr;
+		std::lock_guard<std::mutex> lock(mutex);
 		// LIFO order is more likely than FIFO -> search backwards
 		auto it = rfind_if_unguarded(allocMap,
 		               EqualTupleValue<0>(aligned));
@@ -246,6 +251,7 @@ private:
 
 	// typically contains 5-10 items, so (unsorted) vector is fine
 	std::vector<std::pair<void*, void*>> allocMap;
+	std::mutex mutex;
 };
 
 void* mallocAligned(size_t alignment, size_t size)
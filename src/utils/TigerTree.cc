@@ -2,13 +2,22 @@
 #include "tiger.hh"
 #include "Math.hh"
 #include "MemBuffer.hh"
+#include "ThreadPool.hh"
+#include "xrange.hh"
+#include <algorithm>
 #include <map>
+#include <vector>
 #include <cstring>
 #include <cassert>
 
 namespace openmsx {
 
 constexpr size_t BLOCK_SIZE = 1024;
+// Only hash the leaves in parallel when at least this many are invalid.
+// Typically either (almost) none or all leaves are invalid.
+constexpr size_t PARALLEL_MIN_LEAVES = 1024;
+// Number of leaves hashed in one job.
+constexpr size_t LEAVES_PER_JOB = 256;
 
 struct TTCacheEntry
 {
@@ -53,9 +62,95 @@ TigerTree::TigerTree(TTData& data_, size_t dataSize_, const std::string& name)
 
 const TigerHash& TigerTree::calcHash(const std::function<void(size_t, size_t)>& progressCallback)
 {
+	calcLeaves(progressCallback);
 	return calcHash(getTop(), progressCallback);
 }
 
+// Calculate the hashes of the invalid leaf nodes in parallel. Leaves that
+// are still invalid afterwards (because there were only a few) are calculated
+// later by calcHash(Node, ...).
+void TigerTree::calcLeaves(const std::function<void(size_t, size_t)>& progressCallback)
+{
+	if (entry.valid[getTop().n]) return;
+	// Cheap check to avoid scanning all leaves after a small change: the
+	// number of invalid leaves is at most the number of invalid nodes.
+	if ((entry.numNodes - entry.numNodesValid) < PARALLEL_MIN_LEAVES) return;
+
+	std::vector<size_t> todo;
+	for (size_t n = 0; n < entry.numNodes; n += 2) {
+		if (!entry.valid[n]) todo.push_back(n);
+	}
+	if (todo.size() < PARALLEL_MIN_LEAVES) return;
+
+	// TTData::getData() is not thread-safe, so fetch all data in this
+	// thread. Each job gets its own copy of the data, with an extra byte
+	// in front of each block (see tiger_leaf()).
+	struct Job {
+		MemBuffer<uint8_t> buf{LEAVES_PER_JOB * (BLOCK_SIZE + 1)};
+		std::future<void> done;
+		size_t first, last; // range in 'todo'
+	};
+	std::vector<Job> jobs;
+	ThreadPool threads; // (destroyed before 'jobs')
+	jobs.resize(2 * threads.size()); // keep all threads busy
+
+	auto finish = [&](Job& job) {
+		job.done.get();
+		for (auto i : xrange(job.first, job.last)) {
+			entry.valid[todo[i]] = true;
+		}
+		entry.numNodesValid += job.last - job.first;
+		if (progressCallback) {
+			progressCallback(entry.numNodesValid, entry.numNodes);
+		}
+	};
+
+	size_t j = 0;
+	for (size_t first = 0; first < todo.size(); first += LEAVES_PER_JOB) {
+		auto& job = jobs[j];
+		j = (j + 1) % jobs.size();
+		if (job.done.valid()) finish(job);
+
+		job.first = first;
+		job.last = std::min(first + LEAVES_PER_JOB, todo.size());
+		uint8_t* p = job.buf.data();
+		for (auto i : xrange(job.first, job.last)) {
+			size_t b = todo[i] * (BLOCK_SIZE / 2);
+			size_t l = std::min(dataSize - b, BLOCK_SIZE);
+			memcpy(p + 1, data.getData(b, l), l);
+			p += BLOCK_SIZE + 1;
+		}
+		job.done = threads.submit([this, &todo, &job] {
+			uint8_t* p2 = job.buf.data();
+			for (auto i : xrange(job.first, job.last)) {
+				hashLeaf(todo[i], p2 + 1);
+				p2 += BLOCK_SIZE + 1;
+			}
+		});
+	}
+	for (auto k : xrange(jobs.size())) {
+		// finish in the same order as the jobs were submitted
+		auto& job = jobs[(j + k) % jobs.size()];
+		if (job.done.valid()) finish(job);
+	}
+}
+
+// Calculate the hash of leaf node 'n', the data of that block is at 'd'.
+void TigerTree::hashLeaf(size_t n, uint8_t* d)
+{
+	size_t b = n * (BLOCK_SIZE / 2);
+	size_t l = dataSize - b;
+	if (l >= BLOCK_SIZE) {
+		tiger_leaf(d, entry.hash[n]);
+	} else {
+		// partial last block
+		auto backup = d[-1];
+		d[-1] = 0;
+		tiger(d - 1, l + 1, entry.hash[n]);
+		d[-1] = backup;
+	}
+}
+
 void TigerTree::notifyChange(size_t offset, size_t len, time_t time)
 {
 	entry.time = time;
@@ -94,19 +189,8 @@ const TigerHash& TigerTree::calcHash(Node node, const std::function<void(size_t,
 		} else {
 			// leaf node
 			size_t b = n * (BLOCK_SIZE / 2);
-			size_t l = dataSize - b;
-
-			if (l >= BLOCK_SIZE) {
-				auto* d = data.getData(b, BLOCK_SIZE);
-				tiger_leaf(d, entry.hash[n]);
-			} else {
-				// partial last block
-				auto* d = data.getData(b, l);
-				auto backup = d[-1];
-				d[-1] = 0;
-				tiger(d - 1, l + 1, entry.hash[n]);
-				d[-1] = backup;
-			}
+			size_t l = std::min(dataSize - b, BLOCK_SIZE);
+			hashLeaf(n, data.getData(b, l));
 		}
 		entry.valid[n] = true;
 		entry.numNodesValid++;
@@ -67,7 +67,9 @@ struct TTCacheEntry;
 
 /** Calculate a tiger-tree-hash.
  * Calculation can be done incrementally, so recalculating the hash after a
- * (small) modification of the input is efficient.
+ * (small) modification of the input is efficient. When many blocks must be
+ * (re)hashed (e.g. the first time for a large harddisk image), the leaf
+ * hashes are calculated in parallel, in multiple threads.
  */
 class TigerTree
 {
@@ -102,6 +104,8 @@ private:
 	[[nodiscard]] Node getRightChild(Node node) const;
 
 	[[nodiscard]] const TigerHash& calcHash(Node node, const std::function<void(size_t, size_t)>& progressCallback);
+	void calcLeaves(const std::function<void(size_t, size_t)>& progressCallback);
+	void hashLeaf(size_t n, uint8_t* d);
 
 	TTData& data;
 	const size_t dataSize;
@@ -260,14 +260,24 @@ private:
 	uint8_t x[4];
 };
 
+class UA_L64 {
+public:
+	[[nodiscard]] inline operator uint64_t() const { return read_UA_L64(x); }
+	inline UA_L64& operator=(uint64_t a) { write_UA_L64(x, a); return *this; }
+private:
+	uint8_t x[8];
+};
+
 static_assert(sizeof(UA_B16)  == 2, "must have size 2");
 static_assert(sizeof(UA_L16)  == 2, "must have size 2");
 static_assert(sizeof(UA_B32)  == 4, "must have size 4");
 static_assert(sizeof(UA_L32)  == 4, "must have size 4");
+static_assert(sizeof(UA_L64)  == 8, "must have size 8");
 static_assert(alignof(UA_B16) == 1, "must have alignment 1");
 static_assert(alignof(UA_L16) == 1, "must have alignment 1");
 static_assert(alignof(UA_B32) == 1, "must have alignment 1");
 static_assert(alignof(UA_L32) == 1, "must have alignment 1");
+static_assert(alignof(UA_L64) == 1, "must have alignment 1");
 
 // Template meta-programming.
 // Get a type of the same size of the given type that stores the value in a
@@ -28,6 +28,10 @@ A million repetitions of "a"
 #ifdef __SSE2__
 #include <emmintrin.h> // SSE2
 #endif
+#if defined(__SHA__) && defined(__SSE4_1__)
+#include <immintrin.h> // SHA extensions
+#include <utility>
+#endif
 
 using std::string;
 
@@ -241,6 +245,20 @@ std::string Sha1Sum::toString() const
 	return string(buf, 40);
 }
 
+void Sha1Sum::fromRaw(const uint8_t* data)
+{
+	for (int i = 0; i < 5; ++i) {
+		a[i] = Endian::read_UA_B32(data + 4 * i);
+	}
+}
+
+void Sha1Sum::toRaw(uint8_t* data) const
+{
+	for (int i = 0; i < 5; ++i) {
+		Endian::write_UA_B32(data + 4 * i, a[i]);
+	}
+}
+
 bool Sha1Sum::empty() const
 {
 	return ranges::all_of(a, [](auto& e) { return e == 0; });
@@ -266,7 +284,75 @@ SHA1::SHA1()
 	m_finalized = false;
 }
 
-void SHA1::transform(const uint8_t buffer[64])
+#if defined(__SHA__) && defined(__SSE4_1__)
+
+// One step of 4 rounds using the SHA extensions. Step 'G' uses message words
+// 4*G..4*G+3, the message schedule for step G+3 is (partly) calculated at the
+// same time.
+template<int G>
+static inline void sha1Step(__m128i& abcd, __m128i e[2], __m128i msg[4], const uint8_t* data)
+{
+	constexpr int k = G % 4;
+	if constexpr (G < 4) {
+		const __m128i MASK = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+		msg[k] = _mm_shuffle_epi8(
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * k)), MASK);
+	}
+	if constexpr (G == 0) {
+		e[0] = _mm_add_epi32(e[0], msg[0]);
+	} else {
+		e[G & 1] = _mm_sha1nexte_epu32(e[G & 1], msg[k]);
+	}
+	e[(G + 1) & 1] = abcd;
+	if constexpr ((3 <= G) && (G <= 18)) {
+		msg[(k + 1) % 4] = _mm_sha1msg2_epu32(msg[(k + 1) % 4], msg[k]);
+	}
+	abcd = _mm_sha1rnds4_epu32(abcd, e[G & 1], G / 5);
+	if constexpr ((1 <= G) && (G <= 16)) {
+		msg[(k + 3) % 4] = _mm_sha1msg1_epu32(msg[(k + 3) % 4], msg[k]);
+	}
+	if constexpr ((2 <= G) && (G <= 17)) {
+		msg[(k + 2) % 4] = _mm_xor_si128(msg[(k + 2) % 4], msg[k]);
+	}
+}
+
+template<size_t... G>
+static inline void sha1Steps(__m128i& abcd, __m128i e[2], __m128i msg[4], const uint8_t* data,
+                             std::index_sequence<G...>)
+{
+	(sha1Step<G>(abcd, e, msg, data), ...);
+}
+
+void SHA1::transform(const uint8_t* data, size_t numBlocks)
+{
+	// Keep the state in registers for all blocks.
+	__m128i abcd = _mm_shuffle_epi32(
+		_mm_loadu_si128(reinterpret_cast<const __m128i*>(m_state.a)), 0x1B);
+	__m128i e0 = _mm_set_epi32(int(m_state.a[4]), 0, 0, 0);
+	for (/**/; numBlocks; --numBlocks, data += 64) {
+		__m128i abcdSave = abcd;
+		__m128i e[2] = {e0, e0};
+		__m128i msg[4];
+		sha1Steps(abcd, e, msg, data, std::make_index_sequence<20>());
+		e0 = _mm_sha1nexte_epu32(e[0], e0);
+		abcd = _mm_add_epi32(abcd, abcdSave);
+	}
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(m_state.a), _mm_shuffle_epi32(abcd, 0x1B));
+	m_state.a[4] = uint32_t(_mm_extract_epi32(e0, 3));
+}
+
+#else
+
+void SHA1::transform(const uint8_t* data, size_t numBlocks)
+{
+	for (/**/; numBlocks; --numBlocks, data += 64) {
+		transformBlock(data);
+	}
+}
+
+#endif
+
+void SHA1::transformBlock(const uint8_t buffer[64])
 {
 	WorkspaceBlock block(buffer);
 
@@ -325,10 +411,10 @@ void SHA1::update(const uint8_t* data, size_t len)
 	size_t i;
 	if ((j + len) > 63) {
 		memcpy(&m_buffer[j], data, (i = 64 - j));
-		transform(m_buffer);
-		for (; i + 63 < len; i += 64) {
-			transform(&data[i]);
-		}
+		transform(m_buffer, 1);
+		size_t numBlocks = (len - i) / 64;
+		transform(&data[i], numBlocks);
+		i += 64 * numBlocks;
 		j = 0;
 	} else {
 		i = 0;
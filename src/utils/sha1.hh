@@ -34,6 +34,12 @@ public:
 	void parse40(const char* str);
 	[[nodiscard]] std::string toString() const;
 
+	/** Convert from/to the 20-byte binary representation (the same byte
+	 * order as in the hex string).
+	 */
+	void fromRaw(const uint8_t* data);
+	void toRaw(uint8_t* data) const;
+
 	// Test or set 'null' value.
 	[[nodiscard]] bool empty() const;
 	void clear();
@@ -91,7 +97,8 @@ public:
 	[[nodiscard]] static Sha1Sum calc(const uint8_t* data, size_t len);
 
 private:
-	void transform(const uint8_t buffer[64]);
+	void transform(const uint8_t* data, size_t numBlocks);
+	void transformBlock(const uint8_t buffer[64]);
 	void finalize();
 
 	uint64_t m_count;
@@ -114,6 +114,15 @@ void AviRecorder::stop()
 		mixer = nullptr;
 	}
 	sampleRate = 0;
+	if (aviWriter) {
+		// The last frames are still being written in the background.
+		try {
+			aviWriter->finish();
+		} catch (MSXException& e) {
+			reactor.getCliComm().printWarning(
+				"Error while writing avi file: ", e.getMessage());
+		}
+	}
 	aviWriter.reset();
 	wavWriter.reset();
 }
@@ -2,28 +2,49 @@
 
 #include "AviWriter.hh"
 #include "FileOperations.hh"
+#include "FrameSource.hh"
 #include "MSXException.hh"
 #include "build-info.hh"
 #include "Version.hh"
 #include "cstdiop.hh" // for snprintf
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstring>
 #include <ctime>
+#include <exception>
+#include <memory>
+#include <thread>
 
 namespace openmsx {
 
 constexpr unsigned AVI_HEADER_SIZE = 500;
+// Number of frames that can wait for the writer thread. At 640x480x32bpp
+// that's about 1.2MB per frame.
+constexpr unsigned MAX_PENDING_FRAMES = 16;
+
+// Threads that help the writer thread with the motion search of the codec.
+// Leave one core for the emulation and one for the writer thread itself. A
+// few helpers are enough, a frame only has a few dozen rows of blocks.
+static std::unique_ptr<ThreadPool> createSearchThreads()
+{
+	unsigned cores = std::thread::hardware_concurrency();
+	if (cores <= 2) return nullptr;
+	return std::make_unique<ThreadPool>(std::min(cores - 2, 4u));
+}
 
 AviWriter::AviWriter(const Filename& filename, unsigned width_,
                      unsigned height_, unsigned bpp, unsigned channels_,
                      unsigned freq_)
 	: file(filename, "wb")
-	, codec(width_, height_, bpp)
+	, searchThreads(createSearchThreads())
+	, codec(width_, height_, bpp, searchThreads.get())
 	, fps(0.0f) // will be filled in later
 	, width(width_)
 	, height(height_)
 	, channels(channels_)
 	, audiorate(freq_)
+	, writer(1)
 {
 	uint8_t dummy[AVI_HEADER_SIZE] = {};
 	file.write(dummy, sizeof(dummy));
@@ -37,6 +58,10 @@ AviWriter::AviWriter(const Filename& filename, unsigned width_,
 
 AviWriter::~AviWriter()
 {
+	// Normally finish() already did this. If not (e.g. when an
+	// exception is being handled), errors can only be ignored here.
+	writer.wait();
+
 	if (written == 0) {
 		// no data written yet (a recording less than one video frame)
 		std::string filename = file.getURL();
@@ -238,7 +263,7 @@ AviWriter::~AviWriter()
 	}
 }
 
-void AviWriter::addAviChunk(const char* tag, unsigned size, void* data, unsigned flags)
+void AviWriter::addAviChunk(const char* tag, unsigned size, const void* data, unsigned flags)
 {
 	struct {
 		char t[4];
@@ -261,25 +286,74 @@ void AviWriter::addAviChunk(const char* tag, unsigned size, void* data, unsigned
 	index[idxSize + 3] = size;
 }
 
+void AviWriter::collectFrame()
+{
+	auto p = std::move(pending.front());
+	pending.pop_front();
+	freeFrames.push_back(std::move(p.frame));
+	p.done.get(); // rethrows an error that occurred while writing
+}
+
+void AviWriter::finish()
+{
+	// Wait for all frames, also after an error. Report the first one.
+	std::exception_ptr error;
+	while (!pending.empty()) {
+		try {
+			collectFrame();
+		} catch (...) {
+			if (!error) error = std::current_exception();
+		}
+	}
+	if (error) std::rethrow_exception(error);
+}
+
 void AviWriter::addFrame(FrameSource* frame, unsigned samples, int16_t* sampleData)
 {
-	bool keyFrame = (frames++ % 300 == 0);
-	void* buffer;
-	unsigned size;
-	codec.compressFrame(keyFrame, frame, buffer, size);
-	addAviChunk("00dc", size, buffer, keyFrame ? 0x10 : 0x0);
+	// Wait for the oldest frame when too many are queued, this also
+	// reports (rethrows) any error that occurred while writing it.
+	while (!pending.empty() &&
+	       ((pending.size() >= MAX_PENDING_FRAMES) ||
+	        (pending.front().done.wait_for(std::chrono::seconds(0)) ==
+	         std::future_status::ready))) {
+		collectFrame();
+	}
 
+	std::unique_ptr<Frame> f;
+	if (freeFrames.empty()) {
+		f = std::make_unique<Frame>();
+		f->pixels.resize(codec.getFrameSize());
+	} else {
+		f = std::move(freeFrames.back());
+		freeFrames.pop_back();
+	}
+	f->keyFrame = (frames++ % 300 == 0);
+	codec.copyFrame(frame, f->pixels.data());
+	f->pixelFormat = frame->getPixelFormat();
+	f->samples.clear();
 	if (samples) {
 		assert((samples % channels) == 0);
 		assert(audiorate != 0);
-		if (OPENMSX_BIGENDIAN) {
-			// See comment in WavWriter::write()
-			//VLA(Endian::L16, buf, samples); // doesn't work in clang
-			std::vector<Endian::L16> buf(sampleData, sampleData + samples);
-			addAviChunk("01wb", samples * sizeof(int16_t), buf.data(), 0);
-		} else {
-			addAviChunk("01wb", samples * sizeof(int16_t), sampleData, 0);
-		}
+		f->samples.assign(sampleData, sampleData + samples);
+	}
+	auto* fp = f.get();
+	pending.push_back({writer.submit([this, fp] { writeFrame(*fp); }),
+	                   std::move(f)});
+}
+
+void AviWriter::writeFrame(Frame& frame)
+{
+	// Runs in the writer thread. Everything it touches (codec, file,
+	// index, counters) is only used by the main thread before the first
+	// and after the last frame.
+	void* buffer;
+	unsigned size;
+	codec.compressFrame(frame.keyFrame, frame.pixels.data(),
+	                    frame.pixelFormat, buffer, size);
+	addAviChunk("00dc", size, buffer, frame.keyFrame ? 0x10 : 0x0);
+
+	if (auto samples = unsigned(frame.samples.size())) {
+		addAviChunk("01wb", samples * sizeof(int16_t), frame.samples.data(), 0);
 		audiowritten += samples;
 	}
 }
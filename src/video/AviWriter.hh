@@ -5,8 +5,12 @@
 
 #include "ZMBVEncoder.hh"
 #include "File.hh"
+#include "ThreadPool.hh"
 #include "endian.hh"
 #include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
 #include <vector>
 
 namespace openmsx {
@@ -20,13 +24,37 @@ public:
 	AviWriter(const Filename& filename, unsigned width, unsigned height,
 	          unsigned bpp, unsigned channels, unsigned freq);
 	~AviWriter();
+
+	/** Only the image (and the audio samples) are copied in the calling
+	  * thread, compressing and writing happens in a background thread.
+	  * When that thread falls too far behind, this method blocks.
+	  */
 	void addFrame(FrameSource* frame, unsigned samples, int16_t* sampleData);
 	void setFps(float fps_) { fps = fps_; }
 
+	/** Wait till all frames passed to addFrame() are written. Throws when
+	  * writing any of them failed. Should be called before destroying
+	  * this object, the destructor can only ignore such errors.
+	  */
+	void finish();
+
 private:
-	void addAviChunk(const char* tag, unsigned size, void* data, unsigned flags);
+	struct Frame {
+		MemBuffer<uint8_t> pixels;
+		std::vector<Endian::L16> samples;
+		PixelFormat pixelFormat;
+		bool keyFrame;
+	};
+	struct PendingFrame {
+		std::future<void> done;
+		std::unique_ptr<Frame> frame;
+	};
+	void collectFrame();
+	void writeFrame(Frame& frame);
+	void addAviChunk(const char* tag, unsigned size, const void* data, unsigned flags);
 
 	File file;
+	std::unique_ptr<ThreadPool> searchThreads; // helpers for the codec
 	ZMBVEncoder codec;
 	std::vector<Endian::L32> index;
 
@@ -39,6 +67,13 @@ private:
 	unsigned frames;
 	unsigned audiowritten;
 	unsigned written;
+
+	/** Frames that are not yet written (oldest first). Their number is
+	  * limited, each one holds a full (uncompressed) image. */
+	std::deque<PendingFrame> pending;
+	/** Written frames, their buffers are reused for the next frames. */
+	std::vector<std::unique_ptr<Frame>> freeFrames;
+	ThreadPool writer; // compresses and writes, must be destroyed first
 };
 
 } // namespace openmsx
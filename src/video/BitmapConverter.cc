@@ -1,5 +1,5 @@
 #include "BitmapConverter.hh"
-#include "Math.hh"
+#include "YJKConverter.hh"
 #include "likely.hh"
 #include "unreachable.hh"
 #include "build-info.hh"
@@ -278,25 +278,9 @@ void BitmapConverter<Pixel>::renderYJK(
 	const byte* __restrict vramPtr0,
 	const byte* __restrict vramPtr1)
 {
-	for (unsigned i = 0; i < 64; ++i) {
-		unsigned p[4];
-		p[0] = vramPtr0[2 * i + 0];
-		p[1] = vramPtr1[2 * i + 0];
-		p[2] = vramPtr0[2 * i + 1];
-		p[3] = vramPtr1[2 * i + 1];
-
-		int j = (p[2] & 7) + ((p[3] & 3) << 3) - ((p[3] & 4) << 3);
-		int k = (p[0] & 7) + ((p[1] & 3) << 3) - ((p[1] & 4) << 3);
-
-		for (unsigned n = 0; n < 4; ++n) {
-			int y = p[n] >> 3;
-			int r = Math::clip<0, 31>(y + j);
-			int g = Math::clip<0, 31>(y + k);
-			int b = Math::clip<0, 31>((5 * y - 2 * j - k) / 4);
-			int col = (r << 10) + (g << 5) + b;
-			pixelPtr[4 * i + n] = palette32768[col];
-		}
-	}
+	alignas(16) uint16_t colors[YJKConverter::WIDTH];
+	YJKConverter::calcColors<false>(vramPtr0, vramPtr1, colors);
+	YJKConverter::lookup<false>(colors, pixelPtr, palette16, palette32768);
 }
 
 template <class Pixel>
@@ -305,32 +289,9 @@ void BitmapConverter<Pixel>::renderYAE(
 	const byte* __restrict vramPtr0,
 	const byte* __restrict vramPtr1)
 {
-	for (unsigned i = 0; i < 64; ++i) {
-		unsigned p[4];
-		p[0] = vramPtr0[2 * i + 0];
-		p[1] = vramPtr1[2 * i + 0];
-		p[2] = vramPtr0[2 * i + 1];
-		p[3] = vramPtr1[2 * i + 1];
-
-		int j = (p[2] & 7) + ((p[3] & 3) << 3) - ((p[3] & 4) << 3);
-		int k = (p[0] & 7) + ((p[1] & 3) << 3) - ((p[1] & 4) << 3);
-
-		for (unsigned n = 0; n < 4; ++n) {
-			Pixel pix;
-			if (p[n] & 0x08) {
-				// YAE
-				pix = palette16[p[n] >> 4];
-			} else {
-				// YJK
-				int y = p[n] >> 3;
-				int r = Math::clip<0, 31>(y + j);
-				int g = Math::clip<0, 31>(y + k);
-				int b = Math::clip<0, 31>((5 * y - 2 * j - k) / 4);
-				pix = palette32768[(r << 10) + (g << 5) + b];
-			}
-			pixelPtr[4 * i + n] = pix;
-		}
-	}
+	alignas(16) uint16_t colors[YJKConverter::WIDTH];
+	YJKConverter::calcColors<true>(vramPtr0, vramPtr1, colors);
+	YJKConverter::lookup<true>(colors, pixelPtr, palette16, palette32768);
 }
 
 template <class Pixel>
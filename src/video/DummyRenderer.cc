@@ -83,6 +83,10 @@ void DummyRenderer::updateVRAM(unsigned /*offset*/, EmuTime::param /*time*/) {
 void DummyRenderer::updateWindow(bool /*enabled*/, EmuTime::param /*time*/) {
 }
 
+bool DummyRenderer::mayNeedUpdate(unsigned /*first*/, unsigned /*last*/) const {
+	return false;
+}
+
 void DummyRenderer::paint(OutputSurface& /*output*/) {
 }
 
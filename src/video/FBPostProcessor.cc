@@ -6,6 +6,9 @@
 #include "Scaler.hh"
 #include "ScalerFactory.hh"
 #include "SDLOutputSurface.hh"
+#include "SDLOffScreenSurface.hh"
+#include "PerfCounters.hh"
+#include "ThreadPool.hh"
 #include "Math.hh"
 #include "aligned.hh"
 #include "checked_cast.hh"
@@ -13,9 +16,11 @@
 #include "xrange.hh"
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cmath>
 #include <cstdint>
 #include <cstddef>
+#include <cstring>
 #ifdef __SSE2__
 #include <emmintrin.h>
 #endif
@@ -251,23 +256,13 @@ FBPostProcessor<Pixel>::FBPostProcessor(MSXMotherBoard& motherBoard_,
 template <class Pixel>
 FBPostProcessor<Pixel>::~FBPostProcessor()
 {
+	waitScaleJob();
 	renderSettings.getNoiseSetting().detach(*this);
 }
 
 template <class Pixel>
-void FBPostProcessor<Pixel>::paint(OutputSurface& output_)
+void FBPostProcessor<Pixel>::updateScaler(const PixelFormat& format)
 {
-	auto& output = checked_cast<SDLOutputSurface&>(output_);
-	if (renderSettings.getInterleaveBlackFrame()) {
-		interleaveCount ^= 1;
-		if (interleaveCount) {
-			output.clearScreen();
-			return;
-		}
-	}
-
-	if (!paintFrame) return;
-
 	// New scaler algorithm selected?
 	auto algo = renderSettings.getScaleAlgorithm();
 	unsigned factor = renderSettings.getScaleFactor();
@@ -275,11 +270,26 @@ void FBPostProcessor<Pixel>::paint(OutputSurface& output_)
 		scaleAlgorithm = algo;
 		scaleFactor = factor;
 		currScaler = ScalerFactory<Pixel>::createScaler(
-			PixelOperations<Pixel>(output.getPixelFormat()),
-			renderSettings);
+			PixelOperations<Pixel>(format), renderSettings);
+		changeTracker.invalidate(); // scale all lines again
 	}
 
-	// Scale image.
+	// Number of scale threads changed? This is only called when
+	// scaleImage() isn't running, so it's safe to replace the pool.
+	unsigned numThreads = renderSettings.getScaleThreads();
+	if (numThreads != (bandThreads ? bandThreads->size() : 0)) {
+		bandThreads.reset();
+		if (numThreads) {
+			bandThreads = std::make_unique<ThreadPool>(numThreads);
+		}
+	}
+}
+
+template <class Pixel>
+void FBPostProcessor<Pixel>::scaleImage(SDLOutputSurface& output, float horStretch)
+{
+	// Note: this can run in the scale thread, so it should not access any
+	// settings (the scaler itself only uses thread-safe settings).
 	const unsigned srcHeight = paintFrame->getHeight();
 	const unsigned dstHeight = output.getLogicalHeight();
 
@@ -287,42 +297,176 @@ void FBPostProcessor<Pixel>::paint(OutputSurface& output_)
 	unsigned srcStep = srcHeight / g;
 	unsigned dstStep = dstHeight / g;
 
+	// Scalers that can scale in bands only look at a few neighbouring
+	// lines. For those only the lines that changed since the previous call
+	// are scaled again (into 'prevScaled', which is then copied to the
+	// output). On a (mostly) static screen this skips most of the work.
+	// At 1x, scaling a line is about as cheap as comparing it.
+	unsigned inWidth = lrintf(horStretch);
+	bool partial = currScaler->canScaleInBands() && !superImposeVideoFrame &&
+	               (scaleFactor > 1) && changeTracker.usePartial();
+	auto changed = partial ? getChangedLines(output, srcStep, inWidth)
+	                       : std::vector<bool>(g, true);
+	SDLOutputSurface& target = partial ? *prevScaled : output;
+
+	// When there are extra scale threads (and the scaler supports it) the
+	// regions are split further in bands of at most 'maxDstLines' lines,
+	// so that each thread gets roughly the same amount of work.
+	bool parallel = bandThreads && currScaler->canScaleInBands();
+	unsigned numBands = parallel ? bandThreads->size() + 1 : 1;
+	unsigned maxDstLines = ((g + numBands - 1) / numBands) * dstStep;
+
 	// TODO: Store all MSX lines in RawFrame and only scale the ones that fit
 	//       on the PC screen, as a preparation for resizable output window.
-	unsigned srcStartY = 0;
-	unsigned dstStartY = 0;
-	while (dstStartY < dstHeight) {
-		// Currently this is true because the source frame height
-		// is always >= dstHeight/(dstStep/srcStep).
-		assert(srcStartY < srcHeight);
-
-		// get region with equal lineWidth
-		unsigned lineWidth = getLineWidth(paintFrame, srcStartY, srcStep);
-		unsigned srcEndY = srcStartY + srcStep;
-		unsigned dstEndY = dstStartY + dstStep;
-		while ((srcEndY < srcHeight) && (dstEndY < dstHeight) &&
-		       (getLineWidth(paintFrame, srcEndY, srcStep) == lineWidth)) {
-			srcEndY += srcStep;
-			dstEndY += dstStep;
-		}
+	auto bands = getScaleBands(*paintFrame, dstHeight, srcStep, dstStep,
+	                           changed, maxDstLines);
 
-		// fill region
+	// fill regions
+	auto scaleBand = [&](const ScaleBand& b, ScalerOutput<Pixel>& dst) {
 		//fprintf(stderr, "post processing lines %d-%d: %d\n",
-		//	srcStartY, srcEndY, lineWidth );
-		float horStretch = renderSettings.getHorizontalStretch();
-		unsigned inWidth = lrintf(horStretch);
-		std::unique_ptr<ScalerOutput<Pixel>> dst(
-			StretchScalerOutputFactory<Pixel>::create(
-				output, pixelOps, inWidth));
+		//	b.srcStartY, b.srcEndY, b.lineWidth );
 		currScaler->scaleImage(
 			*paintFrame, superImposeVideoFrame,
-			srcStartY, srcEndY, lineWidth, // source
-			*dst, dstStartY, dstEndY); // dest
+			b.srcStartY, b.srcEndY, b.lineWidth, // source
+			dst, b.dstStartY, b.dstEndY); // dest
+	};
+	if (!parallel || (bands.size() <= 1)) {
+		for (auto& b : bands) {
+			std::unique_ptr<ScalerOutput<Pixel>> dst(
+				StretchScalerOutputFactory<Pixel>::create(
+					target, pixelOps, inWidth));
+			scaleBand(b, *dst);
+		}
+	} else {
+		// Create (and destroy) all outputs in this thread, creating
+		// one (possibly) locks the SDL surface. Each band has its own
+		// output, the outputs themselves are not thread-safe.
+		std::vector<std::unique_ptr<ScalerOutput<Pixel>>> dsts;
+		for (auto i : xrange(bands.size())) {
+			(void)i;
+			dsts.push_back(StretchScalerOutputFactory<Pixel>::create(
+				target, pixelOps, inWidth));
+		}
+		std::vector<std::future<void>> jobs;
+		for (auto i : xrange(size_t(1), bands.size())) {
+			jobs.push_back(bandThreads->submit([&, i] {
+				scaleBand(bands[i], *dsts[i]);
+			}));
+		}
+		scaleBand(bands[0], *dsts[0]);
+		for (auto& job : jobs) job.get();
+	}
+
+	if (partial) copyFrame(*prevScaled, output);
+}
 
-		// next region
-		srcStartY = srcEndY;
-		dstStartY = dstEndY;
+template <class Pixel>
+std::vector<bool> FBPostProcessor<Pixel>::getChangedLines(
+	SDLOutputSurface& output, unsigned srcStep, unsigned inWidth)
+{
+	bool valid = prevScaled &&
+	             (prevScaled->getLogicalSize() == output.getLogicalSize()) &&
+	             (prevInWidth == inWidth);
+	if (!prevScaled ||
+	    (prevScaled->getLogicalSize() != output.getLogicalSize())) {
+		prevScaled = std::make_unique<SDLOffScreenSurface>(
+			*output.getSDLSurface());
 	}
+	prevInWidth = inWidth;
+	return changeTracker.update(*paintFrame, srcStep, valid);
+}
+
+template <class Pixel>
+bool FBPostProcessor<Pixel>::canScaleInThread() const
+{
+	// Not when the output of this PostProcessor is combined with the
+	// output of another one: that other one can change its frame at any
+	// time. For laserdisc, rotateFrames() returns the frame that is being
+	// painted to the caller (to render the next frame in).
+	return (renderSettings.getPostProcessThread() != RenderSettings::PP_MAIN_THREAD) &&
+	       canDoInterlace && !superImposeVideoFrame && !superImposeVdpFrame;
+}
+
+template <class Pixel>
+void FBPostProcessor<Pixel>::startScaleJob()
+{
+	assert(!scaleJob.valid());
+	auto& output = checked_cast<SDLOutputSurface&>(screen);
+	updateScaler(output.getPixelFormat());
+	if (!scaleThread) {
+		scaleThread = std::make_unique<ThreadPool>(1);
+	}
+	scalingIdx = (scaledIdx == 0) ? 1 : 0; // keep the previous result
+	auto& target = scaledFrames[scalingIdx];
+	if (!target || (target->getLogicalSize() != output.getLogicalSize())) {
+		// (re)create, also after the output size (scale factor)
+		// changed
+		target = std::make_unique<SDLOffScreenSurface>(
+			*output.getSDLSurface());
+	}
+	float horStretch = renderSettings.getHorizontalStretch();
+	scaleJob = scaleThread->submit([this, &target, horStretch] {
+		ScopedPerfTimer perfTimer(PerfCounter::POST_PROCESSOR);
+		scaleImage(*target, horStretch);
+	});
+}
+
+template <class Pixel>
+void FBPostProcessor<Pixel>::waitScaleJob()
+{
+	if (!scaleJob.valid()) return;
+	scaleJob.get();
+	scaledIdx = scalingIdx;
+	scalingIdx = -1;
+}
+
+template <class Pixel>
+void FBPostProcessor<Pixel>::copyFrame(SDLOutputSurface& src, SDLOutputSurface& dst)
+{
+	auto width = dst.getLogicalWidth();
+	auto srcAccess = src.getDirectPixelAccess();
+	auto dstAccess = dst.getDirectPixelAccess();
+	for (auto y : xrange(dst.getLogicalHeight())) {
+		memcpy(dstAccess.getLinePtr<Pixel>(y),
+		       srcAccess.getLinePtr<Pixel>(y),
+		       width * sizeof(Pixel));
+	}
+}
+
+template <class Pixel>
+void FBPostProcessor<Pixel>::paint(OutputSurface& output_)
+{
+	ScopedPerfTimer perfTimer(PerfCounter::POST_PROCESSOR);
+
+	auto& output = checked_cast<SDLOutputSurface&>(output_);
+	if (renderSettings.getInterleaveBlackFrame()) {
+		interleaveCount ^= 1;
+		if (interleaveCount) {
+			output.clearScreen();
+			return;
+		}
+	}
+
+	if (!paintFrame) return;
+
+	if (scaleJob.valid() &&
+	    ((renderSettings.getPostProcessThread() != RenderSettings::PP_THREAD_THROUGHPUT) ||
+	     (scaledIdx == -1) ||
+	     (scaleJob.wait_for(std::chrono::seconds(0)) == std::future_status::ready))) {
+		waitScaleJob();
+	}
+	if (newFrame && (scaledIdx != -1) &&
+	    (output.getLogicalSize() == scaledFrames[scaledIdx]->getLogicalSize())) {
+		// Show the result of the scale thread. This is not used when
+		// repainting the same frame again (e.g. when paused): then
+		// the result should reflect changes in the (scaler) settings.
+		copyFrame(*scaledFrames[scaledIdx], output);
+	} else {
+		waitScaleJob(); // the scaler can't be shared with the thread
+		updateScaler(output.getPixelFormat());
+		scaleImage(output, renderSettings.getHorizontalStretch());
+	}
+	newFrame = false;
 
 	drawNoise(output);
 
@@ -333,13 +477,25 @@ template <class Pixel>
 std::unique_ptr<RawFrame> FBPostProcessor<Pixel>::rotateFrames(
 	std::unique_ptr<RawFrame> finishedFrame, EmuTime::param time)
 {
+	// The scale thread is still reading the frames that are about to be
+	// rotated (this is where the pipeline is bounded: at most one frame
+	// is scaled while the next one is emulated).
+	waitScaleJob();
+
 	auto& generator = global_urng(); // fast (non-cryptographic) random numbers
 	std::uniform_int_distribution<int> distribution(0, NOISE_SHIFT / 16 - 1);
 	for (auto y : xrange(screen.getLogicalHeight())) {
 		noiseShift[y] = distribution(generator) * 16;
 	}
 
-	return PostProcessor::rotateFrames(std::move(finishedFrame), time);
+	auto result = PostProcessor::rotateFrames(std::move(finishedFrame), time);
+	newFrame = true;
+	if (canScaleInThread()) {
+		startScaleJob();
+	} else {
+		scaledIdx = -1;
+	}
+	return result;
 }
 
 
@@ -4,12 +4,18 @@
 #include "PostProcessor.hh"
 #include "RenderSettings.hh"
 #include "PixelOperations.hh"
+#include "ScaleBands.hh"
+#include <future>
+#include <memory>
 #include <vector>
 
 namespace openmsx {
 
 class MSXMotherBoard;
 class Display;
+class SDLOffScreenSurface;
+class SDLOutputSurface;
+class ThreadPool;
 template<typename Pixel> class Scaler;
 
 /** Rasterizer using SDL.
@@ -31,6 +37,15 @@ public:
 		std::unique_ptr<RawFrame> finishedFrame, EmuTime::param time) override;
 
 private:
+	void updateScaler(const PixelFormat& format);
+	void scaleImage(SDLOutputSurface& output, float horStretch);
+	bool canScaleInThread() const;
+	void startScaleJob();
+	void waitScaleJob();
+	void copyFrame(SDLOutputSurface& src, SDLOutputSurface& dst);
+	std::vector<bool> getChangedLines(
+		SDLOutputSurface& output, unsigned srcStep, unsigned inWidth);
+
 	void preCalcNoise(float factor);
 	void drawNoise(OutputSurface& output);
 	void drawNoiseLine(Pixel* buf, signed char* noise,
@@ -55,6 +70,34 @@ private:
 	 */
 	std::vector<unsigned> noiseShift;
 
+	/** Thread that scales finished frames, see 'postprocess_thread'
+	  * setting. Created on first use.
+	  */
+	std::unique_ptr<ThreadPool> scaleThread;
+	/** The job that is currently running in 'scaleThread' (if any). */
+	std::future<void> scaleJob;
+	/** The job writes in one of these buffers, the other one holds the
+	  * previous result (so that it can still be shown).
+	  */
+	std::unique_ptr<SDLOffScreenSurface> scaledFrames[2];
+	int scalingIdx = -1; // buffer used by 'scaleJob', or -1
+	int scaledIdx = -1;  // buffer with the most recent result, or -1
+	/** Has a new frame been rotated in since the last paint()? */
+	bool newFrame = false;
+
+	/** Extra threads that scale horizontal bands of the image, see
+	  * 'scale_threads' setting.
+	  */
+	std::unique_ptr<ThreadPool> bandThreads;
+
+	/** The result of the previous scaleImage() call and the source lines
+	  * it was made from, so that only changed lines need to be scaled
+	  * again. Only used for scalers that can scale in bands.
+	  */
+	std::unique_ptr<SDLOffScreenSurface> prevScaled;
+	LineChangeTracker<Pixel> changeTracker;
+	unsigned prevInWidth = 0;
+
 	PixelOperations<Pixel> pixelOps;
 };
 
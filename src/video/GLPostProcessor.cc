@@ -4,6 +4,7 @@
 #include "GLScalerFactory.hh"
 #include "FloatSetting.hh"
 #include "OutputSurface.hh"
+#include "PerfCounters.hh"
 #include "RawFrame.hh"
 #include "Math.hh"
 #include "InitException.hh"
@@ -147,6 +148,8 @@ void GLPostProcessor::createRegions()
 
 void GLPostProcessor::paint(OutputSurface& /*output*/)
 {
+	ScopedPerfTimer perfTimer(PerfCounter::POST_PROCESSOR);
+
 	if (renderSettings.getInterleaveBlackFrame()) {
 		interleaveCount ^= 1;
 		if (interleaveCount) {
@@ -18,6 +18,7 @@ TODO:
 #include "FinishFrameEvent.hh"
 #include "RealTime.hh"
 #include "MSXMotherBoard.hh"
+#include "PerfCounters.hh"
 #include "Reactor.hh"
 #include "Timer.hh"
 #include "unreachable.hh"
@@ -121,6 +122,7 @@ PixelRenderer::PixelRenderer(VDP& vdp_, Display& display)
 
 	finishFrameDuration = 0;
 	frameSkipCounter = 999; // force drawing of frame
+	nextRenderTime = 0;
 	prevRenderFrame = false;
 
 	renderSettings.getMaxFrameSkipSetting().attach(*this);
@@ -171,6 +173,9 @@ void PixelRenderer::frameStart(EmuTime::param time)
 		if (frameSkipCounter < renderSettings.getMinFrameSkip()) {
 			++frameSkipCounter;
 			renderFrame = false;
+		} else if (renderSettings.getRenderOnDemand() &&
+		           !rasterizer->isRecording()) {
+			renderFrame = isFrameShown(time);
 		} else if (frameSkipCounter >= renderSettings.getMaxFrameSkip()) {
 			frameSkipCounter = 0;
 			renderFrame = true;
@@ -200,6 +205,30 @@ void PixelRenderer::frameStart(EmuTime::param time)
 	textModeCounter = 0;
 }
 
+bool PixelRenderer::isFrameShown(EmuTime::param time)
+{
+	// Frames are not shown at all while fast-forwarding (e.g. when
+	// jumping in the reverse history). Otherwise the picture on the host
+	// only has to be updated as often as a real MSX would do, even when
+	// emulation runs (a lot) faster than real time. Allow some jitter in
+	// the host time, so that at normal speed no frames are dropped.
+	// The VDP keeps the rasterizer up-to-date (palette, scroll, ...) also
+	// for frames that are not rendered, so skipping is cheap.
+	++frameSkipCounter;
+	if (vdp.getMotherBoard().isFastForwarding()) return false;
+	auto now = Timer::getTime();
+	if (now < nextRenderTime) return false;
+	if ((frameSkipCounter <= renderSettings.getMaxFrameSkip()) &&
+	    !realTime.timeLeft(unsigned(finishFrameDuration), time)) {
+		// Host is too slow to render this frame in time.
+		return false;
+	}
+	uint64_t frameDuration = vdp.isPalTiming() ? 20000 : 16683; // us
+	nextRenderTime = now + frameDuration * 3 / 4;
+	frameSkipCounter = 0;
+	return true;
+}
+
 void PixelRenderer::frameEnd(EmuTime::param time)
 {
 	bool skipEvent = !renderFrame;
@@ -502,6 +531,32 @@ void PixelRenderer::updateVRAM(unsigned offset, EmuTime::param time)
 	}
 }
 
+bool PixelRenderer::mayNeedUpdate(unsigned first, unsigned last) const
+{
+	// Same as updateVRAM() and checkSync(), but for a range of addresses.
+	if (!renderFrame || !displayEnabled) return false;
+	if (accuracy == RenderSettings::ACC_SCREEN) return false;
+
+	auto mode = vdp.getDisplayMode();
+	if (!mode.isBitmapMode()) return true; // TODO: Look at the tables.
+	if (vdp.isFastBlinkEnabled()) return true; // TODO could be improved
+
+	// Does the range touch the visible page(s)? Like in SDLRasterizer,
+	// in the planar modes both halves of VRAM hold the same page.
+	unsigned pageMask = mode.isPlanar() ? 0x08000 : 0x18000;
+	unsigned visiblePage = vram.nameTable.getMask() & pageMask &
+		(0x10000 | (vdp.getEvenOddMask() << 7));
+	bool multiPage = vdp.isMultiPageScrolling();
+	for (unsigned addr = first & ~0x7FFF; addr <= last; addr += 0x8000) {
+		unsigned page = addr & pageMask;
+		if ((page == visiblePage) ||
+		    (multiPage && (page == (visiblePage & ~0x8000)))) {
+			return true;
+		}
+	}
+	return false;
+}
+
 void PixelRenderer::updateWindow(bool /*enabled*/, EmuTime::param /*time*/)
 {
 	// The bitmapVisibleWindow has moved to a different area.
@@ -534,6 +589,8 @@ void PixelRenderer::sync(EmuTime::param time, bool force)
 
 void PixelRenderer::renderUntil(EmuTime::param time)
 {
+	ScopedPerfTimer perfTimer(PerfCounter::RENDERER);
+
 	// Translate from time to pixel position.
 	int limitTicks = vdp.getTicksThisFrame(time);
 	assert(limitTicks <= vdp.getTicksPerFrame());
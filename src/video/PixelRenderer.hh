@@ -5,6 +5,7 @@
 #include "Observer.hh"
 #include "RenderSettings.hh"
 #include "openmsx.hh"
+#include <cstdint>
 #include <memory>
 
 namespace openmsx {
@@ -56,6 +57,7 @@ public:
 	void updateSpritesEnabled(bool enabled, EmuTime::param time) override;
 	void updateVRAM(unsigned offset, EmuTime::param time) override;
 	void updateWindow(bool enabled, EmuTime::param time) override;
+	bool mayNeedUpdate(unsigned first, unsigned last) const override;
 
 private:
 	/** Indicates whether the area to be drawn is border or display. */
@@ -84,6 +86,11 @@ private:
 
 	inline bool checkSync(int offset, EmuTime::param time);
 
+	/** The render_on_demand version of the frame skip decision: will the
+	  * frame that starts now be shown?
+	  */
+	bool isFrameShown(EmuTime::param time);
+
 	/** Update renderer state to specified moment in time.
 	  * @param time Moment in emulated time to update to.
 	  * @param force When screen accuracy is used,
@@ -121,6 +128,11 @@ private:
 	float finishFrameDuration;
 	int frameSkipCounter;
 
+	/** With render_on_demand, don't render a frame before this host time
+	  * (in us).
+	  */
+	uint64_t nextRenderTime;
+
 	/** Number of the next position within a line to render.
 	  * Expressed in VDP clock ticks since start of line.
 	  */
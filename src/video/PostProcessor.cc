@@ -41,8 +41,8 @@ PostProcessor::PostProcessor(MSXMotherBoard& motherBoard_,
 	, lastFramesCount(0)
 	, maxWidth(maxWidth_)
 	, height(height_)
-	, display(display_)
 	, canDoInterlace(canDoInterlace_)
+	, display(display_)
 	, lastRotate(motherBoard_.getCurrentTime())
 	, eventDistributor(motherBoard_.getReactor().getEventDistributor())
 {
@@ -67,6 +67,14 @@ RenderSettings::RenderSettings(CommandController& commandController)
 	, minFrameSkipSetting(commandController,
 		"minframeskip", "set the min amount of frameskip", 0, 0, 100)
 
+	, renderOnDemandSetting(commandController,
+		"render_on_demand",
+		"only render the frames that can be shown: none while "
+		"fast-forwarding and, when emulation runs faster than real "
+		"time, not more than the MSX frame rate in real time. "
+		"Frames that are being recorded are always rendered",
+		false)
+
 	, fullScreenSetting(commandController,
 		"fullscreen", "full screen display on/off", false)
 
@@ -177,11 +185,39 @@ RenderSettings::RenderSettings(CommandController& commandController)
 		"Useful on (100Hz+) lightboost enabled monitors to reduce "
 		"motion blur and double frame artifacts.",
 		false)
+
+	, postProcessThreadSetting(commandController,
+		"postprocess_thread",
+		"Where to deinterlace, deflicker and scale finished frames "
+		"(only for the SDL renderer).\n"
+		"Possible values are:\n"
+		" main -> in the main thread, in between emulating frames\n"
+		" latency -> in a separate thread, the emulation of the next "
+		"frame can start earlier\n"
+		" throughput -> in a separate thread, and don't wait for it: "
+		"show the previous frame when the current one isn't scaled "
+		"yet (adds up to one frame of latency)",
+		PP_MAIN_THREAD,
+		EnumSetting<PostProcessThread>::Map{
+			{"main",       PP_MAIN_THREAD},
+			{"latency",    PP_THREAD_LATENCY},
+			{"throughput", PP_THREAD_THROUGHPUT}})
+
+	, scaleThreadsSetting(commandController,
+		"scale_threads",
+		"number of extra threads used to scale the image in horizontal "
+		"bands (only for the SDL renderer and not for all scale "
+		"algorithms), 0 means the whole image is scaled in one thread",
+		0, 0, 16)
 {
 	brightnessSetting.attach(*this);
 	contrastSetting  .attach(*this);
 	updateBrightnessAndContrast();
 
+	horizontalBlurSetting.attach(*this);
+	scanlineAlphaSetting .attach(*this);
+	updateBlurAndScanline();
+
 	auto& interp = commandController.getInterpreter();
 	colorMatrixSetting.setChecker([this, &interp](TclObject& newValue) {
 		try {
@@ -222,6 +258,8 @@ RenderSettings::RenderSettings(CommandController& commandController)
 
 RenderSettings::~RenderSettings()
 {
+	scanlineAlphaSetting .detach(*this);
+	horizontalBlurSetting.detach(*this);
 	brightnessSetting.detach(*this);
 	contrastSetting  .detach(*this);
 }
@@ -232,11 +270,20 @@ void RenderSettings::update(const Setting& setting)
 		updateBrightnessAndContrast();
 	} else if (&setting == &contrastSetting) {
 		updateBrightnessAndContrast();
+	} else if ((&setting == &horizontalBlurSetting) ||
+	           (&setting == &scanlineAlphaSetting)) {
+		updateBlurAndScanline();
 	} else {
 		UNREACHABLE;
 	}
 }
 
+void RenderSettings::updateBlurAndScanline()
+{
+	blurFactor = horizontalBlurSetting.getInt() * 256 / 100;
+	scanlineFactor = 255 - ((scanlineAlphaSetting.getInt() * 255) / 100);
+}
+
 void RenderSettings::updateBrightnessAndContrast()
 {
 	float contrastValue = getContrast();
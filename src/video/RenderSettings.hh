@@ -8,6 +8,7 @@
 #include "StringSetting.hh"
 #include "Observer.hh"
 #include "gl_mat.hh"
+#include <atomic>
 
 namespace openmsx {
 
@@ -43,6 +44,12 @@ public:
 		DEFORM_NORMAL, DEFORM_3D
 	};
 
+	/** Where to post process (deinterlace, deflicker, scale) frames.
+	  */
+	enum PostProcessThread {
+		PP_MAIN_THREAD, PP_THREAD_LATENCY, PP_THREAD_THROUGHPUT
+	};
+
 	explicit RenderSettings(CommandController& commandController);
 	~RenderSettings();
 
@@ -63,6 +70,9 @@ public:
 	IntegerSetting& getMinFrameSkipSetting() { return minFrameSkipSetting; }
 	int getMinFrameSkip() const { return minFrameSkipSetting.getInt(); }
 
+	/** Only render frames that can actually be shown? */
+	bool getRenderOnDemand() const { return renderOnDemandSetting.getBoolean(); }
+
 	/** Full screen [on, off]. */
 	BooleanSetting& getFullScreenSetting() { return fullScreenSetting; }
 	bool getFullScreen() const { return fullScreenSetting.getBoolean(); }
@@ -91,15 +101,13 @@ public:
 	FloatSetting& getNoiseSetting() { return noiseSetting; }
 	float getNoise() const { return noiseSetting.getDouble(); }
 
-	/** The amount of horizontal blur [0..256]. */
-	int getBlurFactor() const {
-		return (horizontalBlurSetting.getInt()) * 256 / 100;
-	}
+	/** The amount of horizontal blur [0..256].
+	  * Like getScanlineFactor(), this may be called from the post
+	  * processing thread, so it returns a cached value. */
+	int getBlurFactor() const { return blurFactor; }
 
 	/** The alpha value [0..255] of the gap between scanlines. */
-	int getScanlineFactor() const {
-		return 255 - ((scanlineAlphaSetting.getInt() * 255) / 100);
-	}
+	int getScanlineFactor() const { return scanlineFactor; }
 
 	/** The amount of space [0..1] between scanlines. */
 	float getScanlineGap() const {
@@ -168,6 +176,16 @@ public:
 		return interleaveBlackFrameSetting.getBoolean();
 	}
 
+	/** Post process in the main thread or in a separate thread, and in
+	  * the latter case optimize for latency or for throughput. */
+	PostProcessThread getPostProcessThread() const {
+		return postProcessThreadSetting.getEnum();
+	}
+
+	/** The number of extra threads used by the (software) scalers, zero
+	  * means everything is scaled in the post processing thread. */
+	int getScaleThreads() const { return scaleThreadsSetting.getInt(); }
+
 	/** Apply brightness, contrast and gamma transformation on the input
 	  * color component. The component is expected to be in the range
 	  * [0.0 .. 1.0] but it's not an error if it lays outside of this range.
@@ -196,6 +214,7 @@ private:
 	  * values.
 	  */
 	void updateBrightnessAndContrast();
+	void updateBlurAndScanline();
 
 	void parseColorMatrix(Interpreter& interp, const TclObject& value);
 
@@ -204,6 +223,7 @@ private:
 	BooleanSetting deflickerSetting;
 	IntegerSetting maxFrameSkipSetting;
 	IntegerSetting minFrameSkipSetting;
+	BooleanSetting renderOnDemandSetting;
 	BooleanSetting fullScreenSetting;
 	FloatSetting gammaSetting;
 	FloatSetting brightnessSetting;
@@ -224,10 +244,17 @@ private:
 	FloatSetting horizontalStretchSetting;
 	FloatSetting pointerHideDelaySetting;
 	BooleanSetting interleaveBlackFrameSetting;
+	EnumSetting<PostProcessThread> postProcessThreadSetting;
+	IntegerSetting scaleThreadsSetting;
 
 	float brightness;
 	float contrast;
 
+	// Cached values of the blur and scanline settings. Unlike the settings
+	// themselves these can be read from any thread.
+	std::atomic<int> blurFactor;
+	std::atomic<int> scanlineFactor;
+
 	/** Parsed color matrix, kept in sync with colorMatrix setting. */
 	gl::mat3 colorMatrix;
 	/** True iff color matrix is identity matrix. */
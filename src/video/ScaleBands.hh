@@ -0,0 +1,162 @@
+#ifndef SCALEBANDS_HH
+#define SCALEBANDS_HH
+
+#include "FrameSource.hh"
+#include "vla.hh"
+#include "xrange.hh"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+namespace openmsx {
+
+/** A group of source lines with equal width that is scaled in one go.
+  */
+struct ScaleBand {
+	unsigned srcStartY, srcEndY, lineWidth;
+	unsigned dstStartY, dstEndY;
+};
+
+/** Split a frame in bands of lines with equal width. Lines are handled in
+  * groups of 'srcStep' source lines (which become 'dstStep' destination
+  * lines). Only groups for which 'changed' is true are included, and no
+  * band is larger than 'maxDstLines' destination lines.
+  */
+inline std::vector<ScaleBand> getScaleBands(
+	const FrameSource& frame, unsigned dstHeight,
+	unsigned srcStep, unsigned dstStep,
+	const std::vector<bool>& changed, unsigned maxDstLines)
+{
+	auto getLineWidth = [&](unsigned y) {
+		unsigned result = frame.getLineWidth(y);
+		for (unsigned i = 1; i < srcStep; ++i) {
+			result = std::max(result, frame.getLineWidth(y + i));
+		}
+		return result;
+	};
+
+	const unsigned srcHeight = frame.getHeight();
+	std::vector<ScaleBand> bands;
+	unsigned srcStartY = 0;
+	unsigned dstStartY = 0;
+	while (dstStartY < dstHeight) {
+		// Currently this is true because the source frame height
+		// is always >= dstHeight/(dstStep/srcStep).
+		assert(srcStartY < srcHeight);
+
+		if (!changed[srcStartY / srcStep]) {
+			srcStartY += srcStep;
+			dstStartY += dstStep;
+			continue;
+		}
+
+		// get region with equal lineWidth
+		unsigned lineWidth = getLineWidth(srcStartY);
+		unsigned srcEndY = srcStartY + srcStep;
+		unsigned dstEndY = dstStartY + dstStep;
+		while ((srcEndY < srcHeight) && (dstEndY < dstHeight) &&
+		       ((dstEndY - dstStartY) < maxDstLines) &&
+		       changed[srcEndY / srcStep] &&
+		       (getLineWidth(srcEndY) == lineWidth)) {
+			srcEndY += srcStep;
+			dstEndY += dstStep;
+		}
+		bands.push_back({srcStartY, srcEndY, lineWidth, dstStartY, dstEndY});
+
+		// next region
+		srcStartY = srcEndY;
+		dstStartY = dstEndY;
+	}
+	return bands;
+}
+
+/** Remembers the source lines of the previous scaled frame, so that only
+  * the lines that changed need to be scaled again (on top of the previous
+  * result). Only valid for scalers that can scale in bands.
+  *
+  * On screens that change (almost) completely every frame, comparing the
+  * lines and copying the previous result is pure overhead. So after such a
+  * frame, partial scaling is suspended for a while. The remembered lines
+  * still match the previous result, so resuming later remains correct.
+  */
+template<typename Pixel> class LineChangeTracker
+{
+public:
+	/** Number of frames partial scaling is suspended after a frame in
+	  * which most lines changed.
+	  */
+	static constexpr unsigned BACKOFF_FRAMES = 30;
+
+	/** Forget the previous frame: all lines are changed next time.
+	  */
+	void invalidate() { prevLines.clear(); }
+
+	/** Should the current frame be scaled partially? This returns false
+	  * (and counts down) while partial scaling is suspended.
+	  */
+	[[nodiscard]] bool usePartial()
+	{
+		if (backoff == 0) return true;
+		--backoff;
+		return false;
+	}
+
+	/** Compare the lines of the given frame with the remembered ones, and
+	  * remember the new lines. Lines are grouped per 'srcStep' lines, like
+	  * in getScaleBands().
+	  * @param valid Can the previous result be reused at all?
+	  * @return For each group, does it need to be scaled again?
+	  */
+	[[nodiscard]] std::vector<bool> update(
+		const FrameSource& frame, unsigned srcStep, bool valid)
+	{
+		const unsigned srcHeight = frame.getHeight();
+		if (prevLines.size() != srcHeight) valid = false;
+		prevLines.resize(srcHeight);
+
+		// Compare the source lines, as seen by the scaler, with the
+		// previous ones. This catches all changes (VRAM, palette, VDP
+		// registers, deinterlace, ...) without having to track them in
+		// the VDP.
+		std::vector<bool> changedLines(srcHeight);
+		unsigned numChanged = 0;
+		for (auto y : xrange(srcHeight)) {
+			unsigned width = frame.getLineWidth(y);
+			VLA_SSE_ALIGNED(Pixel, buf, width);
+			auto* line = frame.getLinePtr(int(y), width, buf);
+			auto& prev = prevLines[y];
+			if (!valid || (prev.size() != width) ||
+			    memcmp(prev.data(), line, width * sizeof(Pixel))) {
+				prev.assign(line, line + width);
+				changedLines[y] = true;
+				++numChanged;
+			}
+		}
+		if (valid && (numChanged > (srcHeight / 4) * 3)) {
+			backoff = BACKOFF_FRAMES;
+		}
+
+		// A scaled line also depends on the neighbouring source lines
+		// (at most two above and below for the scalers that can scale
+		// in bands). And all lines in a group are scaled together.
+		std::vector<bool> result(srcHeight / srcStep);
+		for (auto i : xrange(result.size())) {
+			unsigned begin = unsigned(i) * srcStep;
+			unsigned end = std::min(begin + srcStep + 2, srcHeight);
+			begin = (begin < 2) ? 0 : begin - 2;
+			result[i] = std::any_of(changedLines.begin() + begin,
+			                        changedLines.begin() + end,
+			                        [](bool b) { return b; });
+		}
+		return result;
+	}
+
+private:
+	std::vector<std::vector<Pixel>> prevLines;
+	unsigned backoff = 0;
+};
+
+} // namespace openmsx
+
+#endif // SCALEBANDS_HH
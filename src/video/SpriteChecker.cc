@@ -25,6 +25,8 @@ SpriteChecker::SpriteChecker(VDP& vdp_, RenderSettings& renderSettings,
 {
 	vram.spriteAttribTable.setObserver(this);
 	vram.spritePatternTable.setObserver(this);
+	flushCache();
+	cacheHits = cacheMisses = 0;
 }
 
 void SpriteChecker::reset(EmuTime::param time)
@@ -36,6 +38,8 @@ void SpriteChecker::reset(EmuTime::param time)
 	frameStart(time);
 
 	updateSpritesMethod = &SpriteChecker::updateSprites1;
+	flushCache();
+	cacheHits = cacheMisses = 0;
 }
 
 static inline SpriteChecker::SpritePattern doublePattern(SpriteChecker::SpritePattern a)
@@ -78,6 +82,79 @@ inline SpriteChecker::SpritePattern SpriteChecker::calculatePatternPlanar(
 	return !vdp.isSpriteMag() ? pattern : doublePattern(pattern);
 }
 
+inline void SpriteChecker::addToLines(unsigned sprite, int y, int magSize)
+{
+	uint32_t bit = 1u << sprite;
+	for (int i = 0; i < magSize; ++i) {
+		lineSprites[(y + i) & 0xFF] |= bit;
+	}
+}
+inline void SpriteChecker::removeFromLines(unsigned sprite, int y, int magSize)
+{
+	uint32_t bit = ~(1u << sprite);
+	for (int i = 0; i < magSize; ++i) {
+		lineSprites[(y + i) & 0xFF] &= bit;
+	}
+}
+
+inline int SpriteChecker::updateCache(int mode, int magSize)
+{
+	// Y coordinate of sprite n is yPtr[n * yStep].
+	const byte* yPtr;
+	int yStep;
+	if (mode == 1) {
+		yPtr = vram.spriteAttribTable.getReadArea(0, 32 * 4);
+		yStep = 4;
+	} else if (mode == 2) {
+		yPtr = vram.spriteAttribTable.getReadArea(512, 32 * 4);
+		yStep = 4;
+	} else {
+		const byte* dummy;
+		vram.spriteAttribTable.getReadAreaPlanar(512, 32 * 4, yPtr, dummy);
+		yStep = 2;
+	}
+	int endY = (mode == 1) ? 208 : 216;
+
+	if ((mode != cacheMode) || (magSize != cacheMagSize)) {
+		// Sprite mode, size or attribute table address changed (or
+		// the cache was explicitly flushed): start from scratch.
+		++cacheMisses;
+		ranges::fill(lineSprites, 0);
+		endSprites = 0;
+		for (unsigned sprite = 0; sprite < 32; ++sprite) {
+			int y = yPtr[sprite * yStep];
+			cachedY[sprite] = y;
+			addToLines(sprite, y, magSize);
+			if (y == endY) endSprites |= 1u << sprite;
+		}
+		cacheMode = mode;
+		cacheMagSize = magSize;
+	} else if (dirtySprites) {
+		// Only move the sprites that actually moved.
+		++cacheMisses;
+		for (uint32_t dirty = dirtySprites; dirty; dirty &= dirty - 1) {
+			unsigned sprite = Math::findFirstSet(dirty) - 1;
+			int y = yPtr[sprite * yStep];
+			if (y == cachedY[sprite]) continue;
+			removeFromLines(sprite, cachedY[sprite], magSize);
+			addToLines(sprite, y, magSize);
+			cachedY[sprite] = y;
+			if (y == endY) {
+				endSprites |= 1u << sprite;
+			} else {
+				endSprites &= ~(1u << sprite);
+			}
+		}
+	} else {
+		++cacheHits;
+	}
+	dirtySprites = 0;
+
+	// Sprites starting from the first one with the terminating Y
+	// coordinate are not checked.
+	return endSprites ? Math::findFirstSet(endSprites) - 1 : 32;
+}
+
 void SpriteChecker::updateSprites1(int limit)
 {
 	if (vdp.spritesEnabledFast()) {
@@ -97,21 +174,17 @@ void SpriteChecker::updateSprites1(int limit)
 
 inline void SpriteChecker::checkSprites1(int minLine, int maxLine)
 {
-	// This implementation contains a double for-loop. The outer loop goes
-	// over the sprites, the inner loop over the to-be-checked lines. This
-	// is not the order in which the real VDP performs this operation: the
-	// real VDP renders line-per-line and for each line checks all 32
-	// sprites.
-	//
-	// Though this 'reverse' order allows to skip over very large regions
-	// of the inner loop: we only have to process the lines were a
-	// particular sprite is actually visible. I measured this makes this
-	// routine 4x-5x faster!
+	// Like the real VDP, this goes line-per-line and for each line over
+	// the sprites in order. Though instead of looking at all 32 sprites,
+	// it only visits the sprites that are on that line according to
+	// lineSprites[]. That table only changes when a Y coordinate in the
+	// sprite attribute table changes, which is a lot less often than this
+	// routine runs (it runs on every sync, e.g. on every write to the
+	// sprite tables).
 	//
 	// This routine also needs to detect the sprite number of the 'first'
 	// 5th-sprite-condition. With 'first' meaning the first line where this
-	// condition occurs. Because our loops are swapped compared to the real
-	// VDP, we need some extra fixup logic to correctly detect this.
+	// condition occurs.
 
 	// Calculate display line.
 	// This is the line sprites are checked at; the line they are displayed
@@ -126,30 +199,23 @@ inline void SpriteChecker::checkSprites1(int minLine, int maxLine)
 	const byte* attributePtr = vram.spriteAttribTable.getReadArea(0, 32 * 4);
 	byte patternIndexMask = size == 16 ? 0xFC : 0xFF;
 	int fifthSpriteNum  = -1;  // no 5th sprite detected yet
-	int fifthSpriteLine = 999; // larger than any possible valid line
 
-	int sprite = 0;
-	for (/**/; sprite < 32; ++sprite) {
-		int y = attributePtr[4 * sprite + 0];
-		if (y == 208) break;
-
-		for (int line = minLine; line < maxLine; ++line) {
+	int numSprites = updateCache(1, magSize);
+	uint32_t checkedSprites = (numSprites == 32) ? ~uint32_t(0)
+	                                             : (1u << numSprites) - 1;
+	for (int line = minLine; line < maxLine; ++line) {
+		int displayLine = line + displayDelta;
+		for (uint32_t sprites = lineSprites[displayLine & 0xFF] & checkedSprites;
+		     sprites; sprites &= sprites - 1) {
+			int sprite = Math::findFirstSet(sprites) - 1;
 			// Calculate line number within the sprite.
-			int displayLine = line + displayDelta;
-			int spriteLine = (displayLine - y) & 0xFF;
-			if (spriteLine >= magSize) {
-				// Skip ahead till sprite becomes visible.
-				line += 256 - spriteLine - 1; // -1 because of for-loop
-				continue;
-			}
+			int spriteLine = (displayLine - cachedY[sprite]) & 0xFF;
 
 			int visibleIndex = spriteCount[line];
 			if (visibleIndex == 4) {
-				// Find earliest line where this condition occurs.
-				if (line < fifthSpriteLine) {
-					fifthSpriteLine = line;
-					fifthSpriteNum = sprite;
-				}
+				// Only the earliest line where this condition
+				// occurs counts.
+				if (fifthSpriteNum == -1) fifthSpriteNum = sprite;
 				if (limitSprites) continue;
 			}
 
@@ -178,7 +244,7 @@ inline void SpriteChecker::checkSprites1(int minLine, int maxLine)
 	}
 	if (~status & 0x40) {
 		// No 5th sprite detected, store number of latest sprite processed.
-		status = (status & 0x20) | std::min(sprite, 31);
+		status = (status & 0x20) | std::min(numSprites, 31);
 	}
 	vdp.setSpriteStatus(status);
 
@@ -287,38 +353,32 @@ inline void SpriteChecker::checkSprites2(int minLine, int maxLine)
 	int magSize = (mag + 1) * size;
 	int patternIndexMask = (size == 16) ? 0xFC : 0xFF;
 	int ninthSpriteNum  = -1;  // no 9th sprite detected yet
-	int ninthSpriteLine = 999; // larger than any possible valid line
+
+	int numSprites = updateCache(planar ? 3 : 2, magSize);
+	uint32_t checkedSprites = (numSprites == 32) ? ~uint32_t(0)
+	                                             : (1u << numSprites) - 1;
 
 	// Because it gave a measurable performance boost, we duplicated the
 	// code for planar and non-planar modes.
-	int sprite = 0;
 	if (planar) {
 		const byte* attributePtr0;
 		const byte* attributePtr1;
 		vram.spriteAttribTable.getReadAreaPlanar(
 			512, 32 * 4, attributePtr0, attributePtr1);
 		// TODO: Verify CC implementation.
-		for (/**/; sprite < 32; ++sprite) {
-			int y = attributePtr0[2 * sprite + 0];
-			if (y == 216) break;
-
-			for (int line = minLine; line < maxLine; ++line) {
+		for (int line = minLine; line < maxLine; ++line) {
+			int displayLine = line + displayDelta;
+			for (uint32_t sprites = lineSprites[displayLine & 0xFF] & checkedSprites;
+			     sprites; sprites &= sprites - 1) {
+				int sprite = Math::findFirstSet(sprites) - 1;
 				// Calculate line number within the sprite.
-				int displayLine = line + displayDelta;
-				int spriteLine = (displayLine - y) & 0xFF;
-				if (spriteLine >= magSize) {
-					// Skip ahead till sprite is visible.
-					line += 256 - spriteLine - 1;
-					continue;
-				}
+				int spriteLine = (displayLine - cachedY[sprite]) & 0xFF;
 
 				int visibleIndex = spriteCount[line];
 				if (visibleIndex == 8) {
-					// Find earliest line where this condition occurs.
-					if (line < ninthSpriteLine) {
-						ninthSpriteLine = line;
-						ninthSpriteNum = sprite;
-					}
+					// Only the earliest line where this
+					// condition occurs counts.
+					if (ninthSpriteNum == -1) ninthSpriteNum = sprite;
 					if (limitSprites) continue;
 				}
 
@@ -343,27 +403,19 @@ inline void SpriteChecker::checkSprites2(int minLine, int maxLine)
 		const byte* attributePtr0 =
 			vram.spriteAttribTable.getReadArea(512, 32 * 4);
 		// TODO: Verify CC implementation.
-		for (/**/; sprite < 32; ++sprite) {
-			int y = attributePtr0[4 * sprite + 0];
-			if (y == 216) break;
-
-			for (int line = minLine; line < maxLine; ++line) {
+		for (int line = minLine; line < maxLine; ++line) {
+			int displayLine = line + displayDelta;
+			for (uint32_t sprites = lineSprites[displayLine & 0xFF] & checkedSprites;
+			     sprites; sprites &= sprites - 1) {
+				int sprite = Math::findFirstSet(sprites) - 1;
 				// Calculate line number within the sprite.
-				int displayLine = line + displayDelta;
-				int spriteLine = (displayLine - y) & 0xFF;
-				if (spriteLine >= magSize) {
-					// Skip ahead till sprite is visible.
-					line += 256 - spriteLine - 1;
-					continue;
-				}
+				int spriteLine = (displayLine - cachedY[sprite]) & 0xFF;
 
 				int visibleIndex = spriteCount[line];
 				if (visibleIndex == 8) {
-					// Find earliest line where this condition occurs.
-					if (line < ninthSpriteLine) {
-						ninthSpriteLine = line;
-						ninthSpriteNum = sprite;
-					}
+					// Only the earliest line where this
+					// condition occurs counts.
+					if (ninthSpriteNum == -1) ninthSpriteNum = sprite;
 					if (limitSprites) continue;
 				}
 
@@ -411,7 +463,7 @@ inline void SpriteChecker::checkSprites2(int minLine, int maxLine)
 	}
 	if (~status & 0x40) {
 		// No 9th sprite detected, store number of latest sprite processed.
-		status = (status & 0x20) | std::min(sprite, 31);
+		status = (status & 0x20) | std::min(numSprites, 31);
 	}
 	vdp.setSpriteStatus(status);
 
@@ -512,6 +564,9 @@ void SpriteChecker::serialize(Archive& ar, unsigned version)
 		// first (partial) frame after loadstate.
 		ranges::fill(spriteCount, 0);
 		// content of spriteBuffer[] doesn't matter if spriteCount[] is 0
+
+		// The sprite line cache is based on the old VRAM content.
+		flushCache();
 	}
 	ar.serialize("collisionX", collisionX,
 	             "collisionY", collisionY);
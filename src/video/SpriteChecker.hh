@@ -247,14 +247,44 @@ public:
 
 	// VRAMObserver implementation:
 
-	void updateVRAM(unsigned /*offset*/, EmuTime::param time) override {
+	void updateVRAM(unsigned offset, EmuTime::param time) override {
 		checkUntil(time);
+		// Only a change in Y coordinate changes the lines a sprite is
+		// on. Offsets are physical, so in planar mode consecutive
+		// sprites are 2 bytes apart (and odd bytes are in the other
+		// plane). This test also lets through some bytes of the
+		// sprite color table, that only causes a needless update.
+		if (cacheMode == 3) {
+			if ((offset & 0x10001) == 0) {
+				dirtySprites |= 1u << ((offset >> 1) & 31);
+			}
+		} else {
+			if ((offset & 3) == 0) {
+				dirtySprites |= 1u << ((offset >> 2) & 31);
+			}
+		}
 	}
 
 	void updateWindow(bool /*enabled*/, EmuTime::param time) override {
 		sync(time);
+		flushCache();
+	}
+
+	/** Forget the cached sprite line information.
+	  * Must be called when VRAM contents change without going through
+	  * the VRAM window notifications (e.g. VR or 4k/16k remapping).
+	  */
+	inline void flushCache() {
+		cacheMode = 0;
 	}
 
+	/** Number of sprite checks that could use the cached sprite line
+	  * information as-is, and the number of checks that first had to
+	  * update it. Only meant for tuning, not part of the MSX state.
+	  */
+	unsigned getCacheHits()   const { return cacheHits; }
+	unsigned getCacheMisses() const { return cacheMisses; }
+
 	template<typename Archive>
 	void serialize(Archive& ar, unsigned version);
 
@@ -323,6 +353,21 @@ private:
 	  */
 	inline void checkSprites2(int minLine, int maxLine);
 
+	/** Bring lineSprites[] up-to-date with the sprite attribute table.
+	  * @param mode 1 for sprite mode 1, 2 for sprite mode 2, 3 for sprite
+	  *             mode 2 in a planar display mode.
+	  * @param magSize Height of a sprite in lines, corrected for
+	  *                magnification.
+	  * @return The number of sprites in front of the sprite that
+	  *         terminates the attribute table (Y is 208 or 216).
+	  */
+	inline int updateCache(int mode, int magSize);
+
+	/** Add (or remove) a sprite to the lines it covers.
+	  */
+	inline void addToLines(unsigned sprite, int y, int magSize);
+	inline void removeFromLines(unsigned sprite, int y, int magSize);
+
 	using UpdateSpritesMethod = void (SpriteChecker::*)(int limit);
 	UpdateSpritesMethod updateSpritesMethod;
 
@@ -378,6 +423,41 @@ private:
 	  * TODO: Introduce separate update methods for planar/nonplanar modes.
 	  */
 	bool planar;
+
+	/** For each display line (modulo 256) a bitmask of the sprites that
+	  * cover that line, based on their Y coordinate only. Bit n is sprite
+	  * n. This does not depend on vertical scroll or on the sprite
+	  * patterns, so it only changes when a Y coordinate changes. Sprites
+	  * behind the terminating sprite are included, see updateCache().
+	  */
+	uint32_t lineSprites[256];
+
+	/** The Y coordinates that lineSprites[] is based on.
+	  */
+	byte cachedY[32];
+
+	/** Bitmask of the sprites with the terminating Y coordinate.
+	  */
+	uint32_t endSprites;
+
+	/** Bitmask of the sprites whose Y coordinate may have changed since
+	  * lineSprites[] was updated.
+	  */
+	uint32_t dirtySprites;
+
+	/** Sprite mode lineSprites[] was calculated for (see updateCache()),
+	  * or 0 when it must be recalculated from scratch.
+	  */
+	int cacheMode;
+
+	/** Sprite height lineSprites[] was calculated for.
+	  */
+	int cacheMagSize;
+
+	/** Statistics, see getCacheHits().
+	  */
+	unsigned cacheHits;
+	unsigned cacheMisses;
 };
 SERIALIZE_CLASS_VERSION(SpriteChecker, 2);
 
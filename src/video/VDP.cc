@@ -86,6 +86,8 @@ VDP::VDP(const DeviceConfig& config)
 	, msxYPosInfo      (*this)
 	, msxX256PosInfo   (*this)
 	, msxX512PosInfo   (*this)
+	, spriteCacheHitsInfo  (*this)
+	, spriteCacheMissesInfo(*this)
 	, frameStartTime(getCurrentTime())
 	, irqVertical  (getMotherBoard(), getName() + ".IRQvertical",   config)
 	, irqHorizontal(getMotherBoard(), getName() + ".IRQhorizontal", config)
@@ -1782,6 +1784,41 @@ int VDP::MsxX512PosInfo::calc(const EmuTime& time) const
 }
 
 
+// class SpriteCacheHitsInfo
+
+VDP::SpriteCacheHitsInfo::SpriteCacheHitsInfo(VDP& vdp_)
+	: Info(vdp_, "sprite_cache_hits",
+	       "The number of sprite checks (since power up or reset) "
+	       "that could use the cached per-line sprite information "
+	       "without updating it. Only useful to tune the emulator. "
+	       "See also 'sprite_cache_misses'.")
+{
+}
+
+int VDP::SpriteCacheHitsInfo::calc(const EmuTime& /*time*/) const
+{
+	return vdp.spriteChecker->getCacheHits();
+}
+
+
+// class SpriteCacheMissesInfo
+
+VDP::SpriteCacheMissesInfo::SpriteCacheMissesInfo(VDP& vdp_)
+	: Info(vdp_, "sprite_cache_misses",
+	       "The number of sprite checks (since power up or reset) "
+	       "that first had to update the cached per-line sprite "
+	       "information, because a sprite Y coordinate, the sprite "
+	       "mode or size, or the sprite attribute table address "
+	       "changed. See also 'sprite_cache_hits'.")
+{
+}
+
+int VDP::SpriteCacheMissesInfo::calc(const EmuTime& /*time*/) const
+{
+	return vdp.spriteChecker->getCacheMisses();
+}
+
+
 // version 1: initial version
 // version 2: added frameCount
 // version 3: removed verticalAdjust
@@ -1015,6 +1015,16 @@ private:
 		int calc(const EmuTime& time) const override;
 	} msxX512PosInfo;
 
+	struct SpriteCacheHitsInfo final : Info {
+		explicit SpriteCacheHitsInfo(VDP& vdp);
+		int calc(const EmuTime& time) const override;
+	} spriteCacheHitsInfo;
+
+	struct SpriteCacheMissesInfo final : Info {
+		explicit SpriteCacheMissesInfo(VDP& vdp);
+		int calc(const EmuTime& time) const override;
+	} spriteCacheMissesInfo;
+
 	/** Renderer that converts this VDP's state into an image.
 	  */
 	std::unique_ptr<Renderer> renderer;
@@ -34,12 +34,14 @@ TODO:
 */
 
 #include "VDPCmdEngine.hh"
+#include "VDPCmdModes.hh"
 #include "EmuTime.hh"
 #include "VDPVRAM.hh"
 #include "serialize.hh"
 #include "unreachable.hh"
 #include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <iostream>
 
 using std::min;
@@ -159,253 +161,6 @@ template<typename LogOp> static void psetFast(
 	op(time, vram, addr, src, color, mask);
 }
 
-/** Represents V9938 Graphic 4 mode (SCREEN5).
-  */
-struct Graphic4Mode
-{
-	//using IncrByteAddr  = IncrByteAddr4;
-	//using IncrPixelAddr = IncrPixelAddr4;
-	//using IncrMask      = IncrMask4;
-	//using IncrShift     = IncrShift4;
-	static constexpr byte COLOR_MASK = 0x0F;
-	static constexpr byte PIXELS_PER_BYTE = 2;
-	static constexpr byte PIXELS_PER_BYTE_SHIFT = 1;
-	static constexpr unsigned PIXELS_PER_LINE = 256;
-	static inline unsigned addressOf(unsigned x, unsigned y, bool extVRAM);
-	static inline byte point(VDPVRAM& vram, unsigned x, unsigned y, bool extVRAM);
-	template <typename LogOp>
-	static inline void pset(EmuTime::param time, VDPVRAM& vram,
-		unsigned x, unsigned addr, byte src, byte color, LogOp op);
-	static inline byte duplicate(byte color);
-};
-
-inline unsigned Graphic4Mode::addressOf(
-	unsigned x, unsigned y, bool extVRAM)
-{
-	return likely(!extVRAM)
-		? (((y & 1023) << 7) | ((x & 255) >> 1))
-		: (((y &  511) << 7) | ((x & 255) >> 1) | 0x20000);
-}
-
-inline byte Graphic4Mode::point(
-	VDPVRAM& vram, unsigned x, unsigned y, bool extVRAM)
-{
-	return ( vram.cmdReadWindow.readNP(addressOf(x, y, extVRAM))
-		>> (((~x) & 1) << 2) ) & 15;
-}
-
-template<typename LogOp>
-inline void Graphic4Mode::pset(
-	EmuTime::param time, VDPVRAM& vram, unsigned x, unsigned addr,
-	byte src, byte color, LogOp op)
-{
-	byte sh = ((~x) & 1) << 2;
-	op(time, vram, addr, src, color << sh, ~(15 << sh));
-}
-
-inline byte Graphic4Mode::duplicate(byte color)
-{
-	assert((color & 0xF0) == 0);
-	return color | (color << 4);
-}
-
-/** Represents V9938 Graphic 5 mode (SCREEN6).
-  */
-struct Graphic5Mode
-{
-	//using IncrByteAddr  = IncrByteAddr5;
-	//using IncrPixelAddr = IncrPixelAddr5;
-	//using IncrMask      = IncrMask5;
-	//using IncrShift     = IncrShift5;
-	static constexpr byte COLOR_MASK = 0x03;
-	static constexpr byte PIXELS_PER_BYTE = 4;
-	static constexpr byte PIXELS_PER_BYTE_SHIFT = 2;
-	static constexpr unsigned PIXELS_PER_LINE = 512;
-	static inline unsigned addressOf(unsigned x, unsigned y, bool extVRAM);
-	static inline byte point(VDPVRAM& vram, unsigned x, unsigned y, bool extVRAM);
-	template <typename LogOp>
-	static inline void pset(EmuTime::param time, VDPVRAM& vram,
-		unsigned x, unsigned addr, byte src, byte color, LogOp op);
-	static inline byte duplicate(byte color);
-};
-
-inline unsigned Graphic5Mode::addressOf(
-	unsigned x, unsigned y, bool extVRAM)
-{
-	return likely(!extVRAM)
-		? (((y & 1023) << 7) | ((x & 511) >> 2))
-		: (((y &  511) << 7) | ((x & 511) >> 2) | 0x20000);
-}
-
-inline byte Graphic5Mode::point(
-	VDPVRAM& vram, unsigned x, unsigned y, bool extVRAM)
-{
-	return ( vram.cmdReadWindow.readNP(addressOf(x, y, extVRAM))
-		>> (((~x) & 3) << 1) ) & 3;
-}
-
-template<typename LogOp>
-inline void Graphic5Mode::pset(
-	EmuTime::param time, VDPVRAM& vram, unsigned x, unsigned addr,
-	byte src, byte color, LogOp op)
-{
-	byte sh = ((~x) & 3) << 1;
-	op(time, vram, addr, src, color << sh, ~(3 << sh));
-}
-
-inline byte Graphic5Mode::duplicate(byte color)
-{
-	assert((color & 0xFC) == 0);
-	color |= color << 2;
-	color |= color << 4;
-	return color;
-}
-
-/** Represents V9938 Graphic 6 mode (SCREEN7).
-  */
-struct Graphic6Mode
-{
-	//using IncrByteAddr  = IncrByteAddr6;
-	//using IncrPixelAddr = IncrPixelAddr6;
-	//using IncrMask      = IncrMask6;
-	//using IncrShift     = IncrShift6;
-	static constexpr byte COLOR_MASK = 0x0F;
-	static constexpr byte PIXELS_PER_BYTE = 2;
-	static constexpr byte PIXELS_PER_BYTE_SHIFT = 1;
-	static constexpr unsigned PIXELS_PER_LINE = 512;
-	static inline unsigned addressOf(unsigned x, unsigned y, bool extVRAM);
-	static inline byte point(VDPVRAM& vram, unsigned x, unsigned y, bool extVRAM);
-	template <typename LogOp>
-	static inline void pset(EmuTime::param time, VDPVRAM& vram,
-		unsigned x, unsigned addr, byte src, byte color, LogOp op);
-	static inline byte duplicate(byte color);
-};
-
-inline unsigned Graphic6Mode::addressOf(
-	unsigned x, unsigned y, bool extVRAM)
-{
-	return likely(!extVRAM)
-		? (((x & 2) << 15) | ((y & 511) << 7) | ((x & 511) >> 2))
-		: (0x20000         | ((y & 511) << 7) | ((x & 511) >> 2));
-}
-
-inline byte Graphic6Mode::point(
-	VDPVRAM& vram, unsigned x, unsigned y, bool extVRAM)
-{
-	return ( vram.cmdReadWindow.readNP(addressOf(x, y, extVRAM))
-		>> (((~x) & 1) << 2) ) & 15;
-}
-
-template<typename LogOp>
-inline void Graphic6Mode::pset(
-	EmuTime::param time, VDPVRAM& vram, unsigned x, unsigned addr,
-	byte src, byte color, LogOp op)
-{
-	byte sh = ((~x) & 1) << 2;
-	op(time, vram, addr, src, color << sh, ~(15 << sh));
-}
-
-inline byte Graphic6Mode::duplicate(byte color)
-{
-	assert((color & 0xF0) == 0);
-	return color | (color << 4);
-}
-
-/** Represents V9938 Graphic 7 mode (SCREEN8).
-  */
-struct Graphic7Mode
-{
-	//using IncrByteAddr  = IncrByteAddr7;
-	//using IncrPixelAddr = IncrPixelAddr7;
-	//using IncrMask      = IncrMask7;
-	//using IncrShift     = IncrShift7;
-	static constexpr byte COLOR_MASK = 0xFF;
-	static constexpr byte PIXELS_PER_BYTE = 1;
-	static constexpr byte PIXELS_PER_BYTE_SHIFT = 0;
-	static constexpr unsigned PIXELS_PER_LINE = 256;
-	static inline unsigned addressOf(unsigned x, unsigned y, bool extVRAM);
-	static inline byte point(VDPVRAM& vram, unsigned x, unsigned y, bool extVRAM);
-	template<typename LogOp>
-	static inline void pset(EmuTime::param time, VDPVRAM& vram,
-		unsigned x, unsigned addr, byte src, byte color, LogOp op);
-	static inline byte duplicate(byte color);
-};
-
-inline unsigned Graphic7Mode::addressOf(
-	unsigned x, unsigned y, bool extVRAM)
-{
-	return likely(!extVRAM)
-		? (((x & 1) << 16) | ((y & 511) << 7) | ((x & 255) >> 1))
-		: (0x20000         | ((y & 511) << 7) | ((x & 255) >> 1));
-}
-
-inline byte Graphic7Mode::point(
-	VDPVRAM& vram, unsigned x, unsigned y, bool extVRAM)
-{
-	return vram.cmdReadWindow.readNP(addressOf(x, y, extVRAM));
-}
-
-template<typename LogOp>
-inline void Graphic7Mode::pset(
-	EmuTime::param time, VDPVRAM& vram, unsigned /*x*/, unsigned addr,
-	byte src, byte color, LogOp op)
-{
-	op(time, vram, addr, src, color, 0);
-}
-
-inline byte Graphic7Mode::duplicate(byte color)
-{
-	return color;
-}
-
-/** Represents V9958 non-bitmap command mode. This uses the Graphic7Mode
-  * coordinate system, but in non-planar mode.
-  */
-struct NonBitmapMode
-{
-	//using IncrByteAddr  = IncrByteAddrNonBitMap;
-	//using IncrPixelAddr = IncrPixelAddrNonBitMap;
-	//using IncrMask      = IncrMaskNonBitMap;
-	//using IncrShift     = IncrShiftNonBitMap;
-	static constexpr byte COLOR_MASK = 0xFF;
-	static constexpr byte PIXELS_PER_BYTE = 1;
-	static constexpr byte PIXELS_PER_BYTE_SHIFT = 0;
-	static constexpr unsigned PIXELS_PER_LINE = 256;
-	static inline unsigned addressOf(unsigned x, unsigned y, bool extVRAM);
-	static inline byte point(VDPVRAM& vram, unsigned x, unsigned y, bool extVRAM);
-	template<typename LogOp>
-	static inline void pset(EmuTime::param time, VDPVRAM& vram,
-		unsigned x, unsigned addr, byte src, byte color, LogOp op);
-	static inline byte duplicate(byte color);
-};
-
-inline unsigned NonBitmapMode::addressOf(
-	unsigned x, unsigned y, bool extVRAM)
-{
-	return likely(!extVRAM)
-		? (((y & 511) << 8) | (x & 255))
-		: (((y & 255) << 8) | (x & 255) | 0x20000);
-}
-
-inline byte NonBitmapMode::point(
-	VDPVRAM& vram, unsigned x, unsigned y, bool extVRAM)
-{
-	return vram.cmdReadWindow.readNP(addressOf(x, y, extVRAM));
-}
-
-template<typename LogOp>
-inline void NonBitmapMode::pset(
-	EmuTime::param time, VDPVRAM& vram, unsigned /*x*/, unsigned addr,
-	byte src, byte color, LogOp op)
-{
-	op(time, vram, addr, src, color, 0);
-}
-
-inline byte NonBitmapMode::duplicate(byte color)
-{
-	return color;
-}
-
 /** Incremental address calculation (byte based, no extended VRAM)
  */
 struct IncrByteAddr4
@@ -649,74 +404,6 @@ struct IncrShift7
 };
 
 
-// Logical operations:
-
-struct DummyOp {
-	void operator()(EmuTime::param /*time*/, VDPVRAM& /*vram*/, unsigned /*addr*/,
-	                byte /*src*/, byte /*color*/, byte /*mask*/) const
-	{
-		// Undefined logical operations do nothing.
-	}
-};
-
-struct ImpOp {
-	void operator()(EmuTime::param time, VDPVRAM& vram, unsigned addr,
-	                byte src, byte color, byte mask) const
-	{
-		vram.cmdWrite(addr, (src & mask) | color, time);
-	}
-};
-
-struct AndOp {
-	void operator()(EmuTime::param time, VDPVRAM& vram, unsigned addr,
-	                byte src, byte color, byte mask) const
-	{
-		vram.cmdWrite(addr, src & (color | mask), time);
-	}
-};
-
-struct OrOp {
-	void operator()(EmuTime::param time, VDPVRAM& vram, unsigned addr,
-	                byte src, byte color, byte /*mask*/) const
-	{
-		vram.cmdWrite(addr, src | color, time);
-	}
-};
-
-struct XorOp {
-	void operator()(EmuTime::param time, VDPVRAM& vram, unsigned addr,
-	                byte src, byte color, byte /*mask*/) const
-	{
-		vram.cmdWrite(addr, src ^ color, time);
-	}
-};
-
-struct NotOp {
-	void operator()(EmuTime::param time, VDPVRAM& vram, unsigned addr,
-	                byte src, byte color, byte mask) const
-	{
-		vram.cmdWrite(addr, (src & mask) | ~(color | mask), time);
-	}
-};
-
-template<typename Op>
-struct TransparentOp : Op {
-	void operator()(EmuTime::param time, VDPVRAM& vram, unsigned addr,
-	                byte src, byte color, byte mask) const
-	{
-		// TODO does this skip the write or re-write the original value
-		//      might make a difference in case the CPU has written
-		//      the same address inbetween the command read and write
-		if (color) Op::operator()(time, vram, addr, src, color, mask);
-	}
-};
-using TImpOp = TransparentOp<ImpOp>;
-using TAndOp = TransparentOp<AndOp>;
-using TOrOp  = TransparentOp<OrOp>;
-using TXorOp = TransparentOp<XorOp>;
-using TNotOp = TransparentOp<NotOp>;
-
-
 // Commands
 
 void VDPCmdEngine::setStatusChangeTime(EmuTime::param t)
@@ -971,11 +658,23 @@ void VDPCmdEngine::executeLmmv(EmuTime::param limit)
 	bool dstExt = (ARG & MXD) != 0;
 	bool doPset = !dstExt || hasExtendedVRAM;
 	unsigned addr = Mode::addressOf(ADX, DY, dstExt);
+	bool tryBulk = !dstExt;
 	auto calculator = getSlotCalculator(limit);
 
 	switch (phase) {
 	case 0:
 loop:		if (unlikely(calculator.limitReached())) { phase = 0; break; }
+		if (tryBulk && (ANX > BULK_MIN)) {
+			BulkRange<Mode> range(ADX, TX, ANX - 1, DY);
+			if (byte* data = range.getArea(vram, true)) {
+				unsigned n = bulkSlots(calculator, ANX - 1, DELTA_24, DELTA_72);
+				ADX = bulkPset<Mode>(data, ADX, TX, n, DY, CL, limit, LogOp());
+				ANX -= n;
+				addr = Mode::addressOf(ADX, DY, dstExt);
+				goto loop;
+			}
+			tryBulk = false; // retry on the next line
+		}
 		if (likely(doPset)) {
 			tmpDst = vram.cmdWriteWindow.readNP(addr);
 		}
@@ -993,6 +692,7 @@ loop:		if (unlikely(calculator.limitReached())) { phase = 0; break; }
 			delta = DELTA_136; // 72 + 64;
 			DY += TY; --NY;
 			ADX = DX; ANX = tmpNX;
+			tryBulk = !dstExt;
 			if (--tmpNY == 0) {
 				commandDone(calculator.getTime());
 				break;
@@ -1348,9 +1048,20 @@ void VDPCmdEngine::executeHmmv(EmuTime::param limit)
 		ADX, ANX << Mode::PIXELS_PER_BYTE_SHIFT, ARG );
 	bool dstExt = (ARG & MXD) != 0;
 	bool doPset = !dstExt || hasExtendedVRAM;
+	bool tryBulk = !dstExt;
 	auto calculator = getSlotCalculator(limit);
 
 	while (!calculator.limitReached()) {
+		if (tryBulk && (ANX > BULK_MIN)) {
+			BulkRange<Mode> range(ADX, TX, ANX - 1, DY);
+			if (byte* data = range.getArea(vram, true)) {
+				unsigned n = bulkSlots(calculator, ANX - 1, DELTA_48);
+				bulkFill<Mode>(data, ADX, TX, n, DY, COL);
+				ADX += n * TX; ANX -= n;
+				continue;
+			}
+			tryBulk = false; // retry on the next line
+		}
 		if (likely(doPset)) {
 			vram.cmdWrite(Mode::addressOf(ADX, DY, dstExt),
 			              COL, calculator.getTime());
@@ -1361,6 +1072,7 @@ void VDPCmdEngine::executeHmmv(EmuTime::param limit)
 			delta = DELTA_104; // 48 + 56;
 			DY += TY; --NY;
 			ADX = DX; ANX = tmpNX;
+			tryBulk = !dstExt;
 			if (--tmpNY == 0) {
 				commandDone(calculator.getTime());
 				break;
@@ -1456,11 +1168,24 @@ void VDPCmdEngine::executeHmmm(EmuTime::param limit)
 	bool dstExt  = (ARG & MXD) != 0;
 	bool doPoint = !srcExt || hasExtendedVRAM;
 	bool doPset  = !dstExt || hasExtendedVRAM;
+	bool tryBulk = !srcExt && !dstExt;
 	auto calculator = getSlotCalculator(limit);
 
 	switch (phase) {
 	case 0:
 loop:		if (unlikely(calculator.limitReached())) { phase = 0; break; }
+		if (tryBulk && (ANX > BULK_MIN)) {
+			BulkRange<Mode> src(ASX, TX, ANX - 1, SY);
+			BulkRange<Mode> dst(ADX, TX, ANX - 1, DY);
+			byte* data = src.getArea(vram, false);
+			if (data && dst.getArea(vram, true)) {
+				unsigned n = bulkSlots(calculator, ANX - 1, DELTA_24, DELTA_64);
+				bulkCopy<Mode>(data, ASX, SY, ADX, DY, TX, n);
+				ASX += n * TX; ADX += n * TX; ANX -= n;
+				goto loop;
+			}
+			tryBulk = false; // retry on the next line
+		}
 		tmpSrc = likely(doPoint)
 			? vram.cmdReadWindow.readNP(
 			       Mode::addressOf(ASX, SY, srcExt))
@@ -1479,6 +1204,7 @@ loop:		if (unlikely(calculator.limitReached())) { phase = 0; break; }
 			delta = DELTA_128; // 64 + 64
 			SY += TY; DY += TY; --NY;
 			ASX = SX; ADX = DX; ANX = tmpNX;
+			tryBulk = !srcExt && !dstExt;
 			if (--tmpNY == 0) {
 				commandDone(calculator.getTime());
 				break;
@@ -1590,11 +1316,24 @@ void VDPCmdEngine::executeYmmm(EmuTime::param limit)
 	//  OTOH YMMM also uses DX for both read and write
 	bool dstExt = (ARG & MXD) != 0;
 	bool doPset  = !dstExt || hasExtendedVRAM;
+	bool tryBulk = !dstExt;
 	auto calculator = getSlotCalculator(limit);
 
 	switch (phase) {
 	case 0:
 loop:		if (unlikely(calculator.limitReached())) { phase = 0; break; }
+		if (tryBulk && (ANX > BULK_MIN)) {
+			BulkRange<Mode> src(ADX, TX, ANX - 1, SY);
+			BulkRange<Mode> dst(ADX, TX, ANX - 1, DY);
+			byte* data = src.getArea(vram, false);
+			if (data && dst.getArea(vram, true)) {
+				unsigned n = bulkSlots(calculator, ANX - 1, DELTA_24, DELTA_40);
+				bulkCopy<Mode>(data, ADX, SY, ADX, DY, TX, n);
+				ADX += n * TX; ANX -= n;
+				goto loop;
+			}
+			tryBulk = false; // retry on the next line
+		}
 		if (likely(doPset)) {
 			tmpSrc = vram.cmdReadWindow.readNP(
 			       Mode::addressOf(ADX, SY, dstExt));
@@ -1612,6 +1351,7 @@ loop:		if (unlikely(calculator.limitReached())) { phase = 0; break; }
 			// note: going to the next line does not take extra time
 			SY += TY; DY += TY; --NY;
 			ADX = DX; ANX = tmpNX;
+			tryBulk = !dstExt;
 			if (--tmpNY == 0) {
 				commandDone(calculator.getTime());
 				break;
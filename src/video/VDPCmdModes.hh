@@ -0,0 +1,514 @@
+#ifndef VDPCMDMODES_HH
+#define VDPCMDMODES_HH
+
+#include "VDPAccessSlots.hh"
+#include "VDPVRAM.hh"
+#include "EmuTime.hh"
+#include "likely.hh"
+#include "openmsx.hh"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+// The display modes and logical operations of the V9938/V9958 command engine,
+// and the bulk paths built on top of them. These are only used by
+// VDPCmdEngine (and the unit tests).
+
+namespace openmsx {
+
+/** Represents V9938 Graphic 4 mode (SCREEN5).
+  */
+struct Graphic4Mode
+{
+	//using IncrByteAddr  = IncrByteAddr4;
+	//using IncrPixelAddr = IncrPixelAddr4;
+	//using IncrMask      = IncrMask4;
+	//using IncrShift     = IncrShift4;
+	static constexpr byte COLOR_MASK = 0x0F;
+	static constexpr byte PIXELS_PER_BYTE = 2;
+	static constexpr byte PIXELS_PER_BYTE_SHIFT = 1;
+	static constexpr unsigned PIXELS_PER_LINE = 256;
+	static constexpr bool PLANAR = false;
+	static inline unsigned addressOf(unsigned x, unsigned y, bool extVRAM);
+	static inline byte point(VDPVRAM& vram, unsigned x, unsigned y, bool extVRAM);
+	template<typename VRAM, typename LogOp>
+	static inline void pset(EmuTime::param time, VRAM& vram,
+		unsigned x, unsigned addr, byte src, byte color, LogOp op);
+	static inline byte duplicate(byte color);
+};
+
+inline unsigned Graphic4Mode::addressOf(
+	unsigned x, unsigned y, bool extVRAM)
+{
+	return likely(!extVRAM)
+		? (((y & 1023) << 7) | ((x & 255) >> 1))
+		: (((y &  511) << 7) | ((x & 255) >> 1) | 0x20000);
+}
+
+inline byte Graphic4Mode::point(
+	VDPVRAM& vram, unsigned x, unsigned y, bool extVRAM)
+{
+	return ( vram.cmdReadWindow.readNP(addressOf(x, y, extVRAM))
+		>> (((~x) & 1) << 2) ) & 15;
+}
+
+template<typename VRAM, typename LogOp>
+inline void Graphic4Mode::pset(
+	EmuTime::param time, VRAM& vram, unsigned x, unsigned addr,
+	byte src, byte color, LogOp op)
+{
+	byte sh = ((~x) & 1) << 2;
+	op(time, vram, addr, src, color << sh, ~(15 << sh));
+}
+
+inline byte Graphic4Mode::duplicate(byte color)
+{
+	assert((color & 0xF0) == 0);
+	return color | (color << 4);
+}
+
+/** Represents V9938 Graphic 5 mode (SCREEN6).
+  */
+struct Graphic5Mode
+{
+	//using IncrByteAddr  = IncrByteAddr5;
+	//using IncrPixelAddr = IncrPixelAddr5;
+	//using IncrMask      = IncrMask5;
+	//using IncrShift     = IncrShift5;
+	static constexpr byte COLOR_MASK = 0x03;
+	static constexpr byte PIXELS_PER_BYTE = 4;
+	static constexpr byte PIXELS_PER_BYTE_SHIFT = 2;
+	static constexpr unsigned PIXELS_PER_LINE = 512;
+	static constexpr bool PLANAR = false;
+	static inline unsigned addressOf(unsigned x, unsigned y, bool extVRAM);
+	static inline byte point(VDPVRAM& vram, unsigned x, unsigned y, bool extVRAM);
+	template<typename VRAM, typename LogOp>
+	static inline void pset(EmuTime::param time, VRAM& vram,
+		unsigned x, unsigned addr, byte src, byte color, LogOp op);
+	static inline byte duplicate(byte color);
+};
+
+inline unsigned Graphic5Mode::addressOf(
+	unsigned x, unsigned y, bool extVRAM)
+{
+	return likely(!extVRAM)
+		? (((y & 1023) << 7) | ((x & 511) >> 2))
+		: (((y &  511) << 7) | ((x & 511) >> 2) | 0x20000);
+}
+
+inline byte Graphic5Mode::point(
+	VDPVRAM& vram, unsigned x, unsigned y, bool extVRAM)
+{
+	return ( vram.cmdReadWindow.readNP(addressOf(x, y, extVRAM))
+		>> (((~x) & 3) << 1) ) & 3;
+}
+
+template<typename VRAM, typename LogOp>
+inline void Graphic5Mode::pset(
+	EmuTime::param time, VRAM& vram, unsigned x, unsigned addr,
+	byte src, byte color, LogOp op)
+{
+	byte sh = ((~x) & 3) << 1;
+	op(time, vram, addr, src, color << sh, ~(3 << sh));
+}
+
+inline byte Graphic5Mode::duplicate(byte color)
+{
+	assert((color & 0xFC) == 0);
+	color |= color << 2;
+	color |= color << 4;
+	return color;
+}
+
+/** Represents V9938 Graphic 6 mode (SCREEN7).
+  */
+struct Graphic6Mode
+{
+	//using IncrByteAddr  = IncrByteAddr6;
+	//using IncrPixelAddr = IncrPixelAddr6;
+	//using IncrMask      = IncrMask6;
+	//using IncrShift     = IncrShift6;
+	static constexpr byte COLOR_MASK = 0x0F;
+	static constexpr byte PIXELS_PER_BYTE = 2;
+	static constexpr byte PIXELS_PER_BYTE_SHIFT = 1;
+	static constexpr unsigned PIXELS_PER_LINE = 512;
+	static constexpr bool PLANAR = true;
+	static inline unsigned addressOf(unsigned x, unsigned y, bool extVRAM);
+	static inline byte point(VDPVRAM& vram, unsigned x, unsigned y, bool extVRAM);
+	template<typename VRAM, typename LogOp>
+	static inline void pset(EmuTime::param time, VRAM& vram,
+		unsigned x, unsigned addr, byte src, byte color, LogOp op);
+	static inline byte duplicate(byte color);
+};
+
+inline unsigned Graphic6Mode::addressOf(
+	unsigned x, unsigned y, bool extVRAM)
+{
+	return likely(!extVRAM)
+		? (((x & 2) << 15) | ((y & 511) << 7) | ((x & 511) >> 2))
+		: (0x20000         | ((y & 511) << 7) | ((x & 511) >> 2));
+}
+
+inline byte Graphic6Mode::point(
+	VDPVRAM& vram, unsigned x, unsigned y, bool extVRAM)
+{
+	return ( vram.cmdReadWindow.readNP(addressOf(x, y, extVRAM))
+		>> (((~x) & 1) << 2) ) & 15;
+}
+
+template<typename VRAM, typename LogOp>
+inline void Graphic6Mode::pset(
+	EmuTime::param time, VRAM& vram, unsigned x, unsigned addr,
+	byte src, byte color, LogOp op)
+{
+	byte sh = ((~x) & 1) << 2;
+	op(time, vram, addr, src, color << sh, ~(15 << sh));
+}
+
+inline byte Graphic6Mode::duplicate(byte color)
+{
+	assert((color & 0xF0) == 0);
+	return color | (color << 4);
+}
+
+/** Represents V9938 Graphic 7 mode (SCREEN8).
+  */
+struct Graphic7Mode
+{
+	//using IncrByteAddr  = IncrByteAddr7;
+	//using IncrPixelAddr = IncrPixelAddr7;
+	//using IncrMask      = IncrMask7;
+	//using IncrShift     = IncrShift7;
+	static constexpr byte COLOR_MASK = 0xFF;
+	static constexpr byte PIXELS_PER_BYTE = 1;
+	static constexpr byte PIXELS_PER_BYTE_SHIFT = 0;
+	static constexpr unsigned PIXELS_PER_LINE = 256;
+	static constexpr bool PLANAR = true;
+	static inline unsigned addressOf(unsigned x, unsigned y, bool extVRAM);
+	static inline byte point(VDPVRAM& vram, unsigned x, unsigned y, bool extVRAM);
+	template<typename VRAM, typename LogOp>
+	static inline void pset(EmuTime::param time, VRAM& vram,
+		unsigned x, unsigned addr, byte src, byte color, LogOp op);
+	static inline byte duplicate(byte color);
+};
+
+inline unsigned Graphic7Mode::addressOf(
+	unsigned x, unsigned y, bool extVRAM)
+{
+	return likely(!extVRAM)
+		? (((x & 1) << 16) | ((y & 511) << 7) | ((x & 255) >> 1))
+		: (0x20000         | ((y & 511) << 7) | ((x & 255) >> 1));
+}
+
+inline byte Graphic7Mode::point(
+	VDPVRAM& vram, unsigned x, unsigned y, bool extVRAM)
+{
+	return vram.cmdReadWindow.readNP(addressOf(x, y, extVRAM));
+}
+
+template<typename VRAM, typename LogOp>
+inline void Graphic7Mode::pset(
+	EmuTime::param time, VRAM& vram, unsigned /*x*/, unsigned addr,
+	byte src, byte color, LogOp op)
+{
+	op(time, vram, addr, src, color, 0);
+}
+
+inline byte Graphic7Mode::duplicate(byte color)
+{
+	return color;
+}
+
+/** Represents V9958 non-bitmap command mode. This uses the Graphic7Mode
+  * coordinate system, but in non-planar mode.
+  */
+struct NonBitmapMode
+{
+	//using IncrByteAddr  = IncrByteAddrNonBitMap;
+	//using IncrPixelAddr = IncrPixelAddrNonBitMap;
+	//using IncrMask      = IncrMaskNonBitMap;
+	//using IncrShift     = IncrShiftNonBitMap;
+	static constexpr byte COLOR_MASK = 0xFF;
+	static constexpr byte PIXELS_PER_BYTE = 1;
+	static constexpr byte PIXELS_PER_BYTE_SHIFT = 0;
+	static constexpr unsigned PIXELS_PER_LINE = 256;
+	static constexpr bool PLANAR = false;
+	static inline unsigned addressOf(unsigned x, unsigned y, bool extVRAM);
+	static inline byte point(VDPVRAM& vram, unsigned x, unsigned y, bool extVRAM);
+	template<typename VRAM, typename LogOp>
+	static inline void pset(EmuTime::param time, VRAM& vram,
+		unsigned x, unsigned addr, byte src, byte color, LogOp op);
+	static inline byte duplicate(byte color);
+};
+
+inline unsigned NonBitmapMode::addressOf(
+	unsigned x, unsigned y, bool extVRAM)
+{
+	return likely(!extVRAM)
+		? (((y & 511) << 8) | (x & 255))
+		: (((y & 255) << 8) | (x & 255) | 0x20000);
+}
+
+inline byte NonBitmapMode::point(
+	VDPVRAM& vram, unsigned x, unsigned y, bool extVRAM)
+{
+	return vram.cmdReadWindow.readNP(addressOf(x, y, extVRAM));
+}
+
+template<typename VRAM, typename LogOp>
+inline void NonBitmapMode::pset(
+	EmuTime::param time, VRAM& vram, unsigned /*x*/, unsigned addr,
+	byte src, byte color, LogOp op)
+{
+	op(time, vram, addr, src, color, 0);
+}
+
+inline byte NonBitmapMode::duplicate(byte color)
+{
+	return color;
+}
+
+// Logical operations:
+
+struct DummyOp {
+	template<typename VRAM>
+	void operator()(EmuTime::param /*time*/, VRAM& /*vram*/, unsigned /*addr*/,
+	                byte /*src*/, byte /*color*/, byte /*mask*/) const
+	{
+		// Undefined logical operations do nothing.
+	}
+};
+
+struct ImpOp {
+	template<typename VRAM>
+	void operator()(EmuTime::param time, VRAM& vram, unsigned addr,
+	                byte src, byte color, byte mask) const
+	{
+		vram.cmdWrite(addr, (src & mask) | color, time);
+	}
+};
+
+struct AndOp {
+	template<typename VRAM>
+	void operator()(EmuTime::param time, VRAM& vram, unsigned addr,
+	                byte src, byte color, byte mask) const
+	{
+		vram.cmdWrite(addr, src & (color | mask), time);
+	}
+};
+
+struct OrOp {
+	template<typename VRAM>
+	void operator()(EmuTime::param time, VRAM& vram, unsigned addr,
+	                byte src, byte color, byte /*mask*/) const
+	{
+		vram.cmdWrite(addr, src | color, time);
+	}
+};
+
+struct XorOp {
+	template<typename VRAM>
+	void operator()(EmuTime::param time, VRAM& vram, unsigned addr,
+	                byte src, byte color, byte /*mask*/) const
+	{
+		vram.cmdWrite(addr, src ^ color, time);
+	}
+};
+
+struct NotOp {
+	template<typename VRAM>
+	void operator()(EmuTime::param time, VRAM& vram, unsigned addr,
+	                byte src, byte color, byte mask) const
+	{
+		vram.cmdWrite(addr, (src & mask) | ~(color | mask), time);
+	}
+};
+
+template<typename Op>
+struct TransparentOp : Op {
+	template<typename VRAM>
+	void operator()(EmuTime::param time, VRAM& vram, unsigned addr,
+	                byte src, byte color, byte mask) const
+	{
+		// TODO does this skip the write or re-write the original value
+		//      might make a difference in case the CPU has written
+		//      the same address inbetween the command read and write
+		if (color) Op::operator()(time, vram, addr, src, color, mask);
+	}
+};
+using TImpOp = TransparentOp<ImpOp>;
+using TAndOp = TransparentOp<AndOp>;
+using TOrOp  = TransparentOp<OrOp>;
+using TXorOp = TransparentOp<XorOp>;
+using TNotOp = TransparentOp<NotOp>;
+
+// Bulk paths:
+//
+// When a command can execute many accesses on one line before 'limit', and
+// none of the written bytes is observed by another subsystem (renderer,
+// sprite checker), it's not needed to go through VDPVRAM::cmdWrite() and to
+// calculate the exact time of each individual access. Instead VRAM is
+// changed directly (memset/memcpy where possible) and the slot calculator
+// is advanced over all these accesses in one go. The result, including the
+// timing and the command registers, is exactly the same as executing the
+// accesses one by one. The last pixel or byte of a line always goes through
+// the regular code, because there the timing is different and the command
+// may end.
+// Typically this applies to commands that draw in an invisible page.
+
+// Only try the bulk path for at least this many pixels or bytes.
+constexpr unsigned BULK_MIN = 8;
+
+// Used as 'vram' parameter for Mode::pset() and the logical operations:
+// writes straight into VRAM, see VDPVRAM::getCmdArea().
+struct RawVRAM {
+	byte* data;
+	void cmdWrite(unsigned addr, byte value, EmuTime::param /*time*/) const {
+		data[addr] = value;
+	}
+};
+
+// Advance 'calc' over (at most 'max') repetitions of one VRAM access
+// followed by 'delta', but not past its limit. Returns the number of
+// repetitions.
+inline unsigned bulkSlots(VDPAccessSlots::Calculator& calc, unsigned max,
+                          VDPAccessSlots::Delta delta)
+{
+	unsigned n = 0;
+	while ((n < max) && !calc.limitReached()) {
+		calc.next(delta);
+		++n;
+	}
+	return n;
+}
+
+// Same for repetitions of two VRAM accesses. A repetition is only counted
+// when both accesses happen before the limit.
+inline unsigned bulkSlots(VDPAccessSlots::Calculator& calc, unsigned max,
+                          VDPAccessSlots::Delta delta0,
+                          VDPAccessSlots::Delta delta1)
+{
+	unsigned n = 0;
+	while ((n < max) && !calc.limitReached()) {
+		auto tmp = calc;
+		tmp.next(delta0);
+		if (tmp.limitReached()) break;
+		calc.next(delta0);
+		calc.next(delta1);
+		++n;
+	}
+	return n;
+}
+
+// Range of VRAM addresses of 'n' pixels or bytes on line 'y', starting at
+// 'x' and going in direction 'tx'. In the planar modes consecutive bytes are
+// in different halves of VRAM, then [first, last] is the range in the lower
+// half and the same range in the upper half is used as well.
+template<typename Mode> struct BulkRange {
+	BulkRange(unsigned x, int tx, unsigned n, unsigned y)
+	{
+		unsigned xLast = x + (n - 1) * tx;
+		// also catches 'xLast' wrapping around
+		valid = std::max(x, xLast) < Mode::PIXELS_PER_LINE;
+		unsigned a0 = Mode::addressOf(x,     y, false);
+		unsigned a1 = Mode::addressOf(xLast, y, false);
+		if (Mode::PLANAR) {
+			a0 &= 0xFFFF;
+			a1 &= 0xFFFF;
+		}
+		first = std::min(a0, a1);
+		last  = std::max(a0, a1);
+	}
+
+	// Direct access to VRAM for this range, see VDPVRAM::getCmdArea().
+	byte* getArea(VDPVRAM& vram, bool write) const {
+		if (!valid) return nullptr;
+		byte* data = vram.getCmdArea(first, last, write);
+		if (Mode::PLANAR && data &&
+		    !vram.getCmdArea(first | 0x10000, last | 0x10000, write)) {
+			return nullptr;
+		}
+		return data;
+	}
+
+	// Might both ranges have bytes in common? (Conservative for the
+	// planar modes.)
+	bool overlaps(const BulkRange& other) const {
+		return (first <= other.last) && (other.first <= last);
+	}
+
+	unsigned first, last;
+	bool valid;
+};
+
+// Draw 'n' pixels with 'color' on line 'y' with a logical operation, see
+// BulkRange. Returns the x-coordinate after the last pixel.
+template<typename Mode, typename LogOp>
+inline unsigned bulkPset(byte* data, unsigned x, int tx, unsigned n,
+                         unsigned y, byte color, EmuTime::param time, LogOp op)
+{
+	RawVRAM raw{data};
+	for (unsigned i = 0; i < n; ++i) {
+		unsigned a = Mode::addressOf(x, y, false);
+		Mode::pset(time, raw, x, a, data[a], color, op);
+		x += tx;
+	}
+	return x;
+}
+
+// Write 'value' to 'n' bytes on line 'y', see BulkRange.
+template<typename Mode>
+inline void bulkFill(byte* data, unsigned x, int tx, unsigned n, unsigned y,
+                     byte value)
+{
+	auto fill = [&](unsigned x0, int step, unsigned num) {
+		if (num == 0) return;
+		unsigned a0 = Mode::addressOf(x0,                    y, false);
+		unsigned a1 = Mode::addressOf(x0 + (num - 1) * step, y, false);
+		memset(data + std::min(a0, a1), value, num);
+	};
+	if (Mode::PLANAR) {
+		// the even and odd bytes are each contiguous
+		fill(x,      2 * tx, (n + 1) / 2);
+		fill(x + tx, 2 * tx,  n      / 2);
+	} else {
+		fill(x, tx, n);
+	}
+}
+
+// Copy 'n' bytes from line 'sy' to line 'dy', see BulkRange.
+template<typename Mode>
+inline void bulkCopy(byte* data, unsigned sx, unsigned sy,
+                     unsigned dx, unsigned dy, int tx, unsigned n)
+{
+	BulkRange<Mode> src(sx, tx, n, sy);
+	BulkRange<Mode> dst(dx, tx, n, dy);
+	if (src.overlaps(dst)) {
+		// Some bytes are read after they're written, that must happen
+		// in the same order as in the regular code.
+		for (unsigned i = 0; i < n; ++i) {
+			data[Mode::addressOf(dx, dy, false)] =
+				data[Mode::addressOf(sx, sy, false)];
+			sx += tx; dx += tx;
+		}
+		return;
+	}
+	auto copy = [&](unsigned sx0, unsigned dx0, int step, unsigned num) {
+		if (num == 0) return;
+		unsigned s0 = Mode::addressOf(sx0,                    sy, false);
+		unsigned s1 = Mode::addressOf(sx0 + (num - 1) * step, sy, false);
+		unsigned d0 = Mode::addressOf(dx0,                    dy, false);
+		unsigned d1 = Mode::addressOf(dx0 + (num - 1) * step, dy, false);
+		memcpy(data + std::min(d0, d1), data + std::min(s0, s1), num);
+	};
+	if (Mode::PLANAR) {
+		copy(sx,      dx,      2 * tx, (n + 1) / 2);
+		copy(sx + tx, dx + tx, 2 * tx,  n      / 2);
+	} else {
+		copy(sx, dx, tx, n);
+	}
+}
+
+} // namespace openmsx
+
+#endif
@@ -209,6 +209,7 @@ void VDPVRAM::updateVRMode(bool newVRmode, EmuTime::param time)
 	}
 	vrMode = newVRmode;
 	setSizeMask(time);
+	spriteChecker->flushCache(); // VRAM content moves below
 
 	if (vrMode) {
 		// switch from VR=0 to VR=1
@@ -303,6 +304,7 @@ void VDPVRAM::change4k8kMapping(bool mapping8k)
 		}
 	}
 	memcpy(&data[0], tmp, sizeof(tmp));
+	spriteChecker->flushCache();
 }
 
 
@@ -297,6 +297,30 @@ public:
 		return (address & combiMask) == unsigned(baseAddr);
 	}
 
+	/** Test whether any address in the range [first, last] might be
+	  * inside this window. This is conservative: it can return true when
+	  * none of the addresses is inside, but when it returns false it's
+	  * certain that none is.
+	  */
+	inline bool mayOverlap(unsigned first, unsigned last) const {
+		assert(first <= last);
+		if (!isEnabled()) return false;
+		// All addresses in the range are equal to 'first' in the bits
+		// that are not set in 'areaBits'.
+		unsigned areaBits = Math::floodRight(first ^ last);
+		return ((first & combiMask) & ~areaBits) ==
+		       (unsigned(baseAddr)  & ~areaBits);
+	}
+
+	/** Might a change of any address in the range [first, last] need to
+	  * be notified to the observer of this window? See
+	  * VRAMObserver::mayNeedUpdate().
+	  */
+	inline bool mayNeedNotify(unsigned first, unsigned last) const {
+		return hasObserver() && mayOverlap(first, last) &&
+		       observer->mayNeedUpdate(first, last);
+	}
+
 	/** Notifies the observer of this window of a VRAM change,
 	  * if the changes address is inside this window.
 	  * @param address The address to test.
@@ -428,6 +452,32 @@ public:
 		writeCommon(address, value, time);
 	}
 
+	/** Get direct access to VRAM for many command engine accesses to
+	  * addresses in the range [first, last]. This is a faster alternative
+	  * for calling cmdWrite() (or cmdWriteWindow.readNP()) for each byte,
+	  * but it's only possible when
+	  *  - the whole range is present (no mirroring, no gap in 16kB VRAM)
+	  *  - for writes: no observer (renderer, sprite checker) needs to be
+	  *    notified of changes in the range, for example because the
+	  *    range is not in the displayed page.
+	  * @param first First address of the range.
+	  * @param last Last address of the range (inclusive).
+	  * @param write Will the command engine write to this range?
+	  * @return Pointer to the start of VRAM (so not to 'first'), or nullptr
+	  *         when direct access is not possible.
+	  */
+	inline byte* getCmdArea(unsigned first, unsigned last, bool write) {
+		assert(first <= last);
+		if ((last > sizeMask) || (last >= actualSize)) return nullptr;
+		if (write &&
+		    (bitmapVisibleWindow.mayNeedNotify(first, last) ||
+		     spriteAttribTable  .mayNeedNotify(first, last) ||
+		     spritePatternTable .mayNeedNotify(first, last))) {
+			return nullptr;
+		}
+		return &data[0];
+	}
+
 	/** Write a byte to VRAM through the CPU interface.
 	  * @param address The address to write.
 	  * @param value The value to write.
@@ -35,6 +35,18 @@ public:
 	  */
 	virtual void updateWindow(bool enabled, EmuTime::param time) = 0;
 
+	/** Could a change of any byte in the given range of VRAM addresses
+	  * require a call to updateVRAM()? When this returns false, the
+	  * bytes may be changed without notifying the observer (used for the
+	  * bulk paths of the command engine). The answer may be conservative,
+	  * and it's only valid until the observer's state changes.
+	  * @param first First VRAM address (not offset) of the range.
+	  * @param last Last VRAM address of the range (inclusive).
+	  */
+	virtual bool mayNeedUpdate(unsigned /*first*/, unsigned /*last*/) const {
+		return true;
+	}
+
 protected:
 	~VRAMObserver() = default;
 };
@@ -0,0 +1,210 @@
+#ifndef YJKCONVERTER_HH
+#define YJKCONVERTER_HH
+
+// The YJK and YAE (YJK mixed with palette colors) part of BitmapConverter.
+//
+// A line is converted in two steps:
+//  - calcColors(): from the two VRAM planes to one 16-bit value per pixel.
+//    For YJK pixels that's the 15-bit RGB value (index in the 32768-entries
+//    palette). For YAE pixels (only when YAE=true) it's 0x8000 plus the index
+//    in the 16-entries palette.
+//  - lookup(): from those values to host pixels.
+// The first step is where most of the work is, it's done for 8 pixels at a
+// time with SSE2. The second step can use the AVX2 gather instruction for
+// 32bpp pixels, for 16bpp it remains a c++ loop.
+//
+// These routines are in a separate header so that they can be tested and
+// benchmarked (see BitmapConverter_test.cc) without needing a VDP. Like in
+// the rest of openMSX the implementation is selected at compile time.
+
+#include "openmsx.hh"
+#include "Math.hh"
+#include <cstdint>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace openmsx::YJKConverter {
+
+// Number of pixels in a line (in Graphic6 and Graphic7 the VRAM planes each
+// contain 128 bytes for such a line).
+constexpr unsigned WIDTH = 256;
+
+// Portable version. Also used as the reference in the unittest.
+template<bool YAE>
+inline void calcColorsScalar(const byte* __restrict vramPtr0,
+                             const byte* __restrict vramPtr1,
+                             uint16_t* __restrict out)
+{
+	for (unsigned i = 0; i < WIDTH / 4; ++i) {
+		unsigned p[4];
+		p[0] = vramPtr0[2 * i + 0];
+		p[1] = vramPtr1[2 * i + 0];
+		p[2] = vramPtr0[2 * i + 1];
+		p[3] = vramPtr1[2 * i + 1];
+
+		int j = (p[2] & 7) + ((p[3] & 3) << 3) - ((p[3] & 4) << 3);
+		int k = (p[0] & 7) + ((p[1] & 3) << 3) - ((p[1] & 4) << 3);
+
+		for (unsigned n = 0; n < 4; ++n) {
+			if (YAE && (p[n] & 0x08)) {
+				out[4 * i + n] = 0x8000 | (p[n] >> 4);
+			} else {
+				int y = p[n] >> 3;
+				int r = Math::clip<0, 31>(y + j);
+				int g = Math::clip<0, 31>(y + k);
+				int b = Math::clip<0, 31>((5 * y - 2 * j - k) / 4);
+				out[4 * i + n] = (r << 10) + (g << 5) + b;
+			}
+		}
+	}
+}
+
+#ifdef __SSE2__
+// 8 pixels (2 groups of 4 pixels that share J and K), one pixel per 16-bit
+// lane, in display order.
+template<bool YAE>
+inline __m128i calcColors8(__m128i p)
+{
+	// In each 32-bit lane the low 3 bits of the first pixel form the low
+	// bits and those of the second pixel the high bits of a 6-bit signed
+	// number: K (for lanes 0 and 2) or J (lanes 1 and 3).
+	__m128i low = _mm_and_si128(p, _mm_set1_epi16(7));
+	__m128i jk = _mm_or_si128(low, _mm_srli_epi32(low, 13));
+	jk = _mm_srai_epi16(_mm_slli_epi16(jk, 10), 10);
+	__m128i k = _mm_shufflehi_epi16(_mm_shufflelo_epi16(jk, 0x00), 0x00);
+	__m128i j = _mm_shufflehi_epi16(_mm_shufflelo_epi16(jk, 0xAA), 0xAA);
+
+	// Scalar code divides by 4 (rounds towards zero), here we shift (rounds
+	// down). That only differs for negative numbers, and those are clipped
+	// to zero anyway.
+	__m128i y = _mm_srli_epi16(p, 3);
+	__m128i r = _mm_add_epi16(y, j);
+	__m128i g = _mm_add_epi16(y, k);
+	__m128i b = _mm_add_epi16(y, _mm_slli_epi16(y, 2)); // 5 * y
+	b = _mm_sub_epi16(b, _mm_add_epi16(_mm_add_epi16(j, j), k));
+	b = _mm_srai_epi16(b, 2);
+
+	__m128i zero = _mm_setzero_si128();
+	__m128i max = _mm_set1_epi16(31);
+	r = _mm_max_epi16(_mm_min_epi16(r, max), zero);
+	g = _mm_max_epi16(_mm_min_epi16(g, max), zero);
+	b = _mm_max_epi16(_mm_min_epi16(b, max), zero);
+	__m128i col = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, 10),
+	                                        _mm_slli_epi16(g, 5)),
+	                           b);
+	if (YAE) {
+		__m128i a = _mm_set1_epi16(0x08);
+		__m128i isYAE = _mm_cmpeq_epi16(_mm_and_si128(p, a), a);
+		__m128i pal = _mm_or_si128(_mm_srli_epi16(p, 4),
+		                           _mm_set1_epi16(int16_t(0x8000)));
+		col = _mm_or_si128(_mm_and_si128   (isYAE, pal),
+		                   _mm_andnot_si128(isYAE, col));
+	}
+	return col;
+}
+
+template<bool YAE>
+inline void calcColorsSSE2(const byte* __restrict vramPtr0,
+                           const byte* __restrict vramPtr1,
+                           uint16_t* __restrict out)
+{
+	// Interleaving the bytes of both planes gives the pixels in display
+	// order.
+	__m128i zero = _mm_setzero_si128();
+	auto* o = reinterpret_cast<__m128i*>(out);
+	for (unsigned i = 0; i < WIDTH / 32; ++i) {
+		__m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(vramPtr0) + i);
+		__m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(vramPtr1) + i);
+		__m128i lo = _mm_unpacklo_epi8(v0, v1);
+		__m128i hi = _mm_unpackhi_epi8(v0, v1);
+		_mm_storeu_si128(o + 4 * i + 0, calcColors8<YAE>(_mm_unpacklo_epi8(lo, zero)));
+		_mm_storeu_si128(o + 4 * i + 1, calcColors8<YAE>(_mm_unpackhi_epi8(lo, zero)));
+		_mm_storeu_si128(o + 4 * i + 2, calcColors8<YAE>(_mm_unpacklo_epi8(hi, zero)));
+		_mm_storeu_si128(o + 4 * i + 3, calcColors8<YAE>(_mm_unpackhi_epi8(hi, zero)));
+	}
+}
+#endif // __SSE2__
+
+template<bool YAE>
+inline void calcColors(const byte* __restrict vramPtr0,
+                       const byte* __restrict vramPtr1,
+                       uint16_t* __restrict out)
+{
+#ifdef __SSE2__
+	calcColorsSSE2<YAE>(vramPtr0, vramPtr1, out);
+#else
+	calcColorsScalar<YAE>(vramPtr0, vramPtr1, out);
+#endif
+}
+
+// Portable version.
+template<bool YAE, typename Pixel>
+inline void lookupScalar(const uint16_t* __restrict colors,
+                         Pixel* __restrict pixelPtr,
+                         const Pixel* __restrict palette16,
+                         const Pixel* __restrict palette32768)
+{
+	for (unsigned i = 0; i < WIDTH; ++i) {
+		unsigned c = colors[i];
+		if (YAE) {
+			// Both kinds of pixels are mixed arbitrarily, so avoid a
+			// (badly predictable) branch.
+			Pixel yae = palette16[c & 15];
+			Pixel yjk = palette32768[c & 0x7FFF];
+			Pixel mask = Pixel(0) - Pixel(c >> 15);
+			pixelPtr[i] = (yae & mask) | (yjk & ~mask);
+		} else {
+			pixelPtr[i] = palette32768[c];
+		}
+	}
+}
+
+#ifdef __AVX2__
+template<bool YAE>
+inline void lookupAVX2(const uint16_t* __restrict colors,
+                       uint32_t* __restrict pixelPtr,
+                       const uint32_t* __restrict palette16,
+                       const uint32_t* __restrict palette32768)
+{
+	auto* pal16    = reinterpret_cast<const int*>(palette16);
+	auto* pal32768 = reinterpret_cast<const int*>(palette32768);
+	for (unsigned i = 0; i < WIDTH; i += 8) {
+		__m256i c = _mm256_cvtepu16_epi32(_mm_loadu_si128(
+			reinterpret_cast<const __m128i*>(colors + i)));
+		__m256i idx = YAE ? _mm256_and_si256(c, _mm256_set1_epi32(0x7FFF)) : c;
+		__m256i pix = _mm256_i32gather_epi32(pal32768, idx, 4);
+		if (YAE) {
+			__m256i isYAE = _mm256_slli_epi32(c, 16); // sign bit
+			pix = _mm256_mask_i32gather_epi32(
+				pix, pal16, _mm256_and_si256(c, _mm256_set1_epi32(15)),
+				_mm256_srai_epi32(isYAE, 31), 4);
+		}
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pixelPtr + i), pix);
+	}
+}
+#endif // __AVX2__
+
+template<bool YAE, typename Pixel>
+inline void lookup(const uint16_t* __restrict colors,
+                   Pixel* __restrict pixelPtr,
+                   const Pixel* __restrict palette16,
+                   const Pixel* __restrict palette32768)
+{
+#ifdef __AVX2__
+	if constexpr (sizeof(Pixel) == 4) {
+		lookupAVX2<YAE>(colors, reinterpret_cast<uint32_t*>(pixelPtr),
+		                reinterpret_cast<const uint32_t*>(palette16),
+		                reinterpret_cast<const uint32_t*>(palette32768));
+		return;
+	}
+#endif
+	lookupScalar<YAE>(colors, pixelPtr, palette16, palette32768);
+}
+
+} // namespace openmsx::YJKConverter
+
+#endif
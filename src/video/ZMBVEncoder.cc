@@ -2,7 +2,9 @@
 
 #include "ZMBVEncoder.hh"
 #include "FrameSource.hh"
+#include "PerfCounters.hh"
 #include "PixelOperations.hh"
+#include "ThreadPool.hh"
 #include "endian.hh"
 #include "ranges.hh"
 #include "unreachable.hh"
@@ -10,6 +12,8 @@
 #include <cstdlib>
 #include <cstring>
 #include <cmath>
+#include <future>
+#include <vector>
 
 namespace openmsx {
 
@@ -114,8 +118,10 @@ static void createVectorTable()
 	ranges::sort(vectorTable);
 }
 
-ZMBVEncoder::ZMBVEncoder(unsigned width_, unsigned height_, unsigned bpp)
-	: width(width_)
+ZMBVEncoder::ZMBVEncoder(unsigned width_, unsigned height_, unsigned bpp,
+                         ThreadPool* threads_)
+	: threads(threads_)
+	, width(width_)
 	, height(height_)
 {
 	setupBuffers(bpp);
@@ -178,6 +184,7 @@ void ZMBVEncoder::setupBuffers(unsigned bpp)
 	unsigned xblocks = width / BLOCK_WIDTH;
 	unsigned yblocks = height / BLOCK_HEIGHT;
 	blockOffsets.resize(xblocks * yblocks);
+	rowUsed.resize(yblocks);
 	for (unsigned y = 0; y < yblocks; ++y) {
 		for (unsigned x = 0; x < xblocks; ++x) {
 			blockOffsets[y * xblocks + x] =
@@ -228,7 +235,8 @@ unsigned ZMBVEncoder::compareBlock(int vx, int vy, unsigned offset)
 
 template<class P>
 void ZMBVEncoder::addXorBlock(
-	const PixelOperations<P>& pixelOps, int vx, int vy, unsigned offset, unsigned& workUsed)
+	const PixelOperations<P>& pixelOps, int vx, int vy, unsigned offset,
+	uint8_t* out, unsigned& outUsed)
 {
 	using LE_P = typename Endian::Little<P>::type;
 
@@ -237,8 +245,8 @@ void ZMBVEncoder::addXorBlock(
 	for (unsigned y = 0; y < BLOCK_HEIGHT; ++y) {
 		for (unsigned x = 0; x < BLOCK_WIDTH; ++x) {
 			P pxor = pnew[x] ^ pold[x];
-			writePixel(pixelOps, pxor, *reinterpret_cast<LE_P*>(&work[workUsed]));
-			workUsed += sizeof(P);
+			writePixel(pixelOps, pxor, *reinterpret_cast<LE_P*>(&out[outUsed]));
+			outUsed += sizeof(P);
 		}
 		pold += pitch;
 		pnew += pitch;
@@ -246,21 +254,21 @@ void ZMBVEncoder::addXorBlock(
 }
 
 template<class P>
-void ZMBVEncoder::addXorFrame(const PixelFormat& pixelFormat, unsigned& workUsed)
+void ZMBVEncoder::addXorRow(
+	const PixelOperations<P>& pixelOps, unsigned row,
+	int8_t* vectors, uint8_t* rowWork, unsigned& used)
 {
-	PixelOperations<P> pixelOps(pixelFormat);
-	auto* vectors = reinterpret_cast<int8_t*>(&work[workUsed]);
-
+	// Only reads oldframe/newframe and only writes to this row's part of
+	// the work buffer, so different rows can be handled in parallel.
 	unsigned xblocks = width / BLOCK_WIDTH;
-	unsigned yblocks = height / BLOCK_HEIGHT;
-	unsigned blockcount = xblocks * yblocks;
-
-	// Align the following xor data on 4 byte boundary
-	workUsed = (workUsed + blockcount * 2 + 3) & ~3;
+	used = 0;
 
+	// Each row starts from the zero vector (instead of from the last
+	// vector of the previous row), that makes the result independent of
+	// how the rows are distributed over the threads.
 	int bestvx = 0;
 	int bestvy = 0;
-	for (unsigned b = 0; b < blockcount; ++b) {
+	for (unsigned b = row * xblocks; b < (row + 1) * xblocks; ++b) {
 		unsigned offset = blockOffsets[b];
 		// first try best vector of previous block
 		unsigned bestchange = compareBlock<P>(bestvx, bestvy, offset);
@@ -284,8 +292,50 @@ void ZMBVEncoder::addXorFrame(const PixelFormat& pixelFormat, unsigned& workUsed
 		vectors[b * 2 + 1] = (bestvy << 1);
 		if (bestchange) {
 			vectors[b * 2 + 0] |= 1;
-			addXorBlock<P>(pixelOps, bestvx, bestvy, offset, workUsed);
+			addXorBlock<P>(pixelOps, bestvx, bestvy, offset, rowWork, used);
+		}
+	}
+}
+
+template<class P>
+void ZMBVEncoder::addXorFrame(const PixelFormat& pixelFormat, unsigned& workUsed)
+{
+	PixelOperations<P> pixelOps(pixelFormat);
+	auto* vectors = reinterpret_cast<int8_t*>(&work[workUsed]);
+
+	unsigned xblocks = width / BLOCK_WIDTH;
+	unsigned yblocks = height / BLOCK_HEIGHT;
+	unsigned blockcount = xblocks * yblocks;
+
+	// Align the following xor data on 4 byte boundary
+	workUsed = (workUsed + blockcount * 2 + 3) & ~3;
+
+	// Each row of blocks gets room for its worst case (all blocks
+	// changed) in the work buffer, afterwards the rows are moved together.
+	unsigned rowSize = xblocks * BLOCK_WIDTH * BLOCK_HEIGHT * sizeof(P);
+	auto* rowsStart = &work[workUsed];
+	auto doRow = [&](unsigned row) {
+		addXorRow<P>(pixelOps, row, vectors,
+		             rowsStart + row * rowSize, rowUsed[row]);
+	};
+	// The motion search (by far the most expensive part) is done for
+	// each row of blocks separately, those rows are distributed over
+	// the helper threads and this thread.
+	std::vector<std::future<void>> jobs;
+	if (threads) {
+		jobs.reserve(yblocks);
+		for (unsigned row = 1; row < yblocks; ++row) {
+			jobs.push_back(threads->submit([&, row] { doRow(row); }));
 		}
+		doRow(0);
+	} else {
+		for (unsigned row = 0; row < yblocks; ++row) doRow(row);
+	}
+	for (auto& job : jobs) job.get();
+
+	for (unsigned row = 0; row < yblocks; ++row) {
+		memmove(&work[workUsed], rowsStart + row * rowSize, rowUsed[row]);
+		workUsed += rowUsed[row];
 	}
 }
 
@@ -308,7 +358,7 @@ void ZMBVEncoder::addFullFrame(const PixelFormat& pixelFormat, unsigned& workUse
 	}
 }
 
-const void* ZMBVEncoder::getScaledLine(FrameSource* frame, unsigned y, void* workBuf_)
+const void* ZMBVEncoder::getScaledLine(FrameSource* frame, unsigned y, void* workBuf_) const
 {
 #if HAVE_32BPP
 	if (pixelSize == 4) { // 32bpp
@@ -344,9 +394,22 @@ const void* ZMBVEncoder::getScaledLine(FrameSource* frame, unsigned y, void* wor
 	return nullptr; // avoid warning
 }
 
-void ZMBVEncoder::compressFrame(bool keyFrame, FrameSource* frame,
+void ZMBVEncoder::copyFrame(FrameSource* frame, uint8_t* dest) const
+{
+	unsigned lineWidth = width * pixelSize;
+	for (unsigned i = 0; i < height; ++i) {
+		auto* scaled = getScaledLine(frame, i, dest);
+		if (scaled != dest) memcpy(dest, scaled, lineWidth);
+		dest += lineWidth;
+	}
+}
+
+void ZMBVEncoder::compressFrame(bool keyFrame, const uint8_t* pixels,
+                                const PixelFormat& pixelFormat,
                                 void*& buffer, unsigned& written)
 {
+	ScopedPerfTimer perfTimer(PerfCounter::ZMBV_ENCODER);
+
 	std::swap(newframe, oldframe); // replace oldframe with newframe
 
 	// Reset the work buffer
@@ -375,8 +438,8 @@ void ZMBVEncoder::compressFrame(bool keyFrame, FrameSource* frame,
 	uint8_t* dest =
 		&newframe[pixelSize * (MAX_VECTOR + MAX_VECTOR * pitch)];
 	for (unsigned i = 0; i < height; ++i) {
-		auto* scaled = getScaledLine(frame, i, dest);
-		if (scaled != dest) memcpy(dest, scaled, lineWidth);
+		memcpy(dest, pixels, lineWidth);
+		pixels += lineWidth;
 		dest += linePitch;
 	}
 
@@ -386,12 +449,12 @@ void ZMBVEncoder::compressFrame(bool keyFrame, FrameSource* frame,
 		switch (pixelSize) {
 #if HAVE_16BPP
 		case 2:
-			addFullFrame<uint16_t>(frame->getPixelFormat(), workUsed);
+			addFullFrame<uint16_t>(pixelFormat, workUsed);
 			break;
 #endif
 #if HAVE_32BPP
 		case 4:
-			addFullFrame<uint32_t>(frame->getPixelFormat(), workUsed);
+			addFullFrame<uint32_t>(pixelFormat, workUsed);
 			break;
 #endif
 		default:
@@ -402,12 +465,12 @@ void ZMBVEncoder::compressFrame(bool keyFrame, FrameSource* frame,
 		switch (pixelSize) {
 #if HAVE_16BPP
 		case 2:
-			addXorFrame<uint16_t>(frame->getPixelFormat(), workUsed);
+			addXorFrame<uint16_t>(pixelFormat, workUsed);
 			break;
 #endif
 #if HAVE_32BPP
 		case 4:
-			addXorFrame<uint32_t>(frame->getPixelFormat(), workUsed);
+			addXorFrame<uint32_t>(pixelFormat, workUsed);
 			break;
 #endif
 		default:
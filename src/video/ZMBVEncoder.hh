@@ -11,6 +11,7 @@
 namespace openmsx {
 
 class FrameSource;
+class ThreadPool;
 template<class P> class PixelOperations;
 
 class ZMBVEncoder
@@ -18,9 +19,28 @@ class ZMBVEncoder
 public:
 	static constexpr const char CODEC_4CC[5] = "ZMBV"; // 4 + zero-terminator
 
-	ZMBVEncoder(unsigned width, unsigned height, unsigned bpp);
+	/** @param threads Threads that help with the motion search, or
+	  *                nullptr to do everything in the calling thread. Not
+	  *                owned, must outlive this encoder.
+	  */
+	ZMBVEncoder(unsigned width, unsigned height, unsigned bpp,
+	            ThreadPool* threads);
 
-	void compressFrame(bool keyFrame, FrameSource* frame,
+	/** Size (in bytes) of the image captured by copyFrame(). */
+	unsigned getFrameSize() const { return width * height * pixelSize; }
+
+	/** Copy the (scaled) image from 'frame' to 'dest' (getFrameSize()
+	  * bytes). This is the only step that needs the FrameSource, so
+	  * compressFrame() can run later, possibly in another thread.
+	  */
+	void copyFrame(FrameSource* frame, uint8_t* dest) const;
+
+	/** Compress an image previously captured with copyFrame(). The
+	  * motion search is spread over the calling thread and the threads
+	  * passed to the constructor.
+	  */
+	void compressFrame(bool keyFrame, const uint8_t* pixels,
+	                   const PixelFormat& pixelFormat,
 	                   void*& buffer, unsigned& written);
 
 private:
@@ -33,20 +53,26 @@ private:
 	unsigned neededSize();
 	template<class P> void addFullFrame(const PixelFormat& pixelFormat, unsigned& workUsed);
 	template<class P> void addXorFrame (const PixelFormat& pixelFormat, unsigned& workUsed);
+	template<class P> void addXorRow(
+		const PixelOperations<P>& pixelOps, unsigned row,
+		int8_t* vectors, uint8_t* rowWork, unsigned& used);
 	template<class P> unsigned possibleBlock(int vx, int vy, unsigned offset);
 	template<class P> unsigned compareBlock(int vx, int vy, unsigned offset);
 	template<class P> void addXorBlock(
 		const PixelOperations<P>& pixelOps, int vx, int vy,
-		unsigned offset, unsigned& workUsed);
-	const void* getScaledLine(FrameSource* frame, unsigned y, void* workBuf);
+		unsigned offset, uint8_t* out, unsigned& outUsed);
+	const void* getScaledLine(FrameSource* frame, unsigned y, void* workBuf) const;
 
 	MemBuffer<uint8_t, SSE2_ALIGNMENT> oldframe;
 	MemBuffer<uint8_t, SSE2_ALIGNMENT> newframe;
 	MemBuffer<uint8_t, SSE2_ALIGNMENT> work;
 	MemBuffer<uint8_t> output;
 	MemBuffer<unsigned> blockOffsets;
+	MemBuffer<unsigned> rowUsed; // xor data per row of blocks, in bytes
 	unsigned outputSize;
 
+	ThreadPool* threads;
+
 	z_stream zstream;
 
 	const unsigned width;
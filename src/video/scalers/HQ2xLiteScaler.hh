@@ -11,6 +11,8 @@ class HQ2xLiteScaler final : public Scaler2<Pixel>
 public:
 	explicit HQ2xLiteScaler(const PixelOperations<Pixel>& pixelOps);
 
+	bool canScaleInBands() const override { return true; }
+
 	void scale1x1to3x2(FrameSource& src,
 		unsigned srcStartY, unsigned srcEndY, unsigned srcWidth,
 		ScalerOutput<Pixel>& dst, unsigned dstStartY, unsigned dstEndY) override;
@@ -12,6 +12,8 @@ class HQ3xLiteScaler final : public Scaler3<Pixel>
 public:
 	explicit HQ3xLiteScaler(const PixelOperations<Pixel>& pixelOps);
 
+	bool canScaleInBands() const override { return true; }
+
 	void scale2x1to9x3(FrameSource& src,
 		unsigned srcStartY, unsigned srcEndY, unsigned srcWidth,
 		ScalerOutput<Pixel>& dst, unsigned dstStartY, unsigned dstEndY) override;
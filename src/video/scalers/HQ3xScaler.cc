@@ -43,6 +43,9 @@ void HQ_1x1on3x3<Pixel>::operator()(
 	if (edgeOp(c5, c8)) pattern |= 3 <<  6;
 	if (edgeOp(c5, c2)) pattern |= 3 <<  9;
 
+	VLA_SSE_ALIGNED(unsigned, edges, srcWidth);
+	calcLineEdges(in1, in2, srcWidth, edges, edgeOp);
+
 	for (unsigned x = 0; x < srcWidth; ++x) {
 		c1 = c2; c4 = c5; c7 = c8;
 		c2 = c3; c5 = c6; c8 = c9;
@@ -60,11 +63,12 @@ void HQ_1x1on3x3<Pixel>::operator()(
 		// overlaps with top and left
 		//if (edgeOp(c5, c1)) pattern |= 1 <<  3; //     l: c2-c6 9,  t: c4-c8 0
 		//if (edgeOp(c4, c2)) pattern |= 1 <<  4; //     l: c5-c3 10, t: c5-c7 1
-		// non-overlapping pixels
-		if (edgeOp(c5, c8)) pattern |= 1 <<  5; // B
-		if (edgeOp(c5, c9)) pattern |= 1 <<  6; // BR
-		if (edgeOp(c6, c8)) pattern |= 1 <<  7; // BR
-		if (edgeOp(c5, c6)) pattern |= 1 <<  8; // R
+		// non-overlapping pixels, see calcLineEdges()
+		//if (edgeOp(c5, c8)) pattern |= 1 <<  5; // B
+		//if (edgeOp(c5, c9)) pattern |= 1 <<  6; // BR
+		//if (edgeOp(c6, c8)) pattern |= 1 <<  7; // BR
+		//if (edgeOp(c5, c6)) pattern |= 1 <<  8; // R
+		pattern |= edges[x];
 		// overlaps with top
 		//if (edgeOp(c2, c6)) pattern |= 1 <<  9; // R - t: c5-c9 6
 		//if (edgeOp(c5, c3)) pattern |= 1 << 10; // R - t: c6-c8 7
@@ -14,6 +14,8 @@ class HQ3xScaler final : public Scaler3<Pixel>
 public:
 	explicit HQ3xScaler(const PixelOperations<Pixel>& pixelOps);
 
+	bool canScaleInBands() const override { return true; }
+
 	void scale2x1to9x3(FrameSource& src,
 		unsigned srcStartY, unsigned srcEndY, unsigned srcWidth,
 		ScalerOutput<Pixel>& dst, unsigned dstStartY, unsigned dstEndY) override;
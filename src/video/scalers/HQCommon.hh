@@ -10,6 +10,12 @@
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 namespace openmsx {
 
@@ -74,6 +80,60 @@ public:
 
 		return false;
 	}
+
+	// Same as above, but for 4 (SSE2) or 8 (AVX2) pairs of pixels at once.
+	// The result has all bits set for the pairs that have an edge.
+#ifdef __SSE2__
+	inline __m128i operator()(__m128i c1, __m128i c2) const
+	{
+		__m128i mask = _mm_set1_epi32(0xFF);
+		auto comp = [&](__m128i c, unsigned shift) {
+			return _mm_and_si128(
+				_mm_srl_epi32(c, _mm_cvtsi32_si128(shift)), mask);
+		};
+		auto outside = [](__m128i d, int limit) {
+			return _mm_or_si128(
+				_mm_cmpgt_epi32(d, _mm_set1_epi32( limit)),
+				_mm_cmplt_epi32(d, _mm_set1_epi32(-limit)));
+		};
+		__m128i dr = _mm_sub_epi32(comp(c1, shiftR), comp(c2, shiftR));
+		__m128i dg = _mm_sub_epi32(comp(c1, shiftG), comp(c2, shiftG));
+		__m128i db = _mm_sub_epi32(comp(c1, shiftB), comp(c2, shiftB));
+		__m128i dy = _mm_add_epi32(_mm_add_epi32(dr, dg), db);
+		__m128i du = _mm_sub_epi32(dr, db);
+		__m128i dv = _mm_sub_epi32(
+			_mm_add_epi32(_mm_add_epi32(dg, dg), dg), dy);
+		return _mm_or_si128(_mm_or_si128(outside(dy, 0xC0),
+		                                 outside(du, 0x1C)),
+		                    outside(dv, 0x30));
+	}
+#endif
+#ifdef __AVX2__
+	inline __m256i operator()(__m256i c1, __m256i c2) const
+	{
+		__m256i mask = _mm256_set1_epi32(0xFF);
+		auto comp = [&](__m256i c, unsigned shift) {
+			return _mm256_and_si256(
+				_mm256_srl_epi32(c, _mm_cvtsi32_si128(shift)), mask);
+		};
+		auto outside = [](__m256i d, int limit) {
+			return _mm256_or_si256(
+				_mm256_cmpgt_epi32(d, _mm256_set1_epi32( limit)),
+				_mm256_cmpgt_epi32(_mm256_set1_epi32(-limit), d));
+		};
+		__m256i dr = _mm256_sub_epi32(comp(c1, shiftR), comp(c2, shiftR));
+		__m256i dg = _mm256_sub_epi32(comp(c1, shiftG), comp(c2, shiftG));
+		__m256i db = _mm256_sub_epi32(comp(c1, shiftB), comp(c2, shiftB));
+		__m256i dy = _mm256_add_epi32(_mm256_add_epi32(dr, dg), db);
+		__m256i du = _mm256_sub_epi32(dr, db);
+		__m256i dv = _mm256_sub_epi32(
+			_mm256_add_epi32(_mm256_add_epi32(dg, dg), dg), dy);
+		return _mm256_or_si256(_mm256_or_si256(outside(dy, 0xC0),
+		                                       outside(du, 0x1C)),
+		                       outside(dv, 0x30));
+	}
+#endif
+
 private:
 	const unsigned shiftR;
 	const unsigned shiftG;
@@ -92,6 +152,114 @@ EdgeHQ createEdgeHQ(const PixelOperations<Pixel>& pixelOps)
 	}
 }
 
+/** Detect the edges between the pixels of line 'curr' and their right and
+  * bottom neighbours (on line 'next') for a whole line at once. The HQ
+  * scalers need these edges in this part of their pattern:
+  *   bit 5: curr[x]     - next[x]     (bottom)
+  *   bit 6: curr[x]     - next[x + 1] (bottom-right)
+  *   bit 7: curr[x + 1] - next[x]     (bottom-left, seen from x + 1)
+  *   bit 8: curr[x]     - curr[x + 1] (right)
+  * For the last pixel on the line, 'x + 1' is the pixel itself.
+  */
+template <typename Pixel>
+static void calcLineEdgesScalar(
+	const Pixel* __restrict curr, const Pixel* __restrict next,
+	unsigned srcWidth, unsigned* __restrict edges, EdgeHQ edgeOp)
+{
+	for (unsigned x = 0; x < srcWidth; ++x) {
+		unsigned x1 = std::min(x + 1, srcWidth - 1);
+		uint32_t c5 = readPixel(curr[x]);
+		uint32_t c6 = readPixel(curr[x1]);
+		uint32_t c8 = readPixel(next[x]);
+		uint32_t c9 = readPixel(next[x1]);
+		unsigned pattern = 0;
+		if (edgeOp(c5, c8)) pattern |= 1 << 5;
+		if (edgeOp(c5, c9)) pattern |= 1 << 6;
+		if (edgeOp(c6, c8)) pattern |= 1 << 7;
+		if (edgeOp(c5, c6)) pattern |= 1 << 8;
+		edges[x] = pattern;
+	}
+}
+
+#ifdef __SSE2__
+static inline void calcLineEdgesSSE2(
+	const uint32_t* __restrict curr, const uint32_t* __restrict next,
+	unsigned srcWidth, unsigned* __restrict edges, EdgeHQ edgeOp)
+{
+	// Process 4 pixels at once (also needs the pixel right of those),
+	// the remaining pixels are done by the scalar version.
+	__m128i m = _mm_set1_epi32(0xF8F8F8F8); // see readPixel()
+	auto load = [&](const uint32_t* p) {
+		return _mm_and_si128(
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), m);
+	};
+	unsigned x = 0;
+	for (/**/; (x + 4) < srcWidth; x += 4) {
+		__m128i c5 = load(curr + x);
+		__m128i c6 = load(curr + x + 1);
+		__m128i c8 = load(next + x);
+		__m128i c9 = load(next + x + 1);
+		__m128i pattern = _mm_or_si128(
+			_mm_or_si128(
+				_mm_and_si128(edgeOp(c5, c8), _mm_set1_epi32(1 << 5)),
+				_mm_and_si128(edgeOp(c5, c9), _mm_set1_epi32(1 << 6))),
+			_mm_or_si128(
+				_mm_and_si128(edgeOp(c6, c8), _mm_set1_epi32(1 << 7)),
+				_mm_and_si128(edgeOp(c5, c6), _mm_set1_epi32(1 << 8))));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(edges + x), pattern);
+	}
+	calcLineEdgesScalar(curr + x, next + x, srcWidth - x, edges + x, edgeOp);
+}
+#endif
+
+#ifdef __AVX2__
+static inline void calcLineEdgesAVX2(
+	const uint32_t* __restrict curr, const uint32_t* __restrict next,
+	unsigned srcWidth, unsigned* __restrict edges, EdgeHQ edgeOp)
+{
+	// Same as the SSE2 version, but 8 pixels at once.
+	__m256i m = _mm256_set1_epi32(0xF8F8F8F8); // see readPixel()
+	auto load = [&](const uint32_t* p) {
+		return _mm256_and_si256(
+			_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), m);
+	};
+	unsigned x = 0;
+	for (/**/; (x + 8) < srcWidth; x += 8) {
+		__m256i c5 = load(curr + x);
+		__m256i c6 = load(curr + x + 1);
+		__m256i c8 = load(next + x);
+		__m256i c9 = load(next + x + 1);
+		__m256i pattern = _mm256_or_si256(
+			_mm256_or_si256(
+				_mm256_and_si256(edgeOp(c5, c8), _mm256_set1_epi32(1 << 5)),
+				_mm256_and_si256(edgeOp(c5, c9), _mm256_set1_epi32(1 << 6))),
+			_mm256_or_si256(
+				_mm256_and_si256(edgeOp(c6, c8), _mm256_set1_epi32(1 << 7)),
+				_mm256_and_si256(edgeOp(c5, c6), _mm256_set1_epi32(1 << 8))));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(edges + x), pattern);
+	}
+	calcLineEdgesSSE2(curr + x, next + x, srcWidth - x, edges + x, edgeOp);
+}
+#endif
+
+template <typename Pixel>
+static inline void calcLineEdges(
+	const Pixel* __restrict curr, const Pixel* __restrict next,
+	unsigned srcWidth, unsigned* __restrict edges, EdgeHQ edgeOp)
+{
+	// The SIMD versions only handle 32bpp pixels.
+	if constexpr (sizeof(Pixel) == 4) {
+#if defined(__AVX2__)
+		calcLineEdgesAVX2(curr, next, srcWidth, edges, edgeOp);
+		return;
+#elif defined(__SSE2__)
+		calcLineEdgesSSE2(curr, next, srcWidth, edges, edgeOp);
+		return;
+#endif
+	}
+	calcLineEdgesScalar(curr, next, srcWidth, edges, edgeOp);
+}
+
 struct EdgeHQLite
 {
 	inline bool operator()(uint32_t c1, uint32_t c2) const
@@ -30,6 +30,15 @@ public:
 	virtual void scaleImage(FrameSource& src, const RawFrame* superImpose,
 		unsigned srcStartY, unsigned srcEndY, unsigned srcWidth,
 		ScalerOutput<Pixel>& dst, unsigned dstStartY, unsigned dstEndY) = 0;
+
+	/** Can an area be split into horizontal bands that are scaled
+	  * concurrently (each band with its own ScalerOutput)? This requires
+	  * that scaleImage() doesn't modify any member variables and that the
+	  * result for a line only depends on a few neighbouring source lines
+	  * (also those outside the given area), so that the result is the same
+	  * as when the whole area is scaled at once.
+	  */
+	virtual bool canScaleInBands() const { return false; }
 };
 
 } // namespace openmsx
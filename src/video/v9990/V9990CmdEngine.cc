@@ -1,4 +1,5 @@
 #include "V9990CmdEngine.hh"
+#include "V9990CmdModes.hh"
 #include "V9990.hh"
 #include "V9990VRAM.hh"
 #include "V9990DisplayTiming.hh"
@@ -6,7 +7,6 @@
 #include "RenderSettings.hh"
 #include "BooleanSetting.hh"
 #include "EnumSetting.hh"
-#include "MemBuffer.hh"
 #include "Clock.hh"
 #include "serialize.hh"
 #include "likely.hh"
@@ -94,607 +94,19 @@ static EmuDuration getTiming(const V9990CmdEngine& cmdEngine, const EDStorage ta
 
 
 
-// Lazily initialized LUT to speed up logical operations:
-//  - 1st index is the mode: 2,4,8 bpp or 'not-transparent'
-//  - 2nd index is the logical operation: one of the 16 possible binary functions
-// * Each entry contains a 256x256 byte array, that array is indexed using
-//   destination and source byte (in that order).
-// * A fully populated logOpLUT would take 4MB, however the vast majority of
-//   this table is (almost) never used. So we save quite some memory (and
-//   startup time) by lazily initializing this table.
-static MemBuffer<byte> logOpLUT[4][16];
-static byte bitLUT[8][16][2][2]; // to speedup calculating logOpLUT
-
-enum { LOG_NO_T, LOG_BPP2, LOG_BPP4, LOG_BPP8 };
-
-static void initBitTab()
-{
-	for (unsigned op = 0; op < 16; ++op) {
-		unsigned tmp = op;
-		for (unsigned src = 0; src < 2; ++src) {
-			for (unsigned dst = 0; dst < 2; ++dst) {
-				unsigned b = tmp & 1;
-				for (unsigned bit = 0; bit < 8; ++bit) {
-					bitLUT[bit][op][src][dst] = b << bit;
-				}
-				tmp >>= 1;
-			}
-		}
-	}
-}
-
-static inline byte func01(unsigned op, unsigned src, unsigned dst)
-{
-	if ((src & 0x03) == 0) return dst & 0x03;
-	byte res = 0;
-	res |= bitLUT[0][op][(src & 0x01) >> 0][(dst & 0x01) >> 0];
-	res |= bitLUT[1][op][(src & 0x02) >> 1][(dst & 0x02) >> 1];
-	return res;
-}
-static inline byte func23(unsigned op, unsigned src, unsigned dst)
-{
-	if ((src & 0x0C) == 0) return dst & 0x0C;
-	byte res = 0;
-	res |= bitLUT[2][op][(src & 0x04) >> 2][(dst & 0x04) >> 2];
-	res |= bitLUT[3][op][(src & 0x08) >> 3][(dst & 0x08) >> 3];
-	return res;
-}
-static inline byte func45(unsigned op, unsigned src, unsigned dst)
-{
-	if ((src & 0x30) == 0) return dst & 0x30;
-	byte res = 0;
-	res |= bitLUT[4][op][(src & 0x10) >> 4][(dst & 0x10) >> 4];
-	res |= bitLUT[5][op][(src & 0x20) >> 5][(dst & 0x20) >> 5];
-	return res;
-}
-static inline byte func67(unsigned op, unsigned src, unsigned dst)
-{
-	if ((src & 0xC0) == 0) return dst & 0xC0;
-	byte res = 0;
-	res |= bitLUT[6][op][(src & 0x40) >> 6][(dst & 0x40) >> 6];
-	res |= bitLUT[7][op][(src & 0x80) >> 7][(dst & 0x80) >> 7];
-	return res;
-}
-
-static inline byte func03(unsigned op, unsigned src, unsigned dst)
-{
-	if ((src & 0x0F) == 0) return dst & 0x0F;
-	byte res = 0;
-	res |= bitLUT[0][op][(src & 0x01) >> 0][(dst & 0x01) >> 0];
-	res |= bitLUT[1][op][(src & 0x02) >> 1][(dst & 0x02) >> 1];
-	res |= bitLUT[2][op][(src & 0x04) >> 2][(dst & 0x04) >> 2];
-	res |= bitLUT[3][op][(src & 0x08) >> 3][(dst & 0x08) >> 3];
-	return res;
-}
-static inline byte func47(unsigned op, unsigned src, unsigned dst)
-{
-	if ((src & 0xF0) == 0) return dst & 0xF0;
-	byte res = 0;
-	res |= bitLUT[4][op][(src & 0x10) >> 4][(dst & 0x10) >> 4];
-	res |= bitLUT[5][op][(src & 0x20) >> 5][(dst & 0x20) >> 5];
-	res |= bitLUT[6][op][(src & 0x40) >> 6][(dst & 0x40) >> 6];
-	res |= bitLUT[7][op][(src & 0x80) >> 7][(dst & 0x80) >> 7];
-	return res;
-}
-
-static inline byte func07(unsigned op, unsigned src, unsigned dst)
-{
-	// if (src == 0) return dst;  // handled in fillTable8
-	byte res = 0;
-	res |= bitLUT[0][op][(src & 0x01) >> 0][(dst & 0x01) >> 0];
-	res |= bitLUT[1][op][(src & 0x02) >> 1][(dst & 0x02) >> 1];
-	res |= bitLUT[2][op][(src & 0x04) >> 2][(dst & 0x04) >> 2];
-	res |= bitLUT[3][op][(src & 0x08) >> 3][(dst & 0x08) >> 3];
-	res |= bitLUT[4][op][(src & 0x10) >> 4][(dst & 0x10) >> 4];
-	res |= bitLUT[5][op][(src & 0x20) >> 5][(dst & 0x20) >> 5];
-	res |= bitLUT[6][op][(src & 0x40) >> 6][(dst & 0x40) >> 6];
-	res |= bitLUT[7][op][(src & 0x80) >> 7][(dst & 0x80) >> 7];
-	return res;
-}
-
-static void fillTableNoT(unsigned op, byte* table)
-{
-	for (unsigned dst = 0; dst < 256; ++dst) {
-		for (unsigned src = 0; src < 256; ++src) {
-			table[dst * 256 + src] = func07(op, src, dst);
-		}
-	}
-}
-
-static void fillTable2(unsigned op, byte* table)
-{
-	for (unsigned dst = 0; dst < 256; ++dst) {
-		for (unsigned src = 0; src < 256; ++src) {
-			byte res = 0;
-			res |= func01(op, src, dst);
-			res |= func23(op, src, dst);
-			res |= func45(op, src, dst);
-			res |= func67(op, src, dst);
-			table[dst * 256 + src] = res;
-		}
-	}
-}
-
-static void fillTable4(unsigned op, byte* table)
-{
-	for (unsigned dst = 0; dst < 256; ++dst) {
-		for (unsigned src = 0; src < 256; ++src) {
-			byte res = 0;
-			res |= func03(op, src, dst);
-			res |= func47(op, src, dst);
-			table[dst * 256 + src] = res;
-		}
-	}
-}
-
-static void fillTable8(unsigned op, byte* table)
-{
-	for (unsigned dst = 0; dst < 256; ++dst) {
-		{ // src == 0
-			table[dst * 256 + 0  ] = dst;
-		}
-		for (unsigned src = 1; src < 256; ++src) { // src != 0
-			table[dst * 256 + src] = func07(op, src, dst);
-		}
-	}
-}
-
-static const byte* getLogOpImpl(unsigned mode, unsigned op)
-{
-	op &= 0x0f;
-	if (!logOpLUT[mode][op].data()) {
-		logOpLUT[mode][op].resize(256 * 256);
-		switch (mode) {
-		case LOG_NO_T:
-			fillTableNoT(op, logOpLUT[mode][op].data());
-			break;
-		case LOG_BPP2:
-			fillTable2  (op, logOpLUT[mode][op].data());
-			break;
-		case LOG_BPP4:
-			fillTable4  (op, logOpLUT[mode][op].data());
-			break;
-		case LOG_BPP8:
-			fillTable8  (op, logOpLUT[mode][op].data());
-			break;
-		default:
-			UNREACHABLE;
-		}
-	}
-	return logOpLUT[mode][op].data();
-}
-
-
-constexpr byte DIY = 0x08;
-constexpr byte DIX = 0x04;
-constexpr byte NEQ = 0x02;
-constexpr byte MAJ = 0x01;
-
-// P1 --------------------------------------------------------------
-inline unsigned V9990CmdEngine::V9990P1::getPitch(unsigned width)
-{
-	return width / 2;
-}
-
-inline unsigned V9990CmdEngine::V9990P1::addressOf(
-	unsigned x, unsigned y, unsigned pitch)
-{
-	//return V9990VRAM::transformP1(((x / 2) & (pitch - 1)) + y * pitch) & 0x7FFFF;
-	// TODO figure out exactly how the coordinate system maps to vram in P1
-	unsigned addr = V9990VRAM::transformP1(((x / 2) & (pitch - 1)) + y * pitch);
-	return (addr & 0x3FFFF) | ((x & 0x200) << 9);
-}
-
-inline byte V9990CmdEngine::V9990P1::point(
-	V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch)
-{
-	return vram.readVRAMDirect(addressOf(x, y, pitch));
-}
-
-inline byte V9990CmdEngine::V9990P1::shift(
-	byte value, unsigned fromX, unsigned toX)
-{
-	int shift = 4 * ((toX & 1) - (fromX & 1));
-	return (shift > 0) ? (value >> shift) : (value << -shift);
-}
-
-inline byte V9990CmdEngine::V9990P1::shiftMask(unsigned x)
-{
-	return (x & 1) ? 0x0F : 0xF0;
-}
-
-inline const byte* V9990CmdEngine::V9990P1::getLogOpLUT(byte op)
-{
-	return getLogOpImpl((op & 0x10) ? LOG_BPP4 : LOG_NO_T, op);
-}
-
-inline byte V9990CmdEngine::V9990P1::logOp(
-	const byte* lut, byte src, byte dst)
-{
-	return lut[256 * dst + src];
-}
-
-inline void V9990CmdEngine::V9990P1::pset(
-	V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch,
-	byte srcColor, word mask, const byte* lut, byte /*op*/)
-{
-	unsigned addr = addressOf(x, y, pitch);
-	byte dstColor = vram.readVRAMDirect(addr);
-	byte newColor = logOp(lut, srcColor, dstColor);
-	byte mask1 = (addr & 0x40000) ? (mask >> 8) : (mask & 0xFF);
-	byte mask2 = mask1 & shiftMask(x);
-	byte result = (dstColor & ~mask2) | (newColor & mask2);
-	vram.writeVRAMDirect(addr, result);
-}
-inline void V9990CmdEngine::V9990P1::psetColor(
-	V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch,
-	word color, word mask, const byte* lut, byte /*op*/)
-{
-	unsigned addr = addressOf(x, y, pitch);
-	byte srcColor = (addr & 0x40000) ? (color >> 8) : (color & 0xFF);
-	byte dstColor = vram.readVRAMDirect(addr);
-	byte newColor = logOp(lut, srcColor, dstColor);
-	byte mask1 = (addr & 0x40000) ? (mask >> 8) : (mask & 0xFF);
-	byte mask2 = mask1 & (0xF0 >> (4 * (x & 1)));
-	byte result = (dstColor & ~mask2) | (newColor & mask2);
-	vram.writeVRAMDirect(addr, result);
-}
-
-// P2 --------------------------------------------------------------
-inline unsigned V9990CmdEngine::V9990P2::getPitch(unsigned width)
-{
-	return width / 2;
-}
-
-inline unsigned V9990CmdEngine::V9990P2::addressOf(
-	unsigned x, unsigned y, unsigned pitch)
-{
-	// TODO check
-	return V9990VRAM::transformP2(((x / 2) & (pitch - 1)) + y * pitch) & 0x7FFFF;
-}
-
-inline byte V9990CmdEngine::V9990P2::point(
-	V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch)
-{
-	return vram.readVRAMDirect(addressOf(x, y, pitch));
-}
-
-inline byte V9990CmdEngine::V9990P2::shift(
-	byte value, unsigned fromX, unsigned toX)
-{
-	int shift = 4 * ((toX & 1) - (fromX & 1));
-	return (shift > 0) ? (value >> shift) : (value << -shift);
-}
-
-inline byte V9990CmdEngine::V9990P2::shiftMask(unsigned x)
-{
-	return (x & 1) ? 0x0F : 0xF0;
-}
-
-inline const byte* V9990CmdEngine::V9990P2::getLogOpLUT(byte op)
-{
-	return getLogOpImpl((op & 0x10) ? LOG_BPP4 : LOG_NO_T, op);
-}
-
-inline byte V9990CmdEngine::V9990P2::logOp(
-	const byte* lut, byte src, byte dst)
-{
-	return lut[256 * dst + src];
-}
-
-inline void V9990CmdEngine::V9990P2::pset(
-	V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch,
-	byte srcColor, word mask, const byte* lut, byte /*op*/)
-{
-	unsigned addr = addressOf(x, y, pitch);
-	byte dstColor = vram.readVRAMDirect(addr);
-	byte newColor = logOp(lut, srcColor, dstColor);
-	byte mask1 = (addr & 0x40000) ? (mask >> 8) : (mask & 0xFF);
-	byte mask2 = mask1 & shiftMask(x);
-	byte result = (dstColor & ~mask2) | (newColor & mask2);
-	vram.writeVRAMDirect(addr, result);
-}
-
-inline void V9990CmdEngine::V9990P2::psetColor(
-	V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch,
-	word color, word mask, const byte* lut, byte /*op*/)
-{
-	unsigned addr = addressOf(x, y, pitch);
-	byte srcColor = (addr & 0x40000) ? (color >> 8) : (color & 0xFF);
-	byte dstColor = vram.readVRAMDirect(addr);
-	byte newColor = logOp(lut, srcColor, dstColor);
-	byte mask1 = (addr & 0x40000) ? (mask >> 8) : (mask & 0xFF);
-	byte mask2 = mask1 & (0xF0 >> (4 * (x & 1)));
-	byte result = (dstColor & ~mask2) | (newColor & mask2);
-	vram.writeVRAMDirect(addr, result);
-}
-
-// 2 bpp --------------------------------------------------------------
-inline unsigned V9990CmdEngine::V9990Bpp2::getPitch(unsigned width)
-{
-	return width / 4;
-}
-
-inline unsigned V9990CmdEngine::V9990Bpp2::addressOf(
-	unsigned x, unsigned y, unsigned pitch)
-{
-	return V9990VRAM::transformBx(((x / 4) & (pitch - 1)) + y * pitch) & 0x7FFFF;
-}
-
-inline byte V9990CmdEngine::V9990Bpp2::point(
-	V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch)
-{
-	return vram.readVRAMDirect(addressOf(x, y, pitch));
-}
-
-inline byte V9990CmdEngine::V9990Bpp2::shift(
-	byte value, unsigned fromX, unsigned toX)
-{
-	int shift = 2 * ((toX & 3) - (fromX & 3));
-	return (shift > 0) ? (value >> shift) : (value << -shift);
-}
-
-inline byte V9990CmdEngine::V9990Bpp2::shiftMask(unsigned x)
-{
-	return 0xC0 >> (2 * (x & 3));
-}
-
-inline const byte* V9990CmdEngine::V9990Bpp2::getLogOpLUT(byte op)
-{
-	return getLogOpImpl((op & 0x10) ? LOG_BPP2 : LOG_NO_T, op);
-}
-
-inline byte V9990CmdEngine::V9990Bpp2::logOp(
-	const byte* lut, byte src, byte dst)
-{
-	return lut[256 * dst + src];
-}
-
-inline void V9990CmdEngine::V9990Bpp2::pset(
-	V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch,
-	byte srcColor, word mask, const byte* lut, byte /*op*/)
-{
-	unsigned addr = addressOf(x, y, pitch);
-	byte dstColor = vram.readVRAMDirect(addr);
-	byte newColor = logOp(lut, srcColor, dstColor);
-	byte mask1 = (addr & 0x40000) ? (mask >> 8) : (mask & 0xFF);
-	byte mask2 = mask1 & shiftMask(x);
-	byte result = (dstColor & ~mask2) | (newColor & mask2);
-	vram.writeVRAMDirect(addr, result);
-}
-
-inline void V9990CmdEngine::V9990Bpp2::psetColor(
-	V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch,
-	word color, word mask, const byte* lut, byte /*op*/)
-{
-	unsigned addr = addressOf(x, y, pitch);
-	byte srcColor = (addr & 0x40000) ? (color >> 8) : (color & 0xFF);
-	byte dstColor = vram.readVRAMDirect(addr);
-	byte newColor = logOp(lut, srcColor, dstColor);
-	byte mask1 = (addr & 0x40000) ? (mask >> 8) : (mask & 0xFF);
-	byte mask2 = mask1 & (0xC0 >> (2 * (x & 3)));
-	byte result = (dstColor & ~mask2) | (newColor & mask2);
-	vram.writeVRAMDirect(addr, result);
-}
-
-// 4 bpp --------------------------------------------------------------
-inline unsigned V9990CmdEngine::V9990Bpp4::getPitch(unsigned width)
-{
-	return width / 2;
-}
-
-inline unsigned V9990CmdEngine::V9990Bpp4::addressOf(
-	unsigned x, unsigned y, unsigned pitch)
-{
-	return V9990VRAM::transformBx(((x / 2) & (pitch - 1)) + y * pitch) & 0x7FFFF;
-}
-
-inline byte V9990CmdEngine::V9990Bpp4::point(
-	V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch)
-{
-	return vram.readVRAMDirect(addressOf(x, y, pitch));
-}
-
-inline byte V9990CmdEngine::V9990Bpp4::shift(
-	byte value, unsigned fromX, unsigned toX)
-{
-	int shift = 4 * ((toX & 1) - (fromX & 1));
-	return (shift > 0) ? (value >> shift) : (value << -shift);
-}
-
-inline byte V9990CmdEngine::V9990Bpp4::shiftMask(unsigned x)
-{
-	return (x & 1) ? 0x0F : 0xF0;
-}
-
-inline const byte* V9990CmdEngine::V9990Bpp4::getLogOpLUT(byte op)
-{
-	return getLogOpImpl((op & 0x10) ? LOG_BPP4 : LOG_NO_T, op);
-}
-
-inline byte V9990CmdEngine::V9990Bpp4::logOp(
-	const byte* lut, byte src, byte dst)
-{
-	return lut[256 * dst + src];
-}
-
-inline void V9990CmdEngine::V9990Bpp4::pset(
-	V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch,
-	byte srcColor, word mask, const byte* lut, byte /*op*/)
-{
-	unsigned addr = addressOf(x, y, pitch);
-	byte dstColor = vram.readVRAMDirect(addr);
-	byte newColor = logOp(lut, srcColor, dstColor);
-	byte mask1 = (addr & 0x40000) ? (mask >> 8) : (mask & 0xFF);
-	byte mask2 = mask1 & shiftMask(x);
-	byte result = (dstColor & ~mask2) | (newColor & mask2);
-	vram.writeVRAMDirect(addr, result);
-}
-
-inline void V9990CmdEngine::V9990Bpp4::psetColor(
-	V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch,
-	word color, word mask, const byte* lut, byte /*op*/)
-{
-	unsigned addr = addressOf(x, y, pitch);
-	byte srcColor = (addr & 0x40000) ? (color >> 8) : (color & 0xFF);
-	byte dstColor = vram.readVRAMDirect(addr);
-	byte newColor = logOp(lut, srcColor, dstColor);
-	byte mask1 = (addr & 0x40000) ? (mask >> 8) : (mask & 0xFF);
-	byte mask2 = mask1 & (0xF0 >> (4 * (x & 1)));
-	byte result = (dstColor & ~mask2) | (newColor & mask2);
-	vram.writeVRAMDirect(addr, result);
-}
-
-// 8 bpp --------------------------------------------------------------
-inline unsigned V9990CmdEngine::V9990Bpp8::getPitch(unsigned width)
-{
-	return width;
-}
-
-inline unsigned V9990CmdEngine::V9990Bpp8::addressOf(
-	unsigned x, unsigned y, unsigned pitch)
-{
-	return V9990VRAM::transformBx((x & (pitch - 1)) + y * pitch) & 0x7FFFF;
-}
-
-inline byte V9990CmdEngine::V9990Bpp8::point(
-	V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch)
-{
-	return vram.readVRAMDirect(addressOf(x, y, pitch));
-}
-
-inline byte V9990CmdEngine::V9990Bpp8::shift(
-	byte value, unsigned /*fromX*/, unsigned /*toX*/)
-{
-	return value;
-}
-
-inline byte V9990CmdEngine::V9990Bpp8::shiftMask(unsigned /*x*/)
-{
-	return 0xFF;
-}
-
-inline const byte* V9990CmdEngine::V9990Bpp8::getLogOpLUT(byte op)
-{
-	return getLogOpImpl((op & 0x10) ? LOG_BPP8 : LOG_NO_T, op);
-}
-
-inline byte V9990CmdEngine::V9990Bpp8::logOp(
-	const byte* lut, byte src, byte dst)
-{
-	return lut[256 * dst + src];
-}
-
-inline void V9990CmdEngine::V9990Bpp8::pset(
-	V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch,
-	byte srcColor, word mask, const byte* lut, byte /*op*/)
-{
-	unsigned addr = addressOf(x, y, pitch);
-	byte dstColor = vram.readVRAMDirect(addr);
-	byte newColor = logOp(lut, srcColor, dstColor);
-	byte mask1 = (addr & 0x40000) ? (mask >> 8) : (mask & 0xFF);
-	byte result = (dstColor & ~mask1) | (newColor & mask1);
-	vram.writeVRAMDirect(addr, result);
-}
-
-inline void V9990CmdEngine::V9990Bpp8::psetColor(
-	V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch,
-	word color, word mask, const byte* lut, byte /*op*/)
-{
-	unsigned addr = addressOf(x, y, pitch);
-	byte srcColor = (addr & 0x40000) ? (color >> 8) : (color & 0xFF);
-	byte dstColor = vram.readVRAMDirect(addr);
-	byte newColor = logOp(lut, srcColor, dstColor);
-	byte mask1 = (addr & 0x40000) ? (mask >> 8) : (mask & 0xFF);
-	byte result = (dstColor & ~mask1) | (newColor & mask1);
-	vram.writeVRAMDirect(addr, result);
-}
-
-// 16 bpp -------------------------------------------------------------
-inline unsigned V9990CmdEngine::V9990Bpp16::getPitch(unsigned width)
-{
-	//return width * 2;
-	return width;
-}
-
-inline unsigned V9990CmdEngine::V9990Bpp16::addressOf(
-	unsigned x, unsigned y, unsigned pitch)
-{
-	//return V9990VRAM::transformBx(((x * 2) & (pitch - 1)) + y * pitch) & 0x7FFFF;
-	return ((x & (pitch - 1)) + y * pitch) & 0x3FFFF;
-}
-
-inline word V9990CmdEngine::V9990Bpp16::point(
-	V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch)
-{
-	unsigned addr = addressOf(x, y, pitch);
-	return vram.readVRAMDirect(addr + 0x00000) +
-	       vram.readVRAMDirect(addr + 0x40000) * 256;
-}
-
-inline word V9990CmdEngine::V9990Bpp16::shift(
-	word value, unsigned /*fromX*/, unsigned /*toX*/)
-{
-	return value;
-}
-
-inline word V9990CmdEngine::V9990Bpp16::shiftMask(unsigned /*x*/)
-{
-	return 0xFFFF;
-}
-
-inline const byte* V9990CmdEngine::V9990Bpp16::getLogOpLUT(byte op)
-{
-	return getLogOpImpl(LOG_NO_T, op);
-}
-
-inline word V9990CmdEngine::V9990Bpp16::logOp(
-	const byte* lut, word src, word dst, bool transp)
-{
-	if (transp && (src == 0)) return dst;
-	return (lut[((dst & 0x00FF) << 8) + ((src & 0x00FF) >> 0)] << 0) +
-	       (lut[((dst & 0xFF00) << 0) + ((src & 0xFF00) >> 8)] << 8);
-}
-
-inline void V9990CmdEngine::V9990Bpp16::pset(
-	V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch,
-	word srcColor, word mask, const byte* lut, byte op)
-{
-	unsigned addr = addressOf(x, y, pitch);
-	word dstColor = vram.readVRAMDirect(addr + 0x00000) +
-	                vram.readVRAMDirect(addr + 0x40000) * 256;
-	word newColor = logOp(lut, srcColor, dstColor, (op & 0x10) != 0);
-	word result = (dstColor & ~mask) | (newColor & mask);
-	vram.writeVRAMDirect(addr + 0x00000, result & 0xFF);
-	vram.writeVRAMDirect(addr + 0x40000, result >> 8);
-}
-
-inline void V9990CmdEngine::V9990Bpp16::psetColor(
-	V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch,
-	word srcColor, word mask, const byte* lut, byte op)
-{
-	unsigned addr = addressOf(x, y, pitch);
-	word dstColor = vram.readVRAMDirect(addr + 0x00000) +
-	                vram.readVRAMDirect(addr + 0x40000) * 256;
-	word newColor = logOp(lut, srcColor, dstColor, (op & 0x10) != 0);
-	word result = (dstColor & ~mask) | (newColor & mask);
-	vram.writeVRAMDirect(addr + 0x00000, result & 0xFF);
-	vram.writeVRAMDirect(addr + 0x40000, result >> 8);
-}
-
 // ====================================================================
 /** Constructor
   */
 V9990CmdEngine::V9990CmdEngine(V9990& vdp_, EmuTime::param time_,
                                RenderSettings& settings_)
-	: settings(settings_), vdp(vdp_), vram(vdp.getVRAM()), engineTime(time_)
+	: V9990CmdState(time_)
+	, settings(settings_), vdp(vdp_), vram(vdp.getVRAM())
 {
 	cmdTraceSetting = vdp.getMotherBoard().getSharedStuff<BooleanSetting>(
 		"v9990cmdtrace",
 		vdp.getCommandController(), "v9990cmdtrace",
 		"V9990 command tracing on/off", false);
 
-	initBitTab();
 
 	auto& cmdTimingSetting = settings.getCmdTimingSetting();
 	update(cmdTimingSetting);
@@ -961,7 +373,7 @@ void V9990CmdEngine::startLMMC16(EmuTime::param time)
 }
 
 template<>
-void V9990CmdEngine::executeLMMC<V9990CmdEngine::V9990Bpp16>(EmuTime::param limit)
+void V9990CmdEngine::executeLMMC<V9990Bpp16>(EmuTime::param limit)
 {
 	if (!(status & TR)) {
 		status |= TR;
@@ -1028,28 +440,9 @@ void V9990CmdEngine::startLMMV(EmuTime::param time)
 template<typename Mode>
 void V9990CmdEngine::executeLMMV(EmuTime::param limit)
 {
-	// TODO can be optimized a lot
-
-	auto delta = getTiming(*this, LMMV_TIMING);
-	unsigned pitch = Mode::getPitch(vdp.getImageWidth());
-	int dx = (ARG & DIX) ? -1 : 1;
-	int dy = (ARG & DIY) ? -1 : 1;
-	const byte* lut = Mode::getLogOpLUT(LOG);
-	while (engineTime < limit) {
-		engineTime += delta;
-		Mode::psetColor(vram, DX, DY, pitch, fgCol, WM, lut, LOG);
-
-		DX += dx;
-		if (!--(ANX)) {
-			DX -= (NX * dx);
-			DY += dy;
-			if (!--(ANY)) {
-				cmdReady(engineTime);
-				return;
-			} else {
-				ANX = getWrappedNX();
-			}
-		}
+	if (runLMMV<Mode>(vram, Mode::getPitch(vdp.getImageWidth()),
+	                  getTiming(*this, LMMV_TIMING), limit)) {
+		cmdReady(engineTime);
 	}
 }
 
@@ -1120,33 +513,9 @@ void V9990CmdEngine::startLMMM(EmuTime::param time)
 template<typename Mode>
 void V9990CmdEngine::executeLMMM(EmuTime::param limit)
 {
-	// TODO can be optimized a lot
-
-	auto delta = getTiming(*this, LMMM_TIMING);
-	unsigned pitch = Mode::getPitch(vdp.getImageWidth());
-	int dx = (ARG & DIX) ? -1 : 1;
-	int dy = (ARG & DIY) ? -1 : 1;
-	const byte* lut = Mode::getLogOpLUT(LOG);
-	while (engineTime < limit) {
-		engineTime += delta;
-		auto src = Mode::point(vram, SX, SY, pitch);
-		src = Mode::shift(src, SX, DX);
-		Mode::pset(vram, DX, DY, pitch, src, WM, lut, LOG);
-
-		DX += dx;
-		SX += dx;
-		if (!--(ANX)) {
-			DX -= (NX * dx);
-			SX -= (NX * dx);
-			DY += dy;
-			SY += dy;
-			if (!--(ANY)) {
-				cmdReady(engineTime);
-				return;
-			} else {
-				ANX = getWrappedNX();
-			}
-		}
+	if (runLMMM<Mode>(vram, Mode::getPitch(vdp.getImageWidth()),
+	                  getTiming(*this, LMMM_TIMING), limit)) {
+		cmdReady(engineTime);
 	}
 }
 
@@ -1258,62 +627,12 @@ void V9990CmdEngine::startBMXL(EmuTime::param time)
 	ANY = getWrappedNY();
 }
 
-template<>
-void V9990CmdEngine::executeBMXL<V9990CmdEngine::V9990Bpp16>(EmuTime::param limit)
-{
-	// timing value is times 2, because it does 2 bytes per iteration:
-	auto delta = getTiming(*this, BMXL_TIMING) * 2;
-	unsigned pitch = V9990Bpp16::getPitch(vdp.getImageWidth());
-	int dx = (ARG & DIX) ? -1 : 1;
-	int dy = (ARG & DIY) ? -1 : 1;
-	const byte* lut = V9990Bpp16::getLogOpLUT(LOG);
-
-	while (engineTime < limit) {
-		engineTime += delta;
-		word src = vram.readVRAMBx(srcAddress + 0) +
-		           vram.readVRAMBx(srcAddress + 1) * 256;
-		srcAddress += 2;
-		V9990Bpp16::pset(vram, DX, DY, pitch, src, WM, lut, LOG);
-		DX += dx;
-		if (!--(ANX)) {
-			DX -= (NX * dx);
-			DY += dy;
-			if (!--(ANY)) {
-				cmdReady(engineTime);
-				return;
-			} else {
-				ANX = getWrappedNX();
-			}
-		}
-	}
-}
-
 template<typename Mode>
 void V9990CmdEngine::executeBMXL(EmuTime::param limit)
 {
-	auto delta = getTiming(*this, BMXL_TIMING);
-	unsigned pitch = Mode::getPitch(vdp.getImageWidth());
-	int dx = (ARG & DIX) ? -1 : 1;
-	int dy = (ARG & DIY) ? -1 : 1;
-	const byte* lut = Mode::getLogOpLUT(LOG);
-
-	while (engineTime < limit) {
-		engineTime += delta;
-		byte d = vram.readVRAMBx(srcAddress++);
-		for (int i = 0; (ANY > 0) && (i < Mode::PIXELS_PER_BYTE); ++i) {
-			Mode::pset(vram, DX, DY, pitch, d, WM, lut, LOG);
-			DX += dx;
-			if (!--(ANX)) {
-				DX -= (NX * dx);
-				DY += dy;
-				if (!--(ANY)) {
-					cmdReady(engineTime);
-					return;
-				} else {
-					ANX = getWrappedNX();
-				}
-			}
-		}
+	if (runBMXL<Mode>(vram, Mode::getPitch(vdp.getImageWidth()),
+	                  getTiming(*this, BMXL_TIMING), limit)) {
+		cmdReady(engineTime);
 	}
 }
 
@@ -1326,62 +645,12 @@ void V9990CmdEngine::startBMLX(EmuTime::param time)
 	ANY = getWrappedNY();
 }
 
-template<>
-void V9990CmdEngine::executeBMLX<V9990CmdEngine::V9990Bpp16>(EmuTime::param limit)
-{
-	// TODO test corner cases, timing
-	auto delta = getTiming(*this, BMLX_TIMING);
-	unsigned pitch = V9990Bpp16::getPitch(vdp.getImageWidth());
-	int dx = (ARG & DIX) ? -1 : 1;
-	int dy = (ARG & DIY) ? -1 : 1;
-
-	while (engineTime < limit) {
-		engineTime += delta;
-		auto src = V9990Bpp16::point(vram, SX, SY, pitch);
-		vram.writeVRAMBx(dstAddress++, src & 0xFF);
-		vram.writeVRAMBx(dstAddress++, src >> 8);
-		SX += dx;
-		if (!--(ANX)) {
-			SX -= (NX * dx);
-			SY += dy;
-			if (!--(ANY)) {
-				cmdReady(engineTime);
-				return;
-			} else {
-				ANX = getWrappedNX();
-			}
-		}
-	}
-}
 template<typename Mode>
 void V9990CmdEngine::executeBMLX(EmuTime::param limit)
 {
-	// TODO test corner cases, timing
-	auto delta = getTiming(*this, BMLX_TIMING);
-	unsigned pitch = Mode::getPitch(vdp.getImageWidth());
-	int dx = (ARG & DIX) ? -1 : 1;
-	int dy = (ARG & DIY) ? -1 : 1;
-
-	while (engineTime < limit) {
-		engineTime += delta;
-		byte d = 0;
-		for (int i = 0; i < Mode::PIXELS_PER_BYTE; ++i) {
-			auto src = Mode::point(vram, SX, SY, pitch);
-			d |= Mode::shift(src, SX, i) & Mode::shiftMask(i);
-			SX += dx;
-			if (!--(ANX)) {
-				SX -= (NX * dx);
-				SY += dy;
-				if (!--(ANY)) {
-					vram.writeVRAMBx(dstAddress++, d);
-					cmdReady(engineTime);
-					return;
-				} else {
-					ANX = getWrappedNX();
-				}
-			}
-		}
-		vram.writeVRAMBx(dstAddress++, d);
+	if (runBMLX<Mode>(vram, Mode::getPitch(vdp.getImageWidth()),
+	                  getTiming(*this, BMLX_TIMING), limit)) {
+		cmdReady(engineTime);
 	}
 }
 
@@ -1406,56 +675,11 @@ void V9990CmdEngine::startBMLL16(EmuTime::param time)
 	nbBytes    >>= 1;
 }
 
-template<>
-void V9990CmdEngine::executeBMLL<V9990CmdEngine::V9990Bpp16>(EmuTime::param limit)
-{
-	// TODO DIX DIY?
-	// timing value is times 2, because it does 2 bytes per iteration:
-	auto delta = getTiming(*this, BMLL_TIMING) * 2;
-	const byte* lut = V9990Bpp16::getLogOpLUT(LOG);
-	bool transp = (LOG & 0x10) != 0;
-	while (engineTime < limit) {
-		engineTime += delta;
-		// VRAM always mapped as in Bx modes
-		word srcColor = vram.readVRAMDirect(srcAddress + 0x00000) +
-		                vram.readVRAMDirect(srcAddress + 0x40000) * 256;
-		word dstColor = vram.readVRAMDirect(dstAddress + 0x00000) +
-		                vram.readVRAMDirect(dstAddress + 0x40000) * 256;
-		word newColor = V9990Bpp16::logOp(lut, srcColor, dstColor, transp);
-		word result = (dstColor & ~WM) | (newColor & WM);
-		vram.writeVRAMDirect(dstAddress + 0x00000, result & 0xFF);
-		vram.writeVRAMDirect(dstAddress + 0x40000, result >> 8);
-		srcAddress = (srcAddress + 1) & 0x3FFFF;
-		dstAddress = (dstAddress + 1) & 0x3FFFF;
-		if (!--nbBytes) {
-			cmdReady(engineTime);
-			return;
-		}
-	}
-}
-
 template<typename Mode>
 void V9990CmdEngine::executeBMLL(EmuTime::param limit)
 {
-	// TODO DIX DIY?
-	auto delta = getTiming(*this, BMLL_TIMING);
-	const byte* lut = Mode::getLogOpLUT(LOG);
-	while (engineTime < limit) {
-		engineTime += delta;
-		// VRAM always mapped as in Bx modes
-		byte srcColor = vram.readVRAMBx(srcAddress);
-		unsigned addr = V9990VRAM::transformBx(dstAddress);
-		byte dstColor = vram.readVRAMDirect(addr);
-		byte newColor = Mode::logOp(lut, srcColor, dstColor);
-		byte mask = (addr & 0x40000) ? (WM >> 8) : (WM & 0xFF);
-		byte result = (dstColor & ~mask) | (newColor & mask);
-		vram.writeVRAMDirect(addr, result);
-		srcAddress = (srcAddress + 1) & 0x7FFFF;
-		dstAddress = (dstAddress + 1) & 0x7FFFF;
-		if (!--nbBytes) {
-			cmdReady(engineTime);
-			return;
-		}
+	if (runBMLL<Mode>(vram, getTiming(*this, BMLL_TIMING), limit)) {
+		cmdReady(engineTime);
 	}
 }
 
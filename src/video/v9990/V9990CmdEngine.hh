@@ -6,6 +6,7 @@
 #include "EmuTime.hh"
 #include "serialize_meta.hh"
 #include "openmsx.hh"
+#include <initializer_list>
 
 namespace openmsx {
 
@@ -15,9 +16,121 @@ class Setting;
 class RenderSettings;
 class BooleanSetting;
 
+/** The registers and counters of the command engine, and the commands that
+  * only transfer pixels within VRAM (LMMV, LMMM, BMXL, BMLX and BMLL).
+  * These commands don't need the V9990 itself, only (something that acts
+  * like) V9990VRAM, so that they can be tested on their own. They are
+  * defined in V9990CmdModes.hh.
+  */
+class V9990CmdState
+{
+public:
+	// ARG bits
+	static constexpr byte DIY = 0x08;
+	static constexpr byte DIX = 0x04;
+	static constexpr byte NEQ = 0x02;
+	static constexpr byte MAJ = 0x01;
+
+	explicit V9990CmdState(EmuTime::param time) : engineTime(time) {}
+
+	/** Execute the command until 'limit' (or until it's done), using
+	  * the given VRAM, line pitch (see Mode::getPitch()) and the time it
+	  * takes per pixel (per byte in BMXL and BMLL).
+	  * @return Is the command done?
+	  */
+	template<typename Mode, typename VRAM>
+	bool runLMMV(VRAM& vram, unsigned pitch, EmuDuration::param delta,
+	             EmuTime::param limit);
+	template<typename Mode, typename VRAM>
+	bool runLMMM(VRAM& vram, unsigned pitch, EmuDuration::param delta,
+	             EmuTime::param limit);
+	template<typename Mode, typename VRAM>
+	bool runBMXL(VRAM& vram, unsigned pitch, EmuDuration::param delta,
+	             EmuTime::param limit);
+	template<typename Mode, typename VRAM>
+	bool runBMLX(VRAM& vram, unsigned pitch, EmuDuration::param delta,
+	             EmuTime::param limit);
+	template<typename Mode, typename VRAM>
+	bool runBMLL(VRAM& vram, EmuDuration::param delta,
+	             EmuTime::param limit);
+
+	EmuTime engineTime;
+
+	/** VRAM read/write address for various commands
+	  */
+	unsigned srcAddress;
+	unsigned dstAddress;
+	unsigned nbBytes;
+
+	/** counters
+	  */
+	word ASX, ADX, ANX, ANY;
+
+	/** Command parameters
+	  */
+	word SX, SY, DX, DY, NX, NY;
+	word WM, fgCol, bgCol;
+	byte ARG, LOG, CMD;
+
+	inline unsigned getWrappedNX() const {
+		return NX ? NX : 2048;
+	}
+	inline unsigned getWrappedNY() const {
+		return NY ? NY : 4096;
+	}
+
+private:
+	template<typename VRAM>
+	bool runBMXL16(VRAM& vram, unsigned pitch, EmuDuration::param timing,
+	               EmuTime::param limit);
+	template<typename VRAM>
+	bool runBMLX16(VRAM& vram, unsigned pitch, EmuDuration::param delta,
+	               EmuTime::param limit);
+	template<typename VRAM>
+	bool runBMLL16(VRAM& vram, EmuDuration::param timing,
+	               EmuTime::param limit);
+
+	// Only try the bulk path for at least this many pixels or bytes.
+	static constexpr unsigned BULK_MIN = 8;
+
+	// The logical operation that simply copies the source (no
+	// transparency).
+	static constexpr byte LOG_IMP = 0x0C;
+
+	// Number of pixels in a unit of a bulk run: a byte, or in 16bpp a
+	// pixel. Of such a pixel the low byte is at 'addr' and the high byte
+	// at 'addr+0x40000'.
+	template<typename Mode>
+	static constexpr unsigned BULK_PIXELS =
+		Mode::PIXELS_PER_BYTE ? Mode::PIXELS_PER_BYTE : 1;
+
+	static inline unsigned bulkSteps(
+		EmuTime::param time, EmuTime::param limit,
+		EmuDuration::param delta, unsigned max);
+	template<typename Mode>
+	static inline unsigned bulkPixels(unsigned x, int dx, unsigned max);
+	template<typename Mode>
+	static inline int bulkLineAddress(
+		unsigned x, unsigned y, int dx, unsigned num, unsigned pitch);
+	static inline unsigned bulkDistance(unsigned a, unsigned b);
+	template<typename Mode>
+	static inline void bulkCopy(
+		byte* data, unsigned src, unsigned dst, unsigned num,
+		byte op, word mask);
+	template<typename Mode>
+	static inline void bulkFill(
+		byte* data, unsigned dst, unsigned num,
+		byte op, word color, word mask);
+	static inline bool bulkLinear16(
+		unsigned addr, unsigned num, unsigned& lo, unsigned& hi);
+	static inline unsigned bulkDisjoint(
+		unsigned num, std::initializer_list<unsigned> src,
+		std::initializer_list<unsigned> dst);
+};
+
 /** Command engine.
   */
-class V9990CmdEngine final : private Observer<Setting>
+class V9990CmdEngine final : private Observer<Setting>, private V9990CmdState
 {
 public:
 	// status bits
@@ -95,132 +208,6 @@ public:
 	void serialize(Archive& ar, unsigned version);
 
 private:
-	class V9990P1 {
-	public:
-		using Type = byte;
-		static constexpr word BITS_PER_PIXEL  = 4;
-		static constexpr word PIXELS_PER_BYTE = 2;
-		static inline unsigned getPitch(unsigned width);
-		static inline unsigned addressOf(unsigned x, unsigned y, unsigned pitch);
-		static inline byte point(V9990VRAM& vram,
-		                         unsigned x, unsigned y, unsigned pitch);
-		static inline byte shift(byte value, unsigned fromX, unsigned toX);
-		static inline byte shiftMask(unsigned x);
-		static inline const byte* getLogOpLUT(byte op);
-		static inline byte logOp(const byte* lut, byte src, byte dst);
-		static inline void pset(
-			V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch,
-			byte srcColor, word mask, const byte* lut, byte op);
-		static inline void psetColor(
-			V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch,
-			word color, word mask, const byte* lut, byte op);
-	};
-
-	class V9990P2 {
-	public:
-		using Type = byte;
-		static constexpr word BITS_PER_PIXEL  = 4;
-		static constexpr word PIXELS_PER_BYTE = 2;
-		static inline unsigned getPitch(unsigned width);
-		static inline unsigned addressOf(unsigned x, unsigned y, unsigned pitch);
-		static inline byte point(V9990VRAM& vram,
-		                         unsigned x, unsigned y, unsigned pitch);
-		static inline byte shift(byte value, unsigned fromX, unsigned toX);
-		static inline byte shiftMask(unsigned x);
-		static inline const byte* getLogOpLUT(byte op);
-		static inline byte logOp(const byte* lut, byte src, byte dst);
-		static inline void pset(
-			V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch,
-			byte srcColor, word mask, const byte* lut, byte op);
-		static inline void psetColor(
-			V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch,
-			word color, word mask, const byte* lut, byte op);
-	};
-
-	class V9990Bpp2 {
-	public:
-		using Type = byte;
-		static constexpr word BITS_PER_PIXEL  = 2;
-		static constexpr word PIXELS_PER_BYTE = 4;
-		static inline unsigned getPitch(unsigned width);
-		static inline unsigned addressOf(unsigned x, unsigned y, unsigned pitch);
-		static inline byte point(V9990VRAM& vram,
-		                         unsigned x, unsigned y, unsigned pitch);
-		static inline byte shift(byte value, unsigned fromX, unsigned toX);
-		static inline byte shiftMask(unsigned x);
-		static inline const byte* getLogOpLUT(byte op);
-		static inline byte logOp(const byte* lut, byte src, byte dst);
-		static inline void pset(
-			V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch,
-			byte srcColor, word mask, const byte* lut, byte op);
-		static inline void psetColor(
-			V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch,
-			word color, word mask, const byte* lut, byte op);
-	};
-
-	class V9990Bpp4 {
-	public:
-		using Type = byte;
-		static constexpr word BITS_PER_PIXEL  = 4;
-		static constexpr word PIXELS_PER_BYTE = 2;
-		static inline unsigned getPitch(unsigned width);
-		static inline unsigned addressOf(unsigned x, unsigned y, unsigned pitch);
-		static inline byte point(V9990VRAM& vram,
-		                         unsigned x, unsigned y, unsigned pitch);
-		static inline byte shift(byte value, unsigned fromX, unsigned toX);
-		static inline byte shiftMask(unsigned x);
-		static inline const byte* getLogOpLUT(byte op);
-		static inline byte logOp(const byte* lut, byte src, byte dst);
-		static inline void pset(
-			V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch,
-			byte srcColor, word mask, const byte* lut, byte op);
-		static inline void psetColor(
-			V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch,
-			word color, word mask, const byte* lut, byte op);
-	};
-
-	class V9990Bpp8 {
-	public:
-		using Type = byte;
-		static constexpr word BITS_PER_PIXEL  = 8;
-		static constexpr word PIXELS_PER_BYTE = 1;
-		static inline unsigned getPitch(unsigned width);
-		static inline unsigned addressOf(unsigned x, unsigned y, unsigned pitch);
-		static inline byte point(V9990VRAM& vram,
-		                         unsigned x, unsigned y, unsigned pitch);
-		static inline byte shift(byte value, unsigned fromX, unsigned toX);
-		static inline byte shiftMask(unsigned x);
-		static inline const byte* getLogOpLUT(byte op);
-		static inline byte logOp(const byte* lut, byte src, byte dst);
-		static inline void pset(
-			V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch,
-			byte srcColor, word mask, const byte* lut, byte op);
-		static inline void psetColor(
-			V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch,
-			word color, word mask, const byte* lut, byte op);
-	};
-
-	class V9990Bpp16 {
-	public:
-		using Type = word;
-		static constexpr word BITS_PER_PIXEL  = 16;
-		static constexpr word PIXELS_PER_BYTE = 0;
-		static inline unsigned getPitch(unsigned width);
-		static inline unsigned addressOf(unsigned x, unsigned y, unsigned pitch);
-		static inline word point(V9990VRAM& vram,
-		                         unsigned x, unsigned y, unsigned pitch);
-		static inline word shift(word value, unsigned fromX, unsigned toX);
-		static inline word shiftMask(unsigned x);
-		static inline const byte* getLogOpLUT(byte op);
-		static inline word logOp(const byte* lut, word src, word dst, bool transp);
-		static inline void pset(
-			V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch,
-			word srcColor, word mask, const byte* lut, byte op);
-		static inline void psetColor(
-			V9990VRAM& vram, unsigned x, unsigned y, unsigned pitch,
-			word color, word mask, const byte* lut, byte op);
-	};
-
 	void startSTOP  (EmuTime::param time);
 	void startLMMC  (EmuTime::param time);
 	void startLMMC16(EmuTime::param time);
@@ -269,28 +256,10 @@ private:
 	V9990& vdp;
 	V9990VRAM& vram;
 
-	EmuTime engineTime;
-
-	/** VRAM read/write address for various commands
-	  */
-	unsigned srcAddress;
-	unsigned dstAddress;
-	unsigned nbBytes;
-
 	/** The X coord of a border detected by SRCH
 	 */
 	word borderX;
 
-	/** counters
-	  */
-	word ASX, ADX, ANX, ANY;
-
-	/** Command parameters
-	  */
-	word SX, SY, DX, DY, NX, NY;
-	word WM, fgCol, bgCol;
-	byte ARG, LOG, CMD;
-
 	unsigned cmdMode; // TODO keep this up-to-date (now it's calculated at the start of a command)
 
 	/** Status bits
@@ -329,13 +298,6 @@ private:
 	void update(const Setting& setting) override;
 
 	void setCommandMode();
-
-	inline unsigned getWrappedNX() const {
-		return NX ? NX : 2048;
-	}
-	inline unsigned getWrappedNY() const {
-		return NY ? NY : 4096;
-	}
 };
 SERIALIZE_CLASS_VERSION(V9990CmdEngine, 2);
 
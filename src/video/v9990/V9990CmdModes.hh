@@ -0,0 +1,1169 @@
+#ifndef V9990CMDMODES_HH
+#define V9990CMDMODES_HH
+
+#include "V9990CmdEngine.hh"
+#include "V9990LogOp.hh"
+#include "V9990VRAM.hh"
+#include "EmuDuration.hh"
+#include "EmuTime.hh"
+#include "openmsx.hh"
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+
+// The display modes of the V9990 command engine, and the commands that only
+// transfer pixels within VRAM (see V9990CmdState). These are only used by
+// V9990CmdEngine (and the unit tests). 'VRAM' is V9990VRAM, or something
+// with the same read/write methods.
+
+namespace openmsx {
+
+// P1 --------------------------------------------------------------
+struct V9990P1 {
+	using Type = byte;
+	static constexpr word BITS_PER_PIXEL  = 4;
+	static constexpr word PIXELS_PER_BYTE = 2;
+	static constexpr bool BITMAP          = false;
+	static inline unsigned getPitch(unsigned width);
+	static inline unsigned addressOf(unsigned x, unsigned y, unsigned pitch);
+	template<typename VRAM>
+	static inline byte point(VRAM& vram,
+	                         unsigned x, unsigned y, unsigned pitch);
+	static inline byte shift(byte value, unsigned fromX, unsigned toX);
+	static inline byte shiftMask(unsigned x);
+	static inline const byte* getLogOpLUT(byte op);
+	static inline byte logOp(const byte* lut, byte src, byte dst);
+	template<typename VRAM>
+	static inline void pset(
+		VRAM& vram, unsigned x, unsigned y, unsigned pitch,
+		byte srcColor, word mask, const byte* lut, byte op);
+	template<typename VRAM>
+	static inline void psetColor(
+		VRAM& vram, unsigned x, unsigned y, unsigned pitch,
+		word color, word mask, const byte* lut, byte op);
+};
+
+inline unsigned V9990P1::getPitch(unsigned width)
+{
+	return width / 2;
+}
+
+inline unsigned V9990P1::addressOf(
+	unsigned x, unsigned y, unsigned pitch)
+{
+	//return V9990VRAM::transformP1(((x / 2) & (pitch - 1)) + y * pitch) & 0x7FFFF;
+	// TODO figure out exactly how the coordinate system maps to vram in P1
+	unsigned addr = V9990VRAM::transformP1(((x / 2) & (pitch - 1)) + y * pitch);
+	return (addr & 0x3FFFF) | ((x & 0x200) << 9);
+}
+
+template<typename VRAM>
+inline byte V9990P1::point(
+	VRAM& vram, unsigned x, unsigned y, unsigned pitch)
+{
+	return vram.readVRAMDirect(addressOf(x, y, pitch));
+}
+
+inline byte V9990P1::shift(
+	byte value, unsigned fromX, unsigned toX)
+{
+	int shift = 4 * ((toX & 1) - (fromX & 1));
+	return (shift > 0) ? (value >> shift) : (value << -shift);
+}
+
+inline byte V9990P1::shiftMask(unsigned x)
+{
+	return (x & 1) ? 0x0F : 0xF0;
+}
+
+inline const byte* V9990P1::getLogOpLUT(byte op)
+{
+	using namespace V9990LogOp;
+	return getLUT((op & 0x10) ? LOG_BPP4 : LOG_NO_T, op);
+}
+
+inline byte V9990P1::logOp(
+	const byte* lut, byte src, byte dst)
+{
+	return lut[256 * dst + src];
+}
+
+template<typename VRAM>
+inline void V9990P1::pset(
+	VRAM& vram, unsigned x, unsigned y, unsigned pitch,
+	byte srcColor, word mask, const byte* lut, byte /*op*/)
+{
+	unsigned addr = addressOf(x, y, pitch);
+	byte dstColor = vram.readVRAMDirect(addr);
+	byte newColor = logOp(lut, srcColor, dstColor);
+	byte mask1 = (addr & 0x40000) ? (mask >> 8) : (mask & 0xFF);
+	byte mask2 = mask1 & shiftMask(x);
+	byte result = (dstColor & ~mask2) | (newColor & mask2);
+	vram.writeVRAMDirect(addr, result);
+}
+template<typename VRAM>
+inline void V9990P1::psetColor(
+	VRAM& vram, unsigned x, unsigned y, unsigned pitch,
+	word color, word mask, const byte* lut, byte /*op*/)
+{
+	unsigned addr = addressOf(x, y, pitch);
+	byte srcColor = (addr & 0x40000) ? (color >> 8) : (color & 0xFF);
+	byte dstColor = vram.readVRAMDirect(addr);
+	byte newColor = logOp(lut, srcColor, dstColor);
+	byte mask1 = (addr & 0x40000) ? (mask >> 8) : (mask & 0xFF);
+	byte mask2 = mask1 & (0xF0 >> (4 * (x & 1)));
+	byte result = (dstColor & ~mask2) | (newColor & mask2);
+	vram.writeVRAMDirect(addr, result);
+}
+
+// P2 --------------------------------------------------------------
+struct V9990P2 {
+	using Type = byte;
+	static constexpr word BITS_PER_PIXEL  = 4;
+	static constexpr word PIXELS_PER_BYTE = 2;
+	static constexpr bool BITMAP          = false;
+	static inline unsigned getPitch(unsigned width);
+	static inline unsigned addressOf(unsigned x, unsigned y, unsigned pitch);
+	template<typename VRAM>
+	static inline byte point(VRAM& vram,
+	                         unsigned x, unsigned y, unsigned pitch);
+	static inline byte shift(byte value, unsigned fromX, unsigned toX);
+	static inline byte shiftMask(unsigned x);
+	static inline const byte* getLogOpLUT(byte op);
+	static inline byte logOp(const byte* lut, byte src, byte dst);
+	template<typename VRAM>
+	static inline void pset(
+		VRAM& vram, unsigned x, unsigned y, unsigned pitch,
+		byte srcColor, word mask, const byte* lut, byte op);
+	template<typename VRAM>
+	static inline void psetColor(
+		VRAM& vram, unsigned x, unsigned y, unsigned pitch,
+		word color, word mask, const byte* lut, byte op);
+};
+
+inline unsigned V9990P2::getPitch(unsigned width)
+{
+	return width / 2;
+}
+
+inline unsigned V9990P2::addressOf(
+	unsigned x, unsigned y, unsigned pitch)
+{
+	// TODO check
+	return V9990VRAM::transformP2(((x / 2) & (pitch - 1)) + y * pitch) & 0x7FFFF;
+}
+
+template<typename VRAM>
+inline byte V9990P2::point(
+	VRAM& vram, unsigned x, unsigned y, unsigned pitch)
+{
+	return vram.readVRAMDirect(addressOf(x, y, pitch));
+}
+
+inline byte V9990P2::shift(
+	byte value, unsigned fromX, unsigned toX)
+{
+	int shift = 4 * ((toX & 1) - (fromX & 1));
+	return (shift > 0) ? (value >> shift) : (value << -shift);
+}
+
+inline byte V9990P2::shiftMask(unsigned x)
+{
+	return (x & 1) ? 0x0F : 0xF0;
+}
+
+inline const byte* V9990P2::getLogOpLUT(byte op)
+{
+	using namespace V9990LogOp;
+	return getLUT((op & 0x10) ? LOG_BPP4 : LOG_NO_T, op);
+}
+
+inline byte V9990P2::logOp(
+	const byte* lut, byte src, byte dst)
+{
+	return lut[256 * dst + src];
+}
+
+template<typename VRAM>
+inline void V9990P2::pset(
+	VRAM& vram, unsigned x, unsigned y, unsigned pitch,
+	byte srcColor, word mask, const byte* lut, byte /*op*/)
+{
+	unsigned addr = addressOf(x, y, pitch);
+	byte dstColor = vram.readVRAMDirect(addr);
+	byte newColor = logOp(lut, srcColor, dstColor);
+	byte mask1 = (addr & 0x40000) ? (mask >> 8) : (mask & 0xFF);
+	byte mask2 = mask1 & shiftMask(x);
+	byte result = (dstColor & ~mask2) | (newColor & mask2);
+	vram.writeVRAMDirect(addr, result);
+}
+
+template<typename VRAM>
+inline void V9990P2::psetColor(
+	VRAM& vram, unsigned x, unsigned y, unsigned pitch,
+	word color, word mask, const byte* lut, byte /*op*/)
+{
+	unsigned addr = addressOf(x, y, pitch);
+	byte srcColor = (addr & 0x40000) ? (color >> 8) : (color & 0xFF);
+	byte dstColor = vram.readVRAMDirect(addr);
+	byte newColor = logOp(lut, srcColor, dstColor);
+	byte mask1 = (addr & 0x40000) ? (mask >> 8) : (mask & 0xFF);
+	byte mask2 = mask1 & (0xF0 >> (4 * (x & 1)));
+	byte result = (dstColor & ~mask2) | (newColor & mask2);
+	vram.writeVRAMDirect(addr, result);
+}
+
+// 2 bpp --------------------------------------------------------------
+struct V9990Bpp2 {
+	using Type = byte;
+	static constexpr word BITS_PER_PIXEL  = 2;
+	static constexpr word PIXELS_PER_BYTE = 4;
+	static constexpr bool BITMAP          = true;
+	static inline unsigned getPitch(unsigned width);
+	static inline unsigned addressOf(unsigned x, unsigned y, unsigned pitch);
+	template<typename VRAM>
+	static inline byte point(VRAM& vram,
+	                         unsigned x, unsigned y, unsigned pitch);
+	static inline byte shift(byte value, unsigned fromX, unsigned toX);
+	static inline byte shiftMask(unsigned x);
+	static inline const byte* getLogOpLUT(byte op);
+	static inline byte logOp(const byte* lut, byte src, byte dst);
+	template<typename VRAM>
+	static inline void pset(
+		VRAM& vram, unsigned x, unsigned y, unsigned pitch,
+		byte srcColor, word mask, const byte* lut, byte op);
+	template<typename VRAM>
+	static inline void psetColor(
+		VRAM& vram, unsigned x, unsigned y, unsigned pitch,
+		word color, word mask, const byte* lut, byte op);
+};
+
+inline unsigned V9990Bpp2::getPitch(unsigned width)
+{
+	return width / 4;
+}
+
+inline unsigned V9990Bpp2::addressOf(
+	unsigned x, unsigned y, unsigned pitch)
+{
+	return V9990VRAM::transformBx(((x / 4) & (pitch - 1)) + y * pitch) & 0x7FFFF;
+}
+
+template<typename VRAM>
+inline byte V9990Bpp2::point(
+	VRAM& vram, unsigned x, unsigned y, unsigned pitch)
+{
+	return vram.readVRAMDirect(addressOf(x, y, pitch));
+}
+
+inline byte V9990Bpp2::shift(
+	byte value, unsigned fromX, unsigned toX)
+{
+	int shift = 2 * ((toX & 3) - (fromX & 3));
+	return (shift > 0) ? (value >> shift) : (value << -shift);
+}
+
+inline byte V9990Bpp2::shiftMask(unsigned x)
+{
+	return 0xC0 >> (2 * (x & 3));
+}
+
+inline const byte* V9990Bpp2::getLogOpLUT(byte op)
+{
+	using namespace V9990LogOp;
+	return getLUT((op & 0x10) ? LOG_BPP2 : LOG_NO_T, op);
+}
+
+inline byte V9990Bpp2::logOp(
+	const byte* lut, byte src, byte dst)
+{
+	return lut[256 * dst + src];
+}
+
+template<typename VRAM>
+inline void V9990Bpp2::pset(
+	VRAM& vram, unsigned x, unsigned y, unsigned pitch,
+	byte srcColor, word mask, const byte* lut, byte /*op*/)
+{
+	unsigned addr = addressOf(x, y, pitch);
+	byte dstColor = vram.readVRAMDirect(addr);
+	byte newColor = logOp(lut, srcColor, dstColor);
+	byte mask1 = (addr & 0x40000) ? (mask >> 8) : (mask & 0xFF);
+	byte mask2 = mask1 & shiftMask(x);
+	byte result = (dstColor & ~mask2) | (newColor & mask2);
+	vram.writeVRAMDirect(addr, result);
+}
+
+template<typename VRAM>
+inline void V9990Bpp2::psetColor(
+	VRAM& vram, unsigned x, unsigned y, unsigned pitch,
+	word color, word mask, const byte* lut, byte /*op*/)
+{
+	unsigned addr = addressOf(x, y, pitch);
+	byte srcColor = (addr & 0x40000) ? (color >> 8) : (color & 0xFF);
+	byte dstColor = vram.readVRAMDirect(addr);
+	byte newColor = logOp(lut, srcColor, dstColor);
+	byte mask1 = (addr & 0x40000) ? (mask >> 8) : (mask & 0xFF);
+	byte mask2 = mask1 & (0xC0 >> (2 * (x & 3)));
+	byte result = (dstColor & ~mask2) | (newColor & mask2);
+	vram.writeVRAMDirect(addr, result);
+}
+
+// 4 bpp --------------------------------------------------------------
+struct V9990Bpp4 {
+	using Type = byte;
+	static constexpr word BITS_PER_PIXEL  = 4;
+	static constexpr word PIXELS_PER_BYTE = 2;
+	static constexpr bool BITMAP          = true;
+	static inline unsigned getPitch(unsigned width);
+	static inline unsigned addressOf(unsigned x, unsigned y, unsigned pitch);
+	template<typename VRAM>
+	static inline byte point(VRAM& vram,
+	                         unsigned x, unsigned y, unsigned pitch);
+	static inline byte shift(byte value, unsigned fromX, unsigned toX);
+	static inline byte shiftMask(unsigned x);
+	static inline const byte* getLogOpLUT(byte op);
+	static inline byte logOp(const byte* lut, byte src, byte dst);
+	template<typename VRAM>
+	static inline void pset(
+		VRAM& vram, unsigned x, unsigned y, unsigned pitch,
+		byte srcColor, word mask, const byte* lut, byte op);
+	template<typename VRAM>
+	static inline void psetColor(
+		VRAM& vram, unsigned x, unsigned y, unsigned pitch,
+		word color, word mask, const byte* lut, byte op);
+};
+
+inline unsigned V9990Bpp4::getPitch(unsigned width)
+{
+	return width / 2;
+}
+
+inline unsigned V9990Bpp4::addressOf(
+	unsigned x, unsigned y, unsigned pitch)
+{
+	return V9990VRAM::transformBx(((x / 2) & (pitch - 1)) + y * pitch) & 0x7FFFF;
+}
+
+template<typename VRAM>
+inline byte V9990Bpp4::point(
+	VRAM& vram, unsigned x, unsigned y, unsigned pitch)
+{
+	return vram.readVRAMDirect(addressOf(x, y, pitch));
+}
+
+inline byte V9990Bpp4::shift(
+	byte value, unsigned fromX, unsigned toX)
+{
+	int shift = 4 * ((toX & 1) - (fromX & 1));
+	return (shift > 0) ? (value >> shift) : (value << -shift);
+}
+
+inline byte V9990Bpp4::shiftMask(unsigned x)
+{
+	return (x & 1) ? 0x0F : 0xF0;
+}
+
+inline const byte* V9990Bpp4::getLogOpLUT(byte op)
+{
+	using namespace V9990LogOp;
+	return getLUT((op & 0x10) ? LOG_BPP4 : LOG_NO_T, op);
+}
+
+inline byte V9990Bpp4::logOp(
+	const byte* lut, byte src, byte dst)
+{
+	return lut[256 * dst + src];
+}
+
+template<typename VRAM>
+inline void V9990Bpp4::pset(
+	VRAM& vram, unsigned x, unsigned y, unsigned pitch,
+	byte srcColor, word mask, const byte* lut, byte /*op*/)
+{
+	unsigned addr = addressOf(x, y, pitch);
+	byte dstColor = vram.readVRAMDirect(addr);
+	byte newColor = logOp(lut, srcColor, dstColor);
+	byte mask1 = (addr & 0x40000) ? (mask >> 8) : (mask & 0xFF);
+	byte mask2 = mask1 & shiftMask(x);
+	byte result = (dstColor & ~mask2) | (newColor & mask2);
+	vram.writeVRAMDirect(addr, result);
+}
+
+template<typename VRAM>
+inline void V9990Bpp4::psetColor(
+	VRAM& vram, unsigned x, unsigned y, unsigned pitch,
+	word color, word mask, const byte* lut, byte /*op*/)
+{
+	unsigned addr = addressOf(x, y, pitch);
+	byte srcColor = (addr & 0x40000) ? (color >> 8) : (color & 0xFF);
+	byte dstColor = vram.readVRAMDirect(addr);
+	byte newColor = logOp(lut, srcColor, dstColor);
+	byte mask1 = (addr & 0x40000) ? (mask >> 8) : (mask & 0xFF);
+	byte mask2 = mask1 & (0xF0 >> (4 * (x & 1)));
+	byte result = (dstColor & ~mask2) | (newColor & mask2);
+	vram.writeVRAMDirect(addr, result);
+}
+
+// 8 bpp --------------------------------------------------------------
+struct V9990Bpp8 {
+	using Type = byte;
+	static constexpr word BITS_PER_PIXEL  = 8;
+	static constexpr word PIXELS_PER_BYTE = 1;
+	static constexpr bool BITMAP          = true;
+	static inline unsigned getPitch(unsigned width);
+	static inline unsigned addressOf(unsigned x, unsigned y, unsigned pitch);
+	template<typename VRAM>
+	static inline byte point(VRAM& vram,
+	                         unsigned x, unsigned y, unsigned pitch);
+	static inline byte shift(byte value, unsigned fromX, unsigned toX);
+	static inline byte shiftMask(unsigned x);
+	static inline const byte* getLogOpLUT(byte op);
+	static inline byte logOp(const byte* lut, byte src, byte dst);
+	template<typename VRAM>
+	static inline void pset(
+		VRAM& vram, unsigned x, unsigned y, unsigned pitch,
+		byte srcColor, word mask, const byte* lut, byte op);
+	template<typename VRAM>
+	static inline void psetColor(
+		VRAM& vram, unsigned x, unsigned y, unsigned pitch,
+		word color, word mask, const byte* lut, byte op);
+};
+
+inline unsigned V9990Bpp8::getPitch(unsigned width)
+{
+	return width;
+}
+
+inline unsigned V9990Bpp8::addressOf(
+	unsigned x, unsigned y, unsigned pitch)
+{
+	return V9990VRAM::transformBx((x & (pitch - 1)) + y * pitch) & 0x7FFFF;
+}
+
+template<typename VRAM>
+inline byte V9990Bpp8::point(
+	VRAM& vram, unsigned x, unsigned y, unsigned pitch)
+{
+	return vram.readVRAMDirect(addressOf(x, y, pitch));
+}
+
+inline byte V9990Bpp8::shift(
+	byte value, unsigned /*fromX*/, unsigned /*toX*/)
+{
+	return value;
+}
+
+inline byte V9990Bpp8::shiftMask(unsigned /*x*/)
+{
+	return 0xFF;
+}
+
+inline const byte* V9990Bpp8::getLogOpLUT(byte op)
+{
+	using namespace V9990LogOp;
+	return getLUT((op & 0x10) ? LOG_BPP8 : LOG_NO_T, op);
+}
+
+inline byte V9990Bpp8::logOp(
+	const byte* lut, byte src, byte dst)
+{
+	return lut[256 * dst + src];
+}
+
+template<typename VRAM>
+inline void V9990Bpp8::pset(
+	VRAM& vram, unsigned x, unsigned y, unsigned pitch,
+	byte srcColor, word mask, const byte* lut, byte /*op*/)
+{
+	unsigned addr = addressOf(x, y, pitch);
+	byte dstColor = vram.readVRAMDirect(addr);
+	byte newColor = logOp(lut, srcColor, dstColor);
+	byte mask1 = (addr & 0x40000) ? (mask >> 8) : (mask & 0xFF);
+	byte result = (dstColor & ~mask1) | (newColor & mask1);
+	vram.writeVRAMDirect(addr, result);
+}
+
+template<typename VRAM>
+inline void V9990Bpp8::psetColor(
+	VRAM& vram, unsigned x, unsigned y, unsigned pitch,
+	word color, word mask, const byte* lut, byte /*op*/)
+{
+	unsigned addr = addressOf(x, y, pitch);
+	byte srcColor = (addr & 0x40000) ? (color >> 8) : (color & 0xFF);
+	byte dstColor = vram.readVRAMDirect(addr);
+	byte newColor = logOp(lut, srcColor, dstColor);
+	byte mask1 = (addr & 0x40000) ? (mask >> 8) : (mask & 0xFF);
+	byte result = (dstColor & ~mask1) | (newColor & mask1);
+	vram.writeVRAMDirect(addr, result);
+}
+
+// 16 bpp -------------------------------------------------------------
+struct V9990Bpp16 {
+	using Type = word;
+	static constexpr word BITS_PER_PIXEL  = 16;
+	static constexpr word PIXELS_PER_BYTE = 0;
+	static constexpr bool BITMAP          = true;
+	static inline unsigned getPitch(unsigned width);
+	static inline unsigned addressOf(unsigned x, unsigned y, unsigned pitch);
+	template<typename VRAM>
+	static inline word point(VRAM& vram,
+	                         unsigned x, unsigned y, unsigned pitch);
+	static inline word shift(word value, unsigned fromX, unsigned toX);
+	static inline word shiftMask(unsigned x);
+	static inline const byte* getLogOpLUT(byte op);
+	static inline word logOp(const byte* lut, word src, word dst, bool transp);
+	template<typename VRAM>
+	static inline void pset(
+		VRAM& vram, unsigned x, unsigned y, unsigned pitch,
+		word srcColor, word mask, const byte* lut, byte op);
+	template<typename VRAM>
+	static inline void psetColor(
+		VRAM& vram, unsigned x, unsigned y, unsigned pitch,
+		word color, word mask, const byte* lut, byte op);
+};
+
+inline unsigned V9990Bpp16::getPitch(unsigned width)
+{
+	//return width * 2;
+	return width;
+}
+
+inline unsigned V9990Bpp16::addressOf(
+	unsigned x, unsigned y, unsigned pitch)
+{
+	//return V9990VRAM::transformBx(((x * 2) & (pitch - 1)) + y * pitch) & 0x7FFFF;
+	return ((x & (pitch - 1)) + y * pitch) & 0x3FFFF;
+}
+
+template<typename VRAM>
+inline word V9990Bpp16::point(
+	VRAM& vram, unsigned x, unsigned y, unsigned pitch)
+{
+	unsigned addr = addressOf(x, y, pitch);
+	return vram.readVRAMDirect(addr + 0x00000) +
+	       vram.readVRAMDirect(addr + 0x40000) * 256;
+}
+
+inline word V9990Bpp16::shift(
+	word value, unsigned /*fromX*/, unsigned /*toX*/)
+{
+	return value;
+}
+
+inline word V9990Bpp16::shiftMask(unsigned /*x*/)
+{
+	return 0xFFFF;
+}
+
+inline const byte* V9990Bpp16::getLogOpLUT(byte op)
+{
+	return V9990LogOp::getLUT(V9990LogOp::LOG_NO_T, op);
+}
+
+inline word V9990Bpp16::logOp(
+	const byte* lut, word src, word dst, bool transp)
+{
+	if (transp && (src == 0)) return dst;
+	return (lut[((dst & 0x00FF) << 8) + ((src & 0x00FF) >> 0)] << 0) +
+	       (lut[((dst & 0xFF00) << 0) + ((src & 0xFF00) >> 8)] << 8);
+}
+
+template<typename VRAM>
+inline void V9990Bpp16::pset(
+	VRAM& vram, unsigned x, unsigned y, unsigned pitch,
+	word srcColor, word mask, const byte* lut, byte op)
+{
+	unsigned addr = addressOf(x, y, pitch);
+	word dstColor = vram.readVRAMDirect(addr + 0x00000) +
+	                vram.readVRAMDirect(addr + 0x40000) * 256;
+	word newColor = logOp(lut, srcColor, dstColor, (op & 0x10) != 0);
+	word result = (dstColor & ~mask) | (newColor & mask);
+	vram.writeVRAMDirect(addr + 0x00000, result & 0xFF);
+	vram.writeVRAMDirect(addr + 0x40000, result >> 8);
+}
+
+template<typename VRAM>
+inline void V9990Bpp16::psetColor(
+	VRAM& vram, unsigned x, unsigned y, unsigned pitch,
+	word srcColor, word mask, const byte* lut, byte op)
+{
+	unsigned addr = addressOf(x, y, pitch);
+	word dstColor = vram.readVRAMDirect(addr + 0x00000) +
+	                vram.readVRAMDirect(addr + 0x40000) * 256;
+	word newColor = logOp(lut, srcColor, dstColor, (op & 0x10) != 0);
+	word result = (dstColor & ~mask) | (newColor & mask);
+	vram.writeVRAMDirect(addr + 0x00000, result & 0xFF);
+	vram.writeVRAMDirect(addr + 0x40000, result >> 8);
+}
+
+// Bulk paths ---------------------------------------------------------
+//
+// LMMV, LMMM, BMXL, BMLX and BMLL spend most of their time on long runs of
+// pixels (or bytes) that are contiguous in VRAM. As long as such a run is
+// executed before 'limit' and doesn't include the last pixel of a line (or
+// the last byte of BMLL), it can be done in one go: the logical operation
+// is applied to whole bytes with the routines from V9990LogOp.hh and
+// 'engineTime' is advanced only once. Nobody observes the V9990 VRAM while
+// the command executes (the renderer first syncs the command engine), so
+// the result is exactly the same as executing the pixels one by one.
+// This is only done in the bitmap modes (except for BMLL, which ignores the
+// display mode), and only when source and destination don't overlap.
+
+// Number of steps of 'delta' that start before 'limit' (at most 'max').
+inline unsigned V9990CmdState::bulkSteps(
+	EmuTime::param time, EmuTime::param limit, EmuDuration::param delta,
+	unsigned max)
+{
+	if (time >= limit) return 0;
+	if (delta == EmuDuration::zero()) return max; // broken timing
+	uint64_t n = ((limit - time).length() - 1) / delta.length() + 1;
+	return unsigned(std::min<uint64_t>(n, max));
+}
+
+// Number of pixels (at most 'max') of a bulk run that starts at 'x' and
+// goes in direction 'dx'. Only whole units, and 'x' must be the first pixel
+// of its unit. Returns 0 when that's not possible.
+template<typename Mode>
+inline unsigned V9990CmdState::bulkPixels(unsigned x, int dx, unsigned max)
+{
+	constexpr unsigned ppu = BULK_PIXELS<Mode>;
+	unsigned first = (dx > 0) ? 0 : (ppu - 1);
+	if ((x % ppu) != first) return 0;
+	unsigned n = max - (max % ppu);
+	return (n >= BULK_MIN) ? n : 0;
+}
+
+// Lowest address of a run of 'num' units on line 'y', that starts at pixel
+// 'x' and goes in direction 'dx'. In 2, 4 and 8bpp that's a logical address
+// (before V9990VRAM::transformBx()). Returns -1 if the run isn't contiguous.
+template<typename Mode>
+inline int V9990CmdState::bulkLineAddress(
+	unsigned x, unsigned y, int dx, unsigned num, unsigned pitch)
+{
+	constexpr unsigned size = (Mode::BITS_PER_PIXEL == 16) ? 0x40000 : 0x80000;
+	int u0 = x / BULK_PIXELS<Mode>;
+	int u1 = u0 + int(num - 1) * dx;
+	if ((u1 < 0) || ((unsigned(u0) / pitch) != (unsigned(u1) / pitch))) {
+		return -1; // wraps within the line
+	}
+	unsigned addr = ((std::min(u0, u1) & (pitch - 1)) + y * pitch) & (size - 1);
+	if ((addr + num) > size) return -1;
+	return addr;
+}
+
+// Distance between two addresses (in units).
+inline unsigned V9990CmdState::bulkDistance(unsigned a, unsigned b)
+{
+	return (a > b) ? (a - b) : (b - a);
+}
+
+// Apply the logical operation from 'num' source units to 'num' destination
+// units, starting at the lowest (see bulkLineAddress()) addresses 'src' and
+// 'dst'. The two runs may not overlap.
+template<typename Mode>
+inline void V9990CmdState::bulkCopy(
+	byte* data, unsigned src, unsigned dst, unsigned num, byte op, word mask)
+{
+	if constexpr (Mode::BITS_PER_PIXEL == 16) {
+		V9990LogOp::copy16(data + src, data + src + 0x40000,
+		                   data + dst, data + dst + 0x40000,
+		                   num, op, mask);
+	} else {
+		// The even and the odd logical addresses are each contiguous, in
+		// the lower and in the upper half of VRAM.
+		for (unsigned k = 0; k < 2; ++k) {
+			unsigned d = dst + ((dst & 1) ^ k);
+			if (d >= (dst + num)) continue;
+			unsigned s = src + (d - dst);
+			byte m = (d & 1) ? (mask >> 8) : (mask & 0xFF);
+			V9990LogOp::copy(data + V9990VRAM::transformBx(s),
+			                 data + V9990VRAM::transformBx(d),
+			                 (dst + num - d + 1) / 2,
+			                 op, m, Mode::BITS_PER_PIXEL);
+		}
+	}
+}
+
+// Same with a constant source color.
+template<typename Mode>
+inline void V9990CmdState::bulkFill(
+	byte* data, unsigned dst, unsigned num, byte op, word color, word mask)
+{
+	if constexpr (Mode::BITS_PER_PIXEL == 16) {
+		V9990LogOp::fill16(data + dst, data + dst + 0x40000,
+		                   num, op, color, mask);
+	} else {
+		for (unsigned k = 0; k < 2; ++k) {
+			unsigned d = dst + ((dst & 1) ^ k);
+			if (d >= (dst + num)) continue;
+			byte c = (d & 1) ? (color >> 8) : (color & 0xFF);
+			byte m = (d & 1) ? (mask  >> 8) : (mask  & 0xFF);
+			V9990LogOp::fill(data + V9990VRAM::transformBx(d),
+			                 (dst + num - d + 1) / 2,
+			                 op, c, m, Mode::BITS_PER_PIXEL);
+		}
+	}
+}
+
+// In 16bpp BMXL and BMLX transfer pixels to or from linear addresses. A run
+// of 'num' pixels starting at (even or odd) linear address 'addr' has its
+// low and its high bytes each contiguous in VRAM. Returns false if they're
+// not.
+inline bool V9990CmdState::bulkLinear16(
+	unsigned addr, unsigned num, unsigned& lo, unsigned& hi)
+{
+	addr &= 0x7FFFF;
+	if ((addr + 2 * num) > 0x80000) return false;
+	lo = V9990VRAM::transformBx(addr + 0);
+	hi = V9990VRAM::transformBx(addr + 1);
+	return true;
+}
+
+// Number of units (at most 'num') for which the runs starting at the
+// physical addresses in 'src' and in 'dst' don't overlap.
+inline unsigned V9990CmdState::bulkDisjoint(
+	unsigned num, std::initializer_list<unsigned> src,
+	std::initializer_list<unsigned> dst)
+{
+	for (auto s : src) {
+		for (auto d : dst) {
+			num = std::min(num, bulkDistance(s, d));
+		}
+	}
+	return num;
+}
+
+// Commands ---------------------------------------------------------
+
+template<typename Mode, typename VRAM>
+bool V9990CmdState::runLMMV(
+	VRAM& vram, unsigned pitch, EmuDuration::param delta, EmuTime::param limit)
+{
+	int dx = (ARG & DIX) ? -1 : 1;
+	int dy = (ARG & DIY) ? -1 : 1;
+	const byte* lut = Mode::getLogOpLUT(LOG);
+	bool tryBulk = Mode::BITMAP;
+	while (engineTime < limit) {
+		if (tryBulk && (ANX > BULK_MIN)) {
+			unsigned n = bulkPixels<Mode>(
+				DX, dx, bulkSteps(engineTime, limit, delta, ANX - 1));
+			if (n) {
+				unsigned num = n / BULK_PIXELS<Mode>;
+				int dst = bulkLineAddress<Mode>(DX, DY, dx, num, pitch);
+				if (dst >= 0) {
+					bulkFill<Mode>(vram.getWriteBackdoor(), dst, num,
+					               LOG, fgCol, WM);
+					engineTime += delta * n;
+					DX += n * dx;
+					ANX -= n;
+					continue;
+				}
+				tryBulk = false;
+			}
+		}
+		engineTime += delta;
+		Mode::psetColor(vram, DX, DY, pitch, fgCol, WM, lut, LOG);
+
+		DX += dx;
+		if (!--(ANX)) {
+			DX -= (NX * dx);
+			DY += dy;
+			if (!--(ANY)) {
+				return true;
+			} else {
+				ANX = getWrappedNX();
+				tryBulk = Mode::BITMAP;
+			}
+		}
+	}
+	return false;
+}
+
+template<typename Mode, typename VRAM>
+bool V9990CmdState::runLMMM(
+	VRAM& vram, unsigned pitch, EmuDuration::param delta, EmuTime::param limit)
+{
+	int dx = (ARG & DIX) ? -1 : 1;
+	int dy = (ARG & DIY) ? -1 : 1;
+	const byte* lut = Mode::getLogOpLUT(LOG);
+	bool tryBulk = Mode::BITMAP;
+	while (engineTime < limit) {
+		if (tryBulk && (ANX > BULK_MIN) &&
+		    ((SX % BULK_PIXELS<Mode>) == (DX % BULK_PIXELS<Mode>))) {
+			unsigned n = bulkPixels<Mode>(
+				DX, dx, bulkSteps(engineTime, limit, delta, ANX - 1));
+			if (n) {
+				int src = bulkLineAddress<Mode>(SX, SY, dx, 1, pitch);
+				int dst = bulkLineAddress<Mode>(DX, DY, dx, 1, pitch);
+				unsigned num = std::min(n / BULK_PIXELS<Mode>,
+				                        bulkDistance(src, dst));
+				n = num * BULK_PIXELS<Mode>;
+				if (n >= BULK_MIN) {
+					src = bulkLineAddress<Mode>(SX, SY, dx, num, pitch);
+					dst = bulkLineAddress<Mode>(DX, DY, dx, num, pitch);
+				}
+				if ((n >= BULK_MIN) && (src >= 0) && (dst >= 0)) {
+					bulkCopy<Mode>(vram.getWriteBackdoor(), src, dst, num,
+					               LOG, WM);
+					engineTime += delta * n;
+					SX += n * dx;
+					DX += n * dx;
+					ANX -= n;
+					continue;
+				}
+				tryBulk = false;
+			}
+		}
+		engineTime += delta;
+		auto src = Mode::point(vram, SX, SY, pitch);
+		src = Mode::shift(src, SX, DX);
+		Mode::pset(vram, DX, DY, pitch, src, WM, lut, LOG);
+
+		DX += dx;
+		SX += dx;
+		if (!--(ANX)) {
+			DX -= (NX * dx);
+			SX -= (NX * dx);
+			DY += dy;
+			SY += dy;
+			if (!--(ANY)) {
+				return true;
+			} else {
+				ANX = getWrappedNX();
+				tryBulk = Mode::BITMAP;
+			}
+		}
+	}
+	return false;
+}
+
+template<typename VRAM>
+bool V9990CmdState::runBMXL16(
+	VRAM& vram, unsigned pitch, EmuDuration::param timing, EmuTime::param limit)
+{
+	// timing value is times 2, because it does 2 bytes per iteration:
+	auto delta = timing * 2;
+	int dx = (ARG & DIX) ? -1 : 1;
+	int dy = (ARG & DIY) ? -1 : 1;
+	const byte* lut = V9990Bpp16::getLogOpLUT(LOG);
+	bool tryBulk = dx > 0;
+
+	while (engineTime < limit) {
+		if (tryBulk && (ANX > BULK_MIN)) {
+			unsigned n = bulkSteps(engineTime, limit, delta, ANX - 1);
+			unsigned lo, hi;
+			int dst = bulkLineAddress<V9990Bpp16>(DX, DY, dx, n, pitch);
+			if ((n >= BULK_MIN) && (dst >= 0) &&
+			    bulkLinear16(srcAddress, n, lo, hi)) {
+				n = bulkDisjoint(n, {lo, hi}, {unsigned(dst), dst + 0x40000u});
+			} else {
+				n = 0;
+			}
+			if (n >= BULK_MIN) {
+				byte* ram = vram.getWriteBackdoor();
+				V9990LogOp::copy16(ram + lo, ram + hi,
+				                   ram + dst, ram + dst + 0x40000,
+				                   n, LOG, WM);
+				engineTime += delta * n;
+				srcAddress += 2 * n;
+				DX += n;
+				ANX -= n;
+				continue;
+			}
+			tryBulk = false;
+		}
+		engineTime += delta;
+		word src = vram.readVRAMBx(srcAddress + 0) +
+		           vram.readVRAMBx(srcAddress + 1) * 256;
+		srcAddress += 2;
+		V9990Bpp16::pset(vram, DX, DY, pitch, src, WM, lut, LOG);
+		DX += dx;
+		if (!--(ANX)) {
+			DX -= (NX * dx);
+			DY += dy;
+			if (!--(ANY)) {
+				return true;
+			} else {
+				ANX = getWrappedNX();
+				tryBulk = dx > 0;
+			}
+		}
+	}
+	return false;
+}
+
+template<typename Mode, typename VRAM>
+bool V9990CmdState::runBMXL(
+	VRAM& vram, unsigned pitch, EmuDuration::param delta, EmuTime::param limit)
+{
+	if constexpr (Mode::BITS_PER_PIXEL == 16) {
+		return runBMXL16(vram, pitch, delta, limit);
+	} else {
+		int dx = (ARG & DIX) ? -1 : 1;
+		int dy = (ARG & DIY) ? -1 : 1;
+		const byte* lut = Mode::getLogOpLUT(LOG);
+		// A source byte goes to one destination byte, but only when going
+		// to the right (otherwise the order of the bytes gets reversed).
+		bool tryBulk = Mode::BITMAP && (dx > 0);
+
+		while (engineTime < limit) {
+			constexpr unsigned ppu = BULK_PIXELS<Mode>;
+			if (tryBulk && (ANX > BULK_MIN) && ((DX % ppu) == 0)) {
+				unsigned n = bulkPixels<Mode>(DX, dx, ppu *
+					bulkSteps(engineTime, limit, delta, (ANX - 1) / ppu));
+				if (n) {
+					unsigned num = n / ppu;
+					unsigned src = srcAddress & 0x7FFFF;
+					int dst = bulkLineAddress<Mode>(DX, DY, dx, num, pitch);
+					if ((dst >= 0) && ((src + num) <= 0x80000)) {
+						num = std::min(num, bulkDistance(src, dst));
+						n = num * ppu;
+					} else {
+						n = 0;
+					}
+					if (n >= BULK_MIN) {
+						bulkCopy<Mode>(vram.getWriteBackdoor(), src, dst, num,
+						               LOG, WM);
+						engineTime += delta * num;
+						srcAddress += num;
+						DX += n;
+						ANX -= n;
+						continue;
+					}
+					tryBulk = false;
+				}
+			}
+			engineTime += delta;
+			byte d = vram.readVRAMBx(srcAddress++);
+			for (int i = 0; (ANY > 0) && (i < Mode::PIXELS_PER_BYTE); ++i) {
+				Mode::pset(vram, DX, DY, pitch, d, WM, lut, LOG);
+				DX += dx;
+				if (!--(ANX)) {
+					DX -= (NX * dx);
+					DY += dy;
+					if (!--(ANY)) {
+						return true;
+					} else {
+						ANX = getWrappedNX();
+						tryBulk = Mode::BITMAP && (dx > 0);
+					}
+				}
+			}
+		}
+		return false;
+	}
+}
+
+template<typename VRAM>
+bool V9990CmdState::runBMLX16(
+	VRAM& vram, unsigned pitch, EmuDuration::param delta, EmuTime::param limit)
+{
+	// TODO test corner cases, timing
+	int dx = (ARG & DIX) ? -1 : 1;
+	int dy = (ARG & DIY) ? -1 : 1;
+	bool tryBulk = dx > 0;
+
+	while (engineTime < limit) {
+		if (tryBulk && (ANX > BULK_MIN)) {
+			unsigned n = bulkSteps(engineTime, limit, delta, ANX - 1);
+			unsigned lo, hi;
+			int src = bulkLineAddress<V9990Bpp16>(SX, SY, dx, n, pitch);
+			if ((n >= BULK_MIN) && (src >= 0) &&
+			    bulkLinear16(dstAddress, n, lo, hi)) {
+				n = bulkDisjoint(n, {unsigned(src), src + 0x40000u}, {lo, hi});
+			} else {
+				n = 0;
+			}
+			if (n >= BULK_MIN) {
+				byte* ram = vram.getWriteBackdoor();
+				V9990LogOp::copy16(ram + src, ram + src + 0x40000,
+				                   ram + lo, ram + hi,
+				                   n, LOG_IMP, 0xFFFF);
+				engineTime += delta * n;
+				dstAddress += 2 * n;
+				SX += n;
+				ANX -= n;
+				continue;
+			}
+			tryBulk = false;
+		}
+		engineTime += delta;
+		auto src = V9990Bpp16::point(vram, SX, SY, pitch);
+		vram.writeVRAMBx(dstAddress++, src & 0xFF);
+		vram.writeVRAMBx(dstAddress++, src >> 8);
+		SX += dx;
+		if (!--(ANX)) {
+			SX -= (NX * dx);
+			SY += dy;
+			if (!--(ANY)) {
+				return true;
+			} else {
+				ANX = getWrappedNX();
+				tryBulk = dx > 0;
+			}
+		}
+	}
+	return false;
+}
+
+template<typename Mode, typename VRAM>
+bool V9990CmdState::runBMLX(
+	VRAM& vram, unsigned pitch, EmuDuration::param delta, EmuTime::param limit)
+{
+	if constexpr (Mode::BITS_PER_PIXEL == 16) {
+		return runBMLX16(vram, pitch, delta, limit);
+	} else {
+		// TODO test corner cases, timing
+		int dx = (ARG & DIX) ? -1 : 1;
+		int dy = (ARG & DIY) ? -1 : 1;
+		// see runBMXL()
+		bool tryBulk = Mode::BITMAP && (dx > 0);
+
+		while (engineTime < limit) {
+			constexpr unsigned ppu = BULK_PIXELS<Mode>;
+			if (tryBulk && (ANX > BULK_MIN) && ((SX % ppu) == 0)) {
+				unsigned n = bulkPixels<Mode>(SX, dx, ppu *
+					bulkSteps(engineTime, limit, delta, (ANX - 1) / ppu));
+				if (n) {
+					unsigned num = n / ppu;
+					int src = bulkLineAddress<Mode>(SX, SY, dx, num, pitch);
+					unsigned dst = dstAddress & 0x7FFFF;
+					if ((src >= 0) && ((dst + num) <= 0x80000)) {
+						num = std::min(num, bulkDistance(src, dst));
+						n = num * ppu;
+					} else {
+						n = 0;
+					}
+					if (n >= BULK_MIN) {
+						bulkCopy<Mode>(vram.getWriteBackdoor(), src, dst, num,
+						               LOG_IMP, 0xFFFF);
+						engineTime += delta * num;
+						dstAddress += num;
+						SX += n;
+						ANX -= n;
+						continue;
+					}
+					tryBulk = false;
+				}
+			}
+			engineTime += delta;
+			byte d = 0;
+			for (int i = 0; i < Mode::PIXELS_PER_BYTE; ++i) {
+				auto src = Mode::point(vram, SX, SY, pitch);
+				d |= Mode::shift(src, SX, i) & Mode::shiftMask(i);
+				SX += dx;
+				if (!--(ANX)) {
+					SX -= (NX * dx);
+					SY += dy;
+					if (!--(ANY)) {
+						vram.writeVRAMBx(dstAddress++, d);
+						return true;
+					} else {
+						ANX = getWrappedNX();
+						tryBulk = Mode::BITMAP && (dx > 0);
+					}
+				}
+			}
+			vram.writeVRAMBx(dstAddress++, d);
+		}
+		return false;
+	}
+}
+
+template<typename VRAM>
+bool V9990CmdState::runBMLL16(
+	VRAM& vram, EmuDuration::param timing, EmuTime::param limit)
+{
+	// TODO DIX DIY?
+	// timing value is times 2, because it does 2 bytes per iteration:
+	auto delta = timing * 2;
+	const byte* lut = V9990Bpp16::getLogOpLUT(LOG);
+	bool transp = (LOG & 0x10) != 0;
+	// see runBMLL()
+	bool tryBulk = bulkDistance(srcAddress, dstAddress) >= BULK_MIN;
+	while (engineTime < limit) {
+		if (tryBulk && (nbBytes > BULK_MIN)) {
+			unsigned n = std::min({nbBytes - 1,
+			                       0x40000 - srcAddress, 0x40000 - dstAddress,
+			                       bulkDistance(srcAddress, dstAddress)});
+			if (n >= BULK_MIN) n = bulkSteps(engineTime, limit, delta, n);
+			if (n >= BULK_MIN) {
+				bulkCopy<V9990Bpp16>(vram.getWriteBackdoor(),
+				                     srcAddress, dstAddress, n, LOG, WM);
+				engineTime += delta * n;
+				srcAddress = (srcAddress + n) & 0x3FFFF;
+				dstAddress = (dstAddress + n) & 0x3FFFF;
+				nbBytes -= n;
+				continue;
+			}
+		}
+		engineTime += delta;
+		// VRAM always mapped as in Bx modes
+		word srcColor = vram.readVRAMDirect(srcAddress + 0x00000) +
+		                vram.readVRAMDirect(srcAddress + 0x40000) * 256;
+		word dstColor = vram.readVRAMDirect(dstAddress + 0x00000) +
+		                vram.readVRAMDirect(dstAddress + 0x40000) * 256;
+		word newColor = V9990Bpp16::logOp(lut, srcColor, dstColor, transp);
+		word result = (dstColor & ~WM) | (newColor & WM);
+		vram.writeVRAMDirect(dstAddress + 0x00000, result & 0xFF);
+		vram.writeVRAMDirect(dstAddress + 0x40000, result >> 8);
+		srcAddress = (srcAddress + 1) & 0x3FFFF;
+		dstAddress = (dstAddress + 1) & 0x3FFFF;
+		if (!--nbBytes) {
+			return true;
+		}
+	}
+	return false;
+}
+
+template<typename Mode, typename VRAM>
+bool V9990CmdState::runBMLL(
+	VRAM& vram, EmuDuration::param delta, EmuTime::param limit)
+{
+	if constexpr (Mode::BITS_PER_PIXEL == 16) {
+		return runBMLL16(vram, delta, limit);
+	} else {
+		// TODO DIX DIY?
+		const byte* lut = Mode::getLogOpLUT(LOG);
+		// When source and destination are close together, every byte would
+		// fail the checks below.
+		bool tryBulk = bulkDistance(srcAddress, dstAddress) >= BULK_MIN;
+		while (engineTime < limit) {
+			if (tryBulk && (nbBytes > BULK_MIN)) {
+				unsigned n = std::min({nbBytes - 1,
+				                       0x80000 - srcAddress, 0x80000 - dstAddress,
+				                       bulkDistance(srcAddress, dstAddress)});
+				if (n >= BULK_MIN) n = bulkSteps(engineTime, limit, delta, n);
+				if (n >= BULK_MIN) {
+					bulkCopy<Mode>(vram.getWriteBackdoor(),
+					               srcAddress, dstAddress, n, LOG, WM);
+					engineTime += delta * n;
+					srcAddress = (srcAddress + n) & 0x7FFFF;
+					dstAddress = (dstAddress + n) & 0x7FFFF;
+					nbBytes -= n;
+					continue;
+				}
+			}
+			engineTime += delta;
+			// VRAM always mapped as in Bx modes
+			byte srcColor = vram.readVRAMBx(srcAddress);
+			unsigned addr = V9990VRAM::transformBx(dstAddress);
+			byte dstColor = vram.readVRAMDirect(addr);
+			byte newColor = Mode::logOp(lut, srcColor, dstColor);
+			byte mask = (addr & 0x40000) ? (WM >> 8) : (WM & 0xFF);
+			byte result = (dstColor & ~mask) | (newColor & mask);
+			vram.writeVRAMDirect(addr, result);
+			srcAddress = (srcAddress + 1) & 0x7FFFF;
+			dstAddress = (dstAddress + 1) & 0x7FFFF;
+			if (!--nbBytes) {
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+} // namespace openmsx
+
+#endif
@@ -0,0 +1,176 @@
+#include "V9990LogOp.hh"
+#include "MemBuffer.hh"
+#include "unreachable.hh"
+
+namespace openmsx::V9990LogOp {
+
+// Lazily initialized LUT to speed up logical operations:
+//  - 1st index is the mode: 2,4,8 bpp or 'not-transparent'
+//  - 2nd index is the logical operation: one of the 16 possible binary functions
+// * Each entry contains a 256x256 byte array, that array is indexed using
+//   destination and source byte (in that order).
+// * A fully populated logOpLUT would take 4MB, however the vast majority of
+//   this table is (almost) never used. So we save quite some memory (and
+//   startup time) by lazily initializing this table.
+static MemBuffer<byte> logOpLUT[4][16];
+static byte bitLUT[8][16][2][2]; // to speedup calculating logOpLUT
+
+static void initBitTab()
+{
+	for (unsigned op = 0; op < 16; ++op) {
+		unsigned tmp = op;
+		for (unsigned src = 0; src < 2; ++src) {
+			for (unsigned dst = 0; dst < 2; ++dst) {
+				unsigned b = tmp & 1;
+				for (unsigned bit = 0; bit < 8; ++bit) {
+					bitLUT[bit][op][src][dst] = b << bit;
+				}
+				tmp >>= 1;
+			}
+		}
+	}
+}
+
+static inline byte func01(unsigned op, unsigned src, unsigned dst)
+{
+	if ((src & 0x03) == 0) return dst & 0x03;
+	byte res = 0;
+	res |= bitLUT[0][op][(src & 0x01) >> 0][(dst & 0x01) >> 0];
+	res |= bitLUT[1][op][(src & 0x02) >> 1][(dst & 0x02) >> 1];
+	return res;
+}
+static inline byte func23(unsigned op, unsigned src, unsigned dst)
+{
+	if ((src & 0x0C) == 0) return dst & 0x0C;
+	byte res = 0;
+	res |= bitLUT[2][op][(src & 0x04) >> 2][(dst & 0x04) >> 2];
+	res |= bitLUT[3][op][(src & 0x08) >> 3][(dst & 0x08) >> 3];
+	return res;
+}
+static inline byte func45(unsigned op, unsigned src, unsigned dst)
+{
+	if ((src & 0x30) == 0) return dst & 0x30;
+	byte res = 0;
+	res |= bitLUT[4][op][(src & 0x10) >> 4][(dst & 0x10) >> 4];
+	res |= bitLUT[5][op][(src & 0x20) >> 5][(dst & 0x20) >> 5];
+	return res;
+}
+static inline byte func67(unsigned op, unsigned src, unsigned dst)
+{
+	if ((src & 0xC0) == 0) return dst & 0xC0;
+	byte res = 0;
+	res |= bitLUT[6][op][(src & 0x40) >> 6][(dst & 0x40) >> 6];
+	res |= bitLUT[7][op][(src & 0x80) >> 7][(dst & 0x80) >> 7];
+	return res;
+}
+
+static inline byte func03(unsigned op, unsigned src, unsigned dst)
+{
+	if ((src & 0x0F) == 0) return dst & 0x0F;
+	byte res = 0;
+	res |= bitLUT[0][op][(src & 0x01) >> 0][(dst & 0x01) >> 0];
+	res |= bitLUT[1][op][(src & 0x02) >> 1][(dst & 0x02) >> 1];
+	res |= bitLUT[2][op][(src & 0x04) >> 2][(dst & 0x04) >> 2];
+	res |= bitLUT[3][op][(src & 0x08) >> 3][(dst & 0x08) >> 3];
+	return res;
+}
+static inline byte func47(unsigned op, unsigned src, unsigned dst)
+{
+	if ((src & 0xF0) == 0) return dst & 0xF0;
+	byte res = 0;
+	res |= bitLUT[4][op][(src & 0x10) >> 4][(dst & 0x10) >> 4];
+	res |= bitLUT[5][op][(src & 0x20) >> 5][(dst & 0x20) >> 5];
+	res |= bitLUT[6][op][(src & 0x40) >> 6][(dst & 0x40) >> 6];
+	res |= bitLUT[7][op][(src & 0x80) >> 7][(dst & 0x80) >> 7];
+	return res;
+}
+
+static inline byte func07(unsigned op, unsigned src, unsigned dst)
+{
+	// if (src == 0) return dst;  // handled in fillTable8
+	byte res = 0;
+	res |= bitLUT[0][op][(src & 0x01) >> 0][(dst & 0x01) >> 0];
+	res |= bitLUT[1][op][(src & 0x02) >> 1][(dst & 0x02) >> 1];
+	res |= bitLUT[2][op][(src & 0x04) >> 2][(dst & 0x04) >> 2];
+	res |= bitLUT[3][op][(src & 0x08) >> 3][(dst & 0x08) >> 3];
+	res |= bitLUT[4][op][(src & 0x10) >> 4][(dst & 0x10) >> 4];
+	res |= bitLUT[5][op][(src & 0x20) >> 5][(dst & 0x20) >> 5];
+	res |= bitLUT[6][op][(src & 0x40) >> 6][(dst & 0x40) >> 6];
+	res |= bitLUT[7][op][(src & 0x80) >> 7][(dst & 0x80) >> 7];
+	return res;
+}
+
+static void fillTableNoT(unsigned op, byte* table)
+{
+	for (unsigned dst = 0; dst < 256; ++dst) {
+		for (unsigned src = 0; src < 256; ++src) {
+			table[dst * 256 + src] = func07(op, src, dst);
+		}
+	}
+}
+
+static void fillTable2(unsigned op, byte* table)
+{
+	for (unsigned dst = 0; dst < 256; ++dst) {
+		for (unsigned src = 0; src < 256; ++src) {
+			byte res = 0;
+			res |= func01(op, src, dst);
+			res |= func23(op, src, dst);
+			res |= func45(op, src, dst);
+			res |= func67(op, src, dst);
+			table[dst * 256 + src] = res;
+		}
+	}
+}
+
+static void fillTable4(unsigned op, byte* table)
+{
+	for (unsigned dst = 0; dst < 256; ++dst) {
+		for (unsigned src = 0; src < 256; ++src) {
+			byte res = 0;
+			res |= func03(op, src, dst);
+			res |= func47(op, src, dst);
+			table[dst * 256 + src] = res;
+		}
+	}
+}
+
+static void fillTable8(unsigned op, byte* table)
+{
+	for (unsigned dst = 0; dst < 256; ++dst) {
+		{ // src == 0
+			table[dst * 256 + 0  ] = dst;
+		}
+		for (unsigned src = 1; src < 256; ++src) { // src != 0
+			table[dst * 256 + src] = func07(op, src, dst);
+		}
+	}
+}
+
+const byte* getLUT(unsigned mode, unsigned op)
+{
+	op &= 0x0f;
+	if (!logOpLUT[mode][op].data()) {
+		initBitTab();
+		logOpLUT[mode][op].resize(256 * 256);
+		switch (mode) {
+		case LOG_NO_T:
+			fillTableNoT(op, logOpLUT[mode][op].data());
+			break;
+		case LOG_BPP2:
+			fillTable2  (op, logOpLUT[mode][op].data());
+			break;
+		case LOG_BPP4:
+			fillTable4  (op, logOpLUT[mode][op].data());
+			break;
+		case LOG_BPP8:
+			fillTable8  (op, logOpLUT[mode][op].data());
+			break;
+		default:
+			UNREACHABLE;
+		}
+	}
+	return logOpLUT[mode][op].data();
+}
+
+} // namespace openmsx::V9990LogOp
@@ -0,0 +1,284 @@
+#ifndef V9990LOGOP_HH
+#define V9990LOGOP_HH
+
+// The logical operations of the V9990 command engine, applied to whole runs
+// of bytes at once. Used by the bulk paths in V9990CmdEngine.
+//
+// 'op' is the value of the LOGOP register:
+//  - the lower 4 bits select one of the 16 possible binary functions, bit n
+//    is the result for (source-bit, destination-bit) = (n >> 1, n & 1)
+//  - bit 4 (TP) enables transparency: pixels with source color 0 leave the
+//    destination pixel unchanged
+// 'bpp' is the number of bits per pixel (2, 4 or 8), that's only relevant
+// for transparency. 16bpp pixels are split over two runs of bytes (low and
+// high byte), those have their own routines.
+// Only the bits that are set in the write mask are changed.
+//
+// The result is identical to what the per-pixel code in V9990CmdModes.hh
+// calculates (using the lookup tables below), see V9990LogOp_test.cc. Like
+// in the rest of openMSX the implementation (SSE2 or c++) is selected at
+// compile time.
+
+#include "openmsx.hh"
+#include "unreachable.hh"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace openmsx::V9990LogOp {
+
+// The binary function (lower 4 bits of 'op') applied to each bit.
+inline byte func(byte op, byte s, byte d)
+{
+	byte f0 = ((op & 1) ? byte(~d) : 0) | ((op & 2) ? d : 0); // source bit 0
+	byte f1 = ((op & 4) ? byte(~d) : 0) | ((op & 8) ? d : 0); // source bit 1
+	return (s & f1) | (~s & f0);
+}
+
+// The bits of a source byte that belong to non-transparent pixels. BPP=0
+// means no transparency.
+template<unsigned BPP> inline byte visibleBits(byte s)
+{
+	if (BPP == 0) return 0xFF;
+	constexpr unsigned fieldMask = (1 << (BPP ? BPP : 8)) - 1;
+	byte result = 0;
+	for (unsigned i = 0; i < 8; i += (BPP ? BPP : 8)) {
+		if (s & (fieldMask << i)) result |= fieldMask << i;
+	}
+	return result;
+}
+
+// Portable version.
+template<unsigned BPP>
+inline void copyScalar(const byte* __restrict src, byte* __restrict dst,
+                       unsigned num, byte op, byte mask)
+{
+	for (unsigned i = 0; i < num; ++i) {
+		byte s = src[i];
+		byte d = dst[i];
+		byte m = mask & visibleBits<BPP>(s);
+		dst[i] = (d & ~m) | (func(op, s, d) & m);
+	}
+}
+
+// Same for 16bpp: a pixel is transparent when both its low and high byte are
+// zero.
+inline void copy16Scalar(const byte* __restrict srcLo, const byte* __restrict srcHi,
+                         byte* __restrict dstLo, byte* __restrict dstHi,
+                         unsigned num, byte op, word mask)
+{
+	bool transp = (op & 0x10) != 0;
+	for (unsigned i = 0; i < num; ++i) {
+		byte sLo = srcLo[i];
+		byte sHi = srcHi[i];
+		if (transp && ((sLo | sHi) == 0)) continue;
+		byte dLo = dstLo[i];
+		byte dHi = dstHi[i];
+		byte mLo = mask & 0xFF;
+		byte mHi = mask >> 8;
+		dstLo[i] = (dLo & ~mLo) | (func(op, sLo, dLo) & mLo);
+		dstHi[i] = (dHi & ~mHi) | (func(op, sHi, dHi) & mHi);
+	}
+}
+
+#ifdef __SSE2__
+template<unsigned BPP> inline __m128i visibleBits(__m128i s)
+{
+	if (BPP == 0) {
+		return _mm_set1_epi8(-1);
+	} else if (BPP == 8) {
+		return _mm_xor_si128(_mm_cmpeq_epi8(s, _mm_setzero_si128()),
+		                     _mm_set1_epi8(-1));
+	} else if (BPP == 4) {
+		// Collect the OR of each nibble in its lowest bit (shifting 16-bit
+		// lanes also moves bits between bytes, but not into the bits that
+		// are kept), then copy that bit to the rest of the nibble.
+		__m128i t = _mm_or_si128(s, _mm_srli_epi16(s, 1));
+		t = _mm_or_si128(t, _mm_srli_epi16(t, 2));
+		t = _mm_and_si128(t, _mm_set1_epi8(0x11));
+		t = _mm_or_si128(t, _mm_slli_epi16(t, 1));
+		return _mm_or_si128(t, _mm_slli_epi16(t, 2));
+	} else if (BPP == 2) {
+		__m128i t = _mm_or_si128(s, _mm_srli_epi16(s, 1));
+		t = _mm_and_si128(t, _mm_set1_epi8(0x55));
+		return _mm_or_si128(t, _mm_slli_epi16(t, 1));
+	} else {
+		UNREACHABLE; return s;
+	}
+}
+
+// The 4 possible results of a bit: for (source, destination) = (0,0), (0,1),
+// (1,0) and (1,1), each either all zeros or all ones.
+struct FuncSSE2 {
+	explicit FuncSSE2(byte op)
+		: o0(_mm_set1_epi8((op & 1) ? -1 : 0))
+		, o1(_mm_set1_epi8((op & 2) ? -1 : 0))
+		, o2(_mm_set1_epi8((op & 4) ? -1 : 0))
+		, o3(_mm_set1_epi8((op & 8) ? -1 : 0)) {}
+
+	__m128i operator()(__m128i s, __m128i d) const {
+		__m128i f0 = _mm_or_si128(_mm_andnot_si128(d, o0), _mm_and_si128(d, o1));
+		__m128i f1 = _mm_or_si128(_mm_andnot_si128(d, o2), _mm_and_si128(d, o3));
+		return _mm_or_si128(_mm_and_si128(s, f1), _mm_andnot_si128(s, f0));
+	}
+
+	__m128i o0, o1, o2, o3;
+};
+
+inline __m128i select(__m128i mask, __m128i a, __m128i b)
+{
+	// (a & mask) | (b & ~mask)
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+template<unsigned BPP>
+inline void copySSE2(const byte* __restrict src, byte* __restrict dst,
+                     unsigned num, byte op, byte mask)
+{
+	FuncSSE2 f(op);
+	__m128i m = _mm_set1_epi8(mask);
+	unsigned i = 0;
+	for (/**/; (i + 16) <= num; i += 16) {
+		__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+		__m128i m2 = _mm_and_si128(m, visibleBits<BPP>(s));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+		                 select(m2, f(s, d), d));
+	}
+	copyScalar<BPP>(src + i, dst + i, num - i, op, mask);
+}
+
+inline void copy16SSE2(const byte* __restrict srcLo, const byte* __restrict srcHi,
+                       byte* __restrict dstLo, byte* __restrict dstHi,
+                       unsigned num, byte op, word mask)
+{
+	FuncSSE2 f(op);
+	__m128i mLo = _mm_set1_epi8(mask & 0xFF);
+	__m128i mHi = _mm_set1_epi8(mask >> 8);
+	__m128i zero = _mm_setzero_si128();
+	__m128i transp = _mm_set1_epi8((op & 0x10) ? -1 : 0);
+	unsigned i = 0;
+	for (/**/; (i + 16) <= num; i += 16) {
+		__m128i sLo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(srcLo + i));
+		__m128i sHi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(srcHi + i));
+		__m128i dLo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dstLo + i));
+		__m128i dHi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dstHi + i));
+		__m128i hide = _mm_and_si128(
+			transp, _mm_cmpeq_epi8(_mm_or_si128(sLo, sHi), zero));
+		__m128i m2Lo = _mm_andnot_si128(hide, mLo);
+		__m128i m2Hi = _mm_andnot_si128(hide, mHi);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dstLo + i),
+		                 select(m2Lo, f(sLo, dLo), dLo));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dstHi + i),
+		                 select(m2Hi, f(sHi, dHi), dHi));
+	}
+	copy16Scalar(srcLo + i, srcHi + i, dstLo + i, dstHi + i, num - i, op, mask);
+}
+#endif // __SSE2__
+
+template<unsigned BPP>
+inline void copy(const byte* __restrict src, byte* __restrict dst,
+                 unsigned num, byte op, byte mask)
+{
+#ifdef __SSE2__
+	copySSE2<BPP>(src, dst, num, op, mask);
+#else
+	copyScalar<BPP>(src, dst, num, op, mask);
+#endif
+}
+
+// Apply the logical operation with source bytes 'src' to the destination
+// bytes 'dst'. The two ranges must not overlap.
+inline void copy(const byte* __restrict src, byte* __restrict dst,
+                 unsigned num, byte op, byte mask, unsigned bpp)
+{
+	switch ((op & 0x10) ? bpp : 0) {
+		case 0: copy<0>(src, dst, num, op, mask); break;
+		case 2: copy<2>(src, dst, num, op, mask); break;
+		case 4: copy<4>(src, dst, num, op, mask); break;
+		case 8: copy<8>(src, dst, num, op, mask); break;
+		default: UNREACHABLE;
+	}
+}
+
+inline void copy16(const byte* __restrict srcLo, const byte* __restrict srcHi,
+                   byte* __restrict dstLo, byte* __restrict dstHi,
+                   unsigned num, byte op, word mask)
+{
+#ifdef __SSE2__
+	copy16SSE2(srcLo, srcHi, dstLo, dstHi, num, op, mask);
+#else
+	copy16Scalar(srcLo, srcHi, dstLo, dstHi, num, op, mask);
+#endif
+}
+
+// With a constant source byte the operation (including transparency and the
+// write mask) reduces to 'd = (d & andMask) ^ xorMask'.
+struct FillOp {
+	FillOp(byte op, byte s, byte mask, unsigned bpp)
+	{
+		switch ((op & 0x10) ? bpp : 0) {
+			case 0: break;
+			case 2: mask &= visibleBits<2>(s); break;
+			case 4: mask &= visibleBits<4>(s); break;
+			case 8: mask &= visibleBits<8>(s); break;
+			default: UNREACHABLE;
+		}
+		byte r0 =  mask & func(op, s, 0x00); // result for destination bit 0
+		byte r1 = ~mask | func(op, s, 0xFF); // result for destination bit 1
+		andMask = r0 ^ r1;
+		xorMask = r0;
+	}
+	byte andMask, xorMask;
+};
+
+// Portable version.
+inline void fillScalar(byte* dst, unsigned num, FillOp f)
+{
+	for (unsigned i = 0; i < num; ++i) {
+		dst[i] = (dst[i] & f.andMask) ^ f.xorMask;
+	}
+}
+
+#ifdef __SSE2__
+inline void fillSSE2(byte* dst, unsigned num, FillOp f)
+{
+	__m128i a = _mm_set1_epi8(f.andMask);
+	__m128i x = _mm_set1_epi8(f.xorMask);
+	unsigned i = 0;
+	for (/**/; (i + 16) <= num; i += 16) {
+		auto* p = reinterpret_cast<__m128i*>(dst + i);
+		_mm_storeu_si128(p, _mm_xor_si128(_mm_and_si128(_mm_loadu_si128(p), a), x));
+	}
+	fillScalar(dst + i, num - i, f);
+}
+#endif // __SSE2__
+
+// Apply the logical operation with constant source byte 'src' to 'num'
+// destination bytes.
+inline void fill(byte* dst, unsigned num, byte op, byte src, byte mask, unsigned bpp)
+{
+	FillOp f(op, src, mask, bpp);
+#ifdef __SSE2__
+	fillSSE2(dst, num, f);
+#else
+	fillScalar(dst, num, f);
+#endif
+}
+
+inline void fill16(byte* dstLo, byte* dstHi, unsigned num, byte op, word color, word mask)
+{
+	if ((op & 0x10) && (color == 0)) return; // transparent
+	fill(dstLo, num, op & 0x0F, color & 0xFF, mask & 0xFF, 8);
+	fill(dstHi, num, op & 0x0F, color >> 8,   mask >> 8,   8);
+}
+
+// Lookup tables for the per-pixel code: 'mode' is the kind of transparency,
+// the result is indexed as [256 * dst + src]. Tables are calculated when
+// they're first used.
+enum { LOG_NO_T, LOG_BPP2, LOG_BPP4, LOG_BPP8 };
+[[nodiscard]] const byte* getLUT(unsigned mode, unsigned op);
+
+} // namespace openmsx::V9990LogOp
+
+#endif
@@ -30,6 +30,7 @@ V9990PixelRenderer::V9990PixelRenderer(V9990& vdp_)
 {
 	frameSkipCounter = 999; // force drawing of frame;
 	finishFrameDuration = 0;
+	nextRenderTime = 0;
 	drawFrame = false; // don't draw before frameStart is called
 	prevDrawFrame = false;
 
@@ -75,6 +76,9 @@ void V9990PixelRenderer::frameStart(EmuTime::param time)
 		if (frameSkipCounter < renderSettings.getMinFrameSkip()) {
 			++frameSkipCounter;
 			drawFrame = false;
+		} else if (renderSettings.getRenderOnDemand() &&
+		           !rasterizer->isRecording()) {
+			drawFrame = isFrameShown(time);
 		} else if (frameSkipCounter >= renderSettings.getMaxFrameSkip()) {
 			frameSkipCounter = 0;
 			drawFrame = true;
@@ -103,6 +107,23 @@ void V9990PixelRenderer::frameStart(EmuTime::param time)
 	rasterizer->frameStart();
 }
 
+bool V9990PixelRenderer::isFrameShown(EmuTime::param time)
+{
+	// Same as in PixelRenderer.
+	++frameSkipCounter;
+	if (vdp.getMotherBoard().isFastForwarding()) return false;
+	auto now = Timer::getTime();
+	if (now < nextRenderTime) return false;
+	if ((frameSkipCounter <= renderSettings.getMaxFrameSkip()) &&
+	    !realTime.timeLeft(unsigned(finishFrameDuration), time)) {
+		return false;
+	}
+	uint64_t frameDuration = vdp.isPalTiming() ? 20000 : 16683; // us
+	nextRenderTime = now + frameDuration * 3 / 4;
+	frameSkipCounter = 0;
+	return true;
+}
+
 void V9990PixelRenderer::frameEnd(EmuTime::param time)
 {
 	bool skipEvent = !drawFrame;
@@ -5,6 +5,7 @@
 #include "Observer.hh"
 #include "RenderSettings.hh"
 #include "openmsx.hh"
+#include <cstdint>
 #include <memory>
 
 namespace openmsx {
@@ -49,6 +50,11 @@ private:
 	void sync(EmuTime::param time, bool force = false);
 	void renderUntil(EmuTime::param time) override;
 
+	/** Frame skip decision for render_on_demand.
+	  * @see PixelRenderer::isFrameShown()
+	  */
+	bool isFrameShown(EmuTime::param time);
+
 	/** Type of drawing to do.
 	  */
 	enum DrawType {
@@ -76,6 +82,7 @@ private:
 	  */
 	float finishFrameDuration;
 	int frameSkipCounter;
+	uint64_t nextRenderTime; // host time (us), for render_on_demand
 
 	/** Accuracy setting for current frame.
 	 */
@@ -78,6 +78,13 @@ public:
 		data.write(address, value);
 	}
 
+	/** Direct access to the VRAM data, for the bulk paths of the command
+	  * engine. See TrackedRam::getWriteBackdoor().
+	  */
+	inline byte* getWriteBackdoor() {
+		return data.getWriteBackdoor();
+	}
+
 	byte readVRAMCPU(unsigned address, EmuTime::param time);
 	void writeVRAMCPU(unsigned address, byte val, EmuTime::param time);
 